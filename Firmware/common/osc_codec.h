@@ -0,0 +1,157 @@
+#ifndef OSC_CODEC_H
+#define OSC_CODEC_H
+
+/*
+ * Compressed sample payload for the ESP32 -> browser binary WebSocket
+ * frames. Byte 3 of the 4-byte message header names the payload format:
+ * OSC_CODEC_RAW (little-endian uint16 samples) or OSC_CODEC_DELTA:
+ *
+ *   u16 sample count, u16 first sample, then the remaining samples in
+ *   blocks of OSC_CODEC_BLOCK residuals. Each block opens with a 6-bit
+ *   tag: bit 0 selects the predictor (0 = previous sample, 1 = linear
+ *   extrapolation from the previous two), bits 1-5 the width w of the
+ *   block's zigzag residuals, which follow at w bits each. Bits are
+ *   packed LSB first; trailing padding bytes are ignored.
+ *
+ * Flat stretches and RLE-like runs cost one tag per block, ADC noise and
+ * slopes a few bits per sample instead of 16. Per-block widths adapt to
+ * edges without a Huffman table, and the worst case still fits a 16-bit
+ * frame (producers fall back to raw when it doesn't shrink).
+ *
+ * Header-only like osc_frame.h; the decoder in esp32/data/index.html
+ * mirrors osc_codec_decode.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include "osc_frame.h"
+
+#define OSC_CODEC_RAW           0
+#define OSC_CODEC_DELTA         1
+#define OSC_CODEC_COUNT         2
+
+#define OSC_CODEC_BLOCK         16      // Residuals per width tag
+#define OSC_CODEC_TAG_BITS      6
+#define OSC_CODEC_HEADER        4       // Sample count + first sample
+
+// Encoder output bound: 18-bit residuals (linear predictor on 16-bit data) plus tags
+#define OSC_CODEC_MAX_BYTES(n)  (OSC_CODEC_HEADER + \
+    ((size_t)(n) * 18 + ((size_t)(n) / OSC_CODEC_BLOCK + 1) * OSC_CODEC_TAG_BITS + 7) / 8)
+
+/* ==================== BIT PACKING ==================== */
+typedef struct {
+    uint8_t *p;
+    uint32_t acc;
+    uint8_t bits;
+} OscBitWriter;
+
+typedef struct {
+    const uint8_t *p, *end;
+    uint32_t acc;
+    uint8_t bits;
+} OscBitReader;
+
+// n <= 18 and fewer than 8 bits pending, so acc never overflows
+static inline void osc_bits_put(OscBitWriter *w, uint32_t v, uint8_t n) {
+    w->acc |= v << w->bits;
+    w->bits += n;
+    while(w->bits >= 8) {
+        *w->p++ = (uint8_t)w->acc;
+        w->acc >>= 8;
+        w->bits -= 8;
+    }
+}
+
+// Reads past the end return zero bits (caller checks osc_bits_overrun)
+static inline uint32_t osc_bits_get(OscBitReader *r, uint8_t n) {
+    while(r->bits < n) {
+        r->acc |= (uint32_t)((r->p < r->end) ? *r->p : 0) << r->bits;
+        r->p++;
+        r->bits += 8;
+    }
+    uint32_t v = r->acc & ((1u << n) - 1);
+    r->acc >>= n;
+    r->bits -= n;
+    return v;
+}
+
+static inline int osc_bits_overrun(const OscBitReader *r) {
+    return r->p > r->end;
+}
+
+static inline uint32_t osc_zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t osc_unzigzag(uint32_t z) {
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+static inline uint8_t osc_bit_width(uint32_t v) {
+    uint8_t w = 0;
+    while(v) { w++; v >>= 1; }
+    return w;
+}
+
+/* ==================== ENCODE / DECODE ==================== */
+// Encode n samples into out[OSC_CODEC_MAX_BYTES(n)]; returns bytes written
+static inline size_t osc_codec_encode(const uint16_t *s, uint16_t n, uint8_t *out) {
+    OscBitWriter w = {out + OSC_CODEC_HEADER, 0, 0};
+    uint32_t res[2][OSC_CODEC_BLOCK];
+
+    osc_put16(out, n);
+    osc_put16(out + 2, n ? s[0] : 0);
+
+    for(uint32_t start = 1; start < n; start += OSC_CODEC_BLOCK) {
+        uint32_t len = (n - start < OSC_CODEC_BLOCK) ? n - start : OSC_CODEC_BLOCK;
+        uint32_t any[2] = {0, 0};
+
+        // Both predictors per block; OR of the residuals gives the width
+        for(uint32_t k = 0; k < len; k++) {
+            uint32_t i = start + k;
+            int32_t prev = s[i - 1];
+            int32_t lin = (i >= 2) ? 2 * prev - s[i - 2] : prev;
+            res[0][k] = osc_zigzag((int32_t)s[i] - prev);
+            res[1][k] = osc_zigzag((int32_t)s[i] - lin);
+            any[0] |= res[0][k];
+            any[1] |= res[1][k];
+        }
+
+        uint8_t w0 = osc_bit_width(any[0]), w1 = osc_bit_width(any[1]);
+        uint8_t p = (w1 < w0) ? 1 : 0;
+        uint8_t width = p ? w1 : w0;
+        osc_bits_put(&w, p | (width << 1), OSC_CODEC_TAG_BITS);
+        if(width) {
+            for(uint32_t k = 0; k < len; k++) osc_bits_put(&w, res[p][k], width);
+        }
+    }
+
+    if(w.bits) *w.p++ = (uint8_t)w.acc;
+    return (size_t)(w.p - out);
+}
+
+// Decode into out[max]; returns the sample count, or -1 if malformed
+static inline int osc_codec_decode(const uint8_t *in, size_t len, uint16_t *out, uint16_t max) {
+    if(len < OSC_CODEC_HEADER) return -1;
+    uint16_t n = osc_get16(in);
+    if(n > max) return -1;
+    if(n == 0) return 0;
+
+    OscBitReader r = {in + OSC_CODEC_HEADER, in + len, 0, 0};
+    out[0] = osc_get16(in + 2);
+
+    for(uint32_t start = 1; start < n; start += OSC_CODEC_BLOCK) {
+        uint32_t end = (n - start < OSC_CODEC_BLOCK) ? n : start + OSC_CODEC_BLOCK;
+        uint32_t tag = osc_bits_get(&r, OSC_CODEC_TAG_BITS);
+        uint8_t p = tag & 1, width = (uint8_t)(tag >> 1);
+        if(width > 18) return -1;
+
+        for(uint32_t i = start; i < end; i++) {
+            int32_t prev = out[i - 1];
+            int32_t pred = (p && i >= 2) ? 2 * prev - out[i - 2] : prev;
+            out[i] = (uint16_t)(pred + osc_unzigzag(width ? osc_bits_get(&r, width) : 0));
+        }
+    }
+    return osc_bits_overrun(&r) ? -1 : n;
+}
+
+#endif /* OSC_CODEC_H */
@@ -0,0 +1,328 @@
+#ifndef OSC_FRAME_H
+#define OSC_FRAME_H
+
+/*
+ * STM32 -> ESP32 SPI frame: fixed header followed by raw uint16 samples.
+ * Header fields are little-endian; CRC-16/CCITT covers every header byte
+ * before the trailing CRC. Newer producers may grow header_len, older
+ * decoders skip the fields they don't know; a new version byte means a
+ * layout they can't read and is refused.
+ *
+ * Frames flagged OSC_FRAME_RECORD grow the header to OSC_FRAME_RECORD_SIZE
+ * with the deep-memory record extension (bytes 70..85, CRC moves to the end).
+ * Zoom-FFT spectra (OSC_FRAME_ZOOM) use spare v1 bytes for their band:
+ * byte 33 is log2 of the decimation, bytes 66..69 the centre frequency;
+ * their peak frequencies are in mHz. Other spectra averaged as a Welch PSD
+ * put the segment count and overlap in bytes 34..35 and their tone and
+ * noise-floor levels in bytes 66..69 (0 dBFS = OSC_FRAME_FULL_SCALE_DBV).
+ * Record windows (OSC_FRAME_WINDOW, never zoomed) echo the tag of the I:
+ * request they answer in byte 33, so replies can be routed to whoever asked.
+ *
+ * Spectra (OSC_FRAME_SPECTRUM) grow the header to OSC_FRAME_SPECTRUM_SIZE
+ * with their sample scale (bytes 70..75): linear magnitudes scaled to the
+ * strongest bin, or dB with a fixed OSC_FRAME_DB_PER_LSB per code, code 0
+ * at db_floor_cdb below db_ref_cdbfs. Peak magnitudes use the same scale.
+ * Byte 71 and bytes 76..85 carry the distortion analysis of full-band
+ * spectra with measurements (dist_harmonics 0 = none). Spectra with more
+ * than OSC_FRAME_V1_PEAKS peaks append the rest from byte 86, frequency
+ * (u32) and magnitude (u16) each, and pad the header to a word boundary;
+ * older decoders keep the first five.
+ *
+ * Frames longer than OSC_FRAME_CHUNK_BYTES are split into consecutive
+ * SPI transactions; only the first carries the header, and its length
+ * fields tell the receiver how many continuation bytes to expect.
+ *
+ * Header-only and free of HAL/Arduino dependencies so the same code
+ * builds on both MCUs and on a host.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+/* ==================== FRAME LAYOUT ==================== */
+#define OSC_FRAME_MAGIC         0x4653  // "SF"
+#define OSC_FRAME_VERSION       1
+#define OSC_FRAME_HEADER_SIZE   72      // v1 header incl. CRC (keeps samples word-aligned)
+#define OSC_FRAME_V1_PEAKS      5       // Peak slots in the v1 header (bytes 36..65)
+#define OSC_FRAME_MAX_PEAKS     32
+#define OSC_FRAME_MAX_SAMPLES   8192    // Full ADC record
+#define OSC_FRAME_CHUNK_BYTES   2048    // Max bytes per CS-framed SPI transaction
+#define OSC_FRAME_RECORD_SIZE   88      // Header with the record extension (still word-aligned)
+#define OSC_FRAME_SPECTRUM_SIZE 88      // Header with the spectrum scale extension
+#define OSC_FRAME_PEAK_BYTES    6       // Each peak past OSC_FRAME_V1_PEAKS
+#define OSC_FRAME_MAX_HEADER    ((OSC_FRAME_SPECTRUM_SIZE + \
+                                  (OSC_FRAME_MAX_PEAKS - OSC_FRAME_V1_PEAKS) * OSC_FRAME_PEAK_BYTES + 3) & ~3)
+#define OSC_FRAME_MAX_BYTES     (OSC_FRAME_MAX_HEADER + OSC_FRAME_MAX_SAMPLES * 2)
+#define OSC_FRAME_FULL_SCALE_DBV 1.34f  // Full-scale sine (1.65 V peak, 3.3 V ADC) in dBV
+#define OSC_FRAME_DB_PER_LSB    0.01f   // dB spectrum sample step
+
+// Spectrum sample scales
+#define OSC_FRAME_SCALE_LINEAR  0
+#define OSC_FRAME_SCALE_DB      1
+
+// Frame flags
+#define OSC_FRAME_MEAS          0x01    // Measurement fields valid
+#define OSC_FRAME_SPECTRUM      0x02    // Samples are FFT magnitudes
+#define OSC_FRAME_TRIGGERED     0x04    // Trigger-aligned capture
+#define OSC_FRAME_FORCED        0x08    // Auto-mode free run (no edge)
+#define OSC_FRAME_ENVELOPE      0x10    // Samples are (min,max) pairs per bucket
+#define OSC_FRAME_RECORD        0x20    // Header carries the deep-record extension
+#define OSC_FRAME_WINDOW        0x40    // Reply to a record window request, not a live frame
+#define OSC_FRAME_ZOOM          0x80    // Spectrum of a band around zoom_center_hz (peaks in mHz)
+
+// Decode results
+#define OSC_FRAME_OK            0
+#define OSC_FRAME_ERR_SHORT     -1      // Buffer smaller than header/payload
+#define OSC_FRAME_ERR_MAGIC     -2      // Not a frame (sync lost / idle bus)
+#define OSC_FRAME_ERR_VERSION   -3      // Unknown major layout
+#define OSC_FRAME_ERR_CRC       -4      // Header corrupted
+
+typedef struct {
+    uint8_t  version;
+    uint8_t  flags;
+    uint16_t header_len;            // Bytes before the samples
+    uint16_t sample_count;          // uint16 samples after the header
+    uint32_t seq;                   // Frame counter (gaps = dropped frames)
+    uint32_t sample_rate_hz;
+    uint16_t amplitude_mv;
+    uint16_t period_us;
+    uint16_t vrms_mv;
+    uint16_t duty_percent;
+    uint16_t vmax_mv, vmin_mv;
+    uint32_t frequency_hz;
+    uint8_t  num_peaks;
+    uint32_t peak_freqs[OSC_FRAME_MAX_PEAKS];
+    uint16_t peak_mags[OSC_FRAME_MAX_PEAKS];
+    // Zoom band (OSC_FRAME_ZOOM): sample_rate_hz / 2^zoom_log2 wide
+    uint32_t zoom_center_hz;
+    uint8_t  zoom_log2;             // log2 of the decimation
+    // Welch PSD (spectra with psd_segments != 0, never zoomed)
+    uint8_t  psd_segments;          // Segments averaged
+    uint8_t  psd_overlap;           // Segment overlap, percent
+    int16_t  psd_tone_cdbfs;        // Strongest tone power, 0.01 dBFS
+    int16_t  psd_floor_cdbfs;       // Noise density, 0.01 dBFS/Hz
+    // Spectrum extension (OSC_FRAME_SPECTRUM)
+    uint8_t  db_scale;              // OSC_FRAME_SCALE_*
+    int16_t  db_ref_cdbfs;          // Reference level, 0.01 dBFS
+    int16_t  db_floor_cdb;          // Level of code 0 below the reference, 0.01 dB (negative)
+    uint8_t  dist_harmonics;        // Harmonics in THD (0 = no distortion analysis)
+    int16_t  thd_cdb;               // 0.01 dBc
+    int16_t  thdn_cdb;              // THD+N, 0.01 dBc (SINAD = -THD+N)
+    int16_t  snr_cdb;               // 0.01 dB
+    int16_t  sfdr_cdb;              // 0.01 dB
+    uint16_t enob_cbits;            // 0.01 bit
+    // Record extension (OSC_FRAME_RECORD)
+    uint32_t rec_start, rec_span;   // Record samples behind this frame (span 0 = live only)
+    uint32_t rec_total;             // Samples held in the record
+    uint16_t rec_id;                // Changes whenever the record content does
+    uint8_t  rec_segments;          // 1 = single record, N = segmented
+    uint8_t  rec_filled;            // Segments captured so far
+    uint8_t  rec_tag;               // OSC_FRAME_WINDOW: tag of the I: request (0 = untagged)
+} OscFrameHeader;
+
+/* ==================== BYTE HELPERS ==================== */
+static inline void osc_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void osc_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t osc_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t osc_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+static inline uint16_t osc_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    while(len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for(uint8_t b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/* ==================== ENCODE / DECODE ==================== */
+// Record and spectrum extensions share bytes 70..85 (a frame is never both)
+static inline uint8_t osc_frame_peak_slots(uint8_t flags) {
+    return ((flags & (OSC_FRAME_SPECTRUM | OSC_FRAME_RECORD)) == OSC_FRAME_SPECTRUM) ?
+           OSC_FRAME_MAX_PEAKS : OSC_FRAME_V1_PEAKS;
+}
+
+static inline size_t osc_frame_header_len(uint8_t flags, uint8_t num_peaks) {
+    if(flags & OSC_FRAME_RECORD) return OSC_FRAME_RECORD_SIZE;
+    if(!(flags & OSC_FRAME_SPECTRUM)) return OSC_FRAME_HEADER_SIZE;
+    if(num_peaks <= OSC_FRAME_V1_PEAKS) return OSC_FRAME_SPECTRUM_SIZE;
+    if(num_peaks > OSC_FRAME_MAX_PEAKS) num_peaks = OSC_FRAME_MAX_PEAKS;
+    return (OSC_FRAME_SPECTRUM_SIZE + (num_peaks - OSC_FRAME_V1_PEAKS) * OSC_FRAME_PEAK_BYTES + 3) & ~3u;
+}
+
+// Write a v1 header into out[osc_frame_header_len(h->flags, h->num_peaks)];
+// returns bytes written
+static inline size_t osc_frame_encode(const OscFrameHeader *h, uint8_t *out) {
+    uint8_t slots = osc_frame_peak_slots(h->flags);
+    uint8_t n = (h->num_peaks > slots) ? slots : h->num_peaks;
+    size_t len = osc_frame_header_len(h->flags, n);
+
+    for(size_t i = 0; i < len; i++) out[i] = 0;
+    osc_put16(out + 0, OSC_FRAME_MAGIC);
+    out[2] = OSC_FRAME_VERSION;
+    out[3] = h->flags;
+    osc_put16(out + 4, (uint16_t)len);
+    osc_put16(out + 6, h->sample_count);
+    osc_put32(out + 8, h->seq);
+    osc_put32(out + 12, h->sample_rate_hz);
+    osc_put16(out + 16, h->amplitude_mv);
+    osc_put16(out + 18, h->period_us);
+    osc_put16(out + 20, h->vrms_mv);
+    osc_put16(out + 22, h->duty_percent);
+    osc_put16(out + 24, h->vmax_mv);
+    osc_put16(out + 26, h->vmin_mv);
+    osc_put32(out + 28, h->frequency_hz);
+    out[32] = n;
+    for(uint8_t i = 0; i < n; i++) {
+        if(i < OSC_FRAME_V1_PEAKS) {
+            osc_put32(out + 36 + 4 * i, h->peak_freqs[i]);
+            osc_put16(out + 56 + 2 * i, h->peak_mags[i]);
+        } else {
+            uint8_t *p = out + 86 + OSC_FRAME_PEAK_BYTES * (i - OSC_FRAME_V1_PEAKS);
+            osc_put32(p, h->peak_freqs[i]);
+            osc_put16(p + 4, h->peak_mags[i]);
+        }
+    }
+    if(h->flags & OSC_FRAME_ZOOM) {
+        out[33] = h->zoom_log2;
+        osc_put32(out + 66, h->zoom_center_hz);
+    } else if(h->psd_segments) {
+        out[34] = h->psd_segments;
+        out[35] = h->psd_overlap;
+        osc_put16(out + 66, (uint16_t)h->psd_tone_cdbfs);
+        osc_put16(out + 68, (uint16_t)h->psd_floor_cdbfs);
+    }
+    if((h->flags & (OSC_FRAME_ZOOM | OSC_FRAME_WINDOW)) == OSC_FRAME_WINDOW) out[33] = h->rec_tag;
+    if(h->flags & OSC_FRAME_RECORD) {
+        osc_put32(out + 70, h->rec_start);
+        osc_put32(out + 74, h->rec_span);
+        osc_put32(out + 78, h->rec_total);
+        osc_put16(out + 82, h->rec_id);
+        out[84] = h->rec_segments;
+        out[85] = h->rec_filled;
+    } else if(h->flags & OSC_FRAME_SPECTRUM) {
+        out[70] = h->db_scale;
+        osc_put16(out + 72, (uint16_t)h->db_ref_cdbfs);
+        osc_put16(out + 74, (uint16_t)h->db_floor_cdb);
+        if(h->dist_harmonics) {
+            out[71] = h->dist_harmonics;
+            osc_put16(out + 76, (uint16_t)h->thd_cdb);
+            osc_put16(out + 78, (uint16_t)h->thdn_cdb);
+            osc_put16(out + 80, (uint16_t)h->snr_cdb);
+            osc_put16(out + 82, (uint16_t)h->sfdr_cdb);
+            osc_put16(out + 84, h->enob_cbits);
+        }
+    }
+    osc_put16(out + len - 2, osc_crc16(out, len - 2));
+    return len;
+}
+
+// Validate and parse a header; len is the number of bytes available
+// (samples may still be arriving in continuation chunks)
+static inline int osc_frame_decode(const uint8_t *in, size_t len, OscFrameHeader *h) {
+    if(len < OSC_FRAME_HEADER_SIZE) return OSC_FRAME_ERR_SHORT;
+    if(osc_get16(in) != OSC_FRAME_MAGIC) return OSC_FRAME_ERR_MAGIC;
+    if(in[2] < 1 || in[2] > OSC_FRAME_VERSION) return OSC_FRAME_ERR_VERSION;
+
+    uint16_t hlen = osc_get16(in + 4);
+    if(hlen < OSC_FRAME_HEADER_SIZE || hlen > len) return OSC_FRAME_ERR_VERSION;
+    if(osc_get16(in + hlen - 2) != osc_crc16(in, hlen - 2)) return OSC_FRAME_ERR_CRC;
+
+    h->version = in[2];
+    h->flags = in[3];
+    h->header_len = hlen;
+    h->sample_count = osc_get16(in + 6);
+    h->seq = osc_get32(in + 8);
+    h->sample_rate_hz = osc_get32(in + 12);
+    h->amplitude_mv = osc_get16(in + 16);
+    h->period_us = osc_get16(in + 18);
+    h->vrms_mv = osc_get16(in + 20);
+    h->duty_percent = osc_get16(in + 22);
+    h->vmax_mv = osc_get16(in + 24);
+    h->vmin_mv = osc_get16(in + 26);
+    h->frequency_hz = osc_get32(in + 28);
+    // Peaks past the v1 slots only where the header holds them all
+    h->num_peaks = (in[32] > OSC_FRAME_MAX_PEAKS) ? OSC_FRAME_MAX_PEAKS : in[32];
+    if(h->num_peaks > OSC_FRAME_V1_PEAKS &&
+       (osc_frame_peak_slots(h->flags) == OSC_FRAME_V1_PEAKS ||
+        hlen < OSC_FRAME_SPECTRUM_SIZE + OSC_FRAME_PEAK_BYTES * (h->num_peaks - OSC_FRAME_V1_PEAKS)))
+        h->num_peaks = OSC_FRAME_V1_PEAKS;
+    for(uint8_t i = 0; i < OSC_FRAME_MAX_PEAKS; i++) {
+        if(i < OSC_FRAME_V1_PEAKS) {
+            h->peak_freqs[i] = osc_get32(in + 36 + 4 * i);
+            h->peak_mags[i] = osc_get16(in + 56 + 2 * i);
+        } else if(i < h->num_peaks) {
+            const uint8_t *p = in + 86 + OSC_FRAME_PEAK_BYTES * (i - OSC_FRAME_V1_PEAKS);
+            h->peak_freqs[i] = osc_get32(p);
+            h->peak_mags[i] = osc_get16(p + 4);
+        } else {
+            h->peak_freqs[i] = 0;
+            h->peak_mags[i] = 0;
+        }
+    }
+
+    h->zoom_center_hz = (h->flags & OSC_FRAME_ZOOM) ? osc_get32(in + 66) : 0;
+    h->zoom_log2 = (h->flags & OSC_FRAME_ZOOM) ? in[33] : 0;
+    h->rec_tag = ((h->flags & (OSC_FRAME_ZOOM | OSC_FRAME_WINDOW)) == OSC_FRAME_WINDOW) ? in[33] : 0;
+
+    h->psd_segments = (h->flags & OSC_FRAME_ZOOM) ? 0 : in[34];
+    h->psd_overlap = h->psd_segments ? in[35] : 0;
+    h->psd_tone_cdbfs = h->psd_segments ? (int16_t)osc_get16(in + 66) : 0;
+    h->psd_floor_cdbfs = h->psd_segments ? (int16_t)osc_get16(in + 68) : 0;
+
+    h->rec_start = h->rec_span = h->rec_total = 0;
+    h->rec_id = 0;
+    h->rec_segments = h->rec_filled = 0;
+    if((h->flags & OSC_FRAME_RECORD) && hlen >= OSC_FRAME_RECORD_SIZE) {
+        h->rec_start = osc_get32(in + 70);
+        h->rec_span = osc_get32(in + 74);
+        h->rec_total = osc_get32(in + 78);
+        h->rec_id = osc_get16(in + 82);
+        h->rec_segments = in[84];
+        h->rec_filled = in[85];
+    }
+
+    h->db_scale = OSC_FRAME_SCALE_LINEAR;
+    h->db_ref_cdbfs = h->db_floor_cdb = 0;
+    h->dist_harmonics = 0;
+    h->thd_cdb = h->thdn_cdb = h->snr_cdb = h->sfdr_cdb = 0;
+    h->enob_cbits = 0;
+    if(!(h->flags & OSC_FRAME_RECORD) && (h->flags & OSC_FRAME_SPECTRUM) &&
+       hlen >= OSC_FRAME_SPECTRUM_SIZE) {
+        h->db_scale = in[70];
+        h->db_ref_cdbfs = (int16_t)osc_get16(in + 72);
+        h->db_floor_cdb = (int16_t)osc_get16(in + 74);
+        h->dist_harmonics = in[71];
+        if(h->dist_harmonics) {
+            h->thd_cdb = (int16_t)osc_get16(in + 76);
+            h->thdn_cdb = (int16_t)osc_get16(in + 78);
+            h->snr_cdb = (int16_t)osc_get16(in + 80);
+            h->sfdr_cdb = (int16_t)osc_get16(in + 82);
+            h->enob_cbits = osc_get16(in + 84);
+        }
+    }
+
+    if(h->sample_count > OSC_FRAME_MAX_SAMPLES) return OSC_FRAME_ERR_VERSION;
+    return OSC_FRAME_OK;
+}
+
+// Total frame size (header + samples) announced by a decoded header
+static inline size_t osc_frame_length(const OscFrameHeader *h) {
+    return (size_t)h->header_len + (size_t)h->sample_count * 2;
+}
+
+#endif /* OSC_FRAME_H */
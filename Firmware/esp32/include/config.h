@@ -2,13 +2,54 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "osc_frame.h"
 
 // ==================== NETWORK CONFIGURATION ====================
 extern const char* SSID;
 extern const char* PASSWORD;
 
 // ==================== BUFFER CONFIGURATION ====================
-static constexpr uint32_t BUFFER_SIZE = 512;
+static constexpr uint32_t BUFFER_SIZE = OSC_FRAME_CHUNK_BYTES;      // One SPI transaction
+static constexpr uint32_t FRAME_BUFFER_SIZE = OSC_FRAME_MAX_BYTES;  // Reassembled frame (PSRAM)
+static constexpr uint16_t DEFAULT_RESOLUTION = 256;                 // Samples per client frame
+static constexpr uint32_t SPI_QUEUE_DEPTH = 3;      // DMA transactions kept armed
+static constexpr uint32_t SPI_FRAME_SLOTS = 3;      // Reassembled frames (one being filled)
+
+// ==================== TASK CONFIGURATION ====================
+// WiFi/lwIP run on core 0; the bridge tasks share core 1, highest priority
+// nearest the incoming data so logging and JSON never delay a frame
+static constexpr BaseType_t SPI_TASK_CORE = 1;
+static constexpr BaseType_t BRIDGE_TASK_CORE = 1;
+static constexpr UBaseType_t SPI_TASK_PRIORITY = 5;        // SPI ingest
+static constexpr UBaseType_t EGRESS_TASK_PRIORITY = 4;     // WebSocket egress
+static constexpr UBaseType_t UART_TASK_PRIORITY = 3;       // UART ingest / command TX
+static constexpr UBaseType_t HOUSEKEEPING_TASK_PRIORITY = 1;
+static constexpr uint32_t SPI_TASK_STACK = 4096;
+static constexpr uint32_t EGRESS_TASK_STACK = 6144;
+static constexpr uint32_t UART_TASK_STACK = 4096;
+static constexpr uint32_t HOUSEKEEPING_TASK_STACK = 4096;
+static constexpr UBaseType_t RECORDER_TASK_PRIORITY = 1;   // Flash writes / replay reads
+static constexpr uint32_t RECORDER_TASK_STACK = 4096;
+
+static constexpr uint32_t EGRESS_IDLE_MS = 20;        // Egress wakes at least this often
+static constexpr uint32_t UART_POLL_MS = 5;           // UART RX poll while TX queue is idle
+static constexpr uint32_t UART_TX_QUEUE_LEN = 8;      // Pending STM32 commands
+static constexpr uint32_t STM_CMD_LEN = 32;
+static constexpr uint32_t LOG_QUEUE_LEN = 16;         // Pending console lines
+static constexpr uint32_t LOG_LINE_LEN = 128;
+
+// ==================== STM32 PROFILE ====================
+static constexpr uint8_t PROFILE_MAX_PROBES = 16;     // P: dump lines kept
+static constexpr uint8_t PROFILE_HIST_BUCKETS = 16;   // Log2 cycle buckets per probe
+
+// ==================== RECORDER ====================
+// Frames are delta-coded into RAM chunks by the egress task and written
+// one flash sector at a time by the recorder task
+#define RECORD_PATH "/rec.bin"
+static constexpr uint32_t RECORD_CHUNK_BYTES = 4096;  // SPIFFS block / flash sector
+static constexpr uint32_t RECORD_CHUNKS = 8;          // RAM ring between egress and flash
+static constexpr uint32_t RECORD_RESERVE_BYTES = 65536;   // Left free for SPIFFS GC
+static constexpr uint32_t RECORD_MEAS_INTERVAL = 200;     // ms between measurement records
 
 // ==================== WEBSOCKET CONFIGURATION ====================
 static constexpr uint32_t MAX_WS_CLIENTS = 4;
@@ -16,6 +57,11 @@ static constexpr uint32_t WS_TIMEOUT_MS = 15000;      // Increased timeout
 static constexpr uint32_t WS_PING_INTERVAL = 5000;
 static constexpr uint32_t WS_BINARY_INTERVAL = 80;    // Slower: ~12 FPS (was 50ms/20fps)
 static constexpr uint32_t WS_TEXT_INTERVAL = 250;     // Slower: 4 Hz (was 100ms/10hz)
+static constexpr uint32_t WS_FRAME_POOL = 6;          // Shared binary frame buffers in flight
+static constexpr uint32_t WS_CODEC_PAD = 64;          // Compressed frames rounded up for pool reuse
+static constexpr uint8_t WS_FRAME_ENVELOPE = 0x80;    // Mode byte flag: samples are (min,max) pairs
+static constexpr uint8_t WS_FRAME_WINDOW = 0x40;      // Mode byte flag: deep-record window (I: reply)
+static constexpr uint32_t WS_WINDOW_HEADER = 20;      // Window message header before the samples
 
 // ==================== FFT CONFIGURATION ====================
 static constexpr uint32_t FFT_SIZE = 4096;
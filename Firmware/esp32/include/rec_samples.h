@@ -0,0 +1,20 @@
+#ifndef REC_SAMPLES_H
+#define REC_SAMPLES_H
+
+/*
+ * Sample coding of REC_FRAME records (recorder.cpp): each sample as a
+ * zigzag varint of its delta to the previous one, the first against 0.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+// Worst case (a full-scale 16-bit step) is 3 bytes per sample
+#define REC_SAMPLES_MAX_BYTES(n)    (3 * (size_t)(n))
+
+// Returns the bytes written to out
+size_t encodeSamples(const uint16_t* s, uint16_t n, uint8_t* out);
+
+// False if [p, end) runs out or holds a varint longer than 3 bytes
+bool decodeSamples(const uint8_t* p, const uint8_t* end, uint16_t* s, uint16_t n);
+
+#endif
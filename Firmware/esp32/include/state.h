@@ -17,6 +17,9 @@ struct SharedState {
     uint8_t dutyCycle;
     bool running;
     uint32_t lastChangeTime;
+    uint8_t trigMode;       // 0=Off, 1=Auto, 2=Normal, 3=Single (G: command)
+    uint16_t trigLevel;     // mV (L: command)
+    uint8_t trigEdge;       // 0=Rising, 1=Falling (J: command)
     
     void reset() {
         displayMode = MODE_TIME_DOMAIN;
@@ -25,6 +28,9 @@ struct SharedState {
         dutyCycle = 50;
         running = true;
         lastChangeTime = millis();
+        trigMode = 0;
+        trigLevel = 1650;
+        trigEdge = 0;
     }
 };
 
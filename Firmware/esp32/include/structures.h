@@ -2,6 +2,7 @@
 #define STRUCTURES_H
 
 #include <Arduino.h>
+#include "config.h"
 
 // ==================== MEASUREMENT DATA STRUCTURE ====================
 struct MeasData {
@@ -9,10 +10,17 @@ struct MeasData {
   float frequency_hz;
   float period_us;
   float vrms_mv;
-  uint32_t peak_freqs[5];
-  uint16_t peak_mags[5];
-  uint8_t num_peaks;
+  float peak_freqs[OSC_FRAME_MAX_PEAKS];  // Hz, strongest first (zoom spectra resolve below 1 Hz)
+  uint16_t peak_mags[OSC_FRAME_MAX_PEAKS];
+  uint8_t num_peaks;               // As many as the frame carries (DP: command)
   bool valid;
+  uint8_t psd_segments;            // Welch PSD behind the spectrum (0 = EMA)
+  uint8_t psd_overlap;             // Percent
+  float psd_tone_dbfs;             // Strongest tone
+  float psd_floor_dbfs;            // Noise density, dBFS/Hz
+  uint8_t dist_harmonics;          // Harmonics in THD (0 = no distortion analysis)
+  float thd_db, thdn_db, snr_db, sfdr_db;  // dBc / dB
+  float enob;                      // Bits, full-scale referred
   
   float amp_history[8], freq_history[8], period_history[8], vrms_history[8];
   uint8_t history_idx;
@@ -22,6 +30,39 @@ struct MeasData {
   void reset();
 };
 
+// ==================== FFT BAND ====================
+// Band the spectra on the wire cover: the whole rfft (0..Nyquist) or the
+// zoom-FFT band a frame header names (OSC_FRAME_ZOOM)
+struct FftBand {
+  uint32_t sample_rate;           // ADC rate
+  uint32_t center_hz;             // Zoom band centre (0 = full spectrum)
+  uint8_t  zoom_log2;             // Zoom decimation (log2)
+  uint8_t  db_scale;              // Samples in dB (OSC_FRAME_SCALE_DB)
+  int16_t  db_ref_cdbfs;          // dB reference, 0.01 dBFS
+  int16_t  db_floor_cdb;          // Code 0 below the reference, 0.01 dB
+
+  bool note(uint32_t rate, uint32_t center, uint8_t log2);  // true if it moved
+  bool noteScale(uint8_t scale, int16_t ref_cdbfs, int16_t floor_cdb);  // true if it changed
+  bool noteFrame(const OscFrameHeader& hdr);  // Band and scale of a spectrum header; true if either changed
+  float span() const;             // Displayed width in Hz
+  float minFreq() const;
+  float hzPerBin() const;
+  String json() const;            // "fftParams" object
+};
+
+// ==================== DEEP-MEMORY RECORD ====================
+// STM32 record behind live frames, as their headers describe it; clients
+// hear about changes in a "record" message and fetch windows of it with I:
+struct DeepRecord {
+  uint32_t total;                 // Samples held (0 = no deep record)
+  uint32_t rate;
+  uint16_t id;                    // Changes whenever the content does
+  uint8_t  segments, filled;
+
+  bool note(const OscFrameHeader& hdr);  // true if the layout changed
+  String json() const;            // "record" message
+};
+
 // ==================== SIGNAL STATISTICS STRUCTURE ====================
 struct SignalStats {
   float stability;
@@ -33,6 +74,151 @@ struct SignalStats {
   void reset();
 };
 
+// ==================== STM32 ACQUISITION STATISTICS ====================
+// Reply to the Q command: frame rate and share of ADC samples never processed
+struct AcqStats {
+  uint16_t fps;
+  uint16_t dead_permille;
+  uint32_t overruns;
+  bool continuous;
+  uint32_t lastUpdate;
+};
+
+// ==================== STM32 MEMORY BUDGET ====================
+// Reply to the H command: SRAM split in bytes, longest deep record in samples
+struct MemStats {
+  uint32_t ram;
+  uint32_t staticBytes;     // .data + .bss
+  uint32_t acqMemory;       // ADC record + FFT working set + deep-only tail
+  uint32_t fftShared;       // FFT buffers a single deep record overlays
+  uint32_t deepExtra;       // SRAM used by deep records alone
+  uint32_t recordMax;       // Samples in a single deep record
+  uint32_t heap;
+  uint32_t stackPeak;       // Deepest stack use since boot
+  uint32_t free;            // Never touched between heap and stack
+  uint32_t pyramid;         // Min/max/sum index over acq_memory
+  uint32_t lastUpdate;      // 0 = no report received yet
+};
+
+// ==================== STM32 PROFILE ====================
+// Reply to P:2, one line per probe point of the STM32 main loop (cycles)
+struct ProfileProbe {
+  char name[16];
+  uint32_t count;
+  uint32_t avg, min, max;
+  uint32_t hist[PROFILE_HIST_BUCKETS];
+};
+
+struct ProfileStats {
+  ProfileProbe probes[PROFILE_MAX_PROBES];
+  uint8_t count;            // Probes in the last complete dump
+  uint8_t pending;          // Lines received for the dump in progress
+  bool enabled;
+  uint32_t overhead;        // Cycles one probe adds to the STM32 loop
+  uint32_t calls;           // Probe hits in the window
+  uint32_t windowMs;
+  uint16_t clockMhz;
+  uint8_t histMinLog2;      // Bucket 0 upper bound = 2^(histMinLog2+1) cycles
+  uint32_t lastUpdate;      // 0 = no dump received yet
+};
+
+// ==================== SPI FRAME STATISTICS ====================
+// Header validation results for frames received from the STM32
+struct FrameStats {
+  uint32_t ok;
+  uint32_t crcErrors;
+  uint32_t syncErrors;      // Bad magic/version/length, stray continuation chunks
+  uint32_t incomplete;      // Multi-chunk frames cut short by the next header
+  uint32_t lost;            // Sequence gaps (frames the STM32 sent but we missed)
+  uint32_t received;        // Frames reassembled by the SPI task
+  uint32_t dropped;         // Reassembled but the frame queue was full
+  uint32_t overruns;        // SPI ring ran out of armed buffers
+  uint32_t lastSeq;
+  uint32_t bySize[4];       // Frames per size class: <=256, <=1024, <=4096, larger
+  uint16_t size;            // Samples in the last frame
+  uint16_t fps;             // Frames per second (last full second)
+  uint32_t bytesPerSec;
+  uint32_t windowStart, windowFrames, windowBytes;
+};
+
+// ==================== SPI FRAME REASSEMBLY ====================
+// Frames longer than OSC_FRAME_CHUNK_BYTES arrive as consecutive SPI
+// transactions. A chunk starting with a valid header opens a frame (cutting
+// short one still open); anything else continues the open frame.
+struct FrameAssembler {
+  size_t len;               // Bytes collected so far
+  size_t expected;          // Total announced by the header (0 = idle)
+
+  // Add one chunk to dst[0, cap); true once a whole frame is in dst[0, len)
+  bool add(uint8_t* dst, size_t cap, const uint8_t* chunk, size_t n, FrameStats& stats);
+  void reset();
+};
+
+// ==================== WEBSOCKET FAN-OUT STATISTICS ====================
+// Cost of turning SPI frames into WebSocket messages
+struct FanoutStats {
+  uint32_t frames;          // SPI frames fanned out to at least one client
+  uint32_t messages;        // Binary messages queued (one per client per frame)
+  uint32_t copyBytes;       // Bytes copied into shared buffers
+  uint32_t sentBytes;       // Bytes referenced by queued messages
+  uint32_t allocs;          // Pool buffer (re)allocations
+  uint32_t poolMisses;      // No idle buffer: frame skipped for that class
+  uint32_t codecRawBytes;   // Raw size of the frames sent compressed
+  uint32_t codecBytes;      // Their compressed size (padding included)
+  uint32_t latencyUs;       // SPI frame complete -> queued on sockets (last frame)
+  uint32_t latencyMaxUs;
+};
+
+// ==================== TASK DIAGNOSTICS ====================
+enum BridgeTask {
+  TASK_SPI = 0,
+  TASK_UART,
+  TASK_EGRESS,
+  TASK_HOUSEKEEPING,
+  TASK_RECORDER,
+  NUM_BRIDGE_TASKS
+};
+
+// Each task accounts its own working time (blocking waits excluded)
+struct TaskStats {
+  TaskHandle_t handle;
+  uint64_t busyUs;
+  uint64_t windowBusyUs;    // busyUs at the start of the load window
+  uint16_t loadPermille;    // Share of one core over the last window
+};
+
+// Bounded inter-task queue occupancy
+struct QueueStats {
+  uint16_t capacity;
+  uint16_t highWater;
+  uint32_t dropped;         // Items refused because the queue was full
+};
+
+// ==================== RECORDER ====================
+enum RecorderState {
+  REC_IDLE = 0,
+  REC_RECORDING,
+  REC_REPLAYING
+};
+
+// Replay handoff from the recorder task to the egress task
+enum ReplayItem {
+  REPLAY_NONE = 0,
+  REPLAY_FRAME,             // Header + samples to fan out
+  REPLAY_SETTINGS,          // Recorded scope settings
+  REPLAY_END                // Replay finished or aborted
+};
+
+struct RecorderStats {
+  RecorderState state;
+  uint32_t bytes;           // Bytes on flash (readable through /recording)
+  uint32_t limit;           // Size at which recording stops by itself
+  uint32_t frames;          // Frame records written (or replayed)
+  uint32_t writeErrors;     // Short flash writes (recording stopped)
+  uint32_t interval;        // Minimum ms between recorded frames (0 = all)
+  uint32_t durationMs;      // Timestamp of the last record
+};
+
 // ==================== SCOPE STATE (Synced Across All Clients) ====================
 // This tracks the current UI state so new clients get the right initial state
 // and all clients stay in sync
@@ -0,0 +1,107 @@
+#ifndef WS_FRAMES_H
+#define WS_FRAMES_H
+
+/*
+ * SPI frames -> WebSocket messages, independent of the socket library:
+ * resolution classes, decimation, binary payloads in both formats, record
+ * windows, the JSON messages and command parsing. main.cpp drives them
+ * through AsyncWebSocket, the host simulator through its own server.
+ */
+#include <Arduino.h>
+#include "config.h"
+#include "structures.h"
+#include "state.h"
+#include "osc_codec.h"
+
+// ==================== TIMING ====================
+static constexpr uint32_t BINARY_INTERVAL_NORMAL = 50;    // 20 FPS when healthy
+static constexpr uint32_t BINARY_INTERVAL_SLOW = 150;     // ~7 FPS when stressed
+static constexpr uint32_t MEAS_INTERVAL = 500;            // 2 Hz for measurements
+static constexpr uint32_t MEAS_UPDATE_INTERVAL = 200;     // Frame header -> smoothing history
+
+// ==================== FRAME RESOLUTION ====================
+// Resolution classes offered to clients (0 = full record)
+static constexpr uint8_t NUM_RESOLUTIONS = 4;
+extern const uint16_t RESOLUTIONS[NUM_RESOLUTIONS];
+
+uint8_t resolutionClass(uint16_t samples);
+
+// Reduce a frame for a lower-resolution client: spectrum keeps the bin
+// maxima, envelopes merge whole (min,max) pairs, time domain takes evenly
+// spaced samples (STM32 normal mode)
+void decimateFrame(const uint16_t* src, uint32_t n, uint16_t* dst, uint32_t m, uint8_t flags);
+
+// ==================== BINARY PAYLOADS ====================
+// 4-byte message header: mode byte (| WS_FRAME_ENVELOPE), running, system
+// speed, payload format
+void putFrameHeader(uint8_t* buf, uint8_t flags, uint8_t codec, uint8_t speed);
+
+// Buffer for one payload variant, handed out by the transport
+struct WsPayload {
+    uint8_t* data;
+    size_t len;
+    void* handle;               // Transport's own buffer object
+};
+typedef bool (*WsAcquire)(size_t len, WsPayload& out, void* ctx);
+
+// Scratch the builder codes into (null = no delta payloads)
+struct WsScratch {
+    uint8_t* codec;             // 4 + OSC_CODEC_MAX_BYTES(OSC_FRAME_MAX_SAMPLES)
+    uint16_t* samples;          // OSC_FRAME_MAX_SAMPLES, decimated when no raw variant holds them
+};
+
+// Build each wanted (resolution class, format) variant of a frame once.
+// Delta payloads are padded to WS_CODEC_PAD for buffer reuse; when coding
+// doesn't beat raw the class's raw payload stands in for them. Variants
+// that got no buffer stay null.
+void buildFrameVariants(const uint16_t* samples, size_t count, uint8_t flags, uint8_t speed,
+                        const bool wanted[NUM_RESOLUTIONS][OSC_CODEC_COUNT],
+                        WsPayload built[NUM_RESOLUTIONS][OSC_CODEC_COUNT],
+                        const WsScratch& scratch, WsAcquire acquire, void* ctx, FanoutStats& stats);
+
+// I: reply: mode byte with WS_FRAME_WINDOW, then u32 start, span and record
+// total, u16 record id, segments, filled and the raw samples (envelope
+// windows are (min,max) pairs). buf holds WS_WINDOW_HEADER + 2 * sample_count;
+// returns the message length
+size_t buildWindowMessage(uint8_t* buf, const OscFrameHeader& hdr, const uint16_t* samples, uint8_t speed);
+
+// ==================== RECORD WINDOWS ====================
+// Who gets which I: reply. A client keeps one tag while it is connected
+// (fresh per client, never 0) and the STM32 echoes it in rec_tag; a client's
+// newer request takes its queued one's place there, so up to SLOTS clients
+// can't push each other's requests out of the STM32's DEEP_WINDOW_QUEUE
+struct WindowRoutes {
+    static constexpr uint8_t SLOTS = MAX_WS_CLIENTS;
+    uint32_t clients[SLOTS];    // 0 = free
+    uint8_t tags[SLOTS];
+    uint32_t issued[SLOTS];     // Tag count when the slot was taken (oldest goes first)
+    uint32_t count;             // Tags handed out
+
+    uint8_t tagFor(uint32_t clientId);
+    uint32_t clientFor(uint8_t tag) const;      // 0 = nobody (untagged, or the client left)
+    void drop(uint32_t clientId);
+};
+
+// The client's I:start,span,points,mode with tag as the fifth field (one it
+// sent is replaced); missing fields go out empty so the STM32 defaults apply
+void taggedWindowCommand(const char* cmd, uint8_t tag, char* out, size_t len);
+
+// ==================== JSON ====================
+// Live settings, or the recorded ones while a replay is running
+String buildStateJson(const SharedState& s, RecorderState rec);
+String buildInitJson(uint32_t clientId);
+String buildFftJson();          // "fft" message with the current fftBand
+
+// Frame header measurements: smoothed into meas/sigStats at most every
+// MEAS_UPDATE_INTERVAL; returns the "meas" message at most every
+// MEAS_INTERVAL while send is set ("" otherwise). always = no rate limits
+String noteFrameMeasurements(const OscFrameHeader& hdr, uint32_t now, bool send, bool always);
+
+// ==================== COMMANDS ====================
+// Apply a client command to the synced state; true if clients must resync
+bool applyStateCommand(const char* cmd, SharedState& s);
+
+// The command as the STM32 takes it ("L:value" for the one-letter forms)
+void stmCommandForm(const char* cmd, char* out, size_t len);
+
+#endif
@@ -2,20 +2,35 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
+#include <esp_heap_caps.h>
 #include "config.h"
 #include "structures.h"
 #include "state.h"
+#include "osc_codec.h"
+#include "ws_frames.h"
 
 const char* SSID = "SmartScope-Pro";
 const char* PASSWORD = "12345678";
 
 // External declarations
 extern void setup_spi_slave();
-extern bool handle_spi_transaction_nonblocking();
-extern uint8_t* get_rx_buffer();
-extern bool is_spi_data_ready();
-extern void parse_measurements(String line);
-extern String build_measurement_json(MeasData& d);
+extern bool spi_poll_frame();
+extern uint8_t* get_frame_buffer();
+extern size_t get_frame_length();
+extern void spi_release_frame();
+extern void spi_set_consumer(TaskHandle_t task);
+extern int64_t get_frame_timestamp();
+extern void parse_acq_stats(String line);
+extern void parse_profile_line(String line);
+extern void parse_memory_report(String line);
+extern void recorder_begin();
+extern bool recorder_command(const char* arg);
+extern void recorder_service();
+extern void recorder_frame(const OscFrameHeader& hdr, const uint16_t* samples);
+extern void recorder_note_settings();
+extern bool recorder_replaying();
+extern ReplayItem recorder_replay_poll(OscFrameHeader& hdr, const uint16_t*& samples, SharedState& settings);
+extern void recorder_replay_release();
 
 // ==================== GLOBAL INSTANCES ====================
 AsyncWebServer server(80);
@@ -24,13 +39,31 @@ HardwareSerial SerialSTM(2);
 
 // Global state
 MeasData meas = {0};
+FftBand fftBand = {FFT_SAMPLE_RATE, 0, 0};
 SignalStats sigStats = {0};
+AcqStats acqStats = {0};
+MemStats memStats = {0};
+FrameStats frameStats = {0};
+FanoutStats fanoutStats = {0};
+ProfileStats profileStats = {};
+TaskStats taskStats[NUM_BRIDGE_TASKS] = {};
+QueueStats frameQueueStats = {0};
+QueueStats uartTxStats = {0};
+QueueStats logStats = {0};
+RecorderStats recStats = {};
+QueueStats recChunkStats = {0};
+
+// ==================== INTER-TASK QUEUES ====================
+static QueueHandle_t uartTxQueue = nullptr;   // Commands for the STM32 (char[STM_CMD_LEN])
+static QueueHandle_t logQueue = nullptr;      // Console lines (char[LOG_LINE_LEN])
+
+// Bridge tasks, started from setup() (see BRIDGE TASKS)
+static void egressTask(void* arg);
+static void uartTask(void* arg);
+static void housekeepingTask(void* arg);
 
 // ==================== TIMING CONFIGURATION ====================
 // Adjust these for speed vs stability tradeoff
-static const uint32_t BINARY_INTERVAL_NORMAL = 50;    // 20 FPS when healthy
-static const uint32_t BINARY_INTERVAL_SLOW = 150;     // ~7 FPS when stressed
-static const uint32_t MEAS_INTERVAL = 500;            // 2 Hz for measurements
 static const uint32_t BROADCAST_INTERVAL = 200;       // State sync throttle
 static const uint32_t ERROR_RECOVERY_TIME = 2000;     // 2 sec to recover
 static const uint32_t MAX_ERRORS_PER_CLIENT = 3;      // Before marking slow
@@ -44,16 +77,59 @@ struct ClientInfo {
     uint32_t lastText;
     uint8_t errorCount;
     uint8_t speed;  // 0=fast, 1=slow, 2=paused
+    uint16_t resolution;  // Samples per frame requested (0 = full record)
+    uint8_t codec;  // Binary payload format (OSC_CODEC_RAW until CODEC: arrives)
     bool active;
 };
 ClientInfo clients[MAX_WS_CLIENTS] = {0};
 
 // ==================== SYSTEM STATE ====================
 static uint32_t lastBroadcastTime = 0;
-static bool pendingBroadcast = false;
+static volatile bool pendingBroadcast = false;  // Set by WS events, sent by egress
 static uint32_t consecutiveErrors = 0;
 static uint32_t lastErrorTime = 0;
 static uint8_t systemSpeed = 0;  // 0=fast, 1=slow, 2=paused
+static uint16_t stmResolution = DEFAULT_RESOLUTION;  // Frame size requested from STM32
+
+// ==================== QUEUE HELPERS ====================
+static void noteQueueDepth(QueueHandle_t q, QueueStats& stats) {
+    uint16_t depth = uxQueueMessagesWaiting(q);
+    if (depth > stats.highWater) stats.highWater = depth;
+}
+
+// Console output goes through the housekeeping task so a slow UART0
+// never stalls the task that logged; lines are dropped when it backs up
+void bridgeLog(const char* fmt, ...) {
+    char line[LOG_LINE_LEN];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    
+    if (logQueue == nullptr) {
+        Serial.print(line);
+        return;
+    }
+    if (xQueueSend(logQueue, line, 0) != pdTRUE) {
+        logStats.dropped++;
+        return;
+    }
+    noteQueueDepth(logQueue, logStats);
+}
+
+// Queue a command line (without newline) for the UART task
+void sendStmCommand(const char* cmd) {
+    char buf[STM_CMD_LEN];
+    strncpy(buf, cmd, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    
+    if (xQueueSend(uartTxQueue, buf, 0) != pdTRUE) {
+        uartTxStats.dropped++;
+        bridgeLog("⚠ STM32 command dropped: %s\n", buf);
+        return;
+    }
+    noteQueueDepth(uartTxQueue, uartTxStats);
+}
 
 // ==================== HELPER FUNCTIONS ====================
 int findClientSlot(uint32_t id) {
@@ -78,7 +154,7 @@ void removeClient(uint32_t id) {
     int slot = findClientSlot(id);
     if (slot >= 0) {
         clients[slot].active = false;
-        Serial.printf("   Removed client #%u from slot %d\n", id, slot);
+        bridgeLog("   Removed client #%u from slot %d\n", id, slot);
     }
 }
 
@@ -100,29 +176,36 @@ uint32_t getClientInterval(int slot) {
     }
 }
 
-// ==================== BUILD STATE JSON ====================
-String buildStateJson() {
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer),
-        "{\"type\":\"state\",\"displayMode\":%d,\"frequency\":%lu,\"timebase\":%lu,\"duty\":%u,\"running\":%s}",
-        sharedState.displayMode,
-        sharedState.frequency,
-        sharedState.timebase,
-        sharedState.dutyCycle,
-        sharedState.running ? "true" : "false"
-    );
-    return String(buffer);
+// ==================== FRAME RESOLUTION ====================
+// STM32 produces the largest frame any client wants; smaller clients get
+// a decimated copy
+void updateStmResolution() {
+    uint8_t maxClass = resolutionClass(DEFAULT_RESOLUTION);
+    for (int i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!clients[i].active) continue;
+        uint8_t c = resolutionClass(clients[i].resolution);
+        if (c > maxClass) maxClass = c;
+    }
+    
+    uint16_t res = RESOLUTIONS[maxClass];
+    if (res == stmResolution) return;
+    stmResolution = res;
+    
+    char cmd[STM_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "Z:%u", res);
+    sendStmCommand(cmd);
+    bridgeLog("→ Frame resolution: %u\n", res);
 }
 
 // ==================== BROADCAST STATE TO ALL CLIENTS ====================
-void broadcastState() {
+void broadcastState(const SharedState& s = sharedState) {
     if (ws.count() == 0) return;
     if (systemSpeed >= 2) {
         pendingBroadcast = true;
         return;
     }
     
-    String stateJson = buildStateJson();
+    String stateJson = buildStateJson(s, recStats.state);
     
     for (int i = 0; i < MAX_WS_CLIENTS; i++) {
         if (!clients[i].active) continue;
@@ -137,23 +220,87 @@ void broadcastState() {
         client->text(stateJson);
     }
     
-    Serial.printf("📢 Broadcast: %s\n", stateJson.c_str());
+    bridgeLog("📢 Broadcast: %s\n", stateJson.c_str());
 }
 
 // ==================== SEND BINARY TO CLIENTS ====================
-void sendBinaryToClients(uint8_t* buffer, size_t len) {
+// Shared frame pool: each frame is built once per resolution class and
+// payload format into a refcounted message buffer and queued to every
+// client of that variant.
+// AsyncWebSocket holds one reference per queued message and drops it once
+// sent; buffers stay locked so the library never frees them, and an idle
+// one (no references) is reused for the next frame. Variants are all
+// built before any is queued, so buffers taken this frame are skipped.
+static AsyncWebSocketMessageBuffer* framePool[WS_FRAME_POOL] = {nullptr};
+static uint32_t framePoolStamp[WS_FRAME_POOL] = {0};
+static uint32_t framePoolFrame = 0;
+
+static AsyncWebSocketMessageBuffer* acquireFrameBuffer(size_t len) {
+    AsyncWebSocketMessageBuffer* spare = nullptr;
+    uint32_t spareSlot = 0;
+    
+    for (uint32_t i = 0; i < WS_FRAME_POOL; i++) {
+        AsyncWebSocketMessageBuffer* buf = framePool[i];
+        if (buf == nullptr) {
+            buf = new AsyncWebSocketMessageBuffer(len);
+            if (buf == nullptr || buf->get() == nullptr) {
+                delete buf;
+                break;
+            }
+            buf->lock();
+            framePool[i] = buf;
+            framePoolStamp[i] = framePoolFrame;
+            fanoutStats.allocs++;
+            return buf;
+        }
+        if (buf->count() > 0) continue;  // Still queued on a client
+        if (framePoolStamp[i] == framePoolFrame) continue;  // Another variant of this frame
+        if (buf->length() == len) {
+            framePoolStamp[i] = framePoolFrame;
+            return buf;
+        }
+        if (spare == nullptr) {
+            spare = buf;
+            spareSlot = i;
+        }
+    }
+    
+    // Idle buffer of another size (resolution, mode or compressed size changed)
+    if (spare && spare->reserve(len)) {
+        framePoolStamp[spareSlot] = framePoolFrame;
+        fanoutStats.allocs++;
+        return spare;
+    }
+    
+    fanoutStats.poolMisses++;
+    return nullptr;
+}
+
+static uint8_t* codecScratch = nullptr;     // One encoded payload
+static uint16_t* classScratch = nullptr;    // Decimated samples when no raw buffer holds them
+
+static void* allocScratch(size_t len) {
+    void* p = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(len);
+}
+
+// WsAcquire for buildFrameVariants: payloads live in pool buffers
+static bool acquirePoolPayload(size_t len, WsPayload& out, void* ctx) {
+    AsyncWebSocketMessageBuffer* msg = acquireFrameBuffer(len);
+    if (!msg) return false;
+    out = WsPayload{msg->get(), msg->length(), msg};
+    return true;
+}
+
+void sendBinaryToClients(const uint16_t* samples, size_t count, uint8_t flags) {
     if (ws.count() == 0) return;
     if (systemSpeed >= 2) return;
     
     uint32_t now = millis();
     
-    // Add 4-byte header
-    static uint8_t sendBuffer[BUFFER_SIZE + 4];
-    sendBuffer[0] = (uint8_t)sharedState.displayMode;
-    sendBuffer[1] = sharedState.running ? 1 : 0;
-    sendBuffer[2] = systemSpeed;
-    sendBuffer[3] = 0;
-    memcpy(sendBuffer + 4, buffer, len);
+    // Clients due a frame, and the payload variants they need
+    bool due[MAX_WS_CLIENTS] = {false};
+    bool wanted[NUM_RESOLUTIONS][OSC_CODEC_COUNT] = {};
     
     for (int i = 0; i < MAX_WS_CLIENTS; i++) {
         if (!clients[i].active) continue;
@@ -175,9 +322,36 @@ void sendBinaryToClients(uint8_t* buffer, size_t len) {
             continue;
         }
         
-        client->binary(sendBuffer, len + 4);
+        due[i] = true;
+        wanted[resolutionClass(clients[i].resolution)][clients[i].codec] = true;
+    }
+    
+    // One shared buffer per variant; compressed clients get the raw one
+    // when coding doesn't pay off
+    if (!codecScratch) codecScratch = (uint8_t*)allocScratch(4 + OSC_CODEC_MAX_BYTES(OSC_FRAME_MAX_SAMPLES));
+    if (!classScratch) classScratch = (uint16_t*)allocScratch(OSC_FRAME_MAX_SAMPLES * 2);
+    WsPayload built[NUM_RESOLUTIONS][OSC_CODEC_COUNT];
+    framePoolFrame++;
+    buildFrameVariants(samples, count, flags, systemSpeed, wanted, built,
+                       WsScratch{codecScratch, classScratch}, acquirePoolPayload, nullptr, fanoutStats);
+    
+    bool sent = false;
+    
+    for (int i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!due[i]) continue;
+        
+        const WsPayload& msg = built[resolutionClass(clients[i].resolution)][clients[i].codec];
+        AsyncWebSocketClient* client = ws.client(clients[i].id);
+        if (msg.handle == nullptr || client == nullptr) continue;
+        
+        client->binary((AsyncWebSocketMessageBuffer*)msg.handle);
         clients[i].lastBinary = now;
+        fanoutStats.messages++;
+        fanoutStats.sentBytes += msg.len;
+        sent = true;
     }
+    
+    if (sent) fanoutStats.frames++;
 }
 
 // ==================== SEND MEASUREMENTS TO ALL CLIENTS ====================
@@ -217,7 +391,7 @@ void pingClients() {
         if (!clients[i].active) continue;
         
         if ((now - clients[i].lastPing) > WS_TIMEOUT_MS) {
-            Serial.printf("⚠ Client #%u timeout\n", clients[i].id);
+            bridgeLog("⚠ Client #%u timeout\n", clients[i].id);
             AsyncWebSocketClient* client = ws.client(clients[i].id);
             if (client != nullptr) client->close();
             clients[i].active = false;
@@ -233,85 +407,81 @@ void pingClients() {
 
 // ==================== PROCESS COMMAND & SYNC STATE ====================
 void processCommand(const char* cmd, uint32_t senderId) {
-    bool stateChanged = false;
-    
-    if (cmd[0] == 'X') {
-        int mode = (cmd[1] == ':') ? atoi(cmd + 2) : atoi(cmd + 1);
-        if (mode == 0 && sharedState.displayMode != MODE_TIME_DOMAIN) {
-            sharedState.displayMode = MODE_TIME_DOMAIN;
-            stateChanged = true;
-            Serial.println("→ Mode: TIME");
-        } else if (mode == 1 && sharedState.displayMode != MODE_FREQ_DOMAIN) {
-            sharedState.displayMode = MODE_FREQ_DOMAIN;
-            stateChanged = true;
-            Serial.println("→ Mode: FFT");
-        }
-    }
-    else if (cmd[0] == 'F') {
-        uint32_t val = atoi((cmd[1] == ':') ? cmd + 2 : cmd + 1);
-        if (val > 0 && val != sharedState.frequency) {
-            sharedState.frequency = val;
-            stateChanged = true;
-        }
-    }
-    else if (cmd[0] == 'T') {
-        uint32_t val = atoi((cmd[1] == ':') ? cmd + 2 : cmd + 1);
-        if (val > 0 && val != sharedState.timebase) {
-            sharedState.timebase = val;
-            stateChanged = true;
-        }
-    }
-    else if (cmd[0] == 'D') {
-        uint8_t val = atoi((cmd[1] == ':') ? cmd + 2 : cmd + 1);
-        if (val > 0 && val <= 100 && val != sharedState.dutyCycle) {
-            sharedState.dutyCycle = val;
-            stateChanged = true;
-        }
-    }
-    else if (cmd[0] == 'M' || cmd[0] == 'E') {
-        stateChanged = true;
-    }
-    else if (strncmp(cmd, "RUN", 3) == 0 && !sharedState.running) {
-        sharedState.running = true;
-        stateChanged = true;
-    }
-    else if (strncmp(cmd, "STOP", 4) == 0 && sharedState.running) {
-        sharedState.running = false;
-        stateChanged = true;
-    }
-    else if (strncmp(cmd, "RESET", 5) == 0) {
-        meas.reset();
-        sigStats.reset();
-        stateChanged = true;
+    DisplayMode mode = sharedState.displayMode;
+    bool stateChanged = applyStateCommand(cmd, sharedState);
+    if (sharedState.displayMode != mode) {
+        bridgeLog(sharedState.displayMode == MODE_FREQ_DOMAIN ? "→ Mode: FFT\n" : "→ Mode: TIME\n");
     }
     
     // Forward to STM32
     char stmCmd[32];
-    if ((cmd[0] == 'X' || cmd[0] == 'F' || cmd[0] == 'T' || 
-         cmd[0] == 'D' || cmd[0] == 'M' || cmd[0] == 'E') && cmd[1] != ':') {
-        snprintf(stmCmd, sizeof(stmCmd), "%c:%s", cmd[0], cmd + 1);
-    } else {
-        strncpy(stmCmd, cmd, sizeof(stmCmd) - 1);
-        stmCmd[sizeof(stmCmd) - 1] = '\0';
-    }
-    SerialSTM.printf("%s\n", stmCmd);
+    stmCommandForm(cmd, stmCmd, sizeof(stmCmd));
+    sendStmCommand(stmCmd);
     
+    // The egress task broadcasts, so a command never fans out from the WS task
     if (stateChanged) {
         meas.reset();
         sigStats.reset();
         sharedState.lastChangeTime = millis();
-        
-        uint32_t now = millis();
-        if (systemSpeed < 2 && (now - lastBroadcastTime) >= BROADCAST_INTERVAL) {
-            broadcastState();
-            lastBroadcastTime = now;
-            pendingBroadcast = false;
-        } else {
-            pendingBroadcast = true;
-        }
+        pendingBroadcast = true;
+        recorder_note_settings();
+    }
+}
+
+// ==================== DEEP-MEMORY RECORD ====================
+// Live frame headers describe the STM32 record; clients hear about changes
+// in a "record" message and fetch zoomed windows of it with I:
+static DeepRecord deepRecord = {};
+static WindowRoutes windowRoutes = {};     // I: tags -> clients (WS task adds, SPI path reads)
+static portMUX_TYPE windowMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t* windowScratch = nullptr;
+
+// Track the record behind live frames; layout changes go to every client
+static void noteDeepRecord(const OscFrameHeader& hdr) {
+    if (!deepRecord.note(hdr)) return;
+    
+    String json = deepRecord.json();
+    for (int i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!clients[i].active) continue;
+        AsyncWebSocketClient* client = ws.client(clients[i].id);
+        if (client != nullptr && client->status() == WS_CONNECTED) client->text(json);
+    }
+}
+
+// ==================== FFT BAND ====================
+// Spectrum headers say which band they cover and how samples are scaled;
+// when either changes (zoom-FFT on, off or re-centred, dB on or off) every
+// client gets the new fftParams for its labels
+static void noteFftBand(const OscFrameHeader& hdr) {
+    if (!fftBand.noteFrame(hdr)) return;
+    
+    String json = buildFftJson();
+    for (int i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (!clients[i].active) continue;
+        AsyncWebSocketClient* client = ws.client(clients[i].id);
+        if (client != nullptr && client->status() == WS_CONNECTED) client->text(json);
     }
 }
 
+// I: reply for the client whose tag it carries (layout: buildWindowMessage)
+static void sendWindowToClient(const OscFrameHeader& hdr, const uint16_t* samples) {
+    portENTER_CRITICAL(&windowMux);
+    uint32_t clientId = windowRoutes.clientFor(hdr.rec_tag);
+    portEXIT_CRITICAL(&windowMux);
+    
+    AsyncWebSocketClient* client = clientId ? ws.client(clientId) : nullptr;
+    if (client == nullptr || client->status() != WS_CONNECTED) return;
+    
+    if (!windowScratch) windowScratch = (uint8_t*)allocScratch(WS_WINDOW_HEADER + OSC_FRAME_MAX_SAMPLES * 2);
+    if (!windowScratch) return;
+    
+    size_t len = buildWindowMessage(windowScratch, hdr, samples, systemSpeed);
+    
+    client->binary(windowScratch, len);
+    fanoutStats.messages++;
+    fanoutStats.sentBytes += len;
+}
+
 // ==================== WEBSOCKET EVENT HANDLER ====================
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, 
                AwsEventType type, void *arg, uint8_t *data, size_t len) {
@@ -319,8 +489,8 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
     switch (type) {
         case WS_EVT_CONNECT: {
             uint32_t clientId = client->id();
-            Serial.printf("✓ Client #%u connected from %s\n", 
-                          clientId, client->remoteIP().toString().c_str());
+            bridgeLog("✓ Client #%u connected from %s\n", 
+                      clientId, client->remoteIP().toString().c_str());
             
             int slot = getFreeClientSlot();
             if (slot >= 0) {
@@ -330,9 +500,11 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                 clients[slot].lastText = 0;
                 clients[slot].errorCount = 0;
                 clients[slot].speed = 0;
+                clients[slot].resolution = DEFAULT_RESOLUTION;
+                clients[slot].codec = OSC_CODEC_RAW;
                 clients[slot].active = true;
             } else {
-                Serial.println("⚠ No free slots!");
+                bridgeLog("⚠ No free slots!\n");
                 client->close();
                 return;
             }
@@ -341,23 +513,21 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
             systemSpeed = 0;
             consecutiveErrors = 0;
             
-            char initJson[384];
-            snprintf(initJson, sizeof(initJson),
-                "{\"type\":\"init\",\"version\":\"2.6\",\"clientId\":%u,"
-                "\"fftParams\":{\"sampleRate\":%u,\"fftSize\":%u,\"displayBins\":%u,\"maxFreq\":%u,\"hzPerBin\":%.2f}}",
-                clientId, FFT_SAMPLE_RATE, FFT_SIZE, DISPLAY_BINS, 
-                (uint32_t)MAX_DISPLAY_FREQ, HZ_PER_BIN
-            );
-            client->text(initJson);
-            client->text(buildStateJson());
+            client->text(buildInitJson(clientId));
+            client->text(buildStateJson(sharedState, recStats.state));
+            client->text(deepRecord.json());
             
-            Serial.printf("   Slot %d | Total: %d\n", slot, ws.count());
+            bridgeLog("   Slot %d | Total: %d\n", slot, ws.count());
             break;
         }
         
         case WS_EVT_DISCONNECT: {
-            Serial.printf("✗ Client #%u disconnected\n", client->id());
+            bridgeLog("✗ Client #%u disconnected\n", client->id());
             removeClient(client->id());
+            portENTER_CRITICAL(&windowMux);
+            windowRoutes.drop(client->id());
+            portEXIT_CRITICAL(&windowMux);
+            updateStmResolution();
             if (countActiveClients() == 0) {
                 systemSpeed = 0;
                 consecutiveErrors = 0;
@@ -376,7 +546,7 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                 if (clients[slot].errorCount >= MAX_ERRORS_PER_CLIENT) {
                     if (clients[slot].speed < 2) {
                         clients[slot].speed++;
-                        Serial.printf("⚠ Client #%u slowed to level %d\n", 
+                        bridgeLog("⚠ Client #%u slowed to level %d\n", 
                             client->id(), clients[slot].speed);
                     }
                 }
@@ -385,7 +555,7 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                 if (consecutiveErrors >= MAX_CONSECUTIVE_ERRORS) {
                     if (systemSpeed < 2) {
                         systemSpeed++;
-                        Serial.printf("🔻 System speed reduced to level %d\n", systemSpeed);
+                        bridgeLog("🔻 System speed reduced to level %d\n", systemSpeed);
                     }
                 }
             }
@@ -428,7 +598,7 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                 }
                 consecutiveErrors = 0;
                 
-                Serial.printf("← #%u: %s\n", clientId, cmd);
+                bridgeLog("← #%u: %s\n", clientId, cmd);
                 
                 if (strcmp(cmd, "PING") == 0) {
                     client->text("{\"type\":\"pong\"}");
@@ -437,7 +607,49 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                 }
                 
                 if (strcmp(cmd, "GETSTATE") == 0) {
-                    client->text(buildStateJson());
+                    client->text(buildStateJson(sharedState, recStats.state));
+                    return;
+                }
+                
+                // Per-client frame resolution: RES:256/1024/4096, RES:0 full record
+                if (strncmp(cmd, "RES:", 4) == 0) {
+                    if (slot >= 0) {
+                        clients[slot].resolution = RESOLUTIONS[resolutionClass(atoi(cmd + 4))];
+                        updateStmResolution();
+                    }
+                    return;
+                }
+                
+                // Binary payload format offered in init: CODEC:0 raw, CODEC:1 delta
+                if (strncmp(cmd, "CODEC:", 6) == 0) {
+                    int codec = atoi(cmd + 6);
+                    if (slot >= 0) {
+                        clients[slot].codec = (codec > 0 && codec < OSC_CODEC_COUNT) ? codec : OSC_CODEC_RAW;
+                    }
+                    return;
+                }
+                
+                // Deep-record window: I:start,span,points[,mode], tagged so the
+                // reply goes to this client only
+                if (cmd[0] == 'I' && cmd[1] == ':') {
+                    portENTER_CRITICAL(&windowMux);
+                    uint8_t tag = windowRoutes.tagFor(clientId);
+                    portEXIT_CRITICAL(&windowMux);
+                    
+                    char tagged[STM_CMD_LEN];
+                    taggedWindowCommand(cmd, tag, tagged, sizeof(tagged));
+                    sendStmCommand(tagged);
+                    return;
+                }
+                
+                // Recorder: REC:START[,interval_ms], REC:STOP, REC:PLAY
+                if (strncmp(cmd, "REC:", 4) == 0) {
+                    bool ok = recorder_command(cmd + 4);
+                    char reply[64];
+                    snprintf(reply, sizeof(reply), "{\"type\":\"rec\",\"ok\":%s,\"bytes\":%lu}",
+                             ok ? "true" : "false", (unsigned long)recStats.bytes);
+                    client->text(reply);
+                    if (ok) pendingBroadcast = true;
                     return;
                 }
                 
@@ -448,10 +660,86 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
     }
 }
 
+// ==================== SPI FRAME HANDLER ====================
+// Take measurements from a frame header and fan the samples out; live
+// frames and replayed ones both go through here
+static void forward_frame(const OscFrameHeader& hdr, const uint16_t* samples) {
+    noteFftBand(hdr);
+    
+    String json = noteFrameMeasurements(hdr, millis(), systemSpeed < 2 && ws.count() > 0, false);
+    if (json.length()) sendMeasurementsToClients(json);
+    
+    if (ws.count() > 0) {
+        sendBinaryToClients(samples, hdr.sample_count, hdr.flags);
+    }
+}
+
+// Validate the frame header, account it, record it and forward it
+void handle_spi_frame(const uint8_t* frame, size_t len) {
+    // Header was validated during reassembly
+    OscFrameHeader hdr;
+    if (osc_frame_decode(frame, len, &hdr) != OSC_FRAME_OK) return;
+    if (len < osc_frame_length(&hdr)) return;
+    
+    if (frameStats.ok > 0 && hdr.seq != frameStats.lastSeq + 1) {
+        frameStats.lost += hdr.seq - frameStats.lastSeq - 1;
+    }
+    frameStats.lastSeq = hdr.seq;
+    frameStats.ok++;
+    
+    // Throughput per size class, refreshed once per second
+    uint32_t now = millis();
+    frameStats.size = hdr.sample_count;
+    frameStats.bySize[resolutionClass(hdr.sample_count)]++;
+    frameStats.windowFrames++;
+    frameStats.windowBytes += len;
+    if ((now - frameStats.windowStart) >= 1000) {
+        uint32_t elapsed = now - frameStats.windowStart;
+        frameStats.fps = (frameStats.windowFrames * 1000) / elapsed;
+        frameStats.bytesPerSec = ((uint64_t)frameStats.windowBytes * 1000) / elapsed;
+        frameStats.windowStart = now;
+        frameStats.windowFrames = frameStats.windowBytes = 0;
+    }
+    
+    const uint16_t* samples = (const uint16_t*)(frame + hdr.header_len);
+    
+    // Record windows answer one client's I: request, they aren't live frames
+    if (hdr.flags & OSC_FRAME_WINDOW) {
+        sendWindowToClient(hdr, samples);
+        return;
+    }
+    noteDeepRecord(hdr);
+    recorder_frame(hdr, samples);
+    
+    // Clients see the recording instead while it replays
+    if (!recorder_replaying()) forward_frame(hdr, samples);
+}
+
+// Replayed items handed over by the recorder task
+static void handle_replay() {
+    OscFrameHeader hdr;
+    const uint16_t* samples = nullptr;
+    SharedState recorded;
+    
+    ReplayItem item = recorder_replay_poll(hdr, samples, recorded);
+    if (item == REPLAY_NONE) return;
+    
+    if (item == REPLAY_FRAME) {
+        forward_frame(hdr, samples);
+    } else {
+        // Recorded settings change (or live ones back after the replay)
+        meas.reset();
+        sigStats.reset();
+        if (item == REPLAY_SETTINGS) broadcastState(recorded);
+        else pendingBroadcast = true;
+    }
+    recorder_replay_release();
+}
+
 // ==================== UART DATA HANDLER ====================
+// Command replies only: measurements arrive in the SPI frame header
 void handle_uart() {
     static String uartBuffer = "";
-    static uint32_t lastMeasSend = 0;
     
     while (SerialSTM.available()) {
         char c = SerialSTM.read();
@@ -459,19 +747,14 @@ void handle_uart() {
         if (c == '\n') {
             uartBuffer.trim();
             
-            if (uartBuffer.length() > 0) {
-                parse_measurements(uartBuffer);
-                
-                if (meas.valid && meas.frequency_hz > 0) {
-                    sigStats.updateStability(meas.frequency_hz);
-                }
-                
-                uint32_t now = millis();
-                if (systemSpeed < 2 && ws.count() > 0 && meas.valid && 
-                    (now - lastMeasSend) >= MEAS_INTERVAL) {
-                    lastMeasSend = now;
-                    sendMeasurementsToClients(build_measurement_json(meas));
-                }
+            if (uartBuffer.startsWith("Q:")) {
+                parse_acq_stats(uartBuffer);
+            } else if (uartBuffer.startsWith("P:")) {
+                parse_profile_line(uartBuffer);
+            } else if (uartBuffer.startsWith("H:")) {
+                parse_memory_report(uartBuffer);
+            } else if (uartBuffer.length() > 0) {
+                bridgeLog("RECV: %s\n", uartBuffer.c_str());
             }
             uartBuffer = "";
         } 
@@ -482,6 +765,167 @@ void handle_uart() {
     }
 }
 
+// ==================== DIAGNOSTICS JSON ====================
+static const char* const TASK_NAMES[NUM_BRIDGE_TASKS] = {"spi_ingest", "uart", "ws_egress", "housekeeping", "recorder"};
+
+static void appendQueueJson(String& json, const char* name, const QueueStats& q, uint32_t dropped) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "\"%s\":{\"capacity\":%u,\"highWater\":%u,\"dropped\":%lu}",
+             name, q.capacity, q.highWater, (unsigned long)dropped);
+    json += buf;
+}
+
+String buildDiagJson() {
+    String json = "{\"tasks\":[";
+    char buf[256];
+    
+    for (int i = 0; i < NUM_BRIDGE_TASKS; i++) {
+        TaskHandle_t h = taskStats[i].handle;
+        snprintf(buf, sizeof(buf),
+            "%s{\"name\":\"%s\",\"priority\":%u,\"loadPct\":%u.%u,\"busyMs\":%lu,\"stackFree\":%u}",
+            i ? "," : "", TASK_NAMES[i], h ? uxTaskPriorityGet(h) : 0,
+            taskStats[i].loadPermille / 10, taskStats[i].loadPermille % 10,
+            (unsigned long)(taskStats[i].busyUs / 1000), h ? uxTaskGetStackHighWaterMark(h) : 0);
+        json += buf;
+    }
+    
+    json += "],\"queues\":{";
+    appendQueueJson(json, "frames", frameQueueStats, frameStats.dropped);
+    json += ",";
+    appendQueueJson(json, "uartTx", uartTxStats, uartTxStats.dropped);
+    json += ",";
+    appendQueueJson(json, "log", logStats, logStats.dropped);
+    json += ",";
+    appendQueueJson(json, "recorder", recChunkStats, recChunkStats.dropped);
+    
+    snprintf(buf, sizeof(buf), "},\"latency\":{\"lastUs\":%lu,\"maxUs\":%lu}",
+             (unsigned long)fanoutStats.latencyUs, (unsigned long)fanoutStats.latencyMaxUs);
+    json += buf;
+    
+    static const char* const REC_STATES[] = {"idle", "recording", "replaying"};
+    snprintf(buf, sizeof(buf),
+        ",\"recorder\":{\"state\":\"%s\",\"bytes\":%lu,\"limit\":%lu,\"frames\":%lu,"
+        "\"durationMs\":%lu,\"intervalMs\":%lu,\"writeErrors\":%lu}",
+        REC_STATES[recStats.state], (unsigned long)recStats.bytes, (unsigned long)recStats.limit,
+        (unsigned long)recStats.frames, (unsigned long)recStats.durationMs,
+        (unsigned long)recStats.interval, (unsigned long)recStats.writeErrors);
+    json += buf;
+    
+    // Last H reply; /diag asks for a fresh one (see "age")
+    if (memStats.lastUpdate) {
+        snprintf(buf, sizeof(buf),
+            ",\"stm32Memory\":{\"age\":%lu,\"ram\":%lu,\"static\":%lu,\"acqMemory\":%lu,\"fftShared\":%lu,"
+            "\"deepExtra\":%lu,\"recordMax\":%lu,\"heap\":%lu,\"stackPeak\":%lu,\"free\":%lu,\"pyramid\":%lu}",
+            (millis() - memStats.lastUpdate) / 1000, (unsigned long)memStats.ram,
+            (unsigned long)memStats.staticBytes, (unsigned long)memStats.acqMemory,
+            (unsigned long)memStats.fftShared, (unsigned long)memStats.deepExtra,
+            (unsigned long)memStats.recordMax, (unsigned long)memStats.heap,
+            (unsigned long)memStats.stackPeak, (unsigned long)memStats.free,
+            (unsigned long)memStats.pyramid);
+        json += buf;
+    }
+    json += "}";
+    return json;
+}
+
+// ==================== STM32 PROFILE JSON ====================
+// Last P:2 dump; shares are of the STM32 core over the profile window
+String buildProfileJson() {
+    if (!profileStats.lastUpdate) return "{\"available\":false}";
+    
+    char buf[256];
+    float windowCycles = (float)profileStats.windowMs * profileStats.clockMhz * 1000.0f;
+    float clockMhz = profileStats.clockMhz ? profileStats.clockMhz : 1;
+    if (windowCycles <= 0) windowCycles = 1;
+    
+    snprintf(buf, sizeof(buf),
+        "{\"available\":true,\"age\":%lu,\"enabled\":%s,\"clockMhz\":%u,\"windowMs\":%lu,"
+        "\"calls\":%lu,\"overheadCycles\":%lu,\"overheadPct\":%.3f,\"histBaseCycles\":%lu,\"probes\":[",
+        (millis() - profileStats.lastUpdate) / 1000, profileStats.enabled ? "true" : "false",
+        profileStats.clockMhz, (unsigned long)profileStats.windowMs,
+        (unsigned long)profileStats.calls, (unsigned long)profileStats.overhead,
+        100.0f * profileStats.calls * profileStats.overhead / windowCycles,
+        2UL << profileStats.histMinLog2);
+    String json = buf;
+    
+    for (uint8_t i = 0; i < profileStats.count; i++) {
+        const ProfileProbe& p = profileStats.probes[i];
+        snprintf(buf, sizeof(buf),
+            "%s{\"name\":\"%s\",\"count\":%lu,\"avgCycles\":%lu,\"minCycles\":%lu,\"maxCycles\":%lu,"
+            "\"avgUs\":%.2f,\"maxUs\":%.2f,\"sharePct\":%.2f,\"hist\":[",
+            i ? "," : "", p.name, (unsigned long)p.count, (unsigned long)p.avg,
+            (unsigned long)p.min, (unsigned long)p.max, p.avg / clockMhz, p.max / clockMhz,
+            100.0f * p.count * p.avg / windowCycles);
+        json += buf;
+        for (uint8_t b = 0; b < PROFILE_HIST_BUCKETS; b++) {
+            if (b) json += ",";
+            json += String(p.hist[b]);
+        }
+        json += "]}";
+    }
+    json += "]}";
+    return json;
+}
+
+// ==================== RECORDING DOWNLOAD ====================
+// "bytes=a-b", "bytes=a-" or "bytes=-n" against size; false if unsatisfiable
+static bool parseRange(const String& spec, size_t size, size_t& from, size_t& to) {
+    const char* s = spec.c_str();
+    if (strncmp(s, "bytes=", 6) != 0 || size == 0) return false;
+    s += 6;
+    
+    char* end;
+    if (*s == '-') {
+        size_t n = strtoul(s + 1, &end, 10);
+        if (n == 0) return false;
+        from = (n < size) ? size - n : 0;
+        to = size - 1;
+        return true;
+    }
+    
+    from = strtoul(s, &end, 10);
+    if (end == s || *end != '-' || from >= size) return false;
+    to = (end[1] >= '0' && end[1] <= '9') ? strtoul(end + 1, nullptr, 10) : size - 1;
+    if (to >= size) to = size - 1;
+    return to >= from;
+}
+
+// Flushed part of the recording; Range requests get 206 so a long
+// capture can be fetched in pieces, even while it is still growing
+static void sendRecording(AsyncWebServerRequest* r) {
+    size_t size = recStats.bytes;
+    File file = size ? SPIFFS.open(RECORD_PATH, "r") : File();
+    if (!file) {
+        r->send(404, "text/plain", "No recording");
+        return;
+    }
+    
+    size_t from = 0, to = size - 1;
+    bool partial = r->hasHeader("Range");
+    if (partial && !parseRange(r->getHeader("Range")->value(), size, from, to)) {
+        AsyncWebServerResponse* resp = r->beginResponse(416, "text/plain", "Range Not Satisfiable");
+        resp->addHeader("Content-Range", "bytes */" + String((unsigned long)size));
+        r->send(resp);
+        return;
+    }
+    file.seek(from);
+    
+    size_t len = to - from + 1;
+    AsyncWebServerResponse* resp = r->beginResponse("application/octet-stream", len,
+        [file, len](uint8_t* buf, size_t maxLen, size_t index) mutable -> size_t {
+            return file.read(buf, min(maxLen, len - index));
+        });
+    resp->addHeader("Accept-Ranges", "bytes");
+    resp->addHeader("Content-Disposition", "attachment; filename=\"rec.bin\"");
+    if (partial) {
+        char range[64];
+        snprintf(range, sizeof(range), "bytes %u-%u/%u", (unsigned)from, (unsigned)to, (unsigned)size);
+        resp->setCode(206);
+        resp->addHeader("Content-Range", range);
+    }
+    r->send(resp);
+}
+
 // ==================== SETUP ====================
 void setup() {
     Serial.begin(115200);
@@ -494,8 +938,13 @@ void setup() {
     
     sharedState.reset();
     
+    uartTxQueue = xQueueCreate(UART_TX_QUEUE_LEN, STM_CMD_LEN);
+    logQueue = xQueueCreate(LOG_QUEUE_LEN, LOG_LINE_LEN);
+    uartTxStats.capacity = UART_TX_QUEUE_LEN;
+    logStats.capacity = LOG_QUEUE_LEN;
+    
     for (int i = 0; i < MAX_WS_CLIENTS; i++) {
-        clients[i] = {0, 0, 0, 0, 0, 0, false};
+        clients[i] = {0, 0, 0, 0, 0, 0, DEFAULT_RESOLUTION, OSC_CODEC_RAW, false};
     }
     
     Serial.print("SPIFFS... ");
@@ -503,10 +952,12 @@ void setup() {
         Serial.println("FAILED!");
         while(1) delay(1000);
     }
+    recorder_begin();  // Before the server can deliver REC: commands
     Serial.println("OK");
     
     Serial.print("UART... ");
     SerialSTM.begin(UART_BAUD, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    SerialSTM.printf("Z:%u\n", stmResolution);  // STM32 may still hold a previous session's size
     Serial.println("OK");
     
     Serial.print("SPI... ");
@@ -534,15 +985,41 @@ void setup() {
     });
     
     server.on("/state", HTTP_GET, [](AsyncWebServerRequest *r) {
-        r->send(200, "application/json", buildStateJson());
+        r->send(200, "application/json", buildStateJson(sharedState, recStats.state));
     });
     
     server.on("/health", HTTP_GET, [](AsyncWebServerRequest *r) {
-        char buf[256];
+        char buf[896];
         snprintf(buf, sizeof(buf), 
-            "{\"ok\":true,\"up\":%lu,\"clients\":%d,\"heap\":%u,\"speed\":%d,\"errors\":%lu}",
+            "{\"ok\":true,\"up\":%lu,\"clients\":%d,\"heap\":%u,\"speed\":%d,\"errors\":%lu,"
+            "\"acq\":{\"fps\":%u,\"deadPct\":%u.%u,\"overruns\":%lu,\"continuous\":%s,\"age\":%lu},"
+            "\"frames\":{\"ok\":%lu,\"crc\":%lu,\"sync\":%lu,\"incomplete\":%lu,\"lost\":%lu,"
+            "\"received\":%lu,\"dropped\":%lu,\"overruns\":%lu,"
+            "\"size\":%u,\"fps\":%u,\"bytesPerSec\":%lu,\"resolution\":%u,"
+            "\"bySize\":{\"256\":%lu,\"1024\":%lu,\"4096\":%lu,\"full\":%lu}},"
+            "\"fanout\":{\"frames\":%lu,\"messages\":%lu,\"copyBytes\":%lu,\"sentBytes\":%lu,"
+            "\"copyPerFrame\":%lu,\"allocs\":%lu,\"poolMisses\":%lu,\"codecPct\":%lu,"
+            "\"heapMin\":%u,\"heapMaxBlock\":%u}}",
             millis()/1000, countActiveClients(), ESP.getFreeHeap(), 
-            systemSpeed, consecutiveErrors);
+            systemSpeed, consecutiveErrors,
+            acqStats.fps, acqStats.dead_permille / 10, acqStats.dead_permille % 10,
+            (unsigned long)acqStats.overruns, acqStats.continuous ? "true" : "false",
+            (millis() - acqStats.lastUpdate) / 1000,
+            (unsigned long)frameStats.ok, (unsigned long)frameStats.crcErrors,
+            (unsigned long)frameStats.syncErrors, (unsigned long)frameStats.incomplete,
+            (unsigned long)frameStats.lost, (unsigned long)frameStats.received,
+            (unsigned long)frameStats.dropped, (unsigned long)frameStats.overruns,
+            frameStats.size, frameStats.fps,
+            (unsigned long)frameStats.bytesPerSec, stmResolution,
+            (unsigned long)frameStats.bySize[0], (unsigned long)frameStats.bySize[1],
+            (unsigned long)frameStats.bySize[2], (unsigned long)frameStats.bySize[3],
+            (unsigned long)fanoutStats.frames, (unsigned long)fanoutStats.messages,
+            (unsigned long)fanoutStats.copyBytes, (unsigned long)fanoutStats.sentBytes,
+            (unsigned long)(fanoutStats.frames ? fanoutStats.copyBytes / fanoutStats.frames : 0),
+            (unsigned long)fanoutStats.allocs, (unsigned long)fanoutStats.poolMisses,
+            (unsigned long)(fanoutStats.codecRawBytes ?
+                (uint64_t)fanoutStats.codecBytes * 100 / fanoutStats.codecRawBytes : 100),
+            ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
         r->send(200, "application/json", buf);
     });
     
@@ -551,74 +1028,161 @@ void setup() {
         r->send(404, "text/plain", "Not Found");
     });
     
-    server.begin();
-    Serial.println("✓ Ready!\n");
-}
-
-// ==================== MAIN LOOP ====================
-void loop() {
-    static uint32_t lastHeartbeat = 0;
-    static uint32_t lastCleanup = 0;
-    static uint32_t lastBinaryCheck = 0;
+    server.on("/diag", HTTP_GET, [](AsyncWebServerRequest *r) {
+        sendStmCommand("H");
+        r->send(200, "application/json", buildDiagJson());
+    });
     
-    uint32_t now = millis();
+    // Serves the last dump and asks the STM32 for a fresh one (see "age")
+    server.on("/profile", HTTP_GET, [](AsyncWebServerRequest *r) {
+        sendStmCommand("P:2");
+        r->send(200, "application/json", buildProfileJson());
+    });
     
-    // Auto-recovery: speed up if no errors for a while
-    if (systemSpeed > 0 && (now - lastErrorTime) > ERROR_RECOVERY_TIME) {
-        systemSpeed--;
-        Serial.printf("✓ System speed restored to level %d\n", systemSpeed);
-        lastErrorTime = now;  // Prevent immediate re-trigger
-    }
+    server.on("/recording", HTTP_GET, sendRecording);
     
-    // Pending broadcast
-    if (pendingBroadcast && systemSpeed < 2 && 
-        (now - lastBroadcastTime) >= BROADCAST_INTERVAL) {
-        broadcastState();
-        lastBroadcastTime = now;
-        pendingBroadcast = false;
-    }
+    server.begin();
     
-    // UART
-    handle_uart();
+    xTaskCreatePinnedToCore(egressTask, "ws_egress", EGRESS_TASK_STACK, nullptr,
+                            EGRESS_TASK_PRIORITY, &taskStats[TASK_EGRESS].handle, BRIDGE_TASK_CORE);
+    spi_set_consumer(taskStats[TASK_EGRESS].handle);
+    xTaskCreatePinnedToCore(uartTask, "uart", UART_TASK_STACK, nullptr,
+                            UART_TASK_PRIORITY, &taskStats[TASK_UART].handle, BRIDGE_TASK_CORE);
+    xTaskCreatePinnedToCore(housekeepingTask, "housekeeping", HOUSEKEEPING_TASK_STACK, nullptr,
+                            HOUSEKEEPING_TASK_PRIORITY, &taskStats[TASK_HOUSEKEEPING].handle, BRIDGE_TASK_CORE);
     
-    // Binary data - adaptive interval
-    uint32_t binaryInterval = (systemSpeed == 0) ? BINARY_INTERVAL_NORMAL : 
-                              (systemSpeed == 1) ? BINARY_INTERVAL_SLOW : 500;
+    Serial.println("✓ Ready!\n");
+}
+
+// ==================== BRIDGE TASKS ====================
+static void accountBusy(BridgeTask task, int64_t start) {
+    taskStats[task].busyUs += esp_timer_get_time() - start;
+}
+
+// WebSocket egress, woken per SPI frame: frames, windows, measurements,
+// broadcasts and pings go out from here. onWsEvent still answers its own
+// client (init, pong, state, command replies) from the AsyncTCP task
+static void egressTask(void* arg) {
+    uint32_t lastCleanup = 0;
     
-    if ((now - lastBinaryCheck) >= binaryInterval) {
-        lastBinaryCheck = now;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EGRESS_IDLE_MS));
+        int64_t start = esp_timer_get_time();
+        uint32_t now = millis();
         
-        if (is_spi_data_ready() && handle_spi_transaction_nonblocking()) {
-            if (ws.count() > 0) {
-                sendBinaryToClients(get_rx_buffer(), BUFFER_SIZE);
-            }
+        // Auto-recovery: speed up if no errors for a while
+        if (systemSpeed > 0 && (now - lastErrorTime) > ERROR_RECOVERY_TIME) {
+            systemSpeed--;
+            bridgeLog("✓ System speed restored to level %d\n", systemSpeed);
+            lastErrorTime = now;  // Prevent immediate re-trigger
+        }
+        
+        // Binary data - per-client intervals throttle what goes out
+        recorder_service();
+        while (spi_poll_frame()) {
+            handle_spi_frame(get_frame_buffer(), get_frame_length());
+            
+            uint32_t latency = esp_timer_get_time() - get_frame_timestamp();
+            fanoutStats.latencyUs = latency;
+            if (latency > fanoutStats.latencyMaxUs) fanoutStats.latencyMaxUs = latency;
+            spi_release_frame();
+        }
+        handle_replay();
+        
+        // Pending broadcast
+        if (pendingBroadcast && systemSpeed < 2 && 
+            (now - lastBroadcastTime) >= BROADCAST_INTERVAL) {
+            broadcastState();
+            lastBroadcastTime = now;
+            pendingBroadcast = false;
         }
-    }
-    
-    // Keep-alive
-    pingClients();
-    
-    // Heartbeat
-    if ((now - lastHeartbeat) > 10000) {
-        lastHeartbeat = now;
         
-        Serial.println("─────────────────────────────────────");
-        Serial.printf("♥ %lus | Heap:%u | Clients:%d | Speed:%d\n", 
-            now/1000, ESP.getFreeHeap(), countActiveClients(), systemSpeed);
+        // Keep-alive
+        pingClients();
         
-        if (meas.valid) {
-            Serial.printf("  %luHz %umVpp | %s\n", 
-                (unsigned long)meas.frequency_hz, (unsigned)meas.amplitude_mv,
-                sharedState.displayMode == MODE_FREQ_DOMAIN ? "FFT" : "TIME");
+        // Cleanup
+        if ((now - lastCleanup) > 2000) {
+            lastCleanup = now;
+            ws.cleanupClients();
         }
-        Serial.println("─────────────────────────────────────\n");
+        
+        accountBusy(TASK_EGRESS, start);
     }
+}
+
+// UART: command TX from the queue, replies parsed between commands
+static void uartTask(void* arg) {
+    char cmd[STM_CMD_LEN];
     
-    // Cleanup
-    if ((now - lastCleanup) > 2000) {
-        lastCleanup = now;
-        ws.cleanupClients();
+    for (;;) {
+        bool pending = xQueueReceive(uartTxQueue, cmd, pdMS_TO_TICKS(UART_POLL_MS)) == pdTRUE;
+        int64_t start = esp_timer_get_time();
+        
+        if (pending) SerialSTM.printf("%s\n", cmd);
+        handle_uart();
+        
+        accountBusy(TASK_UART, start);
+    }
+}
+
+// Per-task share of one core over the last window
+static void updateTaskLoad(uint32_t windowMs) {
+    for (int i = 0; i < NUM_BRIDGE_TASKS; i++) {
+        uint64_t busy = taskStats[i].busyUs - taskStats[i].windowBusyUs;
+        taskStats[i].windowBusyUs = taskStats[i].busyUs;
+        taskStats[i].loadPermille = min((uint64_t)1000, busy / windowMs);
     }
+}
+
+// Housekeeping: the only task that writes the console
+static void housekeepingTask(void* arg) {
+    uint32_t lastHeartbeat = 0;
+    uint32_t lastLoad = millis();
+    char line[LOG_LINE_LEN];
     
-    delay(1);
-}
\ No newline at end of file
+    for (;;) {
+        bool logged = xQueueReceive(logQueue, line, pdMS_TO_TICKS(100)) == pdTRUE;
+        int64_t start = esp_timer_get_time();
+        
+        while (logged) {
+            Serial.print(line);
+            logged = xQueueReceive(logQueue, line, 0) == pdTRUE;
+        }
+        
+        uint32_t now = millis();
+        if ((now - lastLoad) >= 1000) {
+            updateTaskLoad(now - lastLoad);
+            lastLoad = now;
+        }
+        
+        // Heartbeat
+        if ((now - lastHeartbeat) > 10000) {
+            lastHeartbeat = now;
+            
+            Serial.println("─────────────────────────────────────");
+            Serial.printf("♥ %lus | Heap:%u | Clients:%d | Speed:%d\n", 
+                now/1000, ESP.getFreeHeap(), countActiveClients(), systemSpeed);
+            Serial.printf("  STM32 %u FPS | dead %u.%u%% | overruns %lu\n",
+                acqStats.fps, acqStats.dead_permille / 10, acqStats.dead_permille % 10,
+                (unsigned long)acqStats.overruns);
+            
+            // Refresh acquisition stats for /health (reply arrives via handle_uart)
+            sendStmCommand("Q");
+            
+            if (meas.valid) {
+                Serial.printf("  %luHz %umVpp | %s\n", 
+                    (unsigned long)meas.frequency_hz, (unsigned)meas.amplitude_mv,
+                    sharedState.displayMode == MODE_FREQ_DOMAIN ? "FFT" : "TIME");
+            }
+            Serial.println("─────────────────────────────────────\n");
+        }
+        
+        accountBusy(TASK_HOUSEKEEPING, start);
+    }
+}
+
+// ==================== MAIN LOOP ====================
+// All work runs in the bridge tasks
+void loop() {
+    vTaskDelete(NULL);
+}
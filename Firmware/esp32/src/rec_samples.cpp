@@ -0,0 +1,36 @@
+#include "rec_samples.h"
+
+// Zigzag varint deltas: one byte for steps up to ±63 codes, two up to ±8191
+size_t encodeSamples(const uint16_t* s, uint16_t n, uint8_t* out) {
+    uint8_t* p = out;
+    uint16_t prev = 0;
+    
+    for (uint16_t i = 0; i < n; i++) {
+        int32_t d = (int32_t)s[i] - prev;
+        uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+        prev = s[i];
+        while (z >= 0x80) {
+            *p++ = (uint8_t)z | 0x80;
+            z >>= 7;
+        }
+        *p++ = (uint8_t)z;
+    }
+    return p - out;
+}
+
+bool decodeSamples(const uint8_t* p, const uint8_t* end, uint16_t* s, uint16_t n) {
+    uint16_t prev = 0;
+    
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t z = 0;
+        for (uint8_t shift = 0;; shift += 7) {
+            if (p >= end || shift > 14) return false;
+            uint8_t b = *p++;
+            z |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        prev += (uint16_t)((z >> 1) ^ (0 - (z & 1)));
+        s[i] = prev;
+    }
+    return true;
+}
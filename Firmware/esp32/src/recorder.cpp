@@ -0,0 +1,525 @@
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <esp_heap_caps.h>
+#include "config.h"
+#include "structures.h"
+#include "state.h"
+#include "rec_samples.h"
+
+extern RecorderStats recStats;
+extern QueueStats recChunkStats;
+extern TaskStats taskStats[NUM_BRIDGE_TASKS];
+extern void bridgeLog(const char* fmt, ...);
+
+// ==================== FILE FORMAT ====================
+// RECORD_PATH layout (little-endian):
+//   file header   "OSCR", version, header size, chunk size, start uptime ms,
+//                 settings snapshot
+//   records       type, 0, payload length (u16), ms since start (u32), payload
+//
+// REC_FRAME     flags, coding, sample count, seq, sample rate, then each
+//               sample as a zigzag varint of its delta to the previous one
+//               (rec_samples.cpp)
+// REC_MEAS      STM32 frame header (osc_frame.h v1, CRC included) carrying
+//               the measurements of the frames that follow
+// REC_SETTINGS  settings snapshot after a change
+#define RECORD_MAGIC            "OSCR"
+#define RECORD_VERSION          1
+#define RECORD_FILE_HEADER      32
+#define RECORD_RECORD_HEADER    8
+#define RECORD_SETTINGS_BYTES   16
+#define RECORD_FRAME_FIXED      12
+#define RECORD_MAX_PAYLOAD      (RECORD_FRAME_FIXED + REC_SAMPLES_MAX_BYTES(OSC_FRAME_MAX_SAMPLES))
+
+enum RecordType : uint8_t {
+    REC_FRAME = 1,
+    REC_MEAS = 2,
+    REC_SETTINGS = 3
+};
+
+#define REC_CODING_DELTA        0
+
+// ==================== WRITER QUEUE ====================
+// The egress task fills chunks and queues them; the recorder task writes
+// each one to flash and hands it back through freeChunks
+enum RecOpCode : uint8_t {
+    REC_OP_OPEN = 0,
+    REC_OP_WRITE,
+    REC_OP_CLOSE,
+    REC_OP_PLAY
+};
+
+struct RecOp {
+    RecOpCode code;
+    uint8_t chunk;
+    uint16_t len;
+};
+
+static uint8_t* chunks[RECORD_CHUNKS] = {nullptr};
+static uint8_t* scratch = nullptr;          // One encoded record (replay: one read record)
+static uint16_t* replaySamples = nullptr;
+static QueueHandle_t freeChunks = nullptr;  // Chunk indices ready to fill
+static QueueHandle_t recOps = nullptr;
+
+// Producer state (egress task only)
+static int8_t curChunk = -1;
+static uint32_t curFill = 0;
+static uint32_t produced = 0;               // Bytes handed to the chunk ring
+static uint32_t recStart = 0;
+static uint32_t lastFrameT = 0, lastMeasT = 0;
+static bool measRecorded = false;
+
+// Requests from the command handlers, applied by the egress task
+static volatile bool requestStart = false;
+static volatile bool requestStop = false;
+static volatile bool settingsDirty = false;
+static volatile bool writeFailed = false;   // Set by the recorder task
+static volatile bool replayAbort = false;
+
+// Replay handoff (one item in flight)
+static volatile ReplayItem replayItem = REPLAY_NONE;
+static OscFrameHeader replayHdr;
+static SharedState replaySettings;
+
+static void recorderTask(void* arg);
+
+// ==================== ENCODING ====================
+static void encodeSettings(uint8_t* p, const SharedState& s) {
+    memset(p, 0, RECORD_SETTINGS_BYTES);
+    p[0] = (uint8_t)s.displayMode;
+    p[1] = s.running ? 1 : 0;
+    p[2] = s.trigMode;
+    p[3] = s.trigEdge;
+    osc_put32(p + 4, s.frequency);
+    osc_put32(p + 8, s.timebase);
+    p[12] = s.dutyCycle;
+    osc_put16(p + 14, s.trigLevel);
+}
+
+static void decodeSettings(const uint8_t* p, SharedState& s) {
+    s.displayMode = p[0] ? MODE_FREQ_DOMAIN : MODE_TIME_DOMAIN;
+    s.running = p[1] != 0;
+    s.trigMode = p[2];
+    s.trigEdge = p[3];
+    s.frequency = osc_get32(p + 4);
+    s.timebase = osc_get32(p + 8);
+    s.dutyCycle = p[12];
+    s.trigLevel = osc_get16(p + 14);
+    s.lastChangeTime = millis();
+}
+
+// ==================== CHUNK RING (egress task) ====================
+static void submitChunk() {
+    RecOp op = {REC_OP_WRITE, (uint8_t)curChunk, (uint16_t)curFill};
+    xQueueSend(recOps, &op, 0);  // Sized for every chunk plus control ops
+    
+    uint16_t waiting = RECORD_CHUNKS - uxQueueMessagesWaiting(freeChunks);
+    if (waiting > recChunkStats.highWater) recChunkStats.highWater = waiting;
+    curChunk = -1;
+    curFill = 0;
+}
+
+static void appendBytes(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        if (curChunk < 0) {
+            uint8_t idx;
+            if (xQueueReceive(freeChunks, &idx, 0) != pdTRUE) return;  // Checked by reserve()
+            curChunk = idx;
+        }
+        size_t n = min((size_t)(RECORD_CHUNK_BYTES - curFill), len);
+        memcpy(chunks[curChunk] + curFill, data, n);
+        curFill += n;
+        data += n;
+        len -= n;
+        if (curFill == RECORD_CHUNK_BYTES) submitChunk();
+    }
+}
+
+// Whole records only: fail up front rather than write half of one
+static bool reserve(size_t len) {
+    uint32_t room = uxQueueMessagesWaiting(freeChunks) * RECORD_CHUNK_BYTES;
+    if (curChunk >= 0) room += RECORD_CHUNK_BYTES - curFill;
+    return len <= room;
+}
+
+static void stopRecording(const char* why) {
+    if (curChunk >= 0) {
+        if (curFill > 0) {
+            submitChunk();
+        } else {
+            uint8_t idx = curChunk;
+            xQueueSend(freeChunks, &idx, 0);
+            curChunk = -1;
+        }
+    }
+    RecOp op = {REC_OP_CLOSE, 0, 0};
+    xQueueSend(recOps, &op, 0);
+    recStats.state = REC_IDLE;
+    bridgeLog("■ Recording stopped (%s): %lu frames, %lu bytes, %lu dropped\n", why,
+              (unsigned long)recStats.frames, (unsigned long)produced,
+              (unsigned long)recChunkStats.dropped);
+}
+
+static bool appendRecord(RecordType type, uint32_t t, const uint8_t* payload, size_t len) {
+    if (recStats.state != REC_RECORDING) return false;
+    if (produced + RECORD_RECORD_HEADER + len > recStats.limit) {
+        stopRecording("flash full");
+        return false;
+    }
+    if (!reserve(RECORD_RECORD_HEADER + len)) return false;
+    
+    uint8_t rh[RECORD_RECORD_HEADER] = {type, 0};
+    osc_put16(rh + 2, len);
+    osc_put32(rh + 4, t);
+    appendBytes(rh, sizeof(rh));
+    appendBytes(payload, len);
+    produced += RECORD_RECORD_HEADER + len;
+    recStats.durationMs = t;
+    return true;
+}
+
+static void startRecording() {
+    if (!reserve(RECORD_FILE_HEADER)) return;  // Previous recording still draining
+    
+    uint8_t fh[RECORD_FILE_HEADER] = {0};
+    memcpy(fh, RECORD_MAGIC, 4);
+    fh[4] = RECORD_VERSION;
+    fh[5] = RECORD_FILE_HEADER;
+    osc_put16(fh + 6, RECORD_CHUNK_BYTES);
+    recStart = millis();
+    osc_put32(fh + 8, recStart);
+    encodeSettings(fh + 12, sharedState);
+    
+    RecOp op = {REC_OP_OPEN, 0, 0};
+    xQueueSend(recOps, &op, 0);
+    
+    writeFailed = false;
+    settingsDirty = false;
+    measRecorded = false;
+    recStats.frames = 0;
+    recStats.writeErrors = 0;
+    recStats.durationMs = 0;
+    recChunkStats.highWater = 0;
+    recChunkStats.dropped = 0;
+    
+    produced = 0;
+    appendBytes(fh, sizeof(fh));
+    produced = sizeof(fh);
+    recStats.state = REC_RECORDING;
+    bridgeLog("● Recording to %s (limit %lu bytes, interval %lu ms)\n", RECORD_PATH,
+              (unsigned long)recStats.limit, (unsigned long)recStats.interval);
+}
+
+// ==================== EGRESS HOOKS ====================
+// Apply start/stop requests; called once per egress loop
+void recorder_service() {
+    if (requestStart) {
+        requestStart = false;
+        if (recStats.state == REC_IDLE) startRecording();
+    }
+    if (recStats.state != REC_RECORDING) {
+        requestStop = false;
+        return;
+    }
+    if (writeFailed) {
+        stopRecording("write error");
+    } else if (requestStop) {
+        requestStop = false;
+        stopRecording("stopped");
+    }
+}
+
+// Append one live frame (and its measurements, rate-limited)
+void recorder_frame(const OscFrameHeader& hdr, const uint16_t* samples) {
+    if (recStats.state != REC_RECORDING) return;
+    uint32_t t = millis() - recStart;
+    
+    if (settingsDirty) {
+        settingsDirty = false;
+        encodeSettings(scratch, sharedState);
+        if (!appendRecord(REC_SETTINGS, t, scratch, RECORD_SETTINGS_BYTES)) settingsDirty = true;
+    }
+    
+    // Deep-record extension is live state only: recorded headers drop it
+    if ((hdr.flags & OSC_FRAME_MEAS) && (!measRecorded || (t - lastMeasT) >= RECORD_MEAS_INTERVAL)) {
+        OscFrameHeader h = hdr;
+        h.flags &= ~OSC_FRAME_RECORD;
+        if (appendRecord(REC_MEAS, t, scratch, osc_frame_encode(&h, scratch))) {
+            measRecorded = true;
+            lastMeasT = t;
+        }
+    }
+    
+    if (recStats.frames > 0 && (t - lastFrameT) < recStats.interval) return;
+    
+    scratch[0] = hdr.flags & ~OSC_FRAME_RECORD;
+    scratch[1] = REC_CODING_DELTA;
+    osc_put16(scratch + 2, hdr.sample_count);
+    osc_put32(scratch + 4, hdr.seq);
+    osc_put32(scratch + 8, hdr.sample_rate_hz);
+    size_t len = RECORD_FRAME_FIXED + encodeSamples(samples, hdr.sample_count, scratch + RECORD_FRAME_FIXED);
+    
+    if (appendRecord(REC_FRAME, t, scratch, len)) {
+        recStats.frames++;
+        lastFrameT = t;
+    } else if (recStats.state == REC_RECORDING) {
+        recChunkStats.dropped++;
+    }
+}
+
+// Settings changed: a snapshot goes in before the next frame
+void recorder_note_settings() {
+    if (recStats.state == REC_RECORDING) settingsDirty = true;
+}
+
+bool recorder_replaying() {
+    return recStats.state == REC_REPLAYING;
+}
+
+// Item handed over by the recorder task; release it once consumed
+ReplayItem recorder_replay_poll(OscFrameHeader& hdr, const uint16_t*& samples, SharedState& settings) {
+    ReplayItem item = replayItem;
+    if (item == REPLAY_FRAME) {
+        hdr = replayHdr;
+        samples = replaySamples;
+    } else if (item == REPLAY_SETTINGS) {
+        settings = replaySettings;
+    }
+    return item;
+}
+
+void recorder_replay_release() {
+    replayItem = REPLAY_NONE;
+    xTaskNotifyGive(taskStats[TASK_RECORDER].handle);
+}
+
+// ==================== COMMANDS ====================
+static void* allocBuffer(size_t len) {
+    void* p = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(len);
+}
+
+// Buffers are taken on first use so an unused recorder costs no heap
+static bool allocBuffers() {
+    if (scratch) return true;
+    
+    for (uint32_t i = 0; i < RECORD_CHUNKS; i++) {
+        if (!chunks[i]) chunks[i] = (uint8_t*)allocBuffer(RECORD_CHUNK_BYTES);
+        if (!chunks[i]) return false;
+    }
+    if (!replaySamples) replaySamples = (uint16_t*)allocBuffer(OSC_FRAME_MAX_SAMPLES * 2);
+    if (!replaySamples) return false;
+    scratch = (uint8_t*)allocBuffer(RECORD_MAX_PAYLOAD);
+    return scratch != nullptr;
+}
+
+// REC:START[,interval_ms], REC:STOP, REC:PLAY; false if refused
+bool recorder_command(const char* arg) {
+    if (strncmp(arg, "START", 5) == 0) {
+        if (recStats.state != REC_IDLE) return false;
+        if (!allocBuffers()) {
+            bridgeLog("⚠ Recorder: out of memory\n");
+            return false;
+        }
+        
+        // The previous recording is replaced, so its space counts as free
+        size_t avail = SPIFFS.totalBytes() - SPIFFS.usedBytes() + recStats.bytes;
+        if (avail < RECORD_RESERVE_BYTES + RECORD_CHUNK_BYTES) {
+            bridgeLog("⚠ Recorder: flash full\n");
+            return false;
+        }
+        recStats.limit = avail - RECORD_RESERVE_BYTES;
+        recStats.interval = (arg[5] == ',') ? atoi(arg + 6) : 0;
+        requestStart = true;
+        return true;
+    }
+    
+    if (strncmp(arg, "STOP", 4) == 0) {
+        requestStop = true;
+        replayAbort = true;
+        return true;
+    }
+    
+    if (strncmp(arg, "PLAY", 4) == 0) {
+        if (recStats.state != REC_IDLE || requestStart || recStats.bytes == 0) return false;
+        if (!allocBuffers()) return false;
+        
+        replayAbort = false;
+        recStats.state = REC_REPLAYING;
+        RecOp op = {REC_OP_PLAY, 0, 0};
+        xQueueSend(recOps, &op, 0);
+        return true;
+    }
+    return false;
+}
+
+// ==================== SETUP ====================
+void recorder_begin() {
+    freeChunks = xQueueCreate(RECORD_CHUNKS, sizeof(uint8_t));
+    recOps = xQueueCreate(RECORD_CHUNKS + 4, sizeof(RecOp));
+    for (uint8_t i = 0; i < RECORD_CHUNKS; i++) xQueueSend(freeChunks, &i, 0);
+    recChunkStats.capacity = RECORD_CHUNKS;
+    
+    // A recording from a previous session stays downloadable
+    File f = SPIFFS.open(RECORD_PATH, "r");
+    if (f) {
+        recStats.bytes = f.size();
+        f.close();
+    }
+    
+    xTaskCreatePinnedToCore(recorderTask, "recorder", RECORDER_TASK_STACK, nullptr,
+                            RECORDER_TASK_PRIORITY, &taskStats[TASK_RECORDER].handle, BRIDGE_TASK_CORE);
+}
+
+// ==================== RECORDER TASK ====================
+static void accountBusy(int64_t start) {
+    taskStats[TASK_RECORDER].busyUs += esp_timer_get_time() - start;
+}
+
+// Hand one item to the egress task and wait until it has been consumed
+static void handoff(ReplayItem item) {
+    replayItem = item;
+    xTaskNotifyGive(taskStats[TASK_EGRESS].handle);
+    while (replayItem != REPLAY_NONE) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    }
+}
+
+static bool decodeFrame(const uint8_t* p, size_t len, const OscFrameHeader* meas, bool fresh) {
+    if (len < RECORD_FRAME_FIXED || p[1] != REC_CODING_DELTA) return false;
+    uint16_t count = osc_get16(p + 2);
+    if (count > OSC_FRAME_MAX_SAMPLES) return false;
+    if (!decodeSamples(p + RECORD_FRAME_FIXED, p + len, replaySamples, count)) return false;
+    
+    // Measurements only on the first frame after a REC_MEAS record; the
+    // zoom band and spectrum scale hold until the next one
+    if (meas && fresh) {
+        replayHdr = *meas;
+        replayHdr.flags = p[0] | OSC_FRAME_MEAS;
+    } else {
+        memset(&replayHdr, 0, sizeof(replayHdr));
+        replayHdr.flags = p[0] & ~OSC_FRAME_MEAS;
+        if (meas) {
+            replayHdr.zoom_center_hz = meas->zoom_center_hz;
+            replayHdr.zoom_log2 = meas->zoom_log2;
+            replayHdr.db_scale = meas->db_scale;
+            replayHdr.db_ref_cdbfs = meas->db_ref_cdbfs;
+            replayHdr.db_floor_cdb = meas->db_floor_cdb;
+        }
+    }
+    replayHdr.version = OSC_FRAME_VERSION;
+    replayHdr.header_len = osc_frame_header_len(replayHdr.flags, replayHdr.num_peaks);
+    replayHdr.sample_count = count;
+    replayHdr.seq = osc_get32(p + 4);
+    replayHdr.sample_rate_hz = osc_get32(p + 8);
+    return true;
+}
+
+// Feed the recording to the egress task, paced by the record timestamps
+static void replay() {
+    int64_t busyStart = esp_timer_get_time();
+    uint8_t fh[RECORD_FILE_HEADER];
+    File f = SPIFFS.open(RECORD_PATH, "r");
+    
+    if (!f || f.read(fh, sizeof(fh)) != sizeof(fh) || memcmp(fh, RECORD_MAGIC, 4) != 0 ||
+        fh[4] != RECORD_VERSION || !f.seek(fh[5])) {
+        bridgeLog("⚠ Recorder: no valid recording\n");
+        recStats.state = REC_IDLE;
+        handoff(REPLAY_END);
+        return;
+    }
+    bridgeLog("▶ Replaying %s (%u bytes)\n", RECORD_PATH, (unsigned)f.size());
+    
+    decodeSettings(fh + 12, replaySettings);
+    handoff(REPLAY_SETTINGS);
+    
+    OscFrameHeader meas;
+    bool haveMeas = false, newMeas = false;
+    uint8_t rh[RECORD_RECORD_HEADER];
+    uint32_t t0 = millis();
+    recStats.frames = 0;
+    
+    while (!replayAbort && f.read(rh, sizeof(rh)) == sizeof(rh)) {
+        uint16_t len = osc_get16(rh + 2);
+        uint32_t t = osc_get32(rh + 4);
+        if (len > RECORD_MAX_PAYLOAD || f.read(scratch, len) != len) break;  // Truncated tail
+        
+        accountBusy(busyStart);
+        while (!replayAbort && (int32_t)(t - (millis() - t0)) > 0) {
+            vTaskDelay(pdMS_TO_TICKS(min((uint32_t)50, t - (millis() - t0))));
+        }
+        busyStart = esp_timer_get_time();
+        
+        switch (rh[0]) {
+            case REC_SETTINGS:
+                if (len < RECORD_SETTINGS_BYTES) break;
+                decodeSettings(scratch, replaySettings);
+                handoff(REPLAY_SETTINGS);
+                break;
+            case REC_MEAS:
+                newMeas = osc_frame_decode(scratch, len, &meas) == OSC_FRAME_OK;
+                haveMeas |= newMeas;
+                break;
+            case REC_FRAME:
+                if (!decodeFrame(scratch, len, haveMeas ? &meas : nullptr, newMeas)) break;
+                newMeas = false;
+                recStats.frames++;
+                handoff(REPLAY_FRAME);
+                break;
+            default:
+                break;  // Unknown record types are skipped
+        }
+    }
+    
+    f.close();
+    bridgeLog("■ Replay %s: %lu frames\n", replayAbort ? "stopped" : "done", (unsigned long)recStats.frames);
+    recStats.state = REC_IDLE;
+    handoff(REPLAY_END);
+    accountBusy(busyStart);
+}
+
+// Flash writes and replay reads, below every realtime task
+static void recorderTask(void* arg) {
+    File file;
+    RecOp op;
+    
+    for (;;) {
+        if (xQueueReceive(recOps, &op, portMAX_DELAY) != pdTRUE) continue;
+        int64_t start = esp_timer_get_time();
+        
+        switch (op.code) {
+            case REC_OP_OPEN:
+                SPIFFS.remove(RECORD_PATH);
+                recStats.bytes = 0;
+                file = SPIFFS.open(RECORD_PATH, "w");
+                if (!file) {
+                    recStats.writeErrors++;
+                    writeFailed = true;
+                }
+                break;
+            
+            case REC_OP_WRITE:
+                if (file && !writeFailed) {
+                    size_t n = file.write(chunks[op.chunk], op.len);
+                    file.flush();  // Visible to /recording as soon as it lands
+                    if (n != op.len) {
+                        recStats.writeErrors++;
+                        writeFailed = true;
+                    }
+                    recStats.bytes += n;
+                }
+                xQueueSend(freeChunks, &op.chunk, 0);
+                break;
+            
+            case REC_OP_CLOSE:
+                if (file) file.close();
+                break;
+            
+            case REC_OP_PLAY:
+                replay();
+                continue;  // Accounted its own work
+        }
+        
+        accountBusy(start);
+    }
+}
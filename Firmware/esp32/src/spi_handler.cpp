@@ -1,15 +1,40 @@
 #include <Arduino.h>
 #include <driver/spi_slave.h>
+#include <esp_heap_caps.h>
 #include "config.h"
+#include "structures.h"
+
+extern FrameStats frameStats;
+extern TaskStats taskStats[NUM_BRIDGE_TASKS];
+extern QueueStats frameQueueStats;
 
 // ==================== SPI BUFFERS ====================
-WORD_ALIGNED_ATTR uint8_t rx_buf[BUFFER_SIZE];
+// One DMA buffer per queued transaction; the driver always holds all of
+// them so a chunk arriving while we copy the previous one still lands
+WORD_ALIGNED_ATTR uint8_t rx_bufs[SPI_QUEUE_DEPTH][BUFFER_SIZE];
 WORD_ALIGNED_ATTR uint8_t tx_buf[BUFFER_SIZE];
+static spi_slave_transaction_t transactions[SPI_QUEUE_DEPTH];
+
+// ==================== FRAME QUEUE ====================
+// Single-producer (SPI task) / single-consumer (egress task) ring of reassembled
+// frames. The producer assembles into slot[head] and publishes by moving
+// head; the consumer reads slot[tail] and frees it by moving tail. One
+// slot is always the producer's, so SPI_FRAME_SLOTS - 1 frames can wait.
+static uint8_t* frame_slots[SPI_FRAME_SLOTS] = {nullptr};
+static size_t frame_lens[SPI_FRAME_SLOTS];
+static int64_t frame_stamps[SPI_FRAME_SLOTS];   // esp_timer time the frame completed
+static volatile uint32_t frame_head = 0;
+static volatile uint32_t frame_tail = 0;
+
+// Reassembly state (SPI task only)
+static FrameAssembler assembler = {0, 0};
 
 // ==================== SPI STATE ====================
 static bool spiInitialized = false;
-static bool transactionQueued = false;
-static spi_slave_transaction_t currentTrans;
+static uint32_t armed = 0;          // Transactions currently held by the driver
+static TaskHandle_t consumerTask = nullptr;   // Woken for every published frame
+
+static void spi_ingest_task(void* arg);
 
 // ==================== SPI INITIALIZATION ====================
 void setup_spi_slave() {
@@ -25,87 +50,117 @@ void setup_spi_slave() {
     spi_slave_interface_config_t slvcfg = {
         .spics_io_num = SPI_CS_PIN,
         .flags = 0,
-        .queue_size = 3,
+        .queue_size = SPI_QUEUE_DEPTH,
         .mode = 0
     };
-
+    
     esp_err_t ret = spi_slave_initialize(SPI2_HOST, &buscfg, &slvcfg, SPI_DMA_CH_AUTO);
     if (ret != ESP_OK) {
         Serial.printf("❌ SPI init failed: %d\n", ret);
         while(1) delay(1000);
     }
     
+    // Reassembly slots: PSRAM when fitted, internal heap otherwise
+    for (uint32_t i = 0; i < SPI_FRAME_SLOTS; i++) {
+        frame_slots[i] = (uint8_t*)heap_caps_malloc(FRAME_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!frame_slots[i]) frame_slots[i] = (uint8_t*)malloc(FRAME_BUFFER_SIZE);
+        if (!frame_slots[i]) {
+            Serial.println("❌ Frame buffer alloc failed");
+            while(1) delay(1000);
+        }
+    }
+    
     memset(tx_buf, 0xFF, BUFFER_SIZE);
-    memset(rx_buf, 0, BUFFER_SIZE);
+    memset(rx_bufs, 0, sizeof(rx_bufs));
+    
+    // Arm the whole ring up front
+    for (uint32_t i = 0; i < SPI_QUEUE_DEPTH; i++) {
+        memset(&transactions[i], 0, sizeof(transactions[i]));
+        transactions[i].length = BUFFER_SIZE * 8;
+        transactions[i].rx_buffer = rx_bufs[i];
+        transactions[i].tx_buffer = tx_buf;
+        if (spi_slave_queue_trans(SPI2_HOST, &transactions[i], portMAX_DELAY) == ESP_OK) {
+            armed++;
+        }
+    }
     spiInitialized = true;
-    transactionQueued = false;
     
-    Serial.println("✓ SPI Slave ready (non-blocking mode)");
+    // Collect completions away from the WiFi core
+    frameQueueStats.capacity = SPI_FRAME_SLOTS - 1;
+    xTaskCreatePinnedToCore(spi_ingest_task, "spi_ingest", SPI_TASK_STACK, nullptr,
+                            SPI_TASK_PRIORITY, &taskStats[TASK_SPI].handle, SPI_TASK_CORE);
+    
+    Serial.printf("✓ SPI Slave ready (%u buffers, core %d)\n", armed, SPI_TASK_CORE);
 }
 
-// ==================== CHECK IF DATA READY ====================
-bool is_spi_data_ready() {
-    if (!spiInitialized) return false;
+// ==================== SPI INGEST TASK ====================
+static void spi_ingest_task(void* arg) {
+    spi_slave_transaction_t* done;
     
-    // Queue a transaction if none pending
-    if (!transactionQueued) {
-        memset(&currentTrans, 0, sizeof(currentTrans));
-        currentTrans.length = BUFFER_SIZE * 8;
-        currentTrans.rx_buffer = rx_buf;
-        currentTrans.tx_buffer = tx_buf;
+    for (;;) {
+        if (spi_slave_get_trans_result(SPI2_HOST, &done, portMAX_DELAY) != ESP_OK) continue;
+        int64_t start = esp_timer_get_time();
+        armed--;
+        
+        // Ring ran dry: a chunk clocked in now would have had no buffer
+        if (armed == 0) frameStats.overruns++;
+        
+        uint32_t head = frame_head;
+        size_t len = done->trans_len / 8;
+        bool complete = len && assembler.add(frame_slots[head], FRAME_BUFFER_SIZE,
+                                             (const uint8_t*)done->rx_buffer, len, frameStats);
+        
+        // Hand the buffer straight back to the driver
+        if (spi_slave_queue_trans(SPI2_HOST, done, portMAX_DELAY) == ESP_OK) armed++;
         
-        if (spi_slave_queue_trans(SPI2_HOST, &currentTrans, 0) == ESP_OK) {
-            transactionQueued = true;
+        if (complete) {
+            frameStats.received++;
+            
+            uint32_t next = (head + 1) % SPI_FRAME_SLOTS;
+            if (next == frame_tail) {
+                // Consumer hasn't freed a slot: overwrite this frame with the next
+                frameStats.dropped++;
+            } else {
+                frame_lens[head] = assembler.len;
+                frame_stamps[head] = esp_timer_get_time();
+                __sync_synchronize();  // Slot contents visible before the index moves
+                frame_head = next;
+                
+                uint16_t depth = (next + SPI_FRAME_SLOTS - frame_tail) % SPI_FRAME_SLOTS;
+                if (depth > frameQueueStats.highWater) frameQueueStats.highWater = depth;
+                if (consumerTask) xTaskNotifyGive(consumerTask);
+            }
         }
+        
+        taskStats[TASK_SPI].busyUs += esp_timer_get_time() - start;
     }
-    
-    return transactionQueued;
 }
 
-// ==================== NON-BLOCKING SPI TRANSACTION ====================
-bool handle_spi_transaction_nonblocking() {
-    if (!transactionQueued) return false;
-    
-    spi_slave_transaction_t* completedTrans;
-    
-    // Non-blocking check for completed transaction
-    esp_err_t ret = spi_slave_get_trans_result(SPI2_HOST, &completedTrans, 0);
-    
-    if (ret == ESP_OK && completedTrans->trans_len > 0) {
-        transactionQueued = false;
-        return true;
-    }
-    
-    if (ret == ESP_ERR_TIMEOUT) {
-        // No data yet, transaction still pending
-        return false;
-    }
-    
-    // Error occurred
-    transactionQueued = false;
-    return false;
+// ==================== FRAME QUEUE ACCESS ====================
+// Task to notify when a frame is published (the WebSocket egress task)
+void spi_set_consumer(TaskHandle_t task) {
+    consumerTask = task;
 }
 
-// ==================== LEGACY BLOCKING VERSION ====================
-bool handle_spi_transaction(void* ws_handle) {
-    spi_slave_transaction_t trans;
-    memset(&trans, 0, sizeof(trans));
-    trans.length = BUFFER_SIZE * 8;
-    trans.rx_buffer = rx_buf;
-    trans.tx_buffer = tx_buf;
-    
-    // Reduced timeout - 10ms instead of 100ms
-    if (spi_slave_transmit(SPI2_HOST, &trans, pdMS_TO_TICKS(10)) == ESP_OK) {
-        return (trans.trans_len > 0);
-    }
-    return false;
+// Consumer side: true while a frame waits at the tail
+bool spi_poll_frame() {
+    return spiInitialized && frame_tail != frame_head;
+}
+
+uint8_t* get_frame_buffer() {
+    return frame_slots[frame_tail];
+}
+
+size_t get_frame_length() {
+    return frame_lens[frame_tail];
 }
 
-// ==================== GET BUFFER ACCESS ====================
-uint8_t* get_rx_buffer() {
-    return rx_buf;
+int64_t get_frame_timestamp() {
+    return frame_stamps[frame_tail];
 }
 
-size_t get_last_transaction_length() {
-    return BUFFER_SIZE;
-}
\ No newline at end of file
+// Give the tail slot back to the SPI task once the frame is consumed
+void spi_release_frame() {
+    __sync_synchronize();
+    frame_tail = (frame_tail + 1) % SPI_FRAME_SLOTS;
+}
@@ -6,5 +6,8 @@ SharedState sharedState = {
     .timebase = 100,
     .dutyCycle = 50,
     .running = true,
-    .lastChangeTime = 0
+    .lastChangeTime = 0,
+    .trigMode = 0,
+    .trigLevel = 1650,
+    .trigEdge = 0
 };
\ No newline at end of file
@@ -33,6 +33,122 @@ void MeasData::reset() {
   valid = false;
 }
 
+// ==================== FFTBAND METHODS ====================
+bool FftBand::note(uint32_t rate, uint32_t center, uint8_t log2) {
+  if(rate == sample_rate && center == center_hz && log2 == zoom_log2) return false;
+  sample_rate = rate;
+  center_hz = center;
+  zoom_log2 = log2;
+  return true;
+}
+
+bool FftBand::noteScale(uint8_t scale, int16_t ref_cdbfs, int16_t floor_cdb) {
+  if(scale == db_scale && ref_cdbfs == db_ref_cdbfs && floor_cdb == db_floor_cdb) return false;
+  db_scale = scale;
+  db_ref_cdbfs = ref_cdbfs;
+  db_floor_cdb = floor_cdb;
+  return true;
+}
+
+// Spectrum headers name their band (zoom-FFT on, off or re-centred) and
+// sample scale (dB on or off); other frames leave both as they were
+bool FftBand::noteFrame(const OscFrameHeader& hdr) {
+  if(!(hdr.flags & OSC_FRAME_SPECTRUM)) return false;
+  bool zoom = hdr.flags & OSC_FRAME_ZOOM;
+  bool moved = note(hdr.sample_rate_hz, zoom ? hdr.zoom_center_hz : 0, zoom ? hdr.zoom_log2 : 0);
+  moved |= noteScale(hdr.db_scale, hdr.db_ref_cdbfs, hdr.db_floor_cdb);
+  return moved;
+}
+
+// The rfft shows 0..rate/2 in FFT_SIZE/2 bins; a zoom band rate/2^log2
+// around its centre in as many complex bins
+float FftBand::span() const {
+  return zoom_log2 ? (float)sample_rate / (1UL << zoom_log2) : sample_rate / 2.0f;
+}
+
+float FftBand::minFreq() const {
+  return zoom_log2 ? center_hz - span() / 2 : 0;
+}
+
+float FftBand::hzPerBin() const {
+  return span() / (FFT_SIZE / 2);
+}
+
+// dB spectra: sample v is floor + v * dbPerLsb dBFS, floor = dbRef + dbFloor
+String FftBand::json() const {
+  char buffer[288];
+  snprintf(buffer, sizeof(buffer),
+    "{\"sampleRate\":%lu,\"fftSize\":%u,\"displayBins\":%u,\"minFreq\":%.3f,"
+    "\"maxFreq\":%.3f,\"hzPerBin\":%.6f,\"center\":%lu,\"span\":%.3f,"
+    "\"db\":%s,\"dbRef\":%.2f,\"dbFloor\":%.2f,\"dbPerLsb\":%.3f,\"fullScaleDbv\":%.2f}",
+    (unsigned long)sample_rate, (unsigned)FFT_SIZE, (unsigned)DISPLAY_BINS, minFreq(),
+    minFreq() + span(), hzPerBin(), (unsigned long)(zoom_log2 ? center_hz : 0),
+    zoom_log2 ? span() : 0.0f, (db_scale == OSC_FRAME_SCALE_DB) ? "true" : "false",
+    db_ref_cdbfs / 100.0f, db_floor_cdb / 100.0f, OSC_FRAME_DB_PER_LSB, OSC_FRAME_FULL_SCALE_DBV);
+  return String(buffer);
+}
+
+// ==================== FRAMEASSEMBLER METHODS ====================
+bool FrameAssembler::add(uint8_t* dst, size_t cap, const uint8_t* chunk, size_t n, FrameStats& stats) {
+  OscFrameHeader hdr;
+  int res = osc_frame_decode(chunk, n, &hdr);
+  
+  if(res == OSC_FRAME_OK) {
+    if(expected) stats.incomplete++;
+    expected = osc_frame_length(&hdr);
+    len = 0;
+    // A header grown past what the slot holds: skip the whole frame
+    if(expected > cap) {
+      stats.syncErrors++;
+      expected = 0;
+      return false;
+    }
+  } else if(!expected) {
+    if(res == OSC_FRAME_ERR_CRC) stats.crcErrors++;
+    else stats.syncErrors++;
+    return false;
+  }
+  
+  size_t take = (n < expected - len) ? n : expected - len;
+  memcpy(dst + len, chunk, take);
+  len += take;
+  
+  if(len < expected) return false;
+  expected = 0;
+  return true;
+}
+
+void FrameAssembler::reset() {
+  len = 0;
+  expected = 0;
+}
+
+// ==================== DEEPRECORD METHODS ====================
+// The id follows every frame; only a new layout (size, segments, fill,
+// rate) is worth telling the clients about
+bool DeepRecord::note(const OscFrameHeader& hdr) {
+  bool deep = hdr.flags & OSC_FRAME_RECORD;
+  uint32_t t = deep ? hdr.rec_total : 0;
+  uint8_t segs = deep ? hdr.rec_segments : 0;
+  uint8_t fill = deep ? hdr.rec_filled : 0;
+  id = hdr.rec_id;
+  
+  if(t == total && segs == segments && fill == filled && hdr.sample_rate_hz == rate) return false;
+  total = t;
+  segments = segs;
+  filled = fill;
+  rate = hdr.sample_rate_hz;
+  return true;
+}
+
+String DeepRecord::json() const {
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer),
+    "{\"type\":\"record\",\"id\":%u,\"total\":%lu,\"segments\":%u,\"filled\":%u,\"rate\":%lu}",
+    id, (unsigned long)total, segments, filled, (unsigned long)rate);
+  return String(buffer);
+}
+
 // ==================== SIGNALSTATS METHODS ====================
 void SignalStats::updateStability(uint32_t freq) {
   if(freq == 0) return;
@@ -3,6 +3,10 @@
 #include "config.h"
 
 extern MeasData meas;
+extern FftBand fftBand;
+extern AcqStats acqStats;
+extern MemStats memStats;
+extern ProfileStats profileStats;
 extern HardwareSerial SerialSTM;
 
 // ==================== UART PARSER ====================
@@ -16,7 +20,7 @@ String build_measurement_json(MeasData& d) {
                 ",\"pfreqs\":[";
 
   for (uint8_t i = 0; i < d.num_peaks; i++) {
-    json += String(d.peak_freqs[i]);
+    json += String(d.peak_freqs[i], 3);
     if (i < d.num_peaks - 1) json += ",";
   }
   json += "],\"pmags\":[";
@@ -25,88 +29,148 @@ String build_measurement_json(MeasData& d) {
     if (i < d.num_peaks - 1) json += ",";
   }
 
-  // FFT config for JS peak positioning
-  json += "],\"fftParams\":{";
-  json += "\"sampleRate\":" + String(FFT_SAMPLE_RATE);
-  json += ",\"fftSize\":" + String(FFT_SIZE);
-  json += ",\"displayBins\":" + String(DISPLAY_BINS);
-  json += ",\"maxFreq\":" + String((int)MAX_DISPLAY_FREQ);
-  json += "}}";
+  json += "]";
+
+  // Welch PSD levels, dBV from the ADC full scale
+  if (d.psd_segments) {
+    json += ",\"psd\":{\"seg\":" + String(d.psd_segments) +
+            ",\"ovl\":" + String(d.psd_overlap) +
+            ",\"tone\":" + String(d.psd_tone_dbfs, 2) +
+            ",\"toneDbv\":" + String(d.psd_tone_dbfs + OSC_FRAME_FULL_SCALE_DBV, 2) +
+            ",\"floor\":" + String(d.psd_floor_dbfs, 2) +
+            ",\"floorDbv\":" + String(d.psd_floor_dbfs + OSC_FRAME_FULL_SCALE_DBV, 2) + "}";
+  }
+
+  // Distortion analysis; THD also as a percentage of the fundamental
+  if (d.dist_harmonics) {
+    json += ",\"dist\":{\"h\":" + String(d.dist_harmonics) +
+            ",\"thd\":" + String(d.thd_db, 2) +
+            ",\"thdPct\":" + String(100.0f * powf(10.0f, d.thd_db / 20.0f), 4) +
+            ",\"thdn\":" + String(d.thdn_db, 2) +
+            ",\"sinad\":" + String(-d.thdn_db, 2) +
+            ",\"snr\":" + String(d.snr_db, 2) +
+            ",\"sfdr\":" + String(d.sfdr_db, 2) +
+            ",\"enob\":" + String(d.enob, 2) + "}";
+  }
+
+  // FFT band for JS peak positioning
+  json += ",\"fftParams\":" + fftBand.json() + "}";
 
   return json;
 }
 
-void parse_measurements(String line) {
-  Serial.print("RECV: ");
-  Serial.println(line);
+// Measurements decoded from an SPI frame header (no text parsing)
+void apply_frame_measurements(const OscFrameHeader& h) {
+  if (!(h.flags & OSC_FRAME_MEAS)) return;
 
-  if (!line.startsWith("M:")) return;
+  // Update smoothed scalar measurements
+  meas.update(h.amplitude_mv, h.frequency_hz, h.period_us, h.vrms_mv);
 
-  uint16_t amp = 0, period = 0, vrms = 0;
-  uint32_t freq = 0;
-  uint8_t npeaks = 0;
-  uint32_t f[5] = {0};
-  uint16_t m[5] = {0};
+  // Zoom spectra report peaks in mHz
+  meas.num_peaks = (h.num_peaks > OSC_FRAME_MAX_PEAKS) ? OSC_FRAME_MAX_PEAKS : h.num_peaks;
+  for (uint8_t i = 0; i < meas.num_peaks; i++) {
+    meas.peak_freqs[i] = (h.flags & OSC_FRAME_ZOOM) ? h.peak_freqs[i] / 1000.0f : h.peak_freqs[i];
+    meas.peak_mags[i] = h.peak_mags[i];
+  }
 
-  int parsed = sscanf(line.c_str(),
-                      "M:%hu,%lu,%hu,%hu,%hhu,%lu,%hu,%lu,%hu,%lu,%hu,%lu,%hu,%lu,%hu",
-                      &amp, &freq, &period, &vrms, &npeaks,
-                      &f[0], &m[0], &f[1], &m[1],
-                      &f[2], &m[2], &f[3], &m[3],
-                      &f[4], &m[4]);
+  meas.psd_segments = h.psd_segments;
+  meas.psd_overlap = h.psd_overlap;
+  meas.psd_tone_dbfs = h.psd_tone_cdbfs / 100.0f;
+  meas.psd_floor_dbfs = h.psd_floor_cdbfs / 100.0f;
+
+  meas.dist_harmonics = h.dist_harmonics;
+  meas.thd_db = h.thd_cdb / 100.0f;
+  meas.thdn_db = h.thdn_cdb / 100.0f;
+  meas.snr_db = h.snr_cdb / 100.0f;
+  meas.sfdr_db = h.sfdr_cdb / 100.0f;
+  meas.enob = h.enob_cbits / 100.0f;
+}
 
-  if (parsed < 5) return;
+void parse_acq_stats(String line) {
+  if (!line.startsWith("Q:")) return;
 
-  // Update smoothed scalar measurements
-  meas.update(amp, freq, period, vrms);
+  unsigned int fps = 0, dead = 0, continuous = 0;
+  unsigned long overruns = 0;
+  if (sscanf(line.c_str(), "Q:%u,%u,%lu,%u", &fps, &dead, &overruns, &continuous) < 3) return;
 
-  // Determine how many (freq,mag) pairs were parsed
-  uint8_t available_peaks = 0;
-  if (parsed >= 7) available_peaks = 1;
-  if (parsed >= 9) available_peaks = 2;
-  if (parsed >= 11) available_peaks = 3;
-  if (parsed >= 13) available_peaks = 4;
-  if (parsed >= 15) available_peaks = 5;
+  acqStats.fps = fps;
+  acqStats.dead_permille = dead;
+  acqStats.overruns = overruns;
+  acqStats.continuous = continuous != 0;
+  acqStats.lastUpdate = millis();
+}
 
-  if (npeaks > available_peaks) npeaks = available_peaks;
-  if (npeaks > 5) npeaks = 5;
-  meas.num_peaks = npeaks;
+void parse_memory_report(String line) {
+  if (!line.startsWith("H:")) return;
+
+  unsigned long v[10] = {0};
+  if (sscanf(line.c_str(), "H:%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+             &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8], &v[9]) < 9) return;
+
+  memStats.ram = v[0];
+  memStats.staticBytes = v[1];
+  memStats.acqMemory = v[2];
+  memStats.fftShared = v[3];
+  memStats.deepExtra = v[4];
+  memStats.recordMax = v[5];
+  memStats.heap = v[6];
+  memStats.stackPeak = v[7];
+  memStats.free = v[8];
+  memStats.pyramid = v[9];
+  memStats.lastUpdate = millis();
+}
 
-  // Copy into struct
-  for (uint8_t i = 0; i < meas.num_peaks; i++) {
-    meas.peak_freqs[i] = f[i];
-    meas.peak_mags[i] = m[i];
+// P:2 dump: probe lines are staged, P:END publishes them as one report
+void parse_profile_line(String line) {
+  static ProfileProbe staged[PROFILE_MAX_PROBES];
+  const char* s = line.c_str() + 2;
+
+  if (strncmp(s, "END,", 4) == 0) {
+    unsigned int enabled = 0, clockMhz = 0, histMin = 0;
+    unsigned long overhead = 0, calls = 0, windowMs = 0;
+    if (sscanf(s + 4, "%u,%lu,%lu,%lu,%u,%u", &enabled, &overhead, &calls,
+               &windowMs, &clockMhz, &histMin) < 6) return;
+
+    memcpy(profileStats.probes, staged, sizeof(staged));
+    profileStats.count = profileStats.pending;
+    profileStats.pending = 0;
+    profileStats.enabled = enabled != 0;
+    profileStats.overhead = overhead;
+    profileStats.calls = calls;
+    profileStats.windowMs = windowMs;
+    profileStats.clockMhz = clockMhz;
+    profileStats.histMinLog2 = histMin;
+    profileStats.lastUpdate = millis();
+    return;
   }
+
+  if (profileStats.pending >= PROFILE_MAX_PROBES) return;
+  ProfileProbe& p = staged[profileStats.pending];
+  memset(&p, 0, sizeof(p));
+
+  // name,count,avg,min,max,h0/h1/.../h15
+  const char* comma = strchr(s, ',');
+  if (!comma) return;
+  size_t n = min((size_t)(comma - s), sizeof(p.name) - 1);
+  memcpy(p.name, s, n);
+
+  unsigned long count, avg, mn, mx;
+  int used = 0;
+  if (sscanf(comma + 1, "%lu,%lu,%lu,%lu,%n", &count, &avg, &mn, &mx, &used) < 4 || !used) return;
+  p.count = count;
+  p.avg = avg;
+  p.min = mn;
+  p.max = mx;
+
+  const char* h = comma + 1 + used;
+  for (uint8_t b = 0; b < PROFILE_HIST_BUCKETS && *h; b++) {
+    p.hist[b] = strtoul(h, (char**)&h, 10);
+    if (*h == '/') h++;
+  }
+  profileStats.pending++;
 }
 
 void init_uart() {
   SerialSTM.begin(UART_BAUD, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
   Serial.println("✓ UART initialized");
 }
-
-void handle_uart_data(void* ws_handle) {
-  static String uartBuffer = "";
-  
-  while(SerialSTM.available()) {
-    char c = SerialSTM.read();
-    if(c == '\n') {
-      uartBuffer.trim();
-      if(uartBuffer.length() > 0) {
-        parse_measurements(uartBuffer);
-        
-        // Send to WebSocket if available
-        if(ws_handle && meas.valid) {
-          String json = build_measurement_json(meas);
-          // Note: Actual WebSocket send would need to be in web_interface.cpp
-          // This is a simplification
-        }
-      }
-      uartBuffer = "";
-    } else if(c != '\r') {
-      uartBuffer += c;
-      if(uartBuffer.length() > 200) {
-        uartBuffer = "";
-      }
-    }
-  }
-}
\ No newline at end of file
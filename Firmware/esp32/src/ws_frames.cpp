@@ -0,0 +1,324 @@
+#include "ws_frames.h"
+
+extern MeasData meas;
+extern FftBand fftBand;
+extern SignalStats sigStats;
+extern void apply_frame_measurements(const OscFrameHeader& h);
+extern String build_measurement_json(MeasData& d);
+
+// ==================== FRAME RESOLUTION ====================
+const uint16_t RESOLUTIONS[NUM_RESOLUTIONS] = {256, 1024, 4096, 0};
+
+uint8_t resolutionClass(uint16_t samples) {
+    for (uint8_t i = 0; i < NUM_RESOLUTIONS - 1; i++) {
+        if (samples && samples <= RESOLUTIONS[i]) return i;
+    }
+    return NUM_RESOLUTIONS - 1;
+}
+
+void decimateFrame(const uint16_t* src, uint32_t n, uint16_t* dst, uint32_t m, uint8_t flags) {
+    bool spectrum = flags & OSC_FRAME_SPECTRUM;
+
+    if (flags & OSC_FRAME_ENVELOPE) {
+        n /= 2;
+        m /= 2;
+        for (uint32_t i = 0; i < m; i++) {
+            uint32_t start = (i * n) / m, end = ((i + 1) * n) / m;
+            uint16_t lo = 0xFFFF, hi = 0;
+            for (uint32_t j = start; j < end; j++) {
+                lo = min(lo, src[2 * j]);
+                hi = max(hi, src[2 * j + 1]);
+            }
+            dst[2 * i] = lo;
+            dst[2 * i + 1] = hi;
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < m; i++) {
+        uint32_t start = (i * n) / m, end = ((i + 1) * n) / m;
+        if (spectrum) {
+            uint16_t peak = 0;
+            for (uint32_t j = start; j < end; j++) peak = max(peak, src[j]);
+            dst[i] = peak;
+        } else {
+            dst[i] = src[(start + end) / 2];
+        }
+    }
+}
+
+// ==================== BINARY PAYLOADS ====================
+void putFrameHeader(uint8_t* buf, uint8_t flags, uint8_t codec, uint8_t speed) {
+    buf[0] = (flags & OSC_FRAME_SPECTRUM) ? MODE_FREQ_DOMAIN : MODE_TIME_DOMAIN;
+    if (flags & OSC_FRAME_ENVELOPE) buf[0] |= WS_FRAME_ENVELOPE;
+    buf[1] = sharedState.running ? 1 : 0;
+    buf[2] = speed;
+    buf[3] = codec;
+}
+
+// Raw payload: samples (decimated when n < count) straight into the buffer
+static bool buildRaw(const uint16_t* samples, size_t count, size_t n, uint8_t flags, uint8_t speed,
+                     WsPayload& out, WsAcquire acquire, void* ctx, FanoutStats& stats) {
+    if (!acquire(4 + n * 2, out, ctx)) return false;
+    putFrameHeader(out.data, flags, OSC_CODEC_RAW, speed);
+    if (n < count) {
+        decimateFrame(samples, count, (uint16_t*)(out.data + 4), n, flags);
+    } else {
+        memcpy(out.data + 4, samples, n * 2);
+    }
+    stats.copyBytes += out.len;
+    return true;
+}
+
+// OSC_CODEC_DELTA payload, or false when it wouldn't beat raw
+static bool buildDelta(const uint16_t* src, size_t n, uint8_t flags, uint8_t speed, uint8_t* scratch,
+                       WsPayload& out, WsAcquire acquire, void* ctx, FanoutStats& stats) {
+    size_t len = 4 + osc_codec_encode(src, n, scratch + 4);
+    size_t rawLen = 4 + n * 2;
+    if (len >= rawLen) return false;
+
+    size_t padded = min(rawLen, (len + WS_CODEC_PAD - 1) / WS_CODEC_PAD * WS_CODEC_PAD);
+    if (!acquire(padded, out, ctx)) return false;
+
+    putFrameHeader(scratch, flags, OSC_CODEC_DELTA, speed);
+    memcpy(out.data, scratch, len);
+    memset(out.data + len, 0, padded - len);
+    stats.copyBytes += padded;
+    stats.codecRawBytes += rawLen;
+    stats.codecBytes += padded;
+    return true;
+}
+
+void buildFrameVariants(const uint16_t* samples, size_t count, uint8_t flags, uint8_t speed,
+                        const bool wanted[NUM_RESOLUTIONS][OSC_CODEC_COUNT],
+                        WsPayload built[NUM_RESOLUTIONS][OSC_CODEC_COUNT],
+                        const WsScratch& scratch, WsAcquire acquire, void* ctx, FanoutStats& stats) {
+    for (uint8_t cls = 0; cls < NUM_RESOLUTIONS; cls++) {
+        WsPayload& raw = built[cls][OSC_CODEC_RAW];
+        WsPayload& delta = built[cls][OSC_CODEC_DELTA];
+        raw = delta = WsPayload{nullptr, 0, nullptr};
+        if (!wanted[cls][OSC_CODEC_RAW] && !wanted[cls][OSC_CODEC_DELTA]) continue;
+
+        size_t target = RESOLUTIONS[cls];
+        size_t n = (target && count > target) ? target : count;
+        const uint16_t* src = samples;
+
+        // The delta payload is coded from the raw one's samples when there is one
+        if (wanted[cls][OSC_CODEC_RAW] && buildRaw(samples, count, n, flags, speed, raw, acquire, ctx, stats)) {
+            src = (const uint16_t*)(raw.data + 4);
+        }
+        if (!wanted[cls][OSC_CODEC_DELTA]) continue;
+
+        if (src == samples && n < count) {
+            if (scratch.samples) decimateFrame(samples, count, scratch.samples, n, flags);
+            src = scratch.samples;
+        }
+        if (src && scratch.codec && buildDelta(src, n, flags, speed, scratch.codec, delta, acquire, ctx, stats)) {
+            continue;
+        }
+        if (!raw.data) buildRaw(samples, count, n, flags, speed, raw, acquire, ctx, stats);
+        delta = raw;
+    }
+}
+
+size_t buildWindowMessage(uint8_t* buf, const OscFrameHeader& hdr, const uint16_t* samples, uint8_t speed) {
+    putFrameHeader(buf, hdr.flags, OSC_CODEC_RAW, speed);
+    buf[0] |= WS_FRAME_WINDOW;
+    osc_put32(buf + 4, hdr.rec_start);
+    osc_put32(buf + 8, hdr.rec_span);
+    osc_put32(buf + 12, hdr.rec_total);
+    osc_put16(buf + 16, hdr.rec_id);
+    buf[18] = hdr.rec_segments;
+    buf[19] = hdr.rec_filled;
+    memcpy(buf + WS_WINDOW_HEADER, samples, hdr.sample_count * 2);
+    return WS_WINDOW_HEADER + hdr.sample_count * 2;
+}
+
+// ==================== RECORD WINDOWS ====================
+uint8_t WindowRoutes::tagFor(uint32_t clientId) {
+    int free = -1, oldest = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        if (clients[i] == clientId) return tags[i];
+        if (!clients[i] && free < 0) free = i;
+        if (issued[i] < issued[oldest]) oldest = i;
+    }
+    int slot = (free >= 0) ? free : oldest;
+    clients[slot] = 0;
+
+    // Skip tags still held after the count wraps
+    uint8_t tag;
+    do {
+        tag = count++ % 255 + 1;
+    } while (clientFor(tag));
+    clients[slot] = clientId;
+    tags[slot] = tag;
+    issued[slot] = count;
+    return tag;
+}
+
+uint32_t WindowRoutes::clientFor(uint8_t tag) const {
+    if (!tag) return 0;
+    for (int i = 0; i < SLOTS; i++) {
+        if (clients[i] && tags[i] == tag) return clients[i];
+    }
+    return 0;
+}
+
+void WindowRoutes::drop(uint32_t clientId) {
+    for (int i = 0; i < SLOTS; i++) {
+        if (clients[i] == clientId) clients[i] = 0;
+    }
+}
+
+void taggedWindowCommand(const char* cmd, uint8_t tag, char* out, size_t len) {
+    const char* args = cmd + 2;
+    size_t n = 0;
+    int commas = 0;
+    for (; args[n]; n++) {
+        if (args[n] == ',' && ++commas == 4) break;
+    }
+    int missing = (commas < 3) ? 3 - commas : 0;
+    snprintf(out, len, "I:%.*s%.*s,%u", (int)n, args, missing, ",,,", tag);
+}
+
+// ==================== JSON ====================
+String buildStateJson(const SharedState& s, RecorderState rec) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "{\"type\":\"state\",\"displayMode\":%d,\"frequency\":%lu,\"timebase\":%lu,\"duty\":%u,\"running\":%s,"
+        "\"trigMode\":%u,\"trigLevel\":%u,\"trigEdge\":%u,\"recording\":%s,\"replay\":%s}",
+        s.displayMode,
+        (unsigned long)s.frequency,
+        (unsigned long)s.timebase,
+        s.dutyCycle,
+        s.running ? "true" : "false",
+        s.trigMode,
+        s.trigLevel,
+        s.trigEdge,
+        rec == REC_RECORDING ? "true" : "false",
+        rec == REC_REPLAYING ? "true" : "false"
+    );
+    return String(buffer);
+}
+
+String buildInitJson(uint32_t clientId) {
+    char buffer[384];
+    snprintf(buffer, sizeof(buffer),
+        "{\"type\":\"init\",\"version\":\"2.6\",\"clientId\":%lu,\"codecs\":[\"raw\",\"delta\"],"
+        "\"fftParams\":%s}",
+        (unsigned long)clientId, fftBand.json().c_str()
+    );
+    return String(buffer);
+}
+
+String buildFftJson() {
+    return "{\"type\":\"fft\",\"fftParams\":" + fftBand.json() + "}";
+}
+
+String noteFrameMeasurements(const OscFrameHeader& hdr, uint32_t now, bool send, bool always) {
+    static uint32_t lastMeasUpdate = 0;
+    static uint32_t lastMeasSend = 0;
+
+    if (!(hdr.flags & OSC_FRAME_MEAS)) return String();
+    if (!always && (now - lastMeasUpdate) < MEAS_UPDATE_INTERVAL) return String();
+    lastMeasUpdate = now;
+    apply_frame_measurements(hdr);
+
+    if (meas.valid && meas.frequency_hz > 0) {
+        sigStats.updateStability(meas.frequency_hz);
+    }
+
+    if (!send || !meas.valid) return String();
+    if (!always && (now - lastMeasSend) < MEAS_INTERVAL) return String();
+    lastMeasSend = now;
+    return build_measurement_json(meas);
+}
+
+// ==================== COMMANDS ====================
+bool applyStateCommand(const char* cmd, SharedState& s) {
+    const char* arg = (cmd[1] == ':') ? cmd + 2 : cmd + 1;
+
+    if (cmd[0] == 'X') {
+        int mode = atoi(arg);
+        if (mode == 0 && s.displayMode != MODE_TIME_DOMAIN) {
+            s.displayMode = MODE_TIME_DOMAIN;
+            return true;
+        }
+        if (mode == 1 && s.displayMode != MODE_FREQ_DOMAIN) {
+            s.displayMode = MODE_FREQ_DOMAIN;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'F') {
+        uint32_t val = atoi(arg);
+        if (val > 0 && val != s.frequency) {
+            s.frequency = val;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'T') {
+        uint32_t val = atoi(arg);
+        if (val > 0 && val != s.timebase) {
+            s.timebase = val;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'D' && !isalpha((unsigned char)cmd[1])) {  // DB:/DH:/DP: go to the STM32 only
+        uint8_t val = atoi(arg);
+        if (val > 0 && val <= 100 && val != s.dutyCycle) {
+            s.dutyCycle = val;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'M' || cmd[0] == 'E') {
+        return true;
+    }
+    else if (cmd[0] == 'G') {
+        uint8_t val = atoi(arg);
+        // Single mode re-arms on every G:3, so always resync
+        if (val <= 3) {
+            s.trigMode = val;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'L') {
+        uint16_t val = atoi(arg);
+        if (val <= 3300 && val != s.trigLevel) {
+            s.trigLevel = val;
+            return true;
+        }
+    }
+    else if (cmd[0] == 'J') {
+        uint8_t val = atoi(arg) ? 1 : 0;
+        if (val != s.trigEdge) {
+            s.trigEdge = val;
+            return true;
+        }
+    }
+    else if (strncmp(cmd, "RUN", 3) == 0 && !s.running) {
+        s.running = true;
+        return true;
+    }
+    else if (strncmp(cmd, "STOP", 4) == 0 && s.running) {
+        s.running = false;
+        return true;
+    }
+    else if (strncmp(cmd, "RESET", 5) == 0) {
+        return true;
+    }
+    return false;
+}
+
+void stmCommandForm(const char* cmd, char* out, size_t len) {
+    if ((cmd[0] == 'X' || cmd[0] == 'F' || cmd[0] == 'T' ||
+         cmd[0] == 'D' || cmd[0] == 'M' || cmd[0] == 'E' ||
+         cmd[0] == 'A' || cmd[0] == 'G' || cmd[0] == 'L' || cmd[0] == 'J' ||
+         cmd[0] == 'Y' || cmd[0] == 'O' || cmd[0] == 'W' || cmd[0] == 'B' ||
+         cmd[0] == 'N' || cmd[0] == 'P') && cmd[1] != ':' &&
+        !(cmd[0] == 'D' && isalpha((unsigned char)cmd[1]))) {
+        snprintf(out, len, "%c:%s", cmd[0], cmd + 1);
+    } else {
+        strncpy(out, cmd, len - 1);
+        out[len - 1] = '\0';
+    }
+}
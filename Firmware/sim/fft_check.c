@@ -0,0 +1,198 @@
+/*
+ * Fixed-point FFT engines against the float one. Built once per
+ * FFT_ENGINE from the same osc_signal.c; the F32 build records its
+ * spectra and measurements, the Q15 and Q31 builds rerun the signals and
+ * compare:
+ *
+ *   fft_check --write REF     F32: record the reference
+ *   fft_check REF             Q15/Q31: compare, exit status 1 on a miss
+ *
+ * Signals: a full-scale tone, a -40 dBFS tone, a square wave (THD) and a
+ * two-tone pair 20 dB apart, each as one rfft spectrum and one Welch PSD
+ * (3 segments, 50% overlap), all in dB spectra.
+ */
+#include "osc_signal.h"
+#include "osc_pyramid.h"
+#include "osc_frame.h"
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SAMPLE_RATE     500000
+#define CASES           4
+#define BINS            (FFT_SIZE / 2)
+#define BIN_HZ          ((double)SAMPLE_RATE / FFT_SIZE)
+
+// Engines compare against f32 over their dynamic range: spectrum bins,
+// peaks and the weaker side of every distortion ratio at most range_db
+// below full scale. Q15 drops 11 bits in the transform, its rounding
+// floor sits near -78 dBFS per bin; Q31 is exact to the dB code there.
+#if FFT_ENGINE == FFT_ENGINE_Q15
+static const char *engine = "q15";
+static const double range_db = 45, tol_hz = 2.0, tol_db = 1.0;
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+static const char *engine = "q31";
+static const double range_db = 100, tol_hz = 0.5, tol_db = 0.05;
+#else
+static const char *engine = "f32";
+#endif
+
+static SimDwt dwt;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+SimDwt *sim_dwt(void) {
+    dwt.CYCCNT = (uint32_t)(now_us() * 100.0);
+    return &dwt;
+}
+
+void Error_Handler(void) { abort(); }
+
+/* ==================== SIGNALS ==================== */
+static void fill(uint16_t *buf, uint32_t n, int c) {
+    srand(11 + c);
+    for(uint32_t i = 0; i < n; i++) {
+        double t = (double)i / SAMPLE_RATE, v;
+        switch(c) {
+            case 0:  v = 2000 * sin(2 * M_PI * 1000 * t); break;
+            case 1:  v = 20 * sin(2 * M_PI * 12345 * t); break;
+            case 2:  v = (fmod(t * 1000, 1.0) < 0.5) ? 1500 : -1500; break;
+            default: v = 1500 * sin(2 * M_PI * 5000 * t) + 150 * sin(2 * M_PI * 7300 * t); break;
+        }
+        int code = 2048 + (int)lrint(v) + rand() % 5 - 2;
+        buf[i] = (code < 0) ? 0 : (code > 4095) ? 4095 : code;
+    }
+}
+
+/* ==================== RESULTS ==================== */
+typedef struct {
+    uint32_t peak_freq[5];
+    uint16_t peak_mag[5];
+    uint8_t num_peaks;
+    int16_t thd_cdb, thdn_cdb, snr_cdb, sfdr_cdb, psd_tone_cdbfs, psd_floor_cdbfs;
+    uint16_t spectrum[BINS];
+} CaseResult;
+
+static double run(CaseResult *r, double *fft_us) {
+    static uint16_t samples[WELCH_RECORD];
+    *fft_us = 0;
+    for(int c = 0; c < CASES; c++) {
+        Measurements m = {0};
+        fill(samples, WELCH_RECORD, c);
+
+        fft_frame_count = 0;
+        double t0 = now_us();
+        measure_freq_domain(samples, SAMPLE_RATE, r[c].spectrum, BINS, &m);
+        *fft_us += now_us() - t0;
+        r[c].num_peaks = m.num_peaks;
+        for(int k = 0; k < 5; k++) {
+            r[c].peak_freq[k] = m.peak_freqs[k];
+            r[c].peak_mag[k] = m.peak_mags[k];
+        }
+        r[c].thd_cdb = m.thd_cdb;
+        r[c].thdn_cdb = m.thdn_cdb;
+        r[c].snr_cdb = m.snr_cdb;
+        r[c].sfdr_cdb = m.sfdr_cdb;
+
+        static uint16_t psd[BINS];
+        fft_frame_count = 0;
+        measure_welch_domain(samples, WELCH_RECORD, SAMPLE_RATE, 3, 50, psd, BINS, &m);
+        r[c].psd_tone_cdbfs = m.psd_tone_cdbfs;
+        r[c].psd_floor_cdbfs = m.psd_floor_cdbfs;
+    }
+    return *fft_us / CASES;
+}
+
+static int save(const char *path, const CaseResult *r) {
+    FILE *f = fopen(path, "wb");
+    if(!f) return 0;
+    size_t ok = fwrite(r, sizeof(CaseResult), CASES, f);
+    fclose(f);
+    return ok == CASES;
+}
+
+static int load(const char *path, CaseResult *r) {
+    FILE *f = fopen(path, "rb");
+    if(!f) return 0;
+    size_t ok = fread(r, sizeof(CaseResult), CASES, f);
+    fclose(f);
+    return ok == CASES;
+}
+
+int main(int argc, char **argv) {
+    static CaseResult ref[CASES], out[CASES];
+    double fft_us;
+
+    init_fft(WIN_HANN);
+    fft_set_scale(1, 0, -140);
+    fft_set_distortion(9);
+    fft_set_peaks(5, PEAK_JACOBSEN, 0, 50, 15);
+
+    double us = run(out, &fft_us);
+    // RAM that follows the engine: acq_memory, its zoom index, the window table
+    uint32_t ram = sizeof(acq_memory) + PYR_BYTES + sizeof(fft_sample_t) * FFT_SIZE / 2;
+    printf("fft   %s  %.2f us/frame on the host (%.0f frames/s), FFT buffers %u B, RAM %u B",
+           engine, us, 1e6 / us, (uint32_t)FFT_WORK_BYTES, ram);
+
+    if(argc == 3 && !strcmp(argv[1], "--write")) {
+        int ok = save(argv[2], out);
+        printf("  reference %s\n", ok ? "written" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if(argc != 2 || !load(argv[1], ref)) {
+        printf("  no f32 reference FAIL\n");
+        return 1;
+    }
+
+#if FFT_ENGINE != FFT_ENGINE_F32
+    // dBFS of a spectrum code (fft_set_scale(1, 0, -140))
+    #define CODE_DBFS(c)    ((c) * OSC_FRAME_DB_PER_LSB - 140.0)
+    double peak_hz = 0, spectrum_db = 0, dist_db = 0;
+    uint32_t missed = 0;
+    for(int c = 0; c < CASES; c++) {
+        const CaseResult *a = &ref[c], *b = &out[c];
+
+        // Every f32 peak found at the same rank; extra peaks only from
+        // below the range (the fixed-point rounding floor)
+        for(int k = 0; k < b->num_peaks; k++) {
+            if(k >= a->num_peaks) {
+                if(CODE_DBFS(b->peak_mag[k]) > -range_db) missed++;
+                continue;
+            }
+            peak_hz = fmax(peak_hz, fabs((double)a->peak_freq[k] - b->peak_freq[k]));
+            spectrum_db = fmax(spectrum_db, fabs((double)a->peak_mag[k] - b->peak_mag[k]) * OSC_FRAME_DB_PER_LSB);
+        }
+        if(b->num_peaks < a->num_peaks) missed++;
+
+        // Bin 0 holds what is left of the removed DC, rounding alone
+        for(int i = 1; i < BINS; i++) {
+            if(CODE_DBFS(a->spectrum[i]) < -range_db) continue;
+            spectrum_db = fmax(spectrum_db, fabs((double)a->spectrum[i] - b->spectrum[i]) * OSC_FRAME_DB_PER_LSB);
+        }
+
+        // Ratios to the fundamental, and the Welch levels, where their
+        // weaker side lies inside the range
+        double tone = a->psd_tone_cdbfs / 100.0;
+        int16_t da[] = {a->thd_cdb, a->thdn_cdb, -a->snr_cdb, -a->sfdr_cdb, a->psd_tone_cdbfs, a->psd_floor_cdbfs};
+        int16_t db[] = {b->thd_cdb, b->thdn_cdb, -b->snr_cdb, -b->sfdr_cdb, b->psd_tone_cdbfs, b->psd_floor_cdbfs};
+        double weak[] = {tone + da[0] / 100.0, tone + da[1] / 100.0, tone + da[2] / 100.0,
+                         tone + da[3] / 100.0, tone, da[5] / 100.0 + 10 * log10(BIN_HZ)};
+        for(int k = 0; k < 6; k++)
+            if(weak[k] > -range_db) dist_db = fmax(dist_db, fabs((double)da[k] - db[k]) / 100.0);
+    }
+    int ok = !missed && peak_hz <= tol_hz && spectrum_db <= tol_db && dist_db <= tol_db;
+    printf("\n      vs f32 down to -%.0f dBFS: peaks %.1f Hz, %u missed, spectrum %.2f dB, distortion/PSD %.2f dB  %s\n",
+           range_db, peak_hz, missed, spectrum_db, dist_db, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+#else
+    printf("  reference only\n");
+    return 0;
+#endif
+}
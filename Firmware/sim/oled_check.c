@@ -0,0 +1,137 @@
+/*
+ * OLED rasterizers (osc_display.c) against the drawing they replaced:
+ * the trace as Bresenham segments between neighbouring columns and the
+ * spectrum bars as vertical lines, both through ssd1306_draw_line and
+ * ssd1306_draw_pixel. The whole framebuffer must come out bit for bit.
+ *
+ *   oled_check        one line per trace kind, exit status 1 on a mismatch
+ *
+ * Frames are noise, sines, squares of every width and sparse spikes, at
+ * full width and at random short lengths, so clipped runs, single-pixel
+ * steps and page-crossing runs all occur.
+ */
+#include "ssd1306.h"
+#include "osc_display.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define WAVE_TOP    16
+#define WAVE_BOTTOM 63
+#define WAVE_CENTER 40
+#define FRAMES      40000
+
+// The panel itself is never driven here
+I2C_HandleTypeDef hi2c1;
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *h, uint16_t addr, uint16_t reg, uint16_t reg_size,
+                                    uint8_t *data, uint16_t len, uint32_t timeout) { return HAL_OK; }
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *h, uint16_t addr, uint16_t reg, uint16_t reg_size,
+                                        uint8_t *data, uint16_t len) { return HAL_OK; }
+void HAL_Delay(uint32_t ms) {}
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* ==================== REFERENCE (per-pixel) ==================== */
+static int32_t ref_wave_y(uint16_t sample) {
+    int32_t y = WAVE_CENTER - ((sample - 2048) * 4 / 85);
+    if(y < WAVE_TOP) y = WAVE_TOP;
+    if(y > WAVE_BOTTOM) y = WAVE_BOTTOM;
+    return y;
+}
+
+static void ref_draw_waveform(uint16_t *buffer, uint16_t size) {
+    if(size > 128) size = 128;
+    int32_t prev_y = ref_wave_y(buffer[0]);
+    for(uint16_t x = 1; x < size; x++) {
+        int32_t y = ref_wave_y(buffer[x]);
+        ssd1306_draw_line(x - 1, prev_y, x, y);
+        prev_y = y;
+    }
+}
+
+static void ref_draw_spectrum(uint16_t *buffer, uint16_t size) {
+    if(size > 128) size = 128;
+    const uint8_t height = WAVE_BOTTOM - WAVE_TOP;
+
+    uint16_t max_val = 1;
+    for(uint16_t i = 0; i < size; i++)
+        if(buffer[i] > max_val) max_val = buffer[i];
+
+    for(uint16_t x = 0; x < size; x++) {
+        uint32_t bar = ((uint32_t)buffer[x] * height) / max_val;
+        if(bar > height) bar = height;
+        if(bar < 1 && buffer[x] > 0) bar = 1;
+        if(bar > 0) ssd1306_draw_line(x, WAVE_BOTTOM, x, WAVE_BOTTOM - bar);
+    }
+}
+
+/* ==================== FRAMES ==================== */
+// Noise, a sine, a square of random width and sparse spikes, all 12-bit
+static void fill(uint16_t *buf, int kind, int it) {
+    int width = 1 + it % 20;
+    for(int i = 0; i < 128; i++) {
+        if(kind == 0)      buf[i] = rand() % 4096;
+        else if(kind == 1) buf[i] = 2048 + (int)(1500 * sin(i * 0.2 + it));
+        else if(kind == 2) buf[i] = (i / width) % 2 ? 3500 : 600;
+        else               buf[i] = (rand() % 64 < 3) ? rand() % 4096 : rand() % 50;
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*draw)(uint16_t *, uint16_t);
+    void (*ref)(uint16_t *, uint16_t);
+} Rasterizer;
+
+static int check(const Rasterizer *r) {
+    static uint8_t want[SSD1306_PAGES * SSD1306_WIDTH], got[SSD1306_PAGES * SSD1306_WIDTH];
+    uint16_t buf[128];
+    double ref_ns = 0, new_ns = 0;
+    int fails = 0;
+    srand(14);
+
+    for(int it = 0; it < FRAMES; it++) {
+        uint16_t n = (it % 50 == 0) ? rand() % 130 : 128;
+        fill(buf, it % 4, it);
+
+        ssd1306_clear();
+        double t0 = now_ns();
+        r->ref(buf, n);
+        double t1 = now_ns();
+        ssd1306_save_pages(want, 0, SSD1306_PAGES);
+
+        ssd1306_clear();
+        double t2 = now_ns();
+        r->draw(buf, n);
+        double t3 = now_ns();
+        ssd1306_save_pages(got, 0, SSD1306_PAGES);
+
+        ref_ns += t1 - t0;
+        new_ns += t3 - t2;
+        if(memcmp(want, got, sizeof(want))) {
+            if(!fails) printf("  %s mismatch: frame %d, %u columns, kind %d\n", r->name, it, n, it % 4);
+            fails++;
+        }
+    }
+
+    printf("oled  %-8s %u frames  per-pixel %6.0f ns  page runs %6.0f ns  %4.1fx  %s\n",
+           r->name, FRAMES, ref_ns / FRAMES, new_ns / FRAMES, ref_ns / new_ns, fails ? "FAIL" : "ok");
+    return fails;
+}
+
+int main(void) {
+    static const Rasterizer rasterizers[] = {
+        {"trace", draw_waveform, ref_draw_waveform},
+        {"spectrum", draw_spectrum, ref_draw_spectrum},
+    };
+    int fails = 0;
+    for(unsigned i = 0; i < sizeof(rasterizers) / sizeof(rasterizers[0]); i++)
+        fails += check(&rasterizers[i]);
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/*
+ * Host stand-in for the Arduino core: just enough of String, Serial and
+ * millis() for structures.cpp and uart_parser.cpp.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+// FreeRTOS types referenced by config.h / structures.h
+typedef void* TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+// ==================== STRING ====================
+class String {
+public:
+    String(const char* s = "") : s_(s ? s : "") {}
+    String(const std::string& s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    String(unsigned char v) : s_(std::to_string(v)) {}
+    String(int v) : s_(std::to_string(v)) {}
+    String(unsigned int v) : s_(std::to_string(v)) {}
+    String(long v) : s_(std::to_string(v)) {}
+    String(unsigned long v) : s_(std::to_string(v)) {}
+    String(float v, unsigned char decimals = 2) { format(v, decimals); }
+    String(double v, unsigned char decimals = 2) { format(v, decimals); }
+
+    const char* c_str() const { return s_.c_str(); }
+    unsigned int length() const { return s_.length(); }
+    bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+    int indexOf(char c) const { size_t i = s_.find(c); return i == std::string::npos ? -1 : (int)i; }
+    String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+    long toInt() const { return atol(s_.c_str()); }
+
+    void trim() {
+        size_t b = s_.find_first_not_of(" \t\r\n");
+        size_t e = s_.find_last_not_of(" \t\r\n");
+        s_ = (b == std::string::npos) ? "" : s_.substr(b, e - b + 1);
+    }
+
+    String& operator+=(const String& o) { s_ += o.s_; return *this; }
+    String& operator+=(const char* o) { s_ += o; return *this; }
+    String& operator+=(char c) { s_ += c; return *this; }
+    bool operator==(const char* o) const { return s_ == o; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s_); }
+    friend String operator+(const String& a, const char* b) { return String(a.s_ + b); }
+
+private:
+    void format(double v, unsigned char decimals) {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        s_ = buf;
+    }
+    std::string s_;
+};
+
+// ==================== SERIAL ====================
+#define SERIAL_8N1 0
+
+class HardwareSerial {
+public:
+    explicit HardwareSerial(int port) : port_(port) {}
+    void begin(unsigned long baud, int config = SERIAL_8N1, int rx = -1, int tx = -1) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    size_t print(const char* s) {
+        if(port_ != 0) return 0;
+        fputs(s, stdout);
+        return strlen(s);
+    }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t println(const char* s = "") { size_t n = print(s); print("\n"); return n + 1; }
+    size_t println(const String& s) { return println(s.c_str()); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if(port_ != 0) return 0;
+        va_list args;
+        va_start(args, fmt);
+        int n = vprintf(fmt, args);
+        va_end(args);
+        return n > 0 ? n : 0;
+    }
+
+private:
+    int port_;  // 0 = console; other ports discard output
+};
+
+extern HardwareSerial Serial;
+
+// ==================== TIME ====================
+uint32_t millis();
+uint32_t micros();
+
+#endif /* ARDUINO_H */
@@ -0,0 +1,139 @@
+#ifndef ARM_MATH_H
+#define ARM_MATH_H
+
+/*
+ * Host subset of CMSIS-DSP used by osc_signal.c. Reference (not
+ * optimised) implementations with the same output layout as the
+ * library. The q15/q31 transforms run in integer arithmetic with the
+ * library's per-stage scaling and twiddle precision, so the fixed-point
+ * engines see comparable rounding. The M4 DSP intrinsics are emulated for
+ * the kernel check build.
+ */
+#include <stdint.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef float float32_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define PI 3.14159265358979f
+
+typedef enum {
+    ARM_MATH_SUCCESS = 0,
+    ARM_MATH_ARGUMENT_ERROR = -1
+} arm_status;
+
+typedef struct {
+    uint16_t fftLen;
+} arm_cfft_instance_f32;
+
+typedef struct {
+    arm_cfft_instance_f32 Sint;     // The N/2-point complex FFT inside
+    uint16_t fftLenRFFT;
+} arm_rfft_fast_instance_f32;
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen);
+
+// Packed output: p[0] = DC, p[1] = Nyquist, then re/im for bins 1..N/2-1
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *p,
+                       float32_t *pOut, uint8_t ifftFlag);
+
+// In place, interleaved re/im, natural order out (bitReverseFlag assumed set)
+void arm_cfft_f32(const arm_cfft_instance_f32 *S, float32_t *p1,
+                  uint8_t ifftFlag, uint8_t bitReverseFlag);
+
+/* ==================== FIXED-POINT FFT ==================== */
+typedef struct {
+    uint16_t fftLen;
+} arm_cfft_instance_q15;
+
+typedef struct {
+    uint16_t fftLen;
+} arm_cfft_instance_q31;
+
+typedef struct {
+    uint32_t fftLenReal;
+    const arm_cfft_instance_q15 *pCfft;
+} arm_rfft_instance_q15;
+
+typedef struct {
+    uint32_t fftLenReal;
+    const arm_cfft_instance_q31 *pCfft;
+} arm_rfft_instance_q31;
+
+// Forward only; pDst gets all fftLenReal bins (both halves) as re/im
+// pairs, scaled by 2 / fftLenReal (12.4 / 12.20 at 4096 points)
+arm_status arm_rfft_init_q15(arm_rfft_instance_q15 *S, uint32_t fftLenReal,
+                             uint32_t ifftFlagR, uint32_t bitReverseFlag);
+arm_status arm_rfft_init_q31(arm_rfft_instance_q31 *S, uint32_t fftLenReal,
+                             uint32_t ifftFlagR, uint32_t bitReverseFlag);
+void arm_rfft_q15(const arm_rfft_instance_q15 *S, q15_t *pSrc, q15_t *pDst);
+void arm_rfft_q31(const arm_rfft_instance_q31 *S, q31_t *pSrc, q31_t *pDst);
+
+// In place, natural order out, scaled by 1 / fftLen
+void arm_cfft_q15(const arm_cfft_instance_q15 *S, q15_t *p1, uint8_t ifftFlag, uint8_t bitReverseFlag);
+void arm_cfft_q31(const arm_cfft_instance_q31 *S, q31_t *p1, uint8_t ifftFlag, uint8_t bitReverseFlag);
+
+// Magnitudes come out halved (2.14 / 2.30)
+void arm_cmplx_mag_q15(const q15_t *pSrc, q15_t *pDst, uint32_t numSamples);
+void arm_cmplx_mag_q31(const q31_t *pSrc, q31_t *pDst, uint32_t numSamples);
+
+// Truncating, saturated
+void arm_float_to_q15(const float32_t *pSrc, q15_t *pDst, uint32_t blockSize);
+void arm_float_to_q31(const float32_t *pSrc, q31_t *pDst, uint32_t blockSize);
+
+void arm_cmplx_mag_f32(const float32_t *pSrc, float32_t *pDst, uint32_t numSamples);
+void arm_cmplx_mag_squared_f32(const float32_t *pSrc, float32_t *pDst, uint32_t numSamples);
+void arm_add_f32(const float32_t *pSrcA, const float32_t *pSrcB, float32_t *pDst, uint32_t blockSize);
+
+static inline arm_status arm_sqrt_f32(float32_t in, float32_t *pOut) {
+    if(in < 0.0f) { *pOut = 0.0f; return ARM_MATH_ARGUMENT_ERROR; }
+    *pOut = sqrtf(in);
+    return ARM_MATH_SUCCESS;
+}
+
+static inline float32_t arm_cos_f32(float32_t x) { return cosf(x); }
+static inline float32_t arm_sin_f32(float32_t x) { return sinf(x); }
+
+/* ==================== DSP INTRINSICS ==================== */
+// Cortex-M4 packed 16-bit instructions for the kernel check build
+// (simd_check.c defines __ARM_FEATURE_SIMD32 on the host). The GE flags
+// the subtracts and adds set live in sim_ge, which __SEL reads per lane
+#if defined(__ARM_FEATURE_SIMD32) && !defined(__arm__)
+static uint32_t sim_ge;
+
+static inline uint32_t __USUB16(uint32_t a, uint32_t b) {
+    sim_ge = (((a & 0xFFFF) >= (b & 0xFFFF)) ? 0x3u : 0) | (((a >> 16) >= (b >> 16)) ? 0xCu : 0);
+    return (((a & 0xFFFF) - (b & 0xFFFF)) & 0xFFFF) | (((a >> 16) - (b >> 16)) << 16);
+}
+
+static inline uint32_t __UADD16(uint32_t a, uint32_t b) {
+    uint32_t lo = (a & 0xFFFF) + (b & 0xFFFF), hi = (a >> 16) + (b >> 16);
+    sim_ge = ((lo > 0xFFFF) ? 0x3u : 0) | ((hi > 0xFFFF) ? 0xCu : 0);
+    return (lo & 0xFFFF) | (hi << 16);
+}
+
+static inline uint32_t __SEL(uint32_t a, uint32_t b) {
+    uint32_t r = 0;
+    for(int byte = 0; byte < 4; byte++) {
+        uint32_t mask = 0xFFu << (8 * byte);
+        r |= ((sim_ge >> byte) & 1) ? (a & mask) : (b & mask);
+    }
+    return r;
+}
+
+static inline uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc) {
+    return acc + (uint32_t)((int32_t)(int16_t)a * (int16_t)b +
+                            (int32_t)(int16_t)(a >> 16) * (int16_t)(b >> 16));
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARM_MATH_H */
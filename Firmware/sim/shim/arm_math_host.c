@@ -0,0 +1,252 @@
+#include "arm_math.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ==================== REAL FFT ==================== */
+// N/2-point complex FFT of the packed real input, then the standard
+// split step to recover bins 0..N/2 (same trick rfft_fast uses)
+static float32_t *work = NULL;
+static uint16_t work_len = 0;
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen) {
+    if(fftLen < 32 || (fftLen & (fftLen - 1))) return ARM_MATH_ARGUMENT_ERROR;
+    S->fftLenRFFT = fftLen;
+    S->Sint.fftLen = fftLen / 2;
+    if(work_len < fftLen) {
+        free(work);
+        work = malloc(fftLen * sizeof(float32_t));
+        work_len = fftLen;
+    }
+    return ARM_MATH_SUCCESS;
+}
+
+static void cfft_radix2(float32_t *x, uint32_t n) {
+    // Bit reversal
+    for(uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for(; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if(i < j) {
+            float32_t tr = x[2*i], ti = x[2*i+1];
+            x[2*i] = x[2*j]; x[2*i+1] = x[2*j+1];
+            x[2*j] = tr; x[2*j+1] = ti;
+        }
+    }
+
+    for(uint32_t len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / len;
+        for(uint32_t i = 0; i < n; i += len) {
+            for(uint32_t k = 0; k < len / 2; k++) {
+                float32_t wr = (float32_t)cos(ang * k), wi = (float32_t)sin(ang * k);
+                float32_t *a = &x[2*(i+k)], *b = &x[2*(i+k+len/2)];
+                float32_t tr = b[0] * wr - b[1] * wi;
+                float32_t ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr; b[1] = a[1] - ti;
+                a[0] += tr;       a[1] += ti;
+            }
+        }
+    }
+}
+
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *p,
+                       float32_t *pOut, uint8_t ifftFlag) {
+    uint32_t n = S->fftLenRFFT, h = n / 2;
+    (void)ifftFlag;  // Forward transform only
+
+    memcpy(work, p, n * sizeof(float32_t));
+    cfft_radix2(work, h);
+
+    // X[k] = (Z[k] + conj(Z[h-k]))/2 - j/2 * W^k * (Z[k] - conj(Z[h-k]))
+    pOut[0] = work[0] + work[1];
+    pOut[1] = work[0] - work[1];
+    for(uint32_t k = 1; k < h; k++) {
+        float32_t zr = work[2*k], zi = work[2*k+1];
+        float32_t cr = work[2*(h-k)], ci = -work[2*(h-k)+1];
+        float32_t er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float32_t or_ = 0.5f * (zr - cr), oi = 0.5f * (zi - ci);
+        double ang = -2.0 * M_PI * k / n;
+        float32_t wr = (float32_t)cos(ang), wi = (float32_t)sin(ang);
+        // -j * W * O
+        float32_t tr = wr * or_ - wi * oi, ti = wr * oi + wi * or_;
+        pOut[2*k] = er + ti;
+        pOut[2*k+1] = ei - tr;
+    }
+}
+
+/* ==================== COMPLEX FFT ==================== */
+void arm_cfft_f32(const arm_cfft_instance_f32 *S, float32_t *p1,
+                  uint8_t ifftFlag, uint8_t bitReverseFlag) {
+    (void)ifftFlag; (void)bitReverseFlag;  // Forward, natural order only
+    cfft_radix2(p1, S->fftLen);
+}
+
+/* ==================== FIXED-POINT FFT ==================== */
+// Integer radix-2 with the library's scaling: each stage halves its
+// butterflies (truncating), so an n-point cfft returns X / n; twiddles are
+// rounded to the q format. Values are held in 64 bits between stages
+static int64_t *qwork = NULL;
+static uint32_t qwork_len = 0;
+static arm_cfft_instance_q15 rfft_cfft_q15;
+static arm_cfft_instance_q31 rfft_cfft_q31;
+
+static int64_t *qwork_get(uint32_t n) {
+    if(qwork_len < n) {
+        free(qwork);
+        qwork = malloc(n * sizeof(int64_t));
+        qwork_len = n;
+    }
+    return qwork;
+}
+
+static int64_t q_saturate(int64_t v, int bits) {
+    int64_t hi = ((int64_t)1 << bits) - 1, lo = -((int64_t)1 << bits);
+    return (v > hi) ? hi : (v < lo) ? lo : v;
+}
+
+static int64_t q_twiddle(double v, int bits) {
+    return q_saturate(llround(v * ((int64_t)1 << bits)), bits);
+}
+
+static void cfft_fixed(int64_t *x, uint32_t n, int bits) {
+    for(uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for(; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if(i < j) {
+            int64_t tr = x[2*i], ti = x[2*i+1];
+            x[2*i] = x[2*j]; x[2*i+1] = x[2*j+1];
+            x[2*j] = tr; x[2*j+1] = ti;
+        }
+    }
+
+    for(uint32_t len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / len;
+        for(uint32_t k = 0; k < len / 2; k++) {
+            int64_t wr = q_twiddle(cos(ang * k), bits), wi = q_twiddle(sin(ang * k), bits);
+            for(uint32_t i = 0; i < n; i += len) {
+                int64_t *a = &x[2*(i+k)], *b = &x[2*(i+k+len/2)];
+                int64_t tr = (b[0] * wr - b[1] * wi) >> bits;
+                int64_t ti = (b[0] * wi + b[1] * wr) >> bits;
+                int64_t ar = a[0], ai = a[1];
+                a[0] = (ar + tr) >> 1; a[1] = (ai + ti) >> 1;
+                b[0] = (ar - tr) >> 1; b[1] = (ai - ti) >> 1;
+            }
+        }
+    }
+}
+
+// Packed n/2-point cfft, then the split step (no further scaling)
+static void rfft_fixed(int64_t *z, uint32_t n, int bits, int64_t *out) {
+    uint32_t h = n / 2;
+    cfft_fixed(z, h, bits);
+
+    out[0] = z[0] + z[1]; out[1] = 0;
+    out[n] = z[0] - z[1]; out[n+1] = 0;
+    for(uint32_t k = 1; k < h; k++) {
+        int64_t zr = z[2*k], zi = z[2*k+1];
+        int64_t cr = z[2*(h-k)], ci = -z[2*(h-k)+1];
+        int64_t er = (zr + cr) >> 1, ei = (zi + ci) >> 1;
+        int64_t or_ = (zr - cr) >> 1, oi = (zi - ci) >> 1;
+        double ang = -2.0 * M_PI * k / n;
+        int64_t wr = q_twiddle(cos(ang), bits), wi = q_twiddle(sin(ang), bits);
+        int64_t tr = (wr * or_ - wi * oi) >> bits, ti = (wr * oi + wi * or_) >> bits;
+        out[2*k] = er + ti;
+        out[2*k+1] = ei - tr;
+        out[2*(n-k)] = out[2*k];
+        out[2*(n-k)+1] = -out[2*k+1];
+    }
+}
+
+arm_status arm_rfft_init_q15(arm_rfft_instance_q15 *S, uint32_t fftLenReal,
+                             uint32_t ifftFlagR, uint32_t bitReverseFlag) {
+    (void)ifftFlagR; (void)bitReverseFlag;
+    if(fftLenReal < 32 || (fftLenReal & (fftLenReal - 1))) return ARM_MATH_ARGUMENT_ERROR;
+    rfft_cfft_q15.fftLen = fftLenReal / 2;
+    S->fftLenReal = fftLenReal;
+    S->pCfft = &rfft_cfft_q15;
+    return ARM_MATH_SUCCESS;
+}
+
+arm_status arm_rfft_init_q31(arm_rfft_instance_q31 *S, uint32_t fftLenReal,
+                             uint32_t ifftFlagR, uint32_t bitReverseFlag) {
+    (void)ifftFlagR; (void)bitReverseFlag;
+    if(fftLenReal < 32 || (fftLenReal & (fftLenReal - 1))) return ARM_MATH_ARGUMENT_ERROR;
+    rfft_cfft_q31.fftLen = fftLenReal / 2;
+    S->fftLenReal = fftLenReal;
+    S->pCfft = &rfft_cfft_q31;
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_rfft_q15(const arm_rfft_instance_q15 *S, q15_t *pSrc, q15_t *pDst) {
+    uint32_t n = S->fftLenReal;
+    int64_t *z = qwork_get(3 * n + 2), *out = z + n;
+    for(uint32_t i = 0; i < n; i++) z[i] = pSrc[i];
+    rfft_fixed(z, n, 15, out);
+    for(uint32_t i = 0; i < 2 * n; i++) pDst[i] = (q15_t)q_saturate(out[i], 15);
+}
+
+void arm_rfft_q31(const arm_rfft_instance_q31 *S, q31_t *pSrc, q31_t *pDst) {
+    uint32_t n = S->fftLenReal;
+    int64_t *z = qwork_get(3 * n + 2), *out = z + n;
+    for(uint32_t i = 0; i < n; i++) z[i] = pSrc[i];
+    rfft_fixed(z, n, 31, out);
+    for(uint32_t i = 0; i < 2 * n; i++) pDst[i] = (q31_t)q_saturate(out[i], 31);
+}
+
+void arm_cfft_q15(const arm_cfft_instance_q15 *S, q15_t *p1, uint8_t ifftFlag, uint8_t bitReverseFlag) {
+    (void)ifftFlag; (void)bitReverseFlag;  // Forward, natural order only
+    int64_t *x = qwork_get(2 * S->fftLen);
+    for(uint32_t i = 0; i < 2u * S->fftLen; i++) x[i] = p1[i];
+    cfft_fixed(x, S->fftLen, 15);
+    for(uint32_t i = 0; i < 2u * S->fftLen; i++) p1[i] = (q15_t)q_saturate(x[i], 15);
+}
+
+void arm_cfft_q31(const arm_cfft_instance_q31 *S, q31_t *p1, uint8_t ifftFlag, uint8_t bitReverseFlag) {
+    (void)ifftFlag; (void)bitReverseFlag;
+    int64_t *x = qwork_get(2 * S->fftLen);
+    for(uint32_t i = 0; i < 2u * S->fftLen; i++) x[i] = p1[i];
+    cfft_fixed(x, S->fftLen, 31);
+    for(uint32_t i = 0; i < 2u * S->fftLen; i++) p1[i] = (q31_t)q_saturate(x[i], 31);
+}
+
+/* ==================== COMPLEX MAGNITUDE ==================== */
+void arm_cmplx_mag_f32(const float32_t *pSrc, float32_t *pDst, uint32_t numSamples) {
+    for(uint32_t i = 0; i < numSamples; i++)
+        pDst[i] = sqrtf(pSrc[2*i] * pSrc[2*i] + pSrc[2*i+1] * pSrc[2*i+1]);
+}
+
+void arm_cmplx_mag_q15(const q15_t *pSrc, q15_t *pDst, uint32_t numSamples) {
+    for(uint32_t i = 0; i < numSamples; i++) {
+        double re = pSrc[2*i], im = pSrc[2*i+1];
+        pDst[i] = (q15_t)q_saturate((int64_t)(sqrt(re * re + im * im) / 2), 15);
+    }
+}
+
+void arm_cmplx_mag_q31(const q31_t *pSrc, q31_t *pDst, uint32_t numSamples) {
+    for(uint32_t i = 0; i < numSamples; i++) {
+        double re = pSrc[2*i], im = pSrc[2*i+1];
+        pDst[i] = (q31_t)q_saturate((int64_t)(sqrt(re * re + im * im) / 2), 31);
+    }
+}
+
+void arm_cmplx_mag_squared_f32(const float32_t *pSrc, float32_t *pDst, uint32_t numSamples) {
+    for(uint32_t i = 0; i < numSamples; i++)
+        pDst[i] = pSrc[2*i] * pSrc[2*i] + pSrc[2*i+1] * pSrc[2*i+1];
+}
+
+/* ==================== CONVERSION ==================== */
+void arm_float_to_q15(const float32_t *pSrc, q15_t *pDst, uint32_t blockSize) {
+    for(uint32_t i = 0; i < blockSize; i++)
+        pDst[i] = (q15_t)q_saturate((int64_t)(pSrc[i] * 32768.0f), 15);
+}
+
+void arm_float_to_q31(const float32_t *pSrc, q31_t *pDst, uint32_t blockSize) {
+    for(uint32_t i = 0; i < blockSize; i++)
+        pDst[i] = (q31_t)q_saturate((int64_t)((double)pSrc[i] * 2147483648.0), 31);
+}
+
+/* ==================== BASIC MATH ==================== */
+void arm_add_f32(const float32_t *pSrcA, const float32_t *pSrcB, float32_t *pDst, uint32_t blockSize) {
+    for(uint32_t i = 0; i < blockSize; i++)
+        pDst[i] = pSrcA[i] + pSrcB[i];
+}
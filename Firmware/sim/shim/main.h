@@ -0,0 +1,20 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/*
+ * Host stand-in for Core/Inc/main.h, for sources that include it from
+ * outside Core/Inc; the HAL subset lives in stm32f4xx_hal.h.
+ */
+#include "stm32f4xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void Error_Handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
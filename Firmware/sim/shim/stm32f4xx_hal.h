@@ -0,0 +1,88 @@
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+/*
+ * Host stand-in for the STM32F4 HAL: only what the firmware modules built
+ * by the simulator touch, so Core/Inc/main.h resolves here as well.
+ * DWT->CYCCNT reads the host monotonic clock scaled to the 100 MHz core
+ * clock, so the firmware's cycle counts come out in real host time. The
+ * ADC, its DMA stream and HAL_GetTick are driven by the emulated
+ * converter in sim_trigger.c.
+ */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t CYCCNT;
+} SimDwt;
+
+SimDwt *sim_dwt(void);
+#define DWT (sim_dwt())
+
+/* ==================== ADC + DMA (osc_trigger.c) ==================== */
+typedef enum { HAL_OK = 0, HAL_ERROR } HAL_StatusTypeDef;
+
+typedef struct {
+    volatile uint32_t LTR, HTR;         // Analog watchdog window
+} ADC_TypeDef;
+
+typedef struct {
+    volatile uint32_t NDTR;             // Transfers left in this lap
+} DMA_HandleTypeDef;
+
+typedef struct {
+    ADC_TypeDef *Instance;
+    DMA_HandleTypeDef *DMA_Handle;
+    volatile uint32_t IER;              // Enabled interrupts (ADC_IT_*)
+} ADC_HandleTypeDef;
+
+typedef struct {
+    uint32_t WatchdogMode;
+    uint32_t HighThreshold;
+    uint32_t LowThreshold;
+    uint32_t Channel;
+    uint32_t ITMode;
+} ADC_AnalogWDGConfTypeDef;
+
+#define DISABLE                         0u
+#define ADC_CHANNEL_0                   0u
+#define ADC_ANALOGWATCHDOG_SINGLE_REG   1u
+#define ADC_IT_AWD                      (1u << 6)
+#define ADC_IT_OVR                      (1u << 26)
+#define ADC_FLAG_AWD                    (1u << 0)
+
+#define __HAL_DMA_GET_COUNTER(h)        ((h)->NDTR)
+#define __HAL_ADC_ENABLE_IT(h, it)      ((h)->IER |= (it))
+#define __HAL_ADC_DISABLE_IT(h, it)     ((h)->IER &= ~(it))
+#define __HAL_ADC_CLEAR_FLAG(h, flag)   ((void)(h))
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *data, uint32_t length);
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_AnalogWDGConfig(ADC_HandleTypeDef *hadc, ADC_AnalogWDGConfTypeDef *cfg);
+uint32_t HAL_GetTick(void);
+
+typedef struct {
+    uint32_t Instance;
+} TIM_HandleTypeDef;
+
+/* ==================== I2C (ssd1306.c, stubbed by oled_check.c) ==================== */
+typedef struct {
+    uint32_t Instance;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT            1u
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t reg, uint16_t reg_size,
+                                    uint8_t *data, uint16_t len, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t reg, uint16_t reg_size,
+                                        uint8_t *data, uint16_t len);
+void HAL_Delay(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F4xx_HAL_H */
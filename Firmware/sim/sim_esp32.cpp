@@ -0,0 +1,212 @@
+#include <Arduino.h>
+#include "structures.h"
+#include "config.h"
+#include "state.h"
+#include "sim_esp32.h"
+#include "sim_stm32.h"
+#include "osc_codec.h"
+#include "ws_frames.h"
+
+// ==================== FIRMWARE GLOBALS ====================
+// Definitions main.cpp provides on the board
+MeasData meas = {0};
+FftBand fftBand = {FFT_SAMPLE_RATE, 0, 0};
+SignalStats sigStats = {0};
+AcqStats acqStats = {0};
+MemStats memStats = {0};
+ProfileStats profileStats = {};
+HardwareSerial Serial(0);
+HardwareSerial SerialSTM(2);
+
+uint32_t millis() { return (uint32_t)(sim_now_us() / 1000); }
+uint32_t micros() { return (uint32_t)sim_now_us(); }
+
+static SimServer* ws = nullptr;
+static FanoutStats fanoutStats = {0};
+
+uint16_t sim_esp32_resolution() {
+    uint8_t maxClass = resolutionClass(DEFAULT_RESOLUTION);
+    for (SimClient& c : ws->clients()) {
+        if (!c.websocket || c.fd < 0) continue;
+        uint8_t cls = resolutionClass(c.resolution);
+        if (cls > maxClass) maxClass = cls;
+    }
+    return RESOLUTIONS[maxClass];
+}
+
+uint32_t sim_esp32_frequency() {
+    return meas.valid ? (uint32_t)meas.frequency_hz : 0;
+}
+
+// ==================== BROADCAST ====================
+static void textToAll(const String& json) {
+    for (SimClient& c : ws->clients()) {
+        if (c.websocket && c.fd >= 0) ws->text(c, json.c_str());
+    }
+}
+
+// ==================== DEEP-MEMORY RECORD (as main.cpp) ====================
+static DeepRecord deepRecord = {};
+static WindowRoutes windowRoutes = {};
+
+static void sendWindowToClient(const OscFrameHeader& hdr, const uint16_t* samples) {
+    static uint8_t msg[WS_WINDOW_HEADER + OSC_FRAME_MAX_SAMPLES * 2];
+    size_t len = buildWindowMessage(msg, hdr, samples, 0);
+    uint32_t clientId = windowRoutes.clientFor(hdr.rec_tag);
+
+    for (SimClient& c : ws->clients()) {
+        if (c.websocket && c.fd >= 0 && clientId && c.id == clientId) ws->binary(c, msg, len);
+    }
+}
+
+// ==================== COMMANDS (as processCommand) ====================
+static void processCommand(const std::string& in) {
+    const char* cmd = in.c_str();
+    bool stateChanged = applyStateCommand(cmd, sharedState);
+
+    char stmCmd[32];
+    stmCommandForm(cmd, stmCmd, sizeof(stmCmd));
+    sim_stm32_command(stmCmd);
+
+    if (stateChanged) {
+        meas.reset();
+        sigStats.reset();
+        textToAll(buildStateJson(sharedState, REC_IDLE));
+    }
+}
+
+// ==================== WEBSOCKET EVENTS ====================
+void sim_esp32_begin(SimServer* server) {
+    ws = server;
+    sharedState.reset();
+
+    ws->onOpen = [](SimClient& c) {
+        c.resolution = DEFAULT_RESOLUTION;
+        ws->text(c, buildInitJson(c.id).c_str());
+        ws->text(c, buildStateJson(sharedState, REC_IDLE).c_str());
+        ws->text(c, deepRecord.json().c_str());
+        Serial.printf("✓ Client #%u connected\n", c.id);
+    };
+
+    ws->onClose = [](SimClient& c) {
+        windowRoutes.drop(c.id);
+        Serial.printf("✗ Client #%u disconnected\n", c.id);
+    };
+
+    ws->onText = [](SimClient& c, const std::string& cmd) {
+        if (cmd.empty()) return;
+        if (cmd == "PING") { ws->text(c, "{\"type\":\"pong\"}"); return; }
+        if (cmd == "GETSTATE") { ws->text(c, buildStateJson(sharedState, REC_IDLE).c_str()); return; }
+        if (cmd.compare(0, 4, "RES:") == 0) {
+            c.resolution = RESOLUTIONS[resolutionClass(atoi(cmd.c_str() + 4))];
+            return;
+        }
+        if (cmd.compare(0, 6, "CODEC:") == 0) {
+            int codec = atoi(cmd.c_str() + 6);
+            c.codec = (codec > 0 && codec < OSC_CODEC_COUNT) ? codec : OSC_CODEC_RAW;
+            return;
+        }
+        if (cmd.compare(0, 2, "I:") == 0) {
+            char tagged[STM_CMD_LEN];
+            taggedWindowCommand(cmd.c_str(), windowRoutes.tagFor(c.id), tagged, sizeof(tagged));
+            sim_stm32_command(tagged);
+            return;
+        }
+        Serial.printf("← #%u: %s\n", c.id, cmd.c_str());
+        processCommand(cmd);
+    };
+}
+
+// ==================== FRAME PATH ====================
+// Payload buffers for buildFrameVariants, one per variant of a frame
+struct SimPool {
+    std::vector<uint8_t> bufs[NUM_RESOLUTIONS * OSC_CODEC_COUNT];
+    uint32_t used;
+};
+
+static bool acquireSimPayload(size_t len, WsPayload& out, void* ctx) {
+    SimPool* pool = (SimPool*)ctx;
+    if (pool->used == NUM_RESOLUTIONS * OSC_CODEC_COUNT) return false;
+    std::vector<uint8_t>& buf = pool->bufs[pool->used++];
+    buf.resize(len);
+    out = WsPayload{buf.data(), len, &buf};
+    return true;
+}
+
+void sim_esp32_frame(const uint8_t* frame, size_t len, bool bench, SimEsp32Times* t) {
+    double t0 = sim_now_us();
+    uint32_t now = millis();
+
+    OscFrameHeader hdr;
+    if (osc_frame_decode(frame, len, &hdr) != OSC_FRAME_OK || len < osc_frame_length(&hdr)) return;
+
+    const uint16_t* samples = (const uint16_t*)(frame + hdr.header_len);
+    if (hdr.flags & OSC_FRAME_WINDOW) {
+        sendWindowToClient(hdr, samples);
+        return;
+    }
+    if (deepRecord.note(hdr)) textToAll(deepRecord.json());
+    if (fftBand.noteFrame(hdr)) textToAll(buildFftJson());
+
+    String measJson = noteFrameMeasurements(hdr, now, true, bench);
+    double t1 = sim_now_us();
+
+    // Clients due a frame and the variants they need; the bench builds
+    // every variant so the cost doesn't depend on who is connected
+    bool wanted[NUM_RESOLUTIONS][OSC_CODEC_COUNT] = {};
+    for (SimClient& c : ws->clients()) {
+        if (!c.websocket || c.fd < 0) continue;
+        if ((now - c.lastBinary) < BINARY_INTERVAL_NORMAL) continue;
+        wanted[resolutionClass(c.resolution)][c.codec] = true;
+    }
+    if (bench) memset(wanted, 1, sizeof(wanted));
+
+    static SimPool pool;
+    static uint8_t codecScratch[4 + OSC_CODEC_MAX_BYTES(OSC_FRAME_MAX_SAMPLES)];
+    static uint16_t classScratch[OSC_FRAME_MAX_SAMPLES];
+    WsPayload built[NUM_RESOLUTIONS][OSC_CODEC_COUNT];
+    pool.used = 0;
+    buildFrameVariants(samples, hdr.sample_count, hdr.flags, 0, wanted, built,
+                       WsScratch{codecScratch, classScratch}, acquireSimPayload, &pool, fanoutStats);
+
+    // Every delta payload must decode back to its class's raw samples
+    if (bench) {
+        t->raw_bytes = t->codec_bytes = 0;
+        t->codec_ok = true;
+        for (uint8_t cls = 0; cls < NUM_RESOLUTIONS; cls++) {
+            const WsPayload& raw = built[cls][OSC_CODEC_RAW];
+            const WsPayload& delta = built[cls][OSC_CODEC_DELTA];
+            if (!raw.data || !delta.data) {
+                t->codec_ok = false;
+                continue;
+            }
+            t->raw_bytes += raw.len;
+            t->codec_bytes += delta.len;
+
+            if (delta.data[3] == OSC_CODEC_DELTA) {
+                static uint16_t check[OSC_FRAME_MAX_SAMPLES];
+                int n = osc_codec_decode(delta.data + 4, delta.len - 4, check, OSC_FRAME_MAX_SAMPLES);
+                if (n < 0 || (size_t)n * 2 != raw.len - 4 || memcmp(check, raw.data + 4, n * 2) != 0 ||
+                    memcmp(delta.data, raw.data, 3) != 0) {
+                    t->codec_ok = false;
+                }
+            }
+        }
+    }
+
+    for (SimClient& c : ws->clients()) {
+        if (!c.websocket || c.fd < 0) continue;
+        if (measJson.length()) ws->text(c, measJson.c_str());
+        if ((now - c.lastBinary) < BINARY_INTERVAL_NORMAL) continue;
+
+        const WsPayload& msg = built[resolutionClass(c.resolution)][c.codec];
+        if (!msg.data) continue;
+        ws->binary(c, msg.data, msg.len);
+        c.lastBinary = now;
+    }
+
+    if (t) {
+        t->decode_us = t1 - t0;
+        t->egress_us = sim_now_us() - t1;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef SIM_ESP32_H
+#define SIM_ESP32_H
+
+/*
+ * ESP32 half of the simulator: frames go through the real
+ * osc_frame_decode, uart_parser.cpp and structures.cpp, then out over
+ * the /ws protocol of esp32/src/main.cpp as ws_frames.cpp builds it
+ * (4-byte header + samples, init/state/meas JSON, per-client resolution
+ * and payload format); only the socket server is the simulator's own.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "sim_ws.h"
+
+struct SimEsp32Times {
+    double decode_us;           // Header decode + measurement smoothing + JSON
+    double egress_us;           // Per-class decimation + socket writes
+    size_t raw_bytes;           // Bench: payload bytes per format, all classes
+    size_t codec_bytes;
+    bool codec_ok;              // Bench: every OSC_CODEC_DELTA payload decoded back
+};
+
+struct SimSpiCheck {
+    uint32_t frames;            // Whole frames fed
+    uint32_t delivered;         // Of which reassembled byte for byte
+    uint32_t wrong;             // Frames out that differ, or due and missing
+    uint32_t chunks;            // SPI transactions fed
+    uint32_t cut;               // Frames cut short (next header mid-frame, short last chunk)
+    uint32_t incomplete;        // FrameStats.incomplete after the run
+    uint32_t rejected;          // Chunks that open no frame (stray, bad CRC, oversized)
+    uint32_t refused;           // FrameStats sync + CRC errors after the run
+    double chunk_us;            // FrameAssembler::add per chunk of a clean stream
+};
+
+struct SimRecCheck {
+    uint32_t records;           // Sample runs encoded and decoded back
+    uint32_t samples;
+    uint32_t mismatches;        // Decoded differently, or refused
+    uint32_t oversize;          // Longer than REC_SAMPLES_MAX_BYTES
+    uint32_t cut;               // Truncated or overlong records tried
+    uint32_t accepted;          // Of which decoded anyway
+    double sine_bytes;          // Bytes per sample, noisy sine
+    double encode_ns;           // Per sample, noisy sine
+    double decode_ns;
+};
+
+struct SimWindowCheck {
+    uint32_t rounds;            // Bursts of requests before any reply is drained
+    uint32_t clients;           // Client ids used (askers leave and come back)
+    uint32_t requests;
+    uint32_t replies;
+    uint32_t misrouted;         // Reply to a client that didn't ask, twice, for a stale request or a bad I: form
+    uint32_t lost;              // Asker still connected that got no reply
+    uint32_t left;              // Askers gone before their reply
+    uint32_t unrouted;          // Replies for nobody (left, or untagged)
+};
+
+struct SimJsonCheck {
+    uint32_t messages;          // init, "fft" and meas messages read back
+    uint32_t field_errors;      // Field missing or not what the frame header says
+    uint32_t band_moves;        // Band changes fed
+    uint32_t spurious;          // Of which not noted exactly once by FftBand
+};
+
+void sim_esp32_begin(SimServer* server);
+
+// Process one SPI frame; bench mode skips the UI rate limits and builds
+// every resolution class in both payload formats
+void sim_esp32_frame(const uint8_t* frame, size_t len, bool bench, SimEsp32Times* t);
+
+// Frame size to request from the STM32 (largest client class)
+uint16_t sim_esp32_resolution();
+
+// Last smoothed frequency measurement (0 = invalid)
+uint32_t sim_esp32_frequency();
+
+// Multi-chunk SPI reassembly (FrameAssembler, as the SPI task runs it) over
+// clean, cut-short, interleaved and corrupted chunk streams (sim_spi.cpp)
+void sim_esp32_spi_check(SimSpiCheck* t);
+
+// Recorder sample coding round trips, size bound and refusals (sim_rec.cpp)
+void sim_esp32_rec_check(SimRecCheck* t);
+
+// Concurrent I: requests from several clients routed by their tags (sim_window.cpp)
+void sim_esp32_window_check(SimWindowCheck* t);
+
+// fftParams of the init, "fft" and meas JSON against the STM32 frames
+// they come from, as zoom bands open, move and close, and the meas "psd"
+// levels and "dist" figures of Welch estimates (sim_json.cpp)
+void sim_esp32_json_check(SimJsonCheck* t);
+
+#endif /* SIM_ESP32_H */
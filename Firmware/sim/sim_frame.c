@@ -0,0 +1,188 @@
+#include "sim_frame.h"
+#include "osc_frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each header is filled with distinct random values in every field, so
+ * a field that is dropped, read from the wrong bytes or carried over from
+ * the other extension shows up as a mismatch. The expected decode follows
+ * the layout rules in osc_frame.h: zoom and Welch share bytes 33..35 and
+ * 66..69, window tags byte 33 (zoom wins), record and spectrum share
+ * 70..85 (record wins), peaks past the v1 slots only on spectrum headers.
+ */
+static uint32_t rnd32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void fill(OscFrameHeader *h, uint8_t flags, uint8_t peaks, uint8_t psd, uint8_t dist) {
+    memset(h, 0, sizeof(*h));
+    h->flags = flags;
+    h->sample_count = rand() % (OSC_FRAME_MAX_SAMPLES + 1);
+    h->seq = rnd32();
+    h->sample_rate_hz = rnd32();
+    h->amplitude_mv = rand();
+    h->period_us = rand();
+    h->vrms_mv = rand();
+    h->duty_percent = rand();
+    h->vmax_mv = rand();
+    h->vmin_mv = rand();
+    h->frequency_hz = rnd32();
+    h->num_peaks = peaks;
+    for(int i = 0; i < OSC_FRAME_MAX_PEAKS; i++) {
+        h->peak_freqs[i] = rnd32();
+        h->peak_mags[i] = rand();
+    }
+    h->zoom_center_hz = rnd32();
+    h->zoom_log2 = 1 + rand() % 12;
+    h->psd_segments = psd ? 1 + rand() % 64 : 0;
+    h->psd_overlap = rand() % 76;
+    h->psd_tone_cdbfs = -(rand() % 15000);
+    h->psd_floor_cdbfs = -(rand() % 15000);
+    h->db_scale = rand() & 1;
+    h->db_ref_cdbfs = rand() % 4000 - 2000;
+    h->db_floor_cdb = -(rand() % 16000);
+    h->dist_harmonics = dist ? 1 + rand() % 20 : 0;
+    h->thd_cdb = -(rand() % 12000);
+    h->thdn_cdb = -(rand() % 12000);
+    h->snr_cdb = rand() % 12000;
+    h->sfdr_cdb = rand() % 12000;
+    h->enob_cbits = rand() % 1600;
+    h->rec_start = rnd32();
+    h->rec_span = rnd32();
+    h->rec_total = rnd32();
+    h->rec_id = rand();
+    h->rec_segments = 1 + rand() % 255;
+    h->rec_filled = rand();
+    h->rec_tag = rand();
+}
+
+// What osc_frame_decode must return for h
+static void expected(const OscFrameHeader *h, OscFrameHeader *e) {
+    uint8_t zoom = h->flags & OSC_FRAME_ZOOM;
+    uint8_t record = h->flags & OSC_FRAME_RECORD;
+    uint8_t spectrum = (h->flags & OSC_FRAME_SPECTRUM) && !record;
+    uint8_t slots = osc_frame_peak_slots(h->flags);
+
+    *e = *h;
+    e->version = OSC_FRAME_VERSION;
+    e->num_peaks = (h->num_peaks > slots) ? slots : h->num_peaks;
+    e->header_len = osc_frame_header_len(h->flags, e->num_peaks);
+    for(int i = 0; i < OSC_FRAME_MAX_PEAKS; i++) {
+        // v1 slots are always read back, zero when unused
+        if(i >= e->num_peaks) e->peak_freqs[i] = e->peak_mags[i] = 0;
+    }
+    if(!zoom) e->zoom_center_hz = e->zoom_log2 = 0;
+    if(zoom || !h->psd_segments) {
+        e->psd_segments = e->psd_overlap = 0;
+        e->psd_tone_cdbfs = e->psd_floor_cdbfs = 0;
+    }
+    if(!record) {
+        e->rec_start = e->rec_span = e->rec_total = 0;
+        e->rec_id = 0;
+        e->rec_segments = e->rec_filled = 0;
+    }
+    if(zoom || !(h->flags & OSC_FRAME_WINDOW)) e->rec_tag = 0;
+    if(!spectrum) {
+        e->db_scale = OSC_FRAME_SCALE_LINEAR;
+        e->db_ref_cdbfs = e->db_floor_cdb = 0;
+        e->dist_harmonics = 0;
+    }
+    if(!e->dist_harmonics) {
+        e->thd_cdb = e->thdn_cdb = e->snr_cdb = e->sfdr_cdb = 0;
+        e->enob_cbits = 0;
+    }
+}
+
+static int same(const OscFrameHeader *a, const OscFrameHeader *b) {
+    if(a->version != b->version || a->flags != b->flags || a->header_len != b->header_len ||
+       a->sample_count != b->sample_count || a->seq != b->seq || a->sample_rate_hz != b->sample_rate_hz ||
+       a->amplitude_mv != b->amplitude_mv || a->period_us != b->period_us || a->vrms_mv != b->vrms_mv ||
+       a->duty_percent != b->duty_percent || a->vmax_mv != b->vmax_mv || a->vmin_mv != b->vmin_mv ||
+       a->frequency_hz != b->frequency_hz || a->num_peaks != b->num_peaks)
+        return 0;
+    for(int i = 0; i < OSC_FRAME_MAX_PEAKS; i++)
+        if(a->peak_freqs[i] != b->peak_freqs[i] || a->peak_mags[i] != b->peak_mags[i]) return 0;
+    return a->zoom_center_hz == b->zoom_center_hz && a->zoom_log2 == b->zoom_log2 &&
+           a->psd_segments == b->psd_segments && a->psd_overlap == b->psd_overlap &&
+           a->psd_tone_cdbfs == b->psd_tone_cdbfs && a->psd_floor_cdbfs == b->psd_floor_cdbfs &&
+           a->db_scale == b->db_scale && a->db_ref_cdbfs == b->db_ref_cdbfs &&
+           a->db_floor_cdb == b->db_floor_cdb && a->dist_harmonics == b->dist_harmonics &&
+           a->thd_cdb == b->thd_cdb && a->thdn_cdb == b->thdn_cdb && a->snr_cdb == b->snr_cdb &&
+           a->sfdr_cdb == b->sfdr_cdb && a->enob_cbits == b->enob_cbits &&
+           a->rec_start == b->rec_start && a->rec_span == b->rec_span && a->rec_total == b->rec_total &&
+           a->rec_id == b->rec_id && a->rec_segments == b->rec_segments && a->rec_filled == b->rec_filled &&
+           a->rec_tag == b->rec_tag;
+}
+
+// Re-seal a header after editing it, as a producer would
+static void reseal(uint8_t *buf, size_t len) {
+    osc_put16(buf + len - 2, osc_crc16(buf, len - 2));
+}
+
+void sim_frame_check(SimFrameCheck *t) {
+    static const uint8_t peak_counts[] = {0, 1, 5, 6, 17, OSC_FRAME_MAX_PEAKS, OSC_FRAME_MAX_PEAKS + 1};
+    static uint8_t buf[OSC_FRAME_MAX_HEADER + 16];
+    OscFrameHeader h, e, d;
+    memset(t, 0, sizeof(*t));
+    srand(5);
+
+    for(uint32_t flags = 0; flags < 256; flags++)
+    for(uint32_t p = 0; p < sizeof(peak_counts); p++)
+    for(uint8_t psd = 0; psd <= 1; psd++)
+    for(uint8_t dist = 0; dist <= 1; dist++) {
+        fill(&h, (uint8_t)flags, peak_counts[p], psd, dist);
+        expected(&h, &e);
+        size_t len = osc_frame_encode(&h, buf);
+        t->round_trips++;
+
+        // Round trip, with the header alone and with samples behind it
+        if(len != e.header_len || osc_frame_decode(buf, len, &d) != OSC_FRAME_OK || !same(&d, &e) ||
+           osc_frame_decode(buf, sizeof(buf), &d) != OSC_FRAME_OK || !same(&d, &e) ||
+           osc_frame_length(&d) != len + 2u * h.sample_count) {
+            t->field_errors++;
+            continue;
+        }
+
+        // Header cut anywhere short of its length
+        size_t cut = OSC_FRAME_HEADER_SIZE / 2 + rand() % (len - OSC_FRAME_HEADER_SIZE / 2);
+        int r = osc_frame_decode(buf, cut, &d);
+        if(r != ((cut < OSC_FRAME_HEADER_SIZE) ? OSC_FRAME_ERR_SHORT : OSC_FRAME_ERR_VERSION))
+            t->version_errors++;
+
+        // A version this decoder doesn't know, and version 0, sealed with a valid CRC
+        for(int v = 0; v < 2; v++) {
+            buf[2] = v ? OSC_FRAME_VERSION + 1 + rand() % 254 : 0;
+            reseal(buf, len);
+            if(osc_frame_decode(buf, len, &d) != OSC_FRAME_ERR_VERSION) t->version_errors++;
+        }
+        buf[2] = OSC_FRAME_VERSION;
+        reseal(buf, len);
+
+        // A later v1 producer appends fields: same decode, longer header
+        size_t grown = len + 4 + 4 * (rand() % 3);
+        memmove(buf + grown - 2, buf + len - 2, 2);
+        for(size_t i = len - 2; i < grown - 2; i++) buf[i] = rand();
+        osc_put16(buf + 4, (uint16_t)grown);
+        reseal(buf, grown);
+        e.header_len = grown;
+        if(osc_frame_decode(buf, grown, &d) != OSC_FRAME_OK || !same(&d, &e)) t->growth_errors++;
+
+        // Every single-bit fault in the header (one layout per flag byte)
+        if(p || psd || dist) continue;
+        fill(&h, (uint8_t)flags, OSC_FRAME_MAX_PEAKS, 1, 1);
+        len = osc_frame_encode(&h, buf);
+        for(size_t bit = 0; bit < len * 8; bit++) {
+            buf[bit / 8] ^= 1u << (bit % 8);
+            r = osc_frame_decode(buf, len, &d);
+            t->corruptions++;
+            // Magic, version and length bytes have their own verdicts,
+            // everything else is the CRC's to catch
+            if(r == OSC_FRAME_OK ||
+               (bit / 8 >= 6 && r != OSC_FRAME_ERR_CRC) ||
+               (bit / 8 < 2 && r != OSC_FRAME_ERR_MAGIC))
+                t->undetected++;
+            buf[bit / 8] ^= 1u << (bit % 8);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SIM_FRAME_H
+#define SIM_FRAME_H
+
+/*
+ * osc_frame.h on its own: encode/decode round trips over every flag
+ * combination and the header faults the ESP32 has to refuse (sim_frame.c).
+ */
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t round_trips;       // Headers encoded and decoded back
+    uint32_t field_errors;      // Field lost, leaked into another extension or misplaced
+    uint32_t corruptions;       // Single-bit header faults tried
+    uint32_t undetected;        // Of which decoded as OSC_FRAME_OK
+    uint32_t version_errors;    // Unknown version, short or truncated header not refused
+    uint32_t growth_errors;     // Header grown past the known fields not read as v1
+} SimFrameCheck;
+
+// Round-trip every flag byte with 0..OSC_FRAME_MAX_PEAKS + 1 peaks, Welch
+// and distortion fields on and off; flip every bit of a header of each
+// layout; bump the version, cut the header short, grow it
+void sim_frame_check(SimFrameCheck *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_FRAME_H */
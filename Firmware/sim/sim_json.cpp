@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <Arduino.h>
+#include "structures.h"
+#include "ws_frames.h"
+#include "osc_frame.h"
+#include "sim_esp32.h"
+#include "sim_stm32.h"
+
+extern MeasData meas;
+extern FftBand fftBand;
+
+/*
+ * JSON the browser labels spectra from, built by the firmware's own code
+ * (FftBand, ws_frames.cpp, build_measurement_json) off real STM32 frames:
+ * the fftParams band of the init, "fft" and meas messages as a zoom band
+ * opens, moves, gets clamped at DC and closes, the meas "psd" object of
+ * Welch estimates (none on EMA spectra) and its "dist" object (none with
+ * the analysis off). Every field is read back out of the text and
+ * compared with the header it came from.
+ */
+
+// Number after "key": (first one in json), NAN if the key is missing
+static double jsonNumber(const String& json, const char* key) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* at = strstr(json.c_str(), pattern);
+    if (!at) return NAN;
+    at += strlen(pattern);
+    if (*at == '[') at++;
+    char* end;
+    double v = strtod(at, &end);
+    return (end == at) ? NAN : v;
+}
+
+static bool near(double got, double want, double tol) {
+    return fabs(got - want) <= tol;
+}
+
+// The next frame the STM32 sends after a command
+static bool nextFrame(uint8_t* frame, OscFrameHeader& hdr) {
+    for (int i = 0; i < 4096; i++) {
+        size_t len = sim_stm32_frame(frame, nullptr);
+        if (len) return osc_frame_decode(frame, len, &hdr) == OSC_FRAME_OK;
+    }
+    return false;
+}
+
+// fftParams as FftBand documents the header's band: the whole rfft, or
+// rate/2^log2 around the zoom centre in ZOOM_BINS bins
+static bool bandFields(const String& json, const OscFrameHeader& hdr) {
+    bool zoom = hdr.flags & OSC_FRAME_ZOOM;
+    double span = zoom ? (double)hdr.sample_rate_hz / (1u << hdr.zoom_log2) : 0;
+    double minFreq = zoom ? hdr.zoom_center_hz - span / 2 : 0;
+    double maxFreq = zoom ? minFreq + span : hdr.sample_rate_hz / 2.0;
+    double hzPerBin = (zoom ? span : hdr.sample_rate_hz / 2.0) / (FFT_SIZE / 2);
+    return jsonNumber(json, "sampleRate") == hdr.sample_rate_hz &&
+           jsonNumber(json, "center") == (zoom ? hdr.zoom_center_hz : 0) &&
+           near(jsonNumber(json, "span"), span, 0.001) &&
+           near(jsonNumber(json, "minFreq"), minFreq, 0.001) &&
+           near(jsonNumber(json, "maxFreq"), maxFreq, 0.001) &&
+           near(jsonNumber(json, "hzPerBin"), hzPerBin, 1e-6);
+}
+
+void sim_esp32_json_check(SimJsonCheck* t) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    memset(t, 0, sizeof(*t));
+    FftBand savedBand = fftBand;
+    MeasData savedMeas = meas;
+
+    // Zoom on, moved, clamped at DC (centre 244 Hz), then off again
+    const char* bands[] = {"C:20000,2000", "C:1000,250", "C:50,250", "C:0"};
+    sim_stm32_command("X:1");
+    sim_stm32_command("Z:0");
+    for (const char* c : bands) {
+        OscFrameHeader hdr;
+        sim_stm32_command(c);
+        if (!nextFrame(frame, hdr) || !(hdr.flags & OSC_FRAME_SPECTRUM)) {
+            t->field_errors++;
+            continue;
+        }
+
+        // The band moved: one "fft" message, and none for the same band again
+        t->band_moves++;
+        if (!fftBand.noteFrame(hdr) || fftBand.noteFrame(hdr)) t->spurious++;
+
+        // meas only for frames that carry measurements (not out-of-band zooms)
+        String m = noteFrameMeasurements(hdr, 0, true, true);
+        if (!m.length() != !(hdr.flags & OSC_FRAME_MEAS)) t->field_errors++;
+        String jsons[] = {buildInitJson(1), buildFftJson(), m};
+        for (const String& json : jsons) {
+            if (!json.length()) continue;
+            t->messages++;
+            if (!bandFields(json, hdr)) t->field_errors++;
+        }
+        if (!m.length()) continue;
+
+        // Zoom peaks travel in mHz, the meas JSON shows them in Hz (to the
+        // float MeasData holds them in)
+        double peak = (hdr.flags & OSC_FRAME_ZOOM) ? hdr.peak_freqs[0] / 1000.0 : hdr.peak_freqs[0];
+        if (jsonNumber(m, "npeaks") != hdr.num_peaks ||
+            (hdr.num_peaks && !near(jsonNumber(m, "pfreqs"), peak, 0.001 + peak * FLT_EPSILON))) t->field_errors++;
+    }
+
+    // Welch levels in dBFS and, from the ADC full-scale sine, dBV
+    const char* psdCmds[] = {"U:8,50", "U:0"};
+    for (const char* c : psdCmds) {
+        OscFrameHeader hdr;
+        sim_stm32_command(c);
+        String m = nextFrame(frame, hdr) ? noteFrameMeasurements(hdr, 0, true, true) : String();
+        t->messages++;
+        if (!m.length() || hdr.psd_segments != (c[2] == '8' ? 8 : 0)) {
+            t->field_errors++;
+            continue;
+        }
+        double tone = hdr.psd_tone_cdbfs / 100.0, floor = hdr.psd_floor_cdbfs / 100.0;
+        bool psdOk = !hdr.psd_segments ? isnan(jsonNumber(m, "seg")) :
+                     jsonNumber(m, "seg") == hdr.psd_segments && jsonNumber(m, "ovl") == hdr.psd_overlap &&
+                     near(jsonNumber(m, "tone"), tone, 0.006) &&
+                     near(jsonNumber(m, "toneDbv"), tone + OSC_FRAME_FULL_SCALE_DBV, 0.006) &&
+                     near(jsonNumber(m, "floor"), floor, 0.006) &&
+                     near(jsonNumber(m, "floorDbv"), floor + OSC_FRAME_FULL_SCALE_DBV, 0.006);
+        if (!psdOk) t->field_errors++;
+    }
+
+    // Distortion over a Welch estimate, then with the analysis off again
+    const char* distCmds[] = {"N:2", "U:8,50", "DH:9", "DH:0"};
+    for (const char* c : distCmds) {
+        OscFrameHeader hdr;
+        sim_stm32_command(c);
+        if (c[1] != 'H') continue;
+        String m = nextFrame(frame, hdr) ? noteFrameMeasurements(hdr, 0, true, true) : String();
+        t->messages++;
+        const char* at = strstr(m.c_str(), "\"dist\":");
+        if (!m.length() || hdr.dist_harmonics != (c[3] == '9' ? 9 : 0) || !at != !hdr.dist_harmonics) {
+            t->field_errors++;
+            continue;
+        }
+        if (!at) continue;
+        String dist(at);
+        double thd = hdr.thd_cdb / 100.0, thdn = hdr.thdn_cdb / 100.0, pct = 100 * pow(10, thd / 20);
+        bool distOk = jsonNumber(dist, "h") == hdr.dist_harmonics &&
+                      near(jsonNumber(dist, "thd"), thd, 0.006) &&
+                      near(jsonNumber(dist, "thdPct"), pct, 0.0001 + pct * FLT_EPSILON) &&
+                      near(jsonNumber(dist, "thdn"), thdn, 0.006) &&
+                      near(jsonNumber(dist, "sinad"), -thdn, 0.006) &&
+                      near(jsonNumber(dist, "snr"), hdr.snr_cdb / 100.0, 0.006) &&
+                      near(jsonNumber(dist, "sfdr"), hdr.sfdr_cdb / 100.0, 0.006) &&
+                      near(jsonNumber(dist, "enob"), hdr.enob_cbits / 100.0, 0.006);
+        if (!distOk) t->field_errors++;
+    }
+    sim_stm32_command("U:0");
+    sim_stm32_command("N:0");
+
+    fftBand = savedBand;
+    meas = savedMeas;
+}
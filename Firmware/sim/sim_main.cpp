@@ -0,0 +1,534 @@
+/*
+ * Host simulator for the STM32 -> SPI -> ESP32 -> WebSocket chain.
+ *
+ *   osc_sim [options]                 serve index.html + /ws on --port
+ *   osc_sim --bench N [options]       run N frames per mode flat out, print
+ *                                     frames/s and µs per stage, then exit
+ *
+ * Options:
+ *   --port P          HTTP/WebSocket port (default 8080)
+ *   --www DIR         Directory served at / (default ../esp32/data)
+ *   --wave W          square | sine | triangle (default square = PWM self-test)
+ *   --freq HZ         Generator frequency (default 1000, F: command changes it)
+ *   --vpp V           Peak-to-peak at the ADC pin (default 2.0)
+ *   --noise V         Uniform noise peak-to-peak (default 0.02)
+ *   --input FILE      Replay raw little-endian uint16 ADC codes instead
+ *
+ * Serve mode paces frames at the real acquisition rate of the current
+ * settings; bench mode ignores pacing and UI rate limits.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <vector>
+#include "sim_stm32.h"
+#include "sim_frame.h"
+#include "sim_esp32.h"
+#include "sim_ws.h"
+#include "osc_frame.h"
+
+static volatile bool running = true;
+
+static void onSignal(int) {
+    running = false;
+}
+
+// ==================== STAGE STATISTICS ====================
+struct StageStat {
+    const char* name;
+    double sum, min, max;
+    uint32_t n;
+
+    void add(double us) {
+        if (n == 0 || us < min) min = us;
+        if (us > max) max = us;
+        sum += us;
+        n++;
+    }
+};
+
+static void printStages(const char* mode, StageStat* stages, int count, double elapsedUs, uint32_t frames) {
+    printf("%-5s %6u frames  %9.1f frames/s\n", mode, frames, frames * 1e6 / elapsedUs);
+    for (int i = 0; i < count; i++) {
+        StageStat& s = stages[i];
+        printf("  %-10s avg %9.2f us  min %9.2f us  max %9.2f us\n",
+               s.name, s.n ? s.sum / s.n : 0, s.min, s.max);
+    }
+}
+
+// ==================== BENCH ====================
+static int runBench(uint32_t frames, uint32_t genFreq, const SimSourceConfig& src) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    int failures = 0;
+
+    // Tolerance: 2% in time domain, one bin (SR_FFT_MODE / FFT_SIZE) for the FFT
+    struct { const char* name; const char* cmds[5]; double tolHz; } modes[] = {
+        {"time", {"X:0", "T:1000", "E:1", "M:0", "Z:0"}, genFreq * 0.02},
+        {"env",  {"X:0", "T:1000", "E:1", "M:3", "Z:0"}, genFreq * 0.02},
+        {"fft",  {"X:1", "M:0", "Z:0", nullptr, nullptr}, 500000.0 / 4096},
+    };
+
+    for (auto& m : modes) {
+        for (const char* c : m.cmds) if (c) sim_stm32_command(c);
+
+        StageStat stages[4] = {{"measure"}, {"encode"}, {"decode"}, {"egress"}};
+        double start = sim_now_us();
+        double rawBytes = 0, codecBytes = 0;
+        bool codecOk = true;
+
+        for (uint32_t i = 0; i < frames; i++) {
+            SimStm32Times st;
+            SimEsp32Times et;
+            size_t len = sim_stm32_frame(frame, &st);
+            sim_esp32_frame(frame, len, true, &et);
+            stages[0].add(st.measure_us);
+            stages[1].add(st.encode_us);
+            stages[2].add(et.decode_us);
+            stages[3].add(et.egress_us);
+            rawBytes += et.raw_bytes;
+            codecBytes += et.codec_bytes;
+            codecOk = codecOk && et.codec_ok;
+        }
+
+        printStages(m.name, stages, 4, sim_now_us() - start, frames);
+
+        // Wire size over all four resolution classes, raw vs OSC_CODEC_DELTA
+        printf("  wire      raw %8.0f B/frame  delta %8.0f B/frame  %.2fx %s\n",
+               rawBytes / frames, codecBytes / frames, rawBytes / codecBytes, codecOk ? "ok" : "FAIL");
+        if (!codecOk) failures++;
+
+        // Smoke check: the chain should lock onto the generator
+        uint32_t f = sim_esp32_frequency();
+        bool ok = f && fabs((double)f - genFreq) <= m.tolHz;
+        printf("  measured  %u Hz (generator %u Hz) %s\n", f, genFreq, ok ? "ok" : "FAIL");
+        if (!ok) failures++;
+    }
+
+    // Deep memory: one record over all of acq_memory, then a zoomed window of it
+    const char* deepCmds[] = {"X:0", "T:5000", "M:0", "Z:0", "K:1"};
+    for (const char* c : deepCmds) sim_stm32_command(c);
+    OscFrameHeader live, win;
+    size_t len = sim_stm32_frame(frame, nullptr);
+    bool deepOk = osc_frame_decode(frame, len, &live) == OSC_FRAME_OK && live.rec_total == live.rec_span;
+
+    char cmd[48];
+    uint32_t span = live.rec_total / 8, start = live.rec_total / 2;
+    snprintf(cmd, sizeof(cmd), "I:%u,%u,512,3", start, span);
+    sim_stm32_command(cmd);
+    double t0 = sim_now_us();
+    len = sim_stm32_window(frame);
+    double windowUs = sim_now_us() - t0;
+    deepOk = deepOk && osc_frame_decode(frame, len, &win) == OSC_FRAME_OK &&
+             (win.flags & OSC_FRAME_WINDOW) && (win.flags & OSC_FRAME_ENVELOPE) &&
+             win.sample_count == 1024 && win.rec_start == start && win.rec_span == span &&
+             win.rec_id == live.rec_id && sim_stm32_frame(frame, nullptr) == 0;
+    printf("deep  record %u samples @ %u Hz  window %u+%u -> 512 pairs in %.2f us %s\n",
+           live.rec_total, live.sample_rate_hz, start, span, windowUs, deepOk ? "ok" : "FAIL");
+    if (!deepOk) failures++;
+
+    // Zoom levels over the deep record: sample scan vs min/max/sum pyramid
+    // ("scan" where the buckets are too fine for the index to pay)
+    const char* zoomModes[] = {"avg", "peak", "env"};  // M:1..3
+    for (uint32_t zoom = 1; zoom <= 64; zoom *= 4) {
+        uint32_t zspan = live.rec_total / zoom;
+        for (uint8_t mode = 1; mode <= 3; mode++) {
+            SimZoomTimes zt;
+            char gain[16] = " scan";
+            sim_stm32_zoom((live.rec_total - zspan) / 2, zspan, 128, mode, 500, &zt);
+            if (zt.indexed) snprintf(gain, sizeof(gain), "%4.1fx", zt.brute_us / zt.pyramid_us);
+            printf("zoom  %2ux %-4s %5u -> 128  brute %8.2f us  pyramid %7.2f us  %s %s\n",
+                   zoom, zoomModes[mode - 1], zspan, zt.brute_us, zt.pyramid_us,
+                   gain, zt.match ? "ok" : "FAIL");
+            if (!zt.match) failures++;
+        }
+    }
+
+    // Deep windows against the record: K:1, K:4 and K:32, clamped requests
+    SimDeepCheck deep;
+    sim_stm32_deep_check(&deep);
+    bool dwinOk = !deep.mismatches && !deep.header_errors;
+    printf("dwin  %u windows over K:1/4/32 (K:1 %u samples)  %u header errors  %u sample mismatches  %.2f us %s\n",
+           deep.windows, deep.single_total, deep.header_errors, deep.mismatches, deep.window_us, dwinOk ? "ok" : "FAIL");
+    if (!dwinOk) failures++;
+
+    // Several clients asking at once: every reply reaches only its asker
+    SimWindowCheck wc;
+    sim_esp32_window_check(&wc);
+    bool routeOk = wc.replies && !wc.misrouted && !wc.lost;
+    printf("route %u rounds, %u clients, %u requests -> %u replies  %u misrouted  %u lost  "
+           "%u unrouted (%u left) %s\n",
+           wc.rounds, wc.clients, wc.requests, wc.replies, wc.misrouted, wc.lost, wc.unrouted, wc.left,
+           routeOk ? "ok" : "FAIL");
+    if (!routeOk) failures++;
+
+    // STOP without deep memory: the last frame stays behind for zooming
+    OscFrameHeader last;
+    sim_stm32_command("STOP");
+    len = sim_stm32_frame(frame, nullptr);
+    bool stopOk = osc_frame_decode(frame, len, &last) == OSC_FRAME_OK &&
+                  (last.flags & OSC_FRAME_RECORD) && last.rec_segments == 0 &&
+                  last.rec_total && sim_stm32_frame(frame, nullptr) == 0;
+    snprintf(cmd, sizeof(cmd), "I:%u,%u,256,0", last.rec_total / 4, last.rec_total / 2);
+    sim_stm32_command(cmd);
+    len = sim_stm32_window(frame);
+    stopOk = stopOk && osc_frame_decode(frame, len, &win) == OSC_FRAME_OK &&
+             win.sample_count == 256 && win.rec_span == last.rec_total / 2 && win.rec_id == last.rec_id;
+    sim_stm32_command("RUN");
+    len = sim_stm32_frame(frame, nullptr);
+    stopOk = stopOk && osc_frame_decode(frame, len, &live) == OSC_FRAME_OK && !(live.flags & OSC_FRAME_RECORD);
+    printf("stop  retained %u samples  window %u+%u -> 256 points  run resumes %s\n",
+           last.rec_total, last.rec_total / 4, last.rec_total / 2, stopOk ? "ok" : "FAIL");
+    if (!stopOk) failures++;
+
+    // Zoom-FFT around the generator: feed halves until the ring has filled,
+    // the strongest peak (mHz) must sit within one zoom bin of it
+    snprintf(cmd, sizeof(cmd), "C:%u,250", genFreq);
+    const char* zfftCmds[] = {"X:1", "Z:0", cmd};
+    for (const char* c : zfftCmds) sim_stm32_command(c);
+    OscFrameHeader zh = {};
+    bool zoomOk = false;
+    uint32_t halves = 0, spectra = 0;
+    double feedUs = 0, spectrumUs = 0;
+    for (; halves < 2048 && spectra < 24; halves++) {
+        SimStm32Times st;
+        len = sim_stm32_frame(frame, &st);
+        if (!len) { feedUs += st.measure_us; continue; }
+        SimEsp32Times et;
+        spectrumUs += st.measure_us;
+        sim_esp32_frame(frame, len, true, &et);
+        if (osc_frame_decode(frame, len, &zh) == OSC_FRAME_OK && zh.num_peaks) spectra++;
+    }
+    if (spectra && (zh.flags & OSC_FRAME_ZOOM)) {
+        double binMhz = 1000.0 * zh.sample_rate_hz / (1u << zh.zoom_log2) / 2048;  // ZOOM_BINS
+        zoomOk = fabs((double)zh.peak_freqs[0] - genFreq * 1000.0) <= binMhz;
+        printf("zfft  %u Hz  1/%u  %.3f Hz/bin  feed %.2f us/half  spectrum %.2f us  peak %.3f Hz %s\n",
+               zh.zoom_center_hz, 1u << zh.zoom_log2, binMhz / 1000.0,
+               feedUs / (halves - spectra), spectrumUs / spectra, zh.peak_freqs[0] / 1000.0,
+               zoomOk ? "ok" : "FAIL");
+    } else {
+        printf("zfft  no spectrum after %u halves FAIL\n", halves);
+    }
+    if (!zoomOk) failures++;
+    sim_stm32_command("C:0");
+
+    // Zoom bands: tones off-centre at every decimation within a bin and on
+    // the tone's level, tones outside the band rejected, clamped centres
+    SimZfftCheck zc;
+    double zbandUs = sim_now_us();
+    sim_stm32_zfft_check(&zc);
+    zbandUs = sim_now_us() - zbandUs;
+    bool zbandOk = zc.bands && !zc.band_errors && !zc.misplaced && !zc.leaks;
+    printf("zband %u bands (%u header errors)  in band worst %.2f bins, %.2f dB (%u off)  "
+           "out of band %.1f dB down (%u under %.0f)  %.0f ms %s\n",
+           zc.bands, zc.band_errors, zc.worst_bins, zc.worst_level_db, zc.misplaced,
+           zc.rejection_db, zc.leaks, SIM_ZFFT_REJECT_DB, zbandUs / 1000, zbandOk ? "ok" : "FAIL");
+    if (!zbandOk) failures++;
+
+    // Welch PSD: 8 segments at 50% overlap, three from each 8192-sample
+    // record; the tone must stay within one bin of the generator
+    const char* welchCmds[] = {"X:1", "Z:0", "U:8,50"};
+    for (const char* c : welchCmds) sim_stm32_command(c);
+    OscFrameHeader wh = {};
+    uint32_t records = 0, estimates = 0;
+    double welchUs = 0;
+    for (; records < 64 && estimates < 4; records++) {
+        SimStm32Times st;
+        len = sim_stm32_frame(frame, &st);
+        welchUs += st.measure_us;
+        if (len && osc_frame_decode(frame, len, &wh) == OSC_FRAME_OK) estimates++;
+    }
+    bool welchOk = estimates && wh.psd_segments == 8 && wh.num_peaks &&
+                   fabs((double)wh.peak_freqs[0] - genFreq) <= 500000.0 / 4096;
+    printf("welch %u x 4096 @ %u%%  %.0f segments/s  tone %.2f dBFS (%.2f dBV)  floor %.2f dBFS/Hz  peak %u Hz %s\n",
+           wh.psd_segments, wh.psd_overlap, estimates * 8 / (welchUs / 1e6),
+           wh.psd_tone_cdbfs / 100.0, wh.psd_tone_cdbfs / 100.0 + OSC_FRAME_FULL_SCALE_DBV,
+           wh.psd_floor_cdbfs / 100.0, estimates ? wh.peak_freqs[0] : 0, welchOk ? "ok" : "FAIL");
+    if (!welchOk) failures++;
+    sim_stm32_command("U:0");
+
+    // Welch levels: tone and noise density against the source for every
+    // window and segment layout, segments carried over records
+    SimWelchCheck pc;
+    double psdUs = sim_now_us();
+    sim_stm32_welch_check(&pc);
+    psdUs = sim_now_us() - psdUs;
+    bool psdOk = pc.estimates && !pc.header_errors && !pc.level_errors;
+    printf("psd   %u estimates over 4 windows, 1-64 segments (%u layout errors)  tone within %.3f dB, "
+           "floor within %.3f dB (%u off)  %.0f ms %s\n",
+           pc.estimates, pc.header_errors, pc.worst_tone_db, pc.worst_floor_db, pc.level_errors,
+           psdUs / 1000, psdOk ? "ok" : "FAIL");
+    if (!psdOk) failures++;
+
+    // dB spectra: the fast log within half an LSB of log10f, and the zoom
+    // and Welch peaks on the tone's absolute level (Hann scalloping aside)
+    SimDbCheck dc;
+    sim_stm32_db_check(4096, &dc);
+    auto peakDbfs = [](const OscFrameHeader& h) {
+        return (h.db_ref_cdbfs + h.db_floor_cdb) / 100.0 + h.peak_mags[0] * OSC_FRAME_DB_PER_LSB;
+    };
+    double toneDbfs = wh.psd_tone_cdbfs / 100.0;
+    bool dbOk = dc.max_err_db <= OSC_FRAME_DB_PER_LSB / 2 &&
+                zh.db_scale == OSC_FRAME_SCALE_DB && wh.db_scale == OSC_FRAME_SCALE_DB &&
+                fabs(peakDbfs(zh) - toneDbfs) <= 1.5 && fabs(peakDbfs(wh) - toneDbfs) <= 1.5;
+    printf("dblog max error %.4f dB  %.2f ns vs %.2f ns log10f  peaks zoom %.2f welch %.2f dBFS (tone %.2f) %s\n",
+           dc.max_err_db, dc.fast_ns, dc.ref_ns, peakDbfs(zh), peakDbfs(wh), toneDbfs, dbOk ? "ok" : "FAIL");
+    if (!dbOk) failures++;
+
+    // Distortion over a Welch estimate (exact power averaging): THD against
+    // the synthetic wave's harmonic series up to the analysed order, SNR of
+    // a sine against its uniform noise and quantisation
+    const char* distCmds[] = {"X:1", "Z:0", "N:2", "U:8,50", "DH:9"};
+    for (const char* c : distCmds) sim_stm32_command(c);
+    OscFrameHeader dh = {};
+    double fftUs = 0, distUs = 0;
+    for (uint32_t r = 0, n = 0; r < 64 && n < 4; r++) {
+        SimStm32Times st;
+        len = sim_stm32_frame(frame, &st);
+        if (!len || osc_frame_decode(frame, len, &dh) != OSC_FRAME_OK) continue;
+        fftUs += st.fft_us;
+        distUs += st.distortion_us;
+        n++;
+    }
+    double harm = 0;
+    for (uint32_t n = 3; n <= dh.dist_harmonics + 1u; n += 2)
+        harm += (src.wave == SIM_WAVE_SQUARE) ? 1.0 / (n * n) : (src.wave == SIM_WAVE_TRIANGLE) ? pow(n, -4.0) : 0;
+    double lsb = 3.3 / 4096;
+    double snrSine = 10 * log10(src.vpp * src.vpp / 8 / (src.noise_vpp * src.noise_vpp / 12 + lsb * lsb / 12));
+    char expect[32];
+    bool distOk = dh.dist_harmonics > 0;
+    if (src.path) {
+        snprintf(expect, sizeof(expect), "recorded input");
+    } else if (src.wave == SIM_WAVE_SINE) {
+        snprintf(expect, sizeof(expect), "SNR %.2f", snrSine);
+        distOk = distOk && dh.thd_cdb < -5000 && fabs(dh.snr_cdb / 100.0 - snrSine) <= 1.0;
+    } else {
+        snprintf(expect, sizeof(expect), "THD %.2f", 10 * log10(harm));
+        distOk = distOk && fabs(dh.thd_cdb / 100.0 - 10 * log10(harm)) <= 0.5;
+    }
+    printf("dist  %u harmonics  THD %.2f  THD+N %.2f  SINAD %.2f  SNR %.2f  SFDR %.2f dB  ENOB %.2f (%s)  "
+           "%.2f us, %.1f%% of the FFTs %s\n",
+           dh.dist_harmonics, dh.thd_cdb / 100.0, dh.thdn_cdb / 100.0, -dh.thdn_cdb / 100.0,
+           dh.snr_cdb / 100.0, dh.sfdr_cdb / 100.0, dh.enob_cbits / 100.0, expect,
+           distUs / 4, fftUs > 0 ? 100.0 * distUs / fftUs : 0.0, distOk ? "ok" : "FAIL");
+    if (!distOk) failures++;
+    sim_stm32_command("U:0");
+    sim_stm32_command("N:0");
+
+    // JSON the browser labels spectra from: fftParams in init, "fft" and
+    // meas messages through zoom on, moved, clamped and off; Welch levels
+    // and distortion figures
+    SimJsonCheck jc;
+    sim_esp32_json_check(&jc);
+    bool jsonOk = jc.messages && !jc.field_errors && !jc.spurious;
+    printf("json  %u messages (%u field errors)  fftParams over %u band changes (%u not noted once), psd, dist %s\n",
+           jc.messages, jc.field_errors, jc.band_moves, jc.spurious, jsonOk ? "ok" : "FAIL");
+    if (!jsonOk) failures++;
+
+    // Peaks: each estimator's worst frequency error over tones stepped
+    // across a Hann bin, then the top 32 of the wave, which must come out
+    // strongest first, spaced, and (square wave) all odd harmonics
+    const char* interpNames[] = {"parabolic", "gaussian", "jacobsen"};
+    double hzPerBin = 500000.0 / 4096, interpErr[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++) {
+        snprintf(cmd, sizeof(cmd), "DP:5,%d", k);
+        sim_stm32_command(cmd);
+        for (int j = 0; j < 8; j++) {
+            uint32_t f = genFreq + (uint32_t)(j * hzPerBin / 8 + 0.5);
+            snprintf(cmd, sizeof(cmd), "F:%u", f);
+            sim_stm32_command(cmd);
+            sim_stm32_command("X:1");
+            OscFrameHeader ph = {};
+            len = sim_stm32_frame(frame, nullptr);
+            if (len && osc_frame_decode(frame, len, &ph) == OSC_FRAME_OK && ph.num_peaks)
+                interpErr[k] = fmax(interpErr[k], fabs((double)ph.peak_freqs[0] - f));
+            else
+                interpErr[k] = 1e9;
+        }
+    }
+    snprintf(cmd, sizeof(cmd), "F:%u", genFreq);
+    sim_stm32_command(cmd);
+    bool peaksOk = src.path || (interpErr[2] <= 0.03 * hzPerBin && interpErr[2] <= interpErr[0]);
+
+    OscFrameHeader ph = {};
+    double peaksUs[2] = {0, 0};
+    const char* topCmds[] = {"DP:5,2,0,50,15", "DP:32,2,0,50,15"};
+    for (int k = 0; k < 2; k++) {
+        sim_stm32_command(topCmds[k]);
+        sim_stm32_command("X:1");
+        for (int r = 0; r < 8; r++) {
+            SimStm32Times st;
+            len = sim_stm32_frame(frame, &st);
+            peaksUs[k] += st.peaks_us / 8;
+        }
+    }
+    bool topOk = osc_frame_decode(frame, len, &ph) == OSC_FRAME_OK && ph.num_peaks > 0 &&
+                 ph.num_peaks <= 32 && ph.header_len == osc_frame_header_len(ph.flags, ph.num_peaks);
+    uint32_t oddHarmonics = 0;
+    for (uint32_t i = 0; topOk && i < ph.num_peaks; i++) {
+        if (i && ph.peak_mags[i] > ph.peak_mags[i - 1]) topOk = false;
+        for (uint32_t j = 0; j < i; j++)
+            if (fabs((double)ph.peak_freqs[i] - ph.peak_freqs[j]) < 2 * hzPerBin) topOk = false;
+        double n = (double)ph.peak_freqs[i] / genFreq;
+        long r = lround(n);
+        if ((r & 1) && fabs(n - r) * genFreq <= hzPerBin) oddHarmonics++;
+    }
+    if (!src.path && src.wave == SIM_WAVE_SQUARE)
+        topOk = topOk && ph.num_peaks == 32 && oddHarmonics == 32;
+    printf("peaks max error %.2f / %.2f / %.2f Hz (%s / %s / %s)  top %u (%u odd harmonics, %u B header)  "
+           "%.2f us at K=5, %.2f us at K=32 %s\n",
+           interpErr[0], interpErr[1], interpErr[2], interpNames[0], interpNames[1], interpNames[2],
+           ph.num_peaks, oddHarmonics, ph.header_len, peaksUs[0], peaksUs[1], peaksOk && topOk ? "ok" : "FAIL");
+    if (!peaksOk || !topOk) failures++;
+    sim_stm32_command("DP:5,2,0,50,15");
+
+    // Trigger engine on the emulated ADC: every frame must be the
+    // conversions around a real edge, wherever the window wrapped the ring
+    SimTriggerCheck tc;
+    sim_stm32_trigger(&tc);
+    bool trigOk = tc.frames && !tc.edge_errors && !tc.misplaced && !tc.missed && tc.forced;
+    printf("trig  %u frames (%u forced)  %u edge / %u placement errors  capture %.2f us (%.2f us no spill, "
+           "rotation %.2f us)  %.1f Msps scanned %s\n",
+           tc.frames, tc.forced, tc.edge_errors, tc.misplaced, tc.capture_us, tc.capture_nospill_us,
+           tc.rotate_us, tc.msps, trigOk ? "ok" : "FAIL");
+    if (!trigOk) failures++;
+
+    // SPI header codec: every flag combination must come back field for
+    // field, and no corrupted, truncated or unknown-version header decode
+    SimFrameCheck fc;
+    sim_frame_check(&fc);
+    bool frameOk = !fc.field_errors && !fc.undetected && !fc.version_errors && !fc.growth_errors;
+    printf("frame %u round trips (%u field errors)  %u bit faults (%u undetected)  "
+           "%u version/length and %u grown-header errors %s\n",
+           fc.round_trips, fc.field_errors, fc.corruptions, fc.undetected,
+           fc.version_errors, fc.growth_errors, frameOk ? "ok" : "FAIL");
+    if (!frameOk) failures++;
+
+    // SPI reassembly: frames split over OSC_FRAME_CHUNK_BYTES transactions
+    // come out whole, frames cut short by the next header count as incomplete
+    SimSpiCheck sc;
+    sim_esp32_spi_check(&sc);
+    bool spiOk = sc.delivered == sc.frames && !sc.wrong && sc.incomplete == sc.cut &&
+                 sc.refused == sc.rejected;
+    printf("spi   %u/%u frames reassembled from %u chunks  %u/%u cut short counted incomplete  "
+           "%u/%u stray chunks refused  %.2f us/chunk %s\n",
+           sc.delivered, sc.frames, sc.chunks, sc.incomplete, sc.cut, sc.refused, sc.rejected,
+           sc.chunk_us, spiOk ? "ok" : "FAIL");
+    if (!spiOk) failures++;
+
+    // Recorder sample coding: every REC_FRAME payload decodes back exactly,
+    // within RECORD_MAX_PAYLOAD, and a cut one is refused
+    SimRecCheck rc;
+    sim_esp32_rec_check(&rc);
+    bool recOk = rc.records && !rc.mismatches && !rc.oversize && !rc.accepted;
+    printf("rec   %u records, %u samples round-tripped (%u mismatches, %u over 3 B/sample)  "
+           "%u/%u cut refused  sine %.2f B/sample  %.2f / %.2f ns/sample %s\n",
+           rc.records, rc.samples, rc.mismatches, rc.oversize, rc.cut - rc.accepted, rc.cut,
+           rc.sine_bytes, rc.encode_ns, rc.decode_ns, recOk ? "ok" : "FAIL");
+    if (!recOk) failures++;
+
+    return failures ? 1 : 0;
+}
+
+// ==================== SERVE ====================
+static int runServer(uint16_t port, const char* www) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    SimServer server;
+    if (!server.begin(port, www)) {
+        fprintf(stderr, "Cannot listen on port %u\n", port);
+        return 1;
+    }
+    sim_esp32_begin(&server);
+    printf("Serving %s on http://localhost:%u/\n", www, port);
+
+    uint16_t resolution = 0xFFFF;
+    double next = sim_now_us();
+    uint32_t frames = 0, late = 0;
+    double reportAt = next + 10e6;
+
+    while (running) {
+        // Z: negotiation as updateStmResolution() does it
+        uint16_t wanted = sim_esp32_resolution();
+        if (wanted != resolution) {
+            char cmd[16];
+            snprintf(cmd, sizeof(cmd), "Z:%u", wanted);
+            sim_stm32_command(cmd);
+            resolution = wanted;
+        }
+
+        // I: replies go out ahead of the next live frame, as on the STM32
+        size_t windowLen = sim_stm32_window(frame);
+        if (windowLen) sim_esp32_frame(frame, windowLen, false, nullptr);
+
+        double now = sim_now_us();
+        if (now >= next) {
+            size_t len = sim_stm32_frame(frame, nullptr);
+            if (len) {
+                sim_esp32_frame(frame, len, false, nullptr);
+                frames++;
+            }
+
+            // Real acquisition pacing; don't try to catch up after a stall
+            next += sim_stm32_record_us();
+            if (next < now) { next = now; late++; }
+        }
+
+        if (now >= reportAt) {
+            printf("♥ %u frames | %zu clients | %u late | %u Hz\n",
+                   frames, server.count(), late, sim_esp32_frequency());
+            reportAt += 10e6;
+        }
+
+        double wait = next - sim_now_us();
+        server.poll(wait > 0 ? (int)(wait / 1000) : 0);
+    }
+    return 0;
+}
+
+// ==================== MAIN ====================
+int main(int argc, char** argv) {
+    SimSourceConfig src = {SIM_WAVE_SQUARE, 2.0f, 1.65f, 0.02f, nullptr};
+    uint16_t port = 8080;
+    const char* www = "../esp32/data";
+    uint32_t bench = 0, freq = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!v) { fprintf(stderr, "Missing value for %s\n", a); return 2; }
+        i++;
+
+        if (!strcmp(a, "--port")) port = atoi(v);
+        else if (!strcmp(a, "--www")) www = v;
+        else if (!strcmp(a, "--bench")) bench = atoi(v);
+        else if (!strcmp(a, "--freq")) freq = atoi(v);
+        else if (!strcmp(a, "--vpp")) src.vpp = atof(v);
+        else if (!strcmp(a, "--noise")) src.noise_vpp = atof(v);
+        else if (!strcmp(a, "--input")) src.path = v;
+        else if (!strcmp(a, "--wave")) {
+            src.wave = !strcmp(v, "sine") ? SIM_WAVE_SINE :
+                       !strcmp(v, "triangle") ? SIM_WAVE_TRIANGLE : SIM_WAVE_SQUARE;
+        }
+        else { fprintf(stderr, "Unknown option %s\n", a); return 2; }
+    }
+
+    if (sim_stm32_init(&src) != 0) {
+        fprintf(stderr, "Cannot read %s\n", src.path);
+        return 1;
+    }
+    char cmd[16];
+    snprintf(cmd, sizeof(cmd), "F:%u", freq);
+    sim_stm32_command(cmd);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    if (bench) {
+        static SimServer idle;  // No clients: egress cost is the per-class build
+        sim_esp32_begin(&idle);
+        return runBench(bench, freq, src);
+    }
+    return runServer(port, www);
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rec_samples.h"
+#include "osc_frame.h"
+#include "sim_esp32.h"
+#include "sim_stm32.h"
+
+/*
+ * Recorder sample coding (rec_samples.cpp, what REC_FRAME records hold)
+ * over the traces the recorder sees and the ones that stress the varints:
+ * full-scale 16-bit steps (3 bytes each), 12-bit noise, noisy sines,
+ * flat lines and 0/0xFFFF alternation, from 0 to OSC_FRAME_MAX_SAMPLES
+ * samples. Every record must decode back exactly within the bound
+ * RECORD_MAX_PAYLOAD is sized for; cut and overlong ones must be refused.
+ */
+static uint16_t samples[OSC_FRAME_MAX_SAMPLES];
+static uint16_t decoded[OSC_FRAME_MAX_SAMPLES];
+static uint8_t coded[REC_SAMPLES_MAX_BYTES(OSC_FRAME_MAX_SAMPLES) + 4];
+
+enum { TRACE_FULL, TRACE_NOISE, TRACE_SINE, TRACE_FLAT, TRACE_ALTERNATE, TRACE_KINDS };
+
+static void fill(int kind, uint16_t n) {
+    double period = 8 + rand() % 400;
+    uint16_t level = rand() & 0xFFFF;
+    for (uint16_t i = 0; i < n; i++) {
+        switch (kind) {
+            case TRACE_FULL:  samples[i] = rand() & 0xFFFF; break;
+            case TRACE_NOISE: samples[i] = rand() % 4096; break;
+            case TRACE_SINE:  samples[i] = 2048 + (int)(1500 * sin(2 * M_PI * i / period)) + rand() % 16 - 8; break;
+            case TRACE_FLAT:  samples[i] = level; break;
+            default:          samples[i] = (i & 1) ? 0xFFFF : 0; break;
+        }
+    }
+}
+
+void sim_esp32_rec_check(SimRecCheck* t) {
+    static const uint16_t edges[] = {0, 1, OSC_FRAME_MAX_SAMPLES};
+    memset(t, 0, sizeof(*t));
+    srand(15);
+
+    for (uint32_t r = 0; r < 1000; r++) {
+        int kind = r % TRACE_KINDS;
+        uint16_t n = (r < 3 * TRACE_KINDS) ? edges[r / TRACE_KINDS] : 1 + rand() % OSC_FRAME_MAX_SAMPLES;
+        fill(kind, n);
+        size_t len = encodeSamples(samples, n, coded);
+        t->records++;
+        t->samples += n;
+
+        if (len > REC_SAMPLES_MAX_BYTES(n)) t->oversize++;
+        if (!decodeSamples(coded, coded + len, decoded, n) || memcmp(samples, decoded, 2u * n)) t->mismatches++;
+
+        // The record cut anywhere short of its length
+        if (len) {
+            t->cut++;
+            if (decodeSamples(coded, coded + rand() % len, decoded, n)) t->accepted++;
+        }
+    }
+
+    // A 4-byte varint (no delta needs more than 3)
+    static const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x01};
+    t->cut++;
+    if (decodeSamples(overlong, overlong + sizeof(overlong), decoded, 1)) t->accepted++;
+
+    // Bytes per sample and cost on the recorder's usual trace
+    fill(TRACE_SINE, OSC_FRAME_MAX_SAMPLES);
+    const int reps = 50;
+    size_t len = 0;
+    double t0 = sim_now_us();
+    for (int i = 0; i < reps; i++) len = encodeSamples(samples, OSC_FRAME_MAX_SAMPLES, coded);
+    double t1 = sim_now_us();
+    for (int i = 0; i < reps; i++) decodeSamples(coded, coded + len, decoded, OSC_FRAME_MAX_SAMPLES);
+    double t2 = sim_now_us();
+    t->sine_bytes = (double)len / OSC_FRAME_MAX_SAMPLES;
+    t->encode_ns = (t1 - t0) * 1000 / reps / OSC_FRAME_MAX_SAMPLES;
+    t->decode_ns = (t2 - t1) * 1000 / reps / OSC_FRAME_MAX_SAMPLES;
+}
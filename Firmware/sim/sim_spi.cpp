@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <string.h>
+#include "structures.h"
+#include "config.h"
+#include "sim_esp32.h"
+#include "sim_stm32.h"
+
+/*
+ * FrameAssembler (structures.cpp, the SPI task's reassembly) fed the
+ * chunk streams the STM32 produces and the ones a glitch leaves behind:
+ * frames split at OSC_FRAME_CHUNK_BYTES, frames whose last chunk never
+ * came or came short, a new header arriving mid-frame, stray
+ * continuations, corrupted and oversized headers. Every whole frame must
+ * come out byte for byte; every cut one must count as incomplete.
+ */
+static uint8_t stream[OSC_FRAME_MAX_BYTES + OSC_FRAME_CHUNK_BYTES];
+static uint8_t next[OSC_FRAME_MAX_BYTES + OSC_FRAME_CHUNK_BYTES];
+static uint8_t slot[FRAME_BUFFER_SIZE];
+static uint8_t dma[BUFFER_SIZE];
+
+static FrameAssembler assembler;
+static FrameStats stats;
+static SimSpiCheck* check;
+
+// Header with random fields and samples behind it; returns the frame length
+static size_t buildFrame(uint8_t* out, uint8_t flags, uint8_t peaks, uint16_t samples) {
+    OscFrameHeader h = {};
+    h.flags = flags;
+    h.sample_count = samples;
+    h.seq = rand();
+    h.sample_rate_hz = 500000;
+    h.num_peaks = peaks;
+    for (uint8_t i = 0; i < peaks; i++) h.peak_freqs[i] = rand();
+    h.rec_segments = 1;
+    size_t len = osc_frame_encode(&h, out);
+    for (uint32_t i = 0; i < 2u * samples; i++) out[len + i] = rand();
+    return len + 2u * samples;
+}
+
+// One SPI transaction; a completed frame must be expect[0, expectLen)
+static void feed(const uint8_t* chunk, size_t n, const uint8_t* expect, size_t expectLen) {
+    memcpy(dma, chunk, n);
+    check->chunks++;
+    bool done = assembler.add(slot, sizeof(slot), dma, n, stats);
+    if (done && expect && assembler.len == expectLen && !memcmp(slot, expect, expectLen)) check->delivered++;
+    else if (done || expect) check->wrong++;
+}
+
+static size_t chunkCount(size_t len) {
+    return (len + OSC_FRAME_CHUNK_BYTES - 1) / OSC_FRAME_CHUNK_BYTES;
+}
+
+// Chunks [first, last) of a frame as the STM32 splits it, the last of them
+// shortBy bytes short; due = the frame must come out on its final chunk
+static void feedChunks(const uint8_t* frame, size_t len, size_t first, size_t last,
+                       bool due, size_t shortBy = 0) {
+    for (size_t c = first; c < last; c++) {
+        size_t off = c * OSC_FRAME_CHUNK_BYTES;
+        size_t n = (len - off < OSC_FRAME_CHUNK_BYTES) ? len - off : OSC_FRAME_CHUNK_BYTES;
+        if (c == last - 1) n -= shortBy;
+        feed(frame + off, n, (due && c == chunkCount(len) - 1) ? frame : nullptr, len);
+    }
+}
+
+void sim_esp32_spi_check(SimSpiCheck* t) {
+    // Plain (72 B header), record (88 B) and 32-peak spectrum headers
+    static const struct { uint8_t flags, peaks; } layouts[] = {
+        {OSC_FRAME_MEAS | OSC_FRAME_TRIGGERED, 0},
+        {OSC_FRAME_RECORD | OSC_FRAME_WINDOW | OSC_FRAME_ENVELOPE, 0},
+        {OSC_FRAME_SPECTRUM | OSC_FRAME_MEAS, OSC_FRAME_MAX_PEAKS},
+    };
+    memset(t, 0, sizeof(*t));
+    memset(&stats, 0, sizeof(stats));
+    assembler.reset();
+    check = t;
+    srand(9);
+
+    double cleanUs = 0;
+    uint32_t cleanChunks = 0;
+    for (auto& l : layouts) {
+        size_t hlen = osc_frame_header_len(l.flags, l.peaks);
+        // Frames of one chunk, exactly one or two chunks, one sample past
+        // a boundary, and the full record
+        uint16_t counts[] = {0, 1, 100, (uint16_t)((OSC_FRAME_CHUNK_BYTES - hlen) / 2),
+                             (uint16_t)((OSC_FRAME_CHUNK_BYTES - hlen) / 2 + 1),
+                             (uint16_t)((2 * OSC_FRAME_CHUNK_BYTES - hlen) / 2), 4096, OSC_FRAME_MAX_SAMPLES};
+        for (uint16_t samples : counts) {
+            size_t len = buildFrame(stream, l.flags, l.peaks, samples);
+            size_t chunks = chunkCount(len);
+
+            // Clean
+            double t0 = sim_now_us();
+            feedChunks(stream, len, 0, chunks, true);
+            cleanUs += sim_now_us() - t0;
+            cleanChunks += chunks;
+            t->frames++;
+
+            // The next frame's header after every chunk short of the last,
+            // and after a last chunk that came in short (still holding the
+            // header, else it never opened a frame)
+            size_t lastLen = len - (chunks - 1) * OSC_FRAME_CHUNK_BYTES;
+            size_t room = (chunks == 1) ? lastLen - hlen : lastLen - 1;
+            for (size_t cut = 1; cut <= chunks; cut++) {
+                if (cut == chunks && !room) continue;
+                size_t shortBy = (cut == chunks) ? 1 + rand() % room : 0;
+                size_t nlen = buildFrame(next, l.flags, l.peaks, samples);
+                feedChunks(stream, len, 0, cut, false, shortBy);
+                feedChunks(next, nlen, 0, chunkCount(nlen), true);
+                t->cut++;
+                t->frames++;
+            }
+
+            // Continuations with no frame open, a header that fails its
+            // CRC (its continuations are stray too), then the frame intact
+            if (chunks > 1) {
+                feedChunks(stream, len, 1, chunks, false);
+                stream[8] ^= 0x10;
+                feedChunks(stream, len, 0, chunks, false);
+                stream[8] ^= 0x10;
+                t->rejected += 2 * chunks - 1;
+                feedChunks(stream, len, 0, chunks, true);
+                t->frames++;
+            }
+        }
+    }
+
+    // A valid header announcing more than a frame slot holds (a grown
+    // header in front of a full record): refused with its continuations
+    size_t len = buildFrame(stream, OSC_FRAME_MEAS, 0, OSC_FRAME_MAX_SAMPLES);
+    size_t grown = OSC_FRAME_HEADER_SIZE + 1024;
+    memmove(stream + grown, stream + OSC_FRAME_HEADER_SIZE, 2 * OSC_FRAME_MAX_SAMPLES);
+    memset(stream + OSC_FRAME_HEADER_SIZE - 2, 0, grown - OSC_FRAME_HEADER_SIZE + 2);
+    osc_put16(stream + 4, (uint16_t)grown);
+    osc_put16(stream + grown - 2, osc_crc16(stream, grown - 2));
+    len = grown + 2 * OSC_FRAME_MAX_SAMPLES;
+    feedChunks(stream, len, 0, chunkCount(len), false);
+    t->rejected += chunkCount(len);
+
+    t->incomplete = stats.incomplete;
+    t->refused = stats.syncErrors + stats.crcErrors;
+    t->chunk_us = cleanChunks ? cleanUs / cleanChunks : 0;
+}
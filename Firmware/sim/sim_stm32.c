@@ -0,0 +1,751 @@
+#include "sim_stm32.h"
+#include "osc_signal.h"
+#include "osc_frame.h"
+#include "osc_deep.h"
+#include "osc_pyramid.h"
+#include "osc_zoom.h"
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/* ==================== HOST CLOCK ==================== */
+static SimDwt dwt;
+
+double sim_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Host time in 100 MHz core cycles
+SimDwt *sim_dwt(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    dwt.CYCCNT = (uint32_t)((uint64_t)ts.tv_sec * 100000000ULL + ts.tv_nsec / 10);
+    return &dwt;
+}
+
+void Error_Handler(void) {
+    fprintf(stderr, "Error_Handler\n");
+    abort();
+}
+
+/* ==================== FIRMWARE STATE ==================== */
+// Mirrors the globals of Core/Src/main.c
+static OscSettings settings = DEFAULT_SETTINGS;
+static Measurements measurements;
+static uint8_t measurements_enabled = 0;
+static uint16_t display_buffer[OSC_FRAME_MAX_SAMPLES];
+static uint16_t display_count = DISPLAY_SAMPLES;
+static uint32_t actual_samples_captured = 0;
+static uint32_t frame_seq = 0;
+
+// I: requests queue in osc_deep.c; a single record stays frozen while it is being read
+static double window_hold_until = 0;
+
+// STOP halts on the next frame, which stays behind as the record
+static uint8_t acq_stop_pending = 0, acq_stopped = 0;
+
+/* ==================== SIGNAL SOURCE ==================== */
+static SimSourceConfig source;
+static uint16_t *recording = NULL;
+static size_t recording_len = 0, recording_pos = 0;
+static double phase = 0;                // Generator phase in cycles
+
+static uint16_t volts_to_code(float v) {
+    int code = (int)lroundf(v * 4095.0f / 3.3f);
+    return (code < 0) ? 0 : (code > 4095) ? 4095 : (uint16_t)code;
+}
+
+// Fill n samples at the current rate, continuing where the last record ended
+static void source_fill(uint16_t *dst, uint32_t n) {
+    if(recording) {
+        for(uint32_t i = 0; i < n; i++) {
+            dst[i] = recording[recording_pos] & 0x0FFF;
+            recording_pos = (recording_pos + 1) % recording_len;
+        }
+        return;
+    }
+
+    double step = (double)settings.generator_freq_hz / settings.sample_rate_hz;
+    float duty = settings.duty_cycle_percent / 100.0f;
+    for(uint32_t i = 0; i < n; i++) {
+        float x = (float)(phase - floor(phase)), y;
+        switch(source.wave) {
+            case SIM_WAVE_SINE:     y = 0.5f * sinf(2.0f * PI * x); break;
+            case SIM_WAVE_TRIANGLE: y = (x < 0.5f) ? 2.0f * x - 0.5f : 1.5f - 2.0f * x; break;
+            default:                y = (x < duty) ? 0.5f : -0.5f; break;
+        }
+        float noise = source.noise_vpp * ((float)rand() / RAND_MAX - 0.5f);
+        dst[i] = volts_to_code(source.offset_v + source.vpp * y + noise);
+        phase += step;
+    }
+    phase -= floor(phase);
+}
+
+/* ==================== SETTINGS ==================== */
+// Sample rate and frame size as apply_settings() computes them
+static void apply_settings(OscSettings *s) {
+    fft_set_scale(s->spectrum_db, s->db_ref_dbfs, s->db_floor_db);
+    fft_set_distortion(s->dist_harmonics);
+    fft_set_peaks(s->peak_count, s->peak_interp, s->peak_spacing_hz,
+                  s->peak_percentile, s->peak_margin_db);
+    uint8_t deep_segments = (s->display_mode == DISPLAY_TIME) ? s->deep_segments : 0;
+    uint32_t record = (deep_segments == 1) ? ACQ_MEMORY_SAMPLES :
+                      s->continuous_acq ? ADC_BUFFER_SIZE / 2 : ADC_BUFFER_SIZE;
+    if(deep_segments > 1 && record > deep_capacity(deep_segments))
+        record = deep_capacity(deep_segments);
+    uint8_t welch = (s->display_mode == DISPLAY_FREQ && s->welch_segments && !s->zoom_span_hz);
+    uint64_t window_us = (uint64_t)s->time_div_us * 10;
+    uint32_t target_rate, samples_needed;
+
+    if(s->display_mode == DISPLAY_FREQ) {
+        target_rate = SR_FFT_MODE;
+        samples_needed = welch ? WELCH_RECORD : FFT_SIZE;
+    } else {
+        target_rate = window_us ? (record * 1000000ULL / window_us) : SR_TIME_MODE_MAX;
+        if(target_rate > SR_TIME_MODE_MAX) target_rate = SR_TIME_MODE_MAX;
+        if(target_rate < 10) target_rate = 10;
+        samples_needed = (target_rate * window_us) / 1000000ULL;
+        if(samples_needed > record) samples_needed = record;
+        if(samples_needed < DISPLAY_SAMPLES) samples_needed = DISPLAY_SAMPLES;
+    }
+
+    s->sample_rate_hz = target_rate;
+    actual_samples_captured = samples_needed;
+    zoom_configure(s->zoom_center_hz, (s->display_mode == DISPLAY_FREQ) ? s->zoom_span_hz : 0, target_rate);
+
+    uint32_t frame_max = (s->display_mode == DISPLAY_FREQ) ? FFT_SIZE / 2 : samples_needed;
+    if(frame_max > OSC_FRAME_MAX_SAMPLES) frame_max = OSC_FRAME_MAX_SAMPLES;
+    display_count = (s->frame_samples && s->frame_samples < frame_max) ? s->frame_samples : frame_max;
+    display_count &= ~1u;
+
+    deep_configure(deep_segments, samples_needed);
+    window_hold_until = 0;
+    acq_stop_pending |= acq_stopped;
+    acq_stopped = 0;
+}
+
+int sim_stm32_init(const SimSourceConfig *src) {
+    source = *src;
+
+    if(src->path) {
+        FILE *f = fopen(src->path, "rb");
+        if(!f) return -1;
+        fseek(f, 0, SEEK_END);
+        recording_len = ftell(f) / 2;
+        fseek(f, 0, SEEK_SET);
+        recording = malloc(recording_len * 2);
+        if(!recording_len || !recording ||
+           fread(recording, 2, recording_len, f) != recording_len) {
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+    }
+
+    settings = (OscSettings)DEFAULT_SETTINGS;
+    init_fft(settings.fft_window);
+    reset_measurement_filter();
+    apply_settings(&settings);
+    return 0;
+}
+
+/* ==================== COMMANDS ==================== */
+void sim_stm32_command(const char *cmd) {
+    if(!cmd || !cmd[0]) return;
+
+    int val = (cmd[1] == ':') ? atoi(&cmd[2]) : 0;
+
+    switch(cmd[0]) {
+        case 'T': settings.time_div_us = val; break;
+        case 'F': settings.generator_freq_hz = val; break;
+        case 'D':
+            if(cmd[1] == 'B') {
+                if(cmd[2] != ':') return;
+                const char *ref = strchr(&cmd[3], ',');
+                const char *lo = ref ? strchr(ref + 1, ',') : NULL;
+                settings.spectrum_db = (atoi(&cmd[3]) != 0);
+                if(ref) {
+                    int r = atoi(ref + 1);
+                    settings.db_ref_dbfs = (r < -100) ? -100 : (r > 100) ? 100 : r;
+                }
+                if(lo) {
+                    int f = atoi(lo + 1);
+                    settings.db_floor_db = (f < -300) ? -300 : (f > -10) ? -10 : f;
+                }
+                fft_set_scale(settings.spectrum_db, settings.db_ref_dbfs, settings.db_floor_db);
+                return;
+            }
+            if(cmd[1] == 'H') {
+                int n = (cmd[2] == ':') ? atoi(&cmd[3]) : 0;
+                settings.dist_harmonics = (n < 0) ? 0 : (n > DIST_MAX_HARMONICS) ? DIST_MAX_HARMONICS : n;
+                fft_set_distortion(settings.dist_harmonics);
+                return;
+            }
+            if(cmd[1] == 'P') {
+                if(cmd[2] != ':') return;
+                const char *f[4] = {NULL};
+                f[0] = strchr(&cmd[3], ',');
+                for(int i = 1; i < 4 && f[i-1]; i++) f[i] = strchr(f[i-1] + 1, ',');
+                int k = atoi(&cmd[3]);
+                settings.peak_count = (k < 1) ? 1 : (k > MAX_PEAKS) ? MAX_PEAKS : k;
+                if(f[0]) {
+                    int v = atoi(f[0] + 1);
+                    settings.peak_interp = (v < 0 || v > PEAK_JACOBSEN) ? PEAK_JACOBSEN : (PeakInterp)v;
+                }
+                if(f[1]) {
+                    int v = atoi(f[1] + 1);
+                    settings.peak_spacing_hz = (v < 0) ? 0 : (v > 65535) ? 65535 : v;
+                }
+                if(f[2]) {
+                    int v = atoi(f[2] + 1);
+                    settings.peak_percentile = (v < 0) ? 0 : (v > 100) ? 100 : v;
+                }
+                if(f[3]) {
+                    int v = atoi(f[3] + 1);
+                    settings.peak_margin_db = (v < -60) ? -60 : (v > 60) ? 60 : v;
+                }
+                fft_set_peaks(settings.peak_count, settings.peak_interp, settings.peak_spacing_hz,
+                              settings.peak_percentile, settings.peak_margin_db);
+                return;
+            }
+            settings.duty_cycle_percent = (val < 1) ? 1 : (val > 99) ? 99 : val;
+            break;
+        case 'M': if(val <= MODE_ENVELOPE) settings.mode = (ScopeMode)val; break;
+        case 'A': settings.continuous_acq = (val != 0); break;
+        case 'X':
+            if(val > 1) return;
+            settings.display_mode = (DisplayMode)val;
+            fft_frame_count = 0;
+            break;
+        case 'N':
+            if(val <= WIN_FLATTOP) {
+                settings.fft_window = (FftWindow)val;
+                fft_set_window(settings.fft_window);
+            }
+            return;
+        case 'Z':
+            settings.frame_samples = (val <= 0 || val >= OSC_FRAME_MAX_SAMPLES) ? 0 :
+                                     (val < 64) ? 64 : val;
+            break;
+        case 'C': {
+            const char *span = strchr(&cmd[2], ',');
+            settings.zoom_center_hz = (val < 0) ? 0 : val;
+            settings.zoom_span_hz = (span && atoi(span + 1) > 0) ? atoi(span + 1) : 0;
+            fft_frame_count = 0;
+            break;
+        }
+        case 'U': {
+            const char *overlap = strchr(&cmd[2], ',');
+            settings.welch_segments = (val < 0) ? 0 : (val > WELCH_MAX_SEGMENTS) ? WELCH_MAX_SEGMENTS : val;
+            if(overlap) {
+                int ov = atoi(overlap + 1);
+                settings.welch_overlap = (ov < 0) ? 0 : (ov > WELCH_MAX_OVERLAP) ? WELCH_MAX_OVERLAP : ov;
+            }
+            fft_frame_count = 0;
+            break;
+        }
+        case 'E': measurements_enabled = (cmd[2] == '1'); break;
+        case 'K':
+            settings.deep_segments = (val < 0) ? 0 : (val > DEEP_MAX_SEGMENTS) ? DEEP_MAX_SEGMENTS : val;
+            break;
+        case 'I': {
+            deep_request(&cmd[2], DISPLAY_SAMPLES, settings.mode);
+            window_hold_until = sim_now_us() + DEEP_HOLD_MS * 1000.0;
+            return;
+        }
+        case 'R':
+            if(strcmp(cmd, "RUN") == 0) {
+                acq_stop_pending = 0;
+                if(!acq_stopped) return;
+                acq_stopped = 0;
+                break;
+            }
+            if(strcmp(cmd, "RESET") != 0) return;
+            settings = (OscSettings)DEFAULT_SETTINGS;
+            fft_frame_count = 0;
+            break;
+        case 'S':
+            if(strcmp(cmd, "STOP") == 0 && !acq_stopped) acq_stop_pending = 1;
+            return;
+        default:
+            return;  // Trigger, benchmark, profiling and Q are not simulated
+    }
+
+    reset_measurement_filter();
+    apply_settings(&settings);
+}
+
+uint32_t sim_stm32_record_us(void) {
+    return (uint32_t)((uint64_t)actual_samples_captured * 1000000ULL / settings.sample_rate_hz);
+}
+
+/* ==================== FRAME ==================== */
+// Header (with the record extension when flagged) followed by the samples
+static size_t encode_frame(uint8_t *out, uint8_t flags, const uint16_t *samples, uint16_t count,
+                           uint32_t rec_start, uint32_t rec_span, uint8_t rec_tag) {
+    OscFrameHeader h = {
+        .flags = flags,
+        .sample_count = count,
+        .seq = frame_seq++,
+        .sample_rate_hz = settings.sample_rate_hz
+    };
+    if(flags & OSC_FRAME_MEAS) {
+        h.amplitude_mv = measurements.amplitude_mv;
+        h.period_us = measurements.period_us;
+        h.vrms_mv = measurements.vrms_mv;
+        h.duty_percent = measurements.duty_percent;
+        h.vmax_mv = measurements.vmax_mv;
+        h.vmin_mv = measurements.vmin_mv;
+        h.frequency_hz = measurements.frequency_hz;
+        h.num_peaks = measurements.num_peaks;
+        for(uint8_t i = 0; i < OSC_FRAME_MAX_PEAKS; i++) {
+            h.peak_freqs[i] = measurements.peak_freqs[i];
+            h.peak_mags[i] = measurements.peak_mags[i];
+        }
+        h.psd_segments = measurements.psd_segments;
+        h.psd_overlap = measurements.psd_overlap;
+        h.psd_tone_cdbfs = measurements.psd_tone_cdbfs;
+        h.psd_floor_cdbfs = measurements.psd_floor_cdbfs;
+        h.dist_harmonics = measurements.dist_harmonics;
+        h.thd_cdb = measurements.thd_cdb;
+        h.thdn_cdb = measurements.thdn_cdb;
+        h.snr_cdb = measurements.snr_cdb;
+        h.sfdr_cdb = measurements.sfdr_cdb;
+        h.enob_cbits = measurements.enob_cbits;
+    }
+    if(flags & OSC_FRAME_ZOOM) {
+        h.zoom_center_hz = zoom_band()->center_hz;
+        h.zoom_log2 = zoom_band()->log2;
+    }
+    if(flags & OSC_FRAME_SPECTRUM) {
+        h.db_scale = settings.spectrum_db ? OSC_FRAME_SCALE_DB : OSC_FRAME_SCALE_LINEAR;
+        h.db_ref_cdbfs = settings.db_ref_dbfs * 100;
+        h.db_floor_cdb = settings.db_floor_db * 100;
+    }
+    if(flags & OSC_FRAME_RECORD) {
+        const DeepRecord *rec = deep_record();
+        h.rec_start = rec_start;
+        h.rec_span = rec_span;
+        h.rec_total = rec->total;
+        h.rec_id = rec->id;
+        h.rec_segments = rec->segments;
+        h.rec_filled = rec->filled;
+        h.rec_tag = rec_tag;
+    }
+    size_t len = osc_frame_encode(&h, out);
+    memcpy(out + len, samples, count * sizeof(uint16_t));
+    return len + count * sizeof(uint16_t);
+}
+
+size_t sim_stm32_frame(uint8_t *out, SimStm32Times *t) {
+    // The firmware doesn't re-arm the ADC while stopped or while a client
+    // reads a single record
+    if(acq_stopped) return 0;
+    if(deep_record()->segments == 1 && sim_now_us() < window_hold_until) return 0;
+
+    uint16_t *frame = adc_buffer;
+    source_fill(frame, actual_samples_captured);
+
+    // Zoom-FFT: each record is the next ADC half of the stream; a spectrum
+    // only comes out every ZOOM_HOP decimated outputs
+    double t0 = sim_now_us();
+    uint8_t zoom = (zoom_band()->decimation != 0);
+    if(zoom) {
+        zoom_feed(frame, actual_samples_captured);
+        if(!zoom_ready()) {
+            if(t) { t->measure_us = sim_now_us() - t0; t->encode_us = t->fft_us = t->distortion_us = t->peaks_us = 0; }
+            return 0;
+        }
+        measure_zoom_domain(display_buffer, display_count, &measurements);
+    } else if(settings.display_mode == DISPLAY_FREQ && settings.welch_segments) {
+        // Welch: one-shot records until the segment count is reached
+        if(!measure_welch_domain(frame, actual_samples_captured, settings.sample_rate_hz,
+                                 settings.welch_segments, settings.welch_overlap,
+                                 display_buffer, display_count, &measurements)) {
+            if(t) { t->measure_us = sim_now_us() - t0; t->encode_us = t->fft_us = t->distortion_us = t->peaks_us = 0; }
+            return 0;
+        }
+    } else if(settings.display_mode == DISPLAY_FREQ) {
+        measure_freq_domain(frame, settings.sample_rate_hz,
+                            display_buffer, display_count, &measurements);
+    } else {
+        measure_time_domain(frame, actual_samples_captured,
+                            settings.sample_rate_hz, &measurements);
+        pyramid_decimate(frame, actual_samples_captured,
+                         display_buffer, display_count, settings.mode);
+    }
+    double t1 = sim_now_us();
+    uint8_t recorded = deep_store(frame, actual_samples_captured);
+    if(acq_stop_pending) {
+        acq_stop_pending = 0;
+        acq_stopped = 1;
+        if(settings.display_mode == DISPLAY_TIME) recorded |= deep_retain(frame, actual_samples_captured);
+    }
+
+    uint8_t flags = (settings.display_mode == DISPLAY_FREQ) ? OSC_FRAME_SPECTRUM : 0;
+    if(settings.display_mode == DISPLAY_TIME && settings.mode == MODE_ENVELOPE)
+        flags |= OSC_FRAME_ENVELOPE;
+    if(zoom) flags |= OSC_FRAME_ZOOM;
+    if((measurements_enabled || settings.display_mode == DISPLAY_FREQ) && measurements.valid)
+        flags |= OSC_FRAME_MEAS;
+
+    const DeepRecord *rec = deep_record();
+    uint32_t rec_span = recorded ? rec->segment_len : 0;
+    if(rec->segments || rec->total) flags |= OSC_FRAME_RECORD;
+    size_t len = encode_frame(out, flags, display_buffer, display_count,
+                              recorded ? rec->total - rec_span : 0, rec_span, 0);
+
+    if(t) {
+        t->measure_us = t1 - t0;
+        t->encode_us = sim_now_us() - t1;
+        t->fft_us = fft_cycles.fft / 100.0;
+        t->distortion_us = fft_cycles.distortion / 100.0;
+        t->peaks_us = fft_cycles.peaks / 100.0;
+    }
+    return len;
+}
+
+/* ==================== ZOOM BENCH ==================== */
+void sim_stm32_zoom(uint32_t start, uint32_t span, uint16_t points, uint8_t mode,
+                    uint32_t reps, SimZoomTimes *t) {
+    static uint16_t brute[OSC_FRAME_MAX_SAMPLES], pyramid[OSC_FRAME_MAX_SAMPLES];
+    uint16_t *src = deep_record()->base + start;
+    uint16_t values = (mode == MODE_ENVELOPE) ? points * 2 : points;
+
+    double t0 = sim_now_us();
+    for(uint32_t i = 0; i < reps; i++)
+        decimate_samples(src, span, brute, values, (ScopeMode)mode);
+    double t1 = sim_now_us();
+    for(uint32_t i = 0; i < reps; i++)
+        pyramid_decimate(src, span, pyramid, values, (ScopeMode)mode);
+    double t2 = sim_now_us();
+
+    t->brute_us = (t1 - t0) / reps;
+    t->pyramid_us = (t2 - t1) / reps;
+    t->match = memcmp(brute, pyramid, values * sizeof(uint16_t)) == 0;
+    t->indexed = pyramid_indexed(span, values, (ScopeMode)mode);
+}
+
+void sim_stm32_db_check(uint32_t points, SimDbCheck *t) {
+    static float x[4096];
+    if(points > 4096) points = 4096;
+    if(points < 2) points = 2;
+
+    // Log-spaced over 1e-7..1e9 of full scale, plus the float just below
+    // each power of two, where the exponent split hands over
+    for(uint32_t i = 0; i < points; i++)
+        x[i] = powf(10.0f, -7.0f + 16.0f * i / (points - 1));
+    t->max_err_db = 0;
+    for(uint32_t i = 0; i < points; i++) {
+        float err = fabsf(fast_db20(x[i]) - 20.0f * log10f(x[i]));
+        float below = nextafterf(ldexpf(1.0f, (int)i % 64 - 32), 0.0f);
+        float err2 = fabsf(fast_db20(below) - 20.0f * log10f(below));
+        if(err > t->max_err_db) t->max_err_db = err;
+        if(err2 > t->max_err_db) t->max_err_db = err2;
+    }
+
+    const uint32_t reps = 200;
+    volatile float sink = 0;
+    double t0 = sim_now_us();
+    for(uint32_t r = 0; r < reps; r++)
+        for(uint32_t i = 0; i < points; i++) sink += fast_db20(x[i]);
+    double t1 = sim_now_us();
+    for(uint32_t r = 0; r < reps; r++)
+        for(uint32_t i = 0; i < points; i++) sink += 20.0f * log10f(x[i]);
+    double t2 = sim_now_us();
+    (void)sink;
+
+    t->fast_ns = (t1 - t0) * 1000.0 / ((double)reps * points);
+    t->ref_ns = (t2 - t1) * 1000.0 / ((double)reps * points);
+}
+
+size_t sim_stm32_window(uint8_t *out) {
+    DeepWindowRequest req;
+    if(!deep_next_request(&req)) return 0;
+
+    uint32_t start = req.start, span = req.span;
+    uint16_t count = deep_window(&start, &span, display_buffer, req.points, req.mode);
+    uint8_t flags = OSC_FRAME_RECORD | OSC_FRAME_WINDOW;
+    if(req.mode == MODE_ENVELOPE) flags |= OSC_FRAME_ENVELOPE;
+    return encode_frame(out, flags, display_buffer, count, start, span, req.tag);
+}
+
+/* ==================== DEEP WINDOW CHECK ==================== */
+// One I: request against the record: clamping as deep_window documents it,
+// samples as the brute-force decimation of the slice (raw when unreduced)
+static void deep_check_window(SimDeepCheck *t, uint8_t *frame, uint32_t start, uint32_t span,
+                              uint32_t points, uint32_t mode) {
+    static uint16_t ref[OSC_FRAME_MAX_SAMPLES];
+    const DeepRecord *rec = deep_record();
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "I:%u,%u,%u,%u", start, span, points, mode);
+    sim_stm32_command(cmd);
+
+    double t0 = sim_now_us();
+    size_t len = sim_stm32_window(frame);
+    t->window_us += sim_now_us() - t0;
+    t->windows++;
+
+    ScopeMode m = (mode <= MODE_ENVELOPE) ? (ScopeMode)mode : MODE_NORMAL;
+    uint32_t max = (m == MODE_ENVELOPE) ? OSC_FRAME_MAX_SAMPLES / 2 : OSC_FRAME_MAX_SAMPLES;
+    if(points < 2) points = 2;
+    if(points > max) points = max;
+    if(!rec->total) {
+        start = span = points = 0;
+    } else {
+        if(start >= rec->total) start = rec->total - 1;
+        if(!span || span > rec->total - start) span = rec->total - start;
+        if(span > UINT16_MAX) span = UINT16_MAX;
+        if(points > span) points = span;
+    }
+    uint16_t values = (m == MODE_ENVELOPE) ? points * 2 : points;
+
+    OscFrameHeader h;
+    uint8_t flags = OSC_FRAME_RECORD | OSC_FRAME_WINDOW | ((m == MODE_ENVELOPE) ? OSC_FRAME_ENVELOPE : 0);
+    if(osc_frame_decode(frame, len, &h) != OSC_FRAME_OK || h.flags != flags ||
+       h.rec_start != start || h.rec_span != span || h.sample_count != values ||
+       len != h.header_len + values * sizeof(uint16_t) || h.rec_total != rec->total ||
+       h.rec_id != rec->id || h.rec_segments != rec->segments || h.rec_filled != rec->filled) {
+        t->header_errors++;
+        return;
+    }
+
+    const uint16_t *got = (const uint16_t*)(frame + h.header_len);
+    const uint16_t *want = ref;
+    if(m == MODE_NORMAL && points == span) want = rec->base + start;
+    else decimate_samples(rec->base + start, span, ref, values, m);
+    for(uint16_t i = 0; i < values; i++)
+        if(got[i] != want[i]) t->mismatches++;
+}
+
+void sim_stm32_deep_check(SimDeepCheck *t) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    static const uint8_t layouts[] = {1, 4, DEEP_MAX_SEGMENTS};
+    memset(t, 0, sizeof(*t));
+    srand(18);
+
+    const char *setup[] = {"X:0", "T:5000", "M:0", "Z:0"};
+    for(unsigned i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) sim_stm32_command(setup[i]);
+
+    for(unsigned l = 0; l < sizeof(layouts); l++) {
+        char cmd[16];
+        snprintf(cmd, sizeof(cmd), "K:%u", layouts[l]);
+        sim_stm32_command(cmd);
+        const DeepRecord *rec = deep_record();
+        for(int i = 0; i < 256 && rec->filled < rec->segments; i++) sim_stm32_frame(frame, NULL);
+        if(!rec->total || rec->filled != rec->segments) {
+            t->header_errors++;
+            continue;
+        }
+        if(rec->segments == 1) t->single_total = rec->total;
+
+        uint32_t total = rec->total;
+        // Edges: the whole record, its last sample, past the end, one sample per point
+        deep_check_window(t, frame, 0, 0, 512, MODE_ENVELOPE);
+        deep_check_window(t, frame, total - 1, 0, 512, MODE_NORMAL);
+        deep_check_window(t, frame, total + 1000, 5, 2, MODE_PEAK_DETECT);
+        deep_check_window(t, frame, total / 3, total, 1024, MODE_AVERAGE);
+        deep_check_window(t, frame, total / 2, 300, 300, MODE_NORMAL);
+        deep_check_window(t, frame, 17, 100, OSC_FRAME_MAX_SAMPLES, MODE_ENVELOPE);
+        deep_check_window(t, frame, 5, 1000, 0, 7);
+
+        for(int i = 0; i < 400; i++) {
+            uint32_t start = (uint32_t)rand() % (total + total / 8);
+            uint32_t r = (uint32_t)rand() % 8;
+            uint32_t span = (r == 0) ? 0 : (r == 1) ? total + (uint32_t)rand() % 1000 :
+                            1 + (uint32_t)rand() % ((r == 2) ? 64 : total);
+            uint32_t points = (uint32_t)rand() % 4 ? 2 + (uint32_t)rand() % 2048 : (uint32_t)rand() % (OSC_FRAME_MAX_SAMPLES + 100);
+            deep_check_window(t, frame, start, span, points, (uint32_t)rand() % 5);
+        }
+    }
+
+    // No record: an empty window, not a stale one
+    sim_stm32_command("K:0");
+    deep_check_window(t, frame, 0, 0, 256, MODE_NORMAL);
+    if(t->windows) t->window_us /= t->windows;
+}
+
+/* ==================== ZOOM-FFT CHECK ==================== */
+// Absolute level of a dB-scale spectrum code
+static double spectrum_dbfs(const OscFrameHeader *h, uint16_t code) {
+    return (h->db_ref_cdbfs + h->db_floor_cdb) / 100.0 + code * OSC_FRAME_DB_PER_LSB;
+}
+
+// One band with the generator at gen_hz, run until the ring has filled and
+// the average settled: the header against the band zoom_configure
+// documents, then the tone where it belongs (in band) or the strongest bin
+// as far under the tone level as the decimators promise (out of band)
+static void zfft_check_band(SimZfftCheck *t, uint8_t *frame, uint32_t gen_hz,
+                            uint32_t center, uint32_t span, double tone_dbfs) {
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "F:%u", gen_hz);
+    sim_stm32_command(cmd);
+    snprintf(cmd, sizeof(cmd), "C:%u,%u", center, span);
+    sim_stm32_command(cmd);
+    t->bands++;
+
+    OscFrameHeader h = {0};
+    uint32_t spectra = 0;
+    for(uint32_t halves = 0; halves < 8192 && spectra < 12; halves++) {
+        size_t len = sim_stm32_frame(frame, NULL);
+        if(len && osc_frame_decode(frame, len, &h) == OSC_FRAME_OK) spectra++;
+    }
+
+    uint32_t fs = SR_FFT_MODE;
+    uint8_t log2 = 2;
+    while(log2 < 12 && (fs >> (log2 + 1)) >= span) log2++;
+    uint32_t half_band = (fs >> log2) / 2;
+    if(center < half_band) center = half_band;
+    if(center > fs / 2 - half_band) center = fs / 2 - half_band;
+    if(spectra < 12 || !(h.flags & OSC_FRAME_ZOOM) || h.sample_rate_hz != fs || h.db_scale != OSC_FRAME_SCALE_DB ||
+       h.zoom_log2 != log2 || h.zoom_center_hz != center) {
+        t->band_errors++;
+        return;
+    }
+
+    double bin_hz = (double)(fs >> log2) / ZOOM_BINS;
+    if(gen_hz + half_band > center && gen_hz < center + half_band) {
+        double err = h.num_peaks ? fabs(h.peak_freqs[0] / 1000.0 - gen_hz) / bin_hz : 1e9;
+        double level = h.num_peaks ? fabs(spectrum_dbfs(&h, h.peak_mags[0]) - tone_dbfs) : 1e9;
+        if(err > t->worst_bins) t->worst_bins = err;
+        if(level > t->worst_level_db) t->worst_level_db = level;
+        if(err > 1.0 || level > 2.0) t->misplaced++;
+        return;
+    }
+
+    const uint16_t *bins = (const uint16_t*)(frame + h.header_len);
+    uint16_t top = 0;
+    for(uint16_t i = 0; i < h.sample_count; i++)
+        if(bins[i] > top) top = bins[i];
+    double rejection = tone_dbfs - spectrum_dbfs(&h, top);
+    if(rejection < t->rejection_db) t->rejection_db = rejection;
+    if(rejection < SIM_ZFFT_REJECT_DB) t->leaks++;
+}
+
+void sim_stm32_zfft_check(SimZfftCheck *t) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    // gen, centre, span: off-centre, narrowest band, high band, out of band,
+    // clamped at DC and Nyquist (the generator stops at 65535 Hz)
+    static const uint32_t fixed[][3] = {
+        {1100, 1000, 250}, {1050, 1000, 250}, {900, 1000, 250}, {1003, 1000, 10},
+        {20500, 20000, 2000}, {1400, 1000, 250}, {1000, 5000, 2000}, {100, 50, 250},
+        {1000, 249900, 4000},
+    };
+    SimSourceConfig saved = source;
+    uint32_t saved_freq = settings.generator_freq_hz;
+    memset(t, 0, sizeof(*t));
+    t->rejection_db = 1e9;
+    srand(21);
+
+    source = (SimSourceConfig){SIM_WAVE_SINE, 2.0f, 1.65f, 0.02f, NULL};
+    double tone_dbfs = 20 * log10(source.vpp / 3.3);
+    sim_stm32_command("X:1");
+    sim_stm32_command("Z:0");
+
+    for(unsigned i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+        zfft_check_band(t, frame, fixed[i][0], fixed[i][1], fixed[i][2], tone_dbfs);
+
+    // Random bands of 1/8..1/2048 (1/4096 is the fixed 10 Hz one), the tone
+    // inside (within 0.4 of the band) or at least 0.75 of it away, where
+    // its image would fall back into view
+    for(int i = 0; i < 16; i++) {
+        uint32_t span = (uint32_t)(128 * pow(250.0, (double)rand() / RAND_MAX));
+        uint32_t center = 1000 + (uint32_t)rand() % 64000;
+        uint32_t fs = SR_FFT_MODE, rate = fs / 4;
+        while(rate > fs / 4096 && rate / 2 >= span) rate /= 2;
+        if(center < rate / 2) center = rate / 2;
+        if(center > fs / 2 - rate / 2) center = fs / 2 - rate / 2;
+        double offset = (i & 1) ? (0.75 + 2.0 * rand() / RAND_MAX) * rate : (0.8 * rand() / RAND_MAX - 0.4) * rate;
+        if(rand() & 1) offset = -offset;
+        double gen = center + offset;
+        if(gen < 100 || gen > 65000) gen = center;
+        zfft_check_band(t, frame, (uint32_t)gen, center, span, tone_dbfs);
+    }
+
+    // Zoom off: full-band spectra again
+    OscFrameHeader h = {0};
+    sim_stm32_command("C:0");
+    size_t len = 0;
+    for(int i = 0; i < 8 && !len; i++) len = sim_stm32_frame(frame, NULL);
+    if(!len || osc_frame_decode(frame, len, &h) != OSC_FRAME_OK || (h.flags & OSC_FRAME_ZOOM)) t->band_errors++;
+
+    char cmd[16];
+    snprintf(cmd, sizeof(cmd), "F:%u", saved_freq);
+    sim_stm32_command(cmd);
+    source = saved;
+}
+
+/* ==================== WELCH CHECK ==================== */
+// One estimate from scratch: the records it takes, the header's segment
+// layout, and its tone and density against what the source puts in
+static void welch_check_estimate(SimWelchCheck *t, uint8_t *frame, uint32_t segments, uint32_t overlap) {
+    char cmd[16];
+    snprintf(cmd, sizeof(cmd), "U:%u,%u", segments, overlap);
+    sim_stm32_command(cmd);
+
+    OscFrameHeader h;
+    size_t len = 0;
+    uint32_t records = 0;
+    while(!len && records < 2 * WELCH_MAX_SEGMENTS) {
+        len = sim_stm32_frame(frame, NULL);
+        records++;
+    }
+    t->estimates++;
+
+    uint32_t hop = FFT_SIZE - (FFT_SIZE * overlap) / 100;
+    uint32_t per_record = (WELCH_RECORD - FFT_SIZE) / hop + 1;
+    if(!len || osc_frame_decode(frame, len, &h) != OSC_FRAME_OK || h.psd_segments != segments ||
+       h.psd_overlap != overlap || records != (segments + per_record - 1) / per_record) {
+        t->header_errors++;
+        return;
+    }
+
+    // Full scale is a 3.3 Vpp sine; uniform noise and the code step spread
+    // over 0..fs/2 (density relative to its power)
+    double lsb = 3.3 / 4096, full_scale = 3.3 * 3.3 / 8;
+    double noise = source.noise_vpp * source.noise_vpp / 12 + lsb * lsb / 12;
+    double tone = fabs(h.psd_tone_cdbfs / 100.0 - 20 * log10(source.vpp / 3.3));
+    double floor = fabs(h.psd_floor_cdbfs / 100.0 - 10 * log10(noise / (h.sample_rate_hz / 2.0) / full_scale));
+    if(tone > t->worst_tone_db) t->worst_tone_db = tone;
+    if(floor > t->worst_floor_db) t->worst_floor_db = floor;
+    if(tone > 0.1 || floor > 0.5) t->level_errors++;
+}
+
+void sim_stm32_welch_check(SimWelchCheck *t) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    static const uint8_t layouts[][2] = {{1, 0}, {3, 50}, {8, 50}, {8, 75}, {13, 0}, {WELCH_MAX_SEGMENTS, 75}};
+    SimSourceConfig saved = source;
+    FftWindow saved_window = settings.fft_window;
+    memset(t, 0, sizeof(*t));
+
+    // A sine 24 dB under full scale: the sidelobes of a louder one lift
+    // Hamming's median bin by half a dB
+    source = (SimSourceConfig){SIM_WAVE_SINE, 0.2f, 1.65f, 0.02f, NULL};
+    sim_stm32_command("X:1");
+    sim_stm32_command("Z:0");
+    for(int w = WIN_HANN; w <= WIN_FLATTOP; w++) {
+        char cmd[8];
+        snprintf(cmd, sizeof(cmd), "N:%d", w);
+        sim_stm32_command(cmd);
+        for(unsigned i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+            welch_check_estimate(t, frame, layouts[i][0], layouts[i][1]);
+    }
+
+    // Flat-top: full scale, and the density 20 dB higher under 2 Vpp
+    source.vpp = 3.3f;
+    welch_check_estimate(t, frame, 8, 50);
+    source.vpp = 2.0f;
+    source.noise_vpp = 0.2f;
+    welch_check_estimate(t, frame, 8, 50);
+
+    char cmd[8];
+    snprintf(cmd, sizeof(cmd), "N:%d", saved_window);
+    sim_stm32_command(cmd);
+    sim_stm32_command("U:0");
+    source = saved;
+}
@@ -0,0 +1,146 @@
+#ifndef SIM_STM32_H
+#define SIM_STM32_H
+
+/*
+ * STM32 half of the simulator: a synthetic or recorded ADC stream run
+ * through the real osc_signal.c and packed with osc_frame.h, following
+ * the acquisition loop in Core/Src/main.c (continuous mode, no trigger).
+ * The trigger engine runs separately against an emulated ADC (sim_trigger.c).
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SIM_WAVE_SQUARE = 0,        // Internal PWM generator (self-test wiring)
+    SIM_WAVE_SINE,
+    SIM_WAVE_TRIANGLE
+} SimWave;
+
+typedef struct {
+    SimWave wave;
+    float vpp;                  // Peak-to-peak at the ADC pin
+    float offset_v;             // DC level at the ADC pin
+    float noise_vpp;            // Uniform noise
+    const char *path;           // Raw little-endian uint16 ADC codes, looped (NULL = synthetic)
+} SimSourceConfig;
+
+typedef struct {
+    double measure_us;          // measure_* and decimate_samples
+    double encode_us;           // Header encode + sample copy
+    double fft_us;              // Spectra: the transforms behind the frame (fft_cycles)
+    double distortion_us;       // Spectra: THD/SNR analysis
+    double peaks_us;            // Spectra: peak search + display spectrum
+} SimStm32Times;
+
+typedef struct {
+    double brute_us;            // decimate_samples over the raw samples
+    double pyramid_us;          // pyramid_decimate over the index
+    uint8_t match;              // Both produced the same output
+    uint8_t indexed;            // pyramid_decimate read blocks, not samples
+} SimZoomTimes;
+
+typedef struct {
+    uint32_t windows;           // I: requests answered
+    uint32_t mismatches;        // Samples not decimate_samples over the clamped record slice
+    uint32_t header_errors;     // Flags, clamped start/span, count or record fields wrong
+    uint32_t single_total;      // K:1 record length
+    double window_us;           // Per window
+} SimDeepCheck;
+
+typedef struct {
+    uint32_t bands;             // C: bands run to a settled spectrum
+    uint32_t band_errors;       // Centre or decimation not the band zoom_configure documents
+    uint32_t misplaced;         // In-band tone missing, more than a bin or 2 dB off
+    uint32_t leaks;             // Out-of-band tone within SIM_ZFFT_REJECT_DB of the tone level
+    double worst_bins;          // Worst in-band peak error, in zoom bins
+    double worst_level_db;      // Worst in-band level error
+    double rejection_db;        // Weakest out-of-band rejection
+} SimZfftCheck;
+
+#define SIM_ZFFT_REJECT_DB  40.0
+
+typedef struct {
+    uint32_t estimates;         // Welch estimates read back
+    uint32_t header_errors;     // Segments or overlap not as asked, or not after ceil(segments / per record) records
+    uint32_t level_errors;      // Tone or noise density off the source's
+    double worst_tone_db;       // Against 20*log10(vpp / 3.3)
+    double worst_floor_db;      // Against its uniform noise and quantisation, per Hz
+} SimWelchCheck;
+
+typedef struct {
+    float max_err_db;           // fast_db20 against 20*log10f
+    double fast_ns, ref_ns;     // Per call
+} SimDbCheck;
+
+typedef struct {
+    uint32_t frames;            // Trigger-aligned frames captured
+    uint32_t forced;            // Of which auto-mode free runs
+    uint32_t edge_errors;       // Edge not at the pre-trigger index (or forced on a live wave)
+    uint32_t misplaced;         // Frame not the consecutive conversions of the ring
+    uint32_t missed;            // Configurations that stopped triggering
+    double capture_us;          // trigger_poll on capture, full window, spill free
+    double capture_nospill_us;  // Same with the memory behind the ring taken
+    double rotate_us;           // The full-ring rotation it replaced
+    double msps;                // Emulated conversions through the engine per host second
+} SimTriggerCheck;
+
+int sim_stm32_init(const SimSourceConfig *src);
+
+// Same command letters the STM32 takes over UART (X, T, F, D, DB, DH, DP, M, A, N, Z, C, U, E, K, I, STOP, RUN, RESET)
+void sim_stm32_command(const char *cmd);
+
+// Capture and process one record; returns the frame length written to out
+// (0 while stopped, while a single deep record is held for I: windows, or
+// while a zoom-FFT spectrum or Welch PSD is still collecting)
+size_t sim_stm32_frame(uint8_t *out, SimStm32Times *t);
+
+// Reply to the oldest queued I: request as a RECORD|WINDOW frame carrying
+// its tag; 0 if none is pending
+size_t sim_stm32_window(uint8_t *out);
+
+// Decimate record[start, start + span) to points (pairs for MODE_ENVELOPE)
+// reps times each way; the record is the deep record from sim_stm32_frame
+void sim_stm32_zoom(uint32_t start, uint32_t span, uint16_t points, uint8_t mode,
+                    uint32_t reps, SimZoomTimes *t);
+
+// I: windows over K:1, K:4 and K:32 records (time mode, T:5000): random
+// starts, spans and point counts in every mode, past the end, span 0 and
+// points beyond the span; each reply against the clamping deep_window
+// documents and decimate_samples over the record itself. Leaves K:0
+void sim_stm32_deep_check(SimDeepCheck *t);
+
+// Zoom-FFT bands around a 2 Vpp sine: tones off-centre in bands of every
+// decimation, tones outside the band, centres clamped at DC and Nyquist
+// and zoom off again. Restores the generator, leaves C:0
+void sim_stm32_zfft_check(SimZfftCheck *t);
+
+// Welch estimates of sines with uniform noise, every window at 1 to 64
+// segments and 0/50/75% overlap, then full scale and ten times the noise:
+// levels against the source, segments gathered over as many records as
+// they take. Restores the source and window, leaves U:0
+void sim_stm32_welch_check(SimWelchCheck *t);
+
+// fast_db20 over points log-spaced magnitudes (at most 4096) against
+// 20*log10f: worst error and time per call of each
+void sim_stm32_db_check(uint32_t points, SimDbCheck *t);
+
+// Run osc_trigger.c over sine, square, triangle and flat (auto) inputs on
+// both edges, for window sizes, pre-trigger splits and holdoffs that put
+// the wrap all around the ring, with and without spill memory
+void sim_stm32_trigger(SimTriggerCheck *t);
+
+// Time the ADC needs to fill one record at the current sample rate
+uint32_t sim_stm32_record_us(void);
+
+// Host monotonic clock
+double sim_now_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_STM32_H */
@@ -0,0 +1,206 @@
+#include "sim_stm32.h"
+#include "osc_trigger.h"
+#include "osc_signal.h"
+#include "main.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Emulated ADC for osc_trigger.c: conversions land in the DMA ring one
+ * sample at a time, the analog watchdog compares each against LTR/HTR and
+ * raises its interrupt a few samples late (ISR latency), the DMA wrap
+ * interrupt fires at the end of every lap. HAL_GetTick follows the
+ * converted sample count, so auto-mode timeouts run on emulated time.
+ */
+#define RING_SIZE       ADC_BUFFER_SIZE
+#define RING_MASK       (RING_SIZE - 1)
+#define AWD_LATENCY     5       // Samples between the watchdog hit and trigger_awd_isr
+#define POLL_SAMPLES    48      // Conversions between two main-loop polls
+
+/* ==================== EMULATED ADC ==================== */
+static ADC_TypeDef adc_regs;
+static DMA_HandleTypeDef adc_dma;
+static ADC_HandleTypeDef hadc = {&adc_regs, &adc_dma, 0};
+
+static uint16_t *dma_data;
+static uint32_t dma_length;
+static uint8_t dma_running;
+static uint64_t converted;              // Samples since power-up (emulated clock)
+static uint32_t sample_rate;
+static uint32_t awd_pending;            // Samples left until the watchdog ISR runs
+
+// Absolute sample number behind every ring slot, and both rings as they
+// stood when the capture halted
+static uint64_t ring_sample[RING_SIZE];
+static uint16_t halt_values[RING_SIZE];
+static uint64_t halt_sample[RING_SIZE];
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *h, uint32_t *data, uint32_t length) {
+    dma_data = (uint16_t*)data;
+    dma_length = length;
+    h->DMA_Handle->NDTR = length;
+    dma_running = 1;
+    awd_pending = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *h) {
+    (void)h;
+    dma_running = 0;
+    memcpy(halt_values, dma_data, sizeof(halt_values));
+    memcpy(halt_sample, ring_sample, sizeof(halt_sample));
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_AnalogWDGConfig(ADC_HandleTypeDef *h, ADC_AnalogWDGConfTypeDef *cfg) {
+    h->Instance->LTR = cfg->LowThreshold;
+    h->Instance->HTR = cfg->HighThreshold;
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(converted * 1000 / sample_rate);
+}
+
+/* ==================== SOURCE ==================== */
+typedef enum { TRIG_WAVE_SINE = 0, TRIG_WAVE_SQUARE, TRIG_WAVE_TRIANGLE, TRIG_WAVE_FLAT } TrigWave;
+
+static TrigWave wave;
+static double wave_cycles;              // Cycles per sample
+
+static uint16_t source_sample(uint64_t n) {
+    double ph = fmod(n * wave_cycles, 1.0), v;
+    switch(wave) {
+        case TRIG_WAVE_SINE:     v = sin(2 * M_PI * ph); break;
+        case TRIG_WAVE_SQUARE:   v = (ph < 0.5) ? 1.0 : -1.0; break;
+        case TRIG_WAVE_TRIANGLE: v = (ph < 0.5) ? 4 * ph - 1 : 3 - 4 * ph; break;
+        default:                 v = -0.8; break;
+    }
+    int code = 2048 + (int)lrint(1400 * v) + rand() % 9 - 4;
+    return (code < 0) ? 0 : (code > 4095) ? 4095 : code;
+}
+
+static void adc_convert(uint32_t count) {
+    for(uint32_t k = 0; k < count; k++, converted++) {
+        if(!dma_running) continue;
+        uint32_t slot = dma_length - adc_dma.NDTR;
+        uint16_t v = source_sample(converted);
+        dma_data[slot] = v;
+        ring_sample[slot] = converted;
+        if(--adc_dma.NDTR == 0) {
+            adc_dma.NDTR = dma_length;
+            trigger_wrap_isr();
+        }
+
+        if(awd_pending) {
+            if(--awd_pending == 0 && (hadc.IER & ADC_IT_AWD)) trigger_awd_isr();
+        } else if((hadc.IER & ADC_IT_AWD) && (v < adc_regs.LTR || v > adc_regs.HTR)) {
+            awd_pending = AWD_LATENCY;
+        }
+    }
+}
+
+/* ==================== CHECKS ==================== */
+// The frame must be window consecutive conversions as they stood in the
+// ring at the halt; returns the absolute number of its first sample
+static int64_t frame_origin(const uint16_t *frame, uint32_t window) {
+    for(uint32_t s = 0; s < RING_SIZE; s++) {
+        uint32_t k = 0;
+        while(k < window && halt_values[(s + k) & RING_MASK] == frame[k] &&
+              halt_sample[(s + k) & RING_MASK] == halt_sample[s] + k) k++;
+        if(k == window) return (int64_t)halt_sample[s];
+    }
+    return -1;
+}
+
+// Before this change the ring was rotated in place, three reversals of it
+static void ring_rotate_ref(uint16_t *a, uint32_t start) {
+    uint32_t spans[3][2] = {{0, start}, {start, RING_SIZE}, {0, RING_SIZE}};
+    for(int r = 0; r < 3; r++) {
+        for(uint32_t lo = spans[r][0], hi = spans[r][1]; lo + 1 < hi; ) {
+            uint16_t t = a[lo];
+            a[lo++] = a[--hi];
+            a[hi] = t;
+        }
+    }
+}
+
+void sim_stm32_trigger(SimTriggerCheck *t) {
+    static const uint32_t windows[] = {1000, 4096, 6000, TRIG_MAX_WINDOW};
+    static const uint8_t pres[] = {10, 50, 90};
+    static const uint16_t holdoffs_us[] = {0, 3100, 7300, 11900};
+    memset(t, 0, sizeof(*t));
+    sample_rate = 500000;
+    srand(7);
+
+    double capture_us[2] = {0, 0};
+    uint32_t captures[2] = {0, 0};
+    double t_start = sim_now_us();
+
+    // Every wave on both edges, each window size and split, the spill on
+    // and off, holdoffs that move the trigger (and the wrap) around the ring
+    for(int w = TRIG_WAVE_SINE; w <= TRIG_WAVE_FLAT; w++) {
+        wave = (TrigWave)w;
+        wave_cycles = (w == TRIG_WAVE_FLAT) ? 0 : 1.0 / 1733.0;
+        for(int edge = TRIG_RISING; edge <= TRIG_FALLING; edge++)
+        for(uint32_t wi = 0; wi < sizeof(windows) / sizeof(windows[0]); wi++)
+        for(uint32_t pi = 0; pi < sizeof(pres); pi++)
+        for(uint32_t spill = 0; spill <= 1; spill++) {
+            OscSettings s = DEFAULT_SETTINGS;
+            s.trig_mode = (wave == TRIG_WAVE_FLAT) ? TRIG_AUTO : TRIG_NORMAL;
+            s.trig_edge = (TriggerEdge)edge;
+            s.trig_pre_percent = pres[pi];
+            s.sample_rate_hz = sample_rate;
+            uint32_t window = windows[wi];
+            uint32_t pre = window * s.trig_pre_percent / 100;
+            uint16_t level = (s.trig_level_mv * 4095UL) / 3300;
+
+            for(uint32_t h = 0; h < sizeof(holdoffs_us) / sizeof(holdoffs_us[0]); h++) {
+                s.trig_holdoff_us = holdoffs_us[h];
+                trigger_start(&hadc, &s, window, spill ? ACQ_MEMORY_SAMPLES - RING_SIZE : 0);
+
+                uint32_t frames = 0;
+                for(uint32_t polls = 0; frames < 3 && polls < 20000; polls++) {
+                    adc_convert(POLL_SAMPLES);
+                    double t0 = sim_now_us();
+                    if(!trigger_poll()) continue;
+                    double us = sim_now_us() - t0;
+                    frames++;
+
+                    uint16_t *frame = trigger_frame();
+                    int64_t origin = frame_origin(frame, window);
+                    uint8_t forced = trigger_was_forced();
+                    t->frames++;
+                    if(forced) t->forced++;
+                    if(origin < 0 || frame < acq_memory || frame + window > acq_memory + ACQ_MEMORY_SAMPLES)
+                        t->misplaced++;
+                    if(!forced) {
+                        uint16_t before = frame[pre - 1], at = frame[pre];
+                        uint8_t ok = (edge == TRIG_RISING) ? (before <= level && at > level)
+                                                           : (before >= level && at < level);
+                        if(!ok || wave == TRIG_WAVE_FLAT) t->edge_errors++;
+                    } else if(wave != TRIG_WAVE_FLAT) {
+                        t->edge_errors++;
+                    }
+                    if(window == TRIG_MAX_WINDOW) {
+                        capture_us[spill] += us;
+                        captures[spill]++;
+                    }
+                    trigger_rearm();
+                }
+                if(frames < 3) t->missed++;
+                trigger_stop();
+            }
+        }
+    }
+    t->msps = converted / (sim_now_us() - t_start);
+    t->capture_us = captures[1] ? capture_us[1] / captures[1] : 0;
+    t->capture_nospill_us = captures[0] ? capture_us[0] / captures[0] : 0;
+
+    // Old capture cost for comparison: the full-ring rotation
+    const uint32_t reps = 200;
+    double t0 = sim_now_us();
+    for(uint32_t r = 0; r < reps; r++) ring_rotate_ref(adc_buffer, 1 + r * 37 % (RING_SIZE - 1));
+    t->rotate_us = (sim_now_us() - t0) / reps;
+}
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ws_frames.h"
+#include "osc_frame.h"
+#include "sim_esp32.h"
+#include "sim_stm32.h"
+
+/*
+ * I: windows with several clients asking at once, as main.cpp routes them:
+ * each request is tagged (WindowRoutes, taggedWindowCommand), queued on the
+ * STM32 side (osc_deep.c) and its reply goes to whoever the echoed rec_tag
+ * names. Rounds of up to MAX_WS_CLIENTS clients each send one to three
+ * requests before any reply is drained; every asker must get exactly one
+ * reply, for its latest request. Clients also leave with a request in
+ * flight and new ones take their place: those replies must reach nobody,
+ * as must untagged ones (a bare I: straight to the STM32).
+ */
+struct Asker {
+    uint32_t id;                // 0 = no client in this slot
+    uint32_t start;             // Latest request this round
+    bool asked, gone;
+    uint32_t replies;
+};
+
+// One reply off the STM32, routed; returns the client it goes to (0 = none)
+static uint32_t routeReply(const WindowRoutes& routes, uint8_t* frame, size_t len, OscFrameHeader& hdr) {
+    if (osc_frame_decode(frame, len, &hdr) != OSC_FRAME_OK || !(hdr.flags & OSC_FRAME_WINDOW)) return 0;
+    return routes.clientFor(hdr.rec_tag);
+}
+
+void sim_esp32_window_check(SimWindowCheck* t) {
+    static uint8_t frame[OSC_FRAME_MAX_BYTES];
+    memset(t, 0, sizeof(*t));
+    srand(19);
+
+    const char* setup[] = {"X:0", "T:5000", "M:0", "Z:0", "K:1"};
+    for (const char* c : setup) sim_stm32_command(c);
+    OscFrameHeader hdr;
+    size_t len = sim_stm32_frame(frame, nullptr);
+    uint32_t total = (osc_frame_decode(frame, len, &hdr) == OSC_FRAME_OK) ? hdr.rec_total : 0;
+    if (total < 2048) {
+        t->misrouted++;
+        sim_stm32_command("K:0");
+        return;
+    }
+
+    WindowRoutes routes = {};
+    Asker askers[MAX_WS_CLIENTS] = {};
+    uint32_t nextId = 1;
+    char cmd[STM_CMD_LEN];
+
+    for (uint32_t round = 0; round < 2000; round++) {
+        t->rounds++;
+        for (Asker& a : askers) {
+            if (!a.id) a.id = nextId++;
+            a.asked = a.gone = false;
+            a.replies = 0;
+        }
+
+        // Interleaved requests: 1..3 from each asker, in random order
+        uint32_t pending[MAX_WS_CLIENTS];
+        for (uint32_t i = 0; i < MAX_WS_CLIENTS; i++) pending[i] = (rand() % 4) ? 1 + rand() % 3 : 0;
+        for (uint32_t left = 1; left;) {
+            left = 0;
+            for (uint32_t i = 0; i < MAX_WS_CLIENTS; i++) {
+                if (!pending[i] || rand() % 2) {
+                    left += pending[i];
+                    continue;
+                }
+                Asker& a = askers[i];
+                a.start = rand() % (total - 1024);
+                a.asked = true;
+                pending[i]--;
+                left += pending[i];
+
+                // Client form as index.html sends it; some leave fields off
+                char req[STM_CMD_LEN];
+                if (rand() % 8) snprintf(req, sizeof(req), "I:%u,1024,256,%u", a.start, rand() % 4);
+                else snprintf(req, sizeof(req), "I:%u,1024", a.start);
+                taggedWindowCommand(req, routes.tagFor(a.id), cmd, sizeof(cmd));
+                sim_stm32_command(cmd);
+                t->requests++;
+            }
+        }
+
+        // Now and then one leaves before its reply, or a bare I: comes in
+        if (rand() % 8 == 0) {
+            Asker& a = askers[rand() % MAX_WS_CLIENTS];
+            if (a.asked) {
+                routes.drop(a.id);
+                a.gone = true;
+                a.id = 0;
+                t->left++;
+            }
+        }
+        bool bare = rand() % 16 == 0;
+        if (bare) {
+            sim_stm32_command("I:0,1024,256,0");
+            t->requests++;
+        }
+
+        // Drain: each reply to exactly its asker, for the latest request
+        uint32_t expectedNobody = bare ? 1 : 0;
+        for (Asker& a : askers) expectedNobody += a.gone ? 1 : 0;
+        uint32_t nobody = 0;
+        while ((len = sim_stm32_window(frame))) {
+            t->replies++;
+            uint32_t to = routeReply(routes, frame, len, hdr);
+            if (!to) {
+                nobody++;
+                continue;
+            }
+            Asker* a = nullptr;
+            for (Asker& c : askers) if (c.id == to) a = &c;
+            if (!a || !a->asked || a->replies++ || hdr.rec_start != a->start) t->misrouted++;
+        }
+        if (nobody != expectedNobody) t->misrouted++;
+        t->unrouted += nobody;
+        for (Asker& a : askers) {
+            if (a.asked && !a.gone && !a.replies) t->lost++;
+        }
+    }
+    t->clients = nextId - 1;
+
+    // The client form with every field, a client-sent tag and none at all
+    const char* forms[][2] = {
+        {"I:10,20,30,3", "I:10,20,30,3,7"},
+        {"I:10,20,30,3,99", "I:10,20,30,3,7"},
+        {"I:10", "I:10,,,,7"},
+        {"I:10,20", "I:10,20,,,7"},
+    };
+    for (auto& f : forms) {
+        taggedWindowCommand(f[0], 7, cmd, sizeof(cmd));
+        if (strcmp(cmd, f[1])) t->misrouted++;
+    }
+
+    sim_stm32_command("K:0");
+}
@@ -0,0 +1,283 @@
+#include "sim_ws.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+// ==================== SHA-1 / BASE64 (handshake only) ====================
+static void sha1(const std::string& msg, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string m = msg;
+    uint64_t bits = (uint64_t)msg.size() * 8;
+    m += (char)0x80;
+    while(m.size() % 64 != 56) m += (char)0;
+    for(int i = 7; i >= 0; i--) m += (char)(bits >> (i * 8));
+
+    for(size_t off = 0; off < m.size(); off += 64) {
+        uint32_t w[80];
+        for(int i = 0; i < 16; i++)
+            w[i] = ((uint8_t)m[off + 4*i] << 24) | ((uint8_t)m[off + 4*i + 1] << 16) |
+                   ((uint8_t)m[off + 4*i + 2] << 8) | (uint8_t)m[off + 4*i + 3];
+        for(int i = 16; i < 80; i++) {
+            uint32_t x = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+            w[i] = (x << 1) | (x >> 31);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for(int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if(i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if(i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else            { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for(int i = 0; i < 20; i++) out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static std::string base64(const uint8_t* data, size_t len) {
+    static const char* tbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for(size_t i = 0; i < len; i += 3) {
+        uint32_t v = data[i] << 16;
+        if(i + 1 < len) v |= data[i + 1] << 8;
+        if(i + 2 < len) v |= data[i + 2];
+        out += tbl[(v >> 18) & 63];
+        out += tbl[(v >> 12) & 63];
+        out += (i + 1 < len) ? tbl[(v >> 6) & 63] : '=';
+        out += (i + 2 < len) ? tbl[v & 63] : '=';
+    }
+    return out;
+}
+
+// ==================== SOCKET HELPERS ====================
+static void sendAll(int fd, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while(len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            ::poll(&pfd, 1, 100);
+            continue;
+        }
+        if(n <= 0) return;
+        p += n;
+        len -= n;
+    }
+}
+
+static const char* contentType(const std::string& path) {
+    if(path.size() >= 5 && path.compare(path.size() - 5, 5, ".html") == 0) return "text/html";
+    if(path.size() >= 3 && path.compare(path.size() - 3, 3, ".js") == 0) return "application/javascript";
+    if(path.size() >= 4 && path.compare(path.size() - 4, 4, ".css") == 0) return "text/css";
+    return "application/octet-stream";
+}
+
+// ==================== SERVER ====================
+bool SimServer::begin(uint16_t port, const std::string& wwwRoot) {
+    root_ = wwwRoot;
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if(listenFd_ < 0) return false;
+
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bind(listenFd_, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd_, 8) < 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    fcntl(listenFd_, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+size_t SimServer::count() const {
+    size_t n = 0;
+    for(const SimClient& c : clients_) if(c.websocket && c.fd >= 0) n++;
+    return n;
+}
+
+void SimServer::poll(int timeoutMs) {
+    std::vector<struct pollfd> fds;
+    fds.push_back({listenFd_, POLLIN, 0});
+    for(const SimClient& c : clients_) fds.push_back({c.fd, POLLIN, 0});
+
+    if(::poll(fds.data(), fds.size(), timeoutMs) <= 0) return;
+
+    if(fds[0].revents & POLLIN) {
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if(fd >= 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            clients_.push_back({fd, nextId_++, false, "", 0, 0, 0});
+        }
+    }
+
+    // Clients accepted above have no pollfd entry yet
+    for(size_t i = 1; i < fds.size(); i++) {
+        if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        SimClient& c = clients_[i - 1];
+
+        char buf[4096];
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if(n <= 0) {
+            closeClient(c);
+            continue;
+        }
+        c.in.append(buf, n);
+
+        if(c.websocket) handleFrames(c);
+        else handleHttp(c);
+    }
+
+    for(size_t i = 0; i < clients_.size();) {
+        if(clients_[i].fd < 0) clients_.erase(clients_.begin() + i);
+        else i++;
+    }
+}
+
+void SimServer::closeClient(SimClient& c) {
+    if(c.fd < 0) return;
+    if(c.websocket && onClose) onClose(c);
+    close(c.fd);
+    c.fd = -1;
+}
+
+void SimServer::handleHttp(SimClient& c) {
+    size_t end = c.in.find("\r\n\r\n");
+    if(end == std::string::npos) return;
+
+    std::string req = c.in.substr(0, end);
+    c.in.erase(0, end + 4);
+
+    std::istringstream lines(req);
+    std::string method, path, line, key;
+    lines >> method >> path;
+    while(std::getline(lines, line)) {
+        if(strncasecmp(line.c_str(), "Sec-WebSocket-Key:", 18) == 0) {
+            key = line.substr(18);
+            key.erase(0, key.find_first_not_of(" \t"));
+            key.erase(key.find_last_not_of(" \t\r") + 1);
+        }
+    }
+
+    if(path == "/ws" && !key.empty()) {
+        uint8_t digest[20];
+        sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+        std::string resp = "HTTP/1.1 101 Switching Protocols\r\n"
+                           "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: " + base64(digest, 20) + "\r\n\r\n";
+        sendAll(c.fd, resp.data(), resp.size());
+        c.websocket = true;
+        if(onOpen) onOpen(c);
+        return;
+    }
+
+    // Static files (no directory traversal)
+    if(path == "/") path = "/index.html";
+    std::string body;
+    bool found = false;
+    if(path.find("..") == std::string::npos) {
+        std::ifstream f(root_ + path, std::ios::binary);
+        if(f) {
+            std::ostringstream ss;
+            ss << f.rdbuf();
+            body = ss.str();
+            found = true;
+        }
+    }
+
+    char hdr[160];
+    snprintf(hdr, sizeof(hdr), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+             found ? "200 OK" : "404 Not Found", found ? contentType(path) : "text/plain", body.size());
+    sendAll(c.fd, hdr, strlen(hdr));
+    sendAll(c.fd, body.data(), body.size());
+    closeClient(c);
+}
+
+void SimServer::handleFrames(SimClient& c) {
+    for(;;) {
+        if(c.in.size() < 2) return;
+        const uint8_t* p = (const uint8_t*)c.in.data();
+        uint8_t opcode = p[0] & 0x0F;
+        bool masked = p[1] & 0x80;
+        uint64_t len = p[1] & 0x7F;
+        size_t pos = 2;
+
+        if(len == 126) {
+            if(c.in.size() < 4) return;
+            len = (p[2] << 8) | p[3];
+            pos = 4;
+        } else if(len == 127) {
+            if(c.in.size() < 10) return;
+            len = 0;
+            for(int i = 0; i < 8; i++) len = (len << 8) | p[2 + i];
+            pos = 10;
+        }
+
+        uint8_t mask[4] = {0, 0, 0, 0};
+        if(masked) {
+            if(c.in.size() < pos + 4) return;
+            memcpy(mask, p + pos, 4);
+            pos += 4;
+        }
+        if(c.in.size() < pos + len) return;
+
+        std::string payload = c.in.substr(pos, len);
+        for(size_t i = 0; i < payload.size(); i++) payload[i] ^= mask[i & 3];
+        c.in.erase(0, pos + len);
+
+        switch(opcode) {
+            case 0x1: if(onText) onText(c, payload); break;
+            case 0x8: closeClient(c); return;
+            case 0x9: sendFrame(c, 0xA, (const uint8_t*)payload.data(), payload.size()); break;
+            default: break;  // Binary/continuation/pong: unused by the UI
+        }
+    }
+}
+
+void SimServer::sendFrame(SimClient& c, uint8_t opcode, const uint8_t* data, size_t len) {
+    if(c.fd < 0) return;
+    uint8_t hdr[10];
+    size_t n = 2;
+    hdr[0] = 0x80 | opcode;
+    if(len < 126) {
+        hdr[1] = (uint8_t)len;
+    } else if(len < 65536) {
+        hdr[1] = 126;
+        hdr[2] = (uint8_t)(len >> 8);
+        hdr[3] = (uint8_t)len;
+        n = 4;
+    } else {
+        hdr[1] = 127;
+        for(int i = 0; i < 8; i++) hdr[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        n = 10;
+    }
+    sendAll(c.fd, hdr, n);
+    sendAll(c.fd, data, len);
+}
+
+void SimServer::text(SimClient& c, const std::string& msg) {
+    sendFrame(c, 0x1, (const uint8_t*)msg.data(), msg.size());
+}
+
+void SimServer::binary(SimClient& c, const uint8_t* data, size_t len) {
+    sendFrame(c, 0x2, data, len);
+}
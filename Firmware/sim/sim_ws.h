@@ -0,0 +1,54 @@
+#ifndef SIM_WS_H
+#define SIM_WS_H
+
+/*
+ * Minimal single-threaded HTTP + WebSocket server (RFC 6455, no
+ * extensions) so index.html can run against the simulator. Serves files
+ * from one directory and upgrades GET /ws.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+struct SimClient {
+    int fd;
+    uint32_t id;
+    bool websocket;             // Upgraded (false = plain HTTP request)
+    std::string in;             // Unparsed input
+    uint16_t resolution;        // Requested samples per frame (0 = full)
+    uint8_t codec;              // Binary payload format (osc_codec.h)
+    uint32_t lastBinary;        // ms
+};
+
+class SimServer {
+public:
+    std::function<void(SimClient&)> onOpen;
+    std::function<void(SimClient&)> onClose;
+    std::function<void(SimClient&, const std::string&)> onText;
+
+    bool begin(uint16_t port, const std::string& wwwRoot);
+
+    // Accept and service sockets, waiting at most timeoutMs
+    void poll(int timeoutMs);
+
+    void text(SimClient& c, const std::string& msg);
+    void binary(SimClient& c, const uint8_t* data, size_t len);
+
+    std::vector<SimClient>& clients() { return clients_; }
+    size_t count() const;
+
+private:
+    void handleHttp(SimClient& c);
+    void handleFrames(SimClient& c);
+    void sendFrame(SimClient& c, uint8_t opcode, const uint8_t* data, size_t len);
+    void closeClient(SimClient& c);
+
+    int listenFd_ = -1;
+    uint32_t nextId_ = 1;
+    std::string root_;
+    std::vector<SimClient> clients_;
+};
+
+#endif /* SIM_WS_H */
@@ -0,0 +1,239 @@
+/*
+ * Cortex-M4 packed-SIMD kernels against their scalar references (the
+ * OSC_SCALAR_REF build), bit for bit. The firmware sources are included
+ * so their static kernels are reachable; the Makefile defines
+ * __ARM_FEATURE_SIMD32, which selects the SIMD versions and the
+ * intrinsic emulation in shim/arm_math.h.
+ *
+ *   simd_check        one line per kernel, exit status 1 on a mismatch
+ *                     (time_edges; envelope_bucket alone and through
+ *                     envelope_decimate; the zoom pyramid's leaf_full
+ *                     and pyramid_decimate over what it builds)
+ *
+ * Buffers sit at every sample offset from a word boundary, with odd and
+ * even lengths, so both the aligned body and the head/tail fix-ups run.
+ * The build traps misaligned word loads (-fsanitize=alignment): the M4
+ * tolerates them, but each one costs a cycle and the kernels promise
+ * aligned loads.
+ */
+#include "osc_signal.c"
+#include "osc_pyramid.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef __ARM_FEATURE_SIMD32
+#error "simd_check needs -D__ARM_FEATURE_SIMD32"
+#endif
+
+static SimDwt dwt;
+SimDwt *sim_dwt(void) { return &dwt; }
+void Error_Handler(void) { abort(); }
+
+static const uint32_t sizes[] = {1, 2, 3, 4, 5, 7, 8, 9, 63, 64, 65, 127, 1001, 4095, 4096, 8191};
+
+#define WAVES       3       // 12-bit ADC traces
+#define WAVE_FULL   3       // Full 16-bit range: the lanes compare unsigned
+
+// Noise, a noisy sine and a square with a random period, all 12-bit
+static void fill(uint16_t *buf, uint32_t n, int wave) {
+    double period = 8 + rand() % 400;
+    for(uint32_t i = 0; i < n; i++) {
+        int v;
+        if(wave == WAVE_FULL) { buf[i] = rand() & 0xFFFF; continue; }
+        if(wave == 0)      v = rand() % 4096;
+        else if(wave == 1) v = 2048 + (int)(1500 * sin(2 * M_PI * i / period)) + rand() % 64 - 32;
+        else               v = (fmod(i, period) < period / 2) ? 3500 + rand() % 40 : 500 + rand() % 40;
+        buf[i] = (v < 0) ? 0 : (v > 4095) ? 4095 : v;
+    }
+}
+
+/* ==================== TIME EDGES ==================== */
+static uint32_t check_time_edges(uint32_t *cases) {
+    uint32_t fails = 0;
+    for(uint32_t off = 0; off < 4; off++)
+    for(uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for(int wave = 0; wave < WAVES; wave++)
+    for(int rep = 0; rep < 4; rep++) {
+        uint16_t *buf = acq_memory + off;
+        uint32_t n = sizes[s];
+        fill(buf, n, wave);
+
+        uint16_t dc = 1000 + rand() % 2000, hyst = 20 + rand() % 400;
+        EdgeScan ref = {
+            .dc = dc, .thresh_high = dc + hyst, .thresh_low = dc - hyst,
+            .state = (uint8_t)(rep & 1)
+        };
+        EdgeScan simd = ref;
+        time_edges_scalar(buf, n, &ref);
+        time_edges_simd(buf, n, &simd);
+        (*cases)++;
+        if(ref.rising_edges != simd.rising_edges || ref.first_edge != simd.first_edge ||
+           ref.last_edge != simd.last_edge || ref.high_count != simd.high_count ||
+           ref.state != simd.state) {
+            if(!fails) printf("  time_edges mismatch: offset %u, %u samples, wave %d\n", off, n, wave);
+            fails++;
+        }
+    }
+    return fails;
+}
+
+/* ==================== ENVELOPE ==================== */
+// envelope_decimate on the scalar bucket kernel
+static void envelope_decimate_ref(const uint16_t *src, uint32_t units, uint32_t step,
+                                  uint16_t *dst, uint32_t buckets) {
+    for(uint32_t i = 0; i < buckets; i++) {
+        uint32_t start = (i * units) / buckets;
+        uint32_t end = ((i + 1) * units) / buckets;
+        if(end == start) end = start + 1;
+        envelope_bucket_scalar(&src[start * step], (end - start) * step, &dst[2 * i]);
+    }
+}
+
+// Single buckets at every offset, then whole decimations of raw samples
+// (step 1) and of an existing envelope (step 2, pairs stay word-aligned
+// or not with the source)
+static uint32_t check_envelope(uint32_t *cases) {
+    static uint16_t ref[2 * 4096], simd[2 * 4096], pairs[2 * 8192];
+    uint32_t fails = 0;
+
+    for(uint32_t off = 0; off < 4; off++)
+    for(uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for(int wave = 0; wave <= WAVE_FULL; wave++)
+    for(int rep = 0; rep < 4; rep++) {
+        uint16_t *buf = acq_memory + off;
+        uint32_t n = sizes[s];
+        fill(buf, n, wave);
+
+        envelope_bucket_scalar(buf, n, ref);
+        envelope_bucket_simd(buf, n, simd);
+        (*cases)++;
+        if(ref[0] != simd[0] || ref[1] != simd[1]) {
+            if(!fails) printf("  envelope_bucket mismatch: offset %u, %u samples, wave %d\n", off, n, wave);
+            fails++;
+        }
+
+        // Raw samples into 1..4096 buckets, then those pairs merged again
+        uint32_t buckets = 1 + rand() % 4096;
+        envelope_decimate_ref(buf, n, 1, ref, buckets);
+        envelope_decimate(buf, n, 1, simd, buckets);
+        (*cases)++;
+        if(memcmp(ref, simd, 4 * buckets)) {
+            if(!fails) printf("  envelope_decimate mismatch: offset %u, %u samples -> %u, wave %d\n",
+                              off, n, buckets, wave);
+            fails++;
+        }
+
+        uint16_t *src = pairs + off;
+        memcpy(src, ref, 4 * buckets);
+        uint32_t merged = 1 + rand() % 512;
+        envelope_decimate_ref(src, buckets, 2, ref, merged);
+        envelope_decimate(src, buckets, 2, simd, merged);
+        (*cases)++;
+        if(memcmp(ref, simd, 4 * merged)) {
+            if(!fails) printf("  envelope merge mismatch: offset %u, %u pairs -> %u, wave %d\n",
+                              off, buckets, merged, wave);
+            fails++;
+        }
+    }
+    return fails;
+}
+
+/* ==================== PYRAMID ==================== */
+// Blocks sit at fixed positions in acq_memory, so the leaf kernel runs on
+// whole blocks only. The index is then built from ranges that start and
+// end anywhere (leaves straddled by two neighbours, parts rewritten later)
+// and read back through pyramid_decimate against decimate_samples over
+// the same samples. The pyramid's SMLAD assumes 12-bit samples
+static uint32_t check_pyramid(uint32_t *cases, uint32_t *indexed) {
+    static uint16_t ref[4096], got[4096];
+    uint32_t fails = 0;
+
+    for(uint32_t rep = 0; rep < 64; rep++) {
+        uint32_t blk = rand() % (ACQ_MEMORY_SAMPLES / PYR_LEAF);
+        uint16_t *buf = &acq_memory[blk * PYR_LEAF];
+        fill(buf, PYR_LEAF, rep % WAVES);
+
+        PyrNode want, simd;
+        PyrStats ts = {0, 0, 4095, 0}, tw = ts;
+        leaf_scalar(buf, PYR_LEAF, &want, &ts);
+        leaf_full(buf, &simd, &tw);
+        (*cases)++;
+        if(want.vmin != simd.vmin || want.vmax != simd.vmax || want.sum != simd.sum ||
+           ts.sum != tw.sum || ts.sum_sq != tw.sum_sq || ts.vmin != tw.vmin || ts.vmax != tw.vmax) {
+            if(!fails) printf("  leaf_full mismatch: block %u, wave %u\n", blk, rep % WAVES);
+            fails++;
+        }
+    }
+
+    for(uint32_t round = 0; round < 12; round++) {
+        int wave = round % WAVES;
+        uint32_t chunk = (round & 1) ? 1 + rand() % 5000 : 0;
+
+        // The whole memory in random-length pieces, then a piece of it rewritten
+        fill(acq_memory, ACQ_MEMORY_SAMPLES, wave);
+        for(uint32_t a = 0, n; a < ACQ_MEMORY_SAMPLES; a += n) {
+            n = chunk ? chunk : 1 + rand() % 3000;
+            if(n > ACQ_MEMORY_SAMPLES - a) n = ACQ_MEMORY_SAMPLES - a;
+
+            PyrStats t;
+            pyramid_update(&acq_memory[a], n, &t);
+            uint64_t sum = 0, sum_sq = 0;
+            uint16_t vmin = 4095, vmax = 0;
+            for(uint32_t i = a; i < a + n; i++) {
+                sum += acq_memory[i];
+                sum_sq += (uint32_t)acq_memory[i] * acq_memory[i];
+                if(acq_memory[i] < vmin) vmin = acq_memory[i];
+                if(acq_memory[i] > vmax) vmax = acq_memory[i];
+            }
+            (*cases)++;
+            if(t.sum != sum || t.sum_sq != sum_sq || t.vmin != vmin || t.vmax != vmax) {
+                if(!fails) printf("  pyramid_update stats mismatch: %u samples at %u, wave %d\n", n, a, wave);
+                fails++;
+            }
+        }
+        uint32_t a = rand() % ACQ_MEMORY_SAMPLES, n = 1 + rand() % (ACQ_MEMORY_SAMPLES - a);
+        fill(&acq_memory[a], n, (wave + 1) % WAVES);
+        pyramid_update(&acq_memory[a], n, NULL);
+
+        for(uint32_t q = 0; q < 500; q++) {
+            ScopeMode mode = (ScopeMode)(MODE_AVERAGE + q % 3);
+            uint32_t start = rand() % ACQ_MEMORY_SAMPLES;
+            uint32_t span = 1 + rand() % (ACQ_MEMORY_SAMPLES - start);
+            uint16_t values = 2 + rand() % 511;
+            if(mode == MODE_ENVELOPE) values &= ~1u;
+
+            decimate_samples(&acq_memory[start], span, ref, values, mode);
+            pyramid_decimate(&acq_memory[start], span, got, values, mode);
+            (*cases)++;
+            *indexed += pyramid_indexed(span, values, mode);
+            if(memcmp(ref, got, values * sizeof(uint16_t))) {
+                if(!fails) printf("  pyramid_decimate mismatch: %u samples at %u -> %u, mode %d, wave %d\n",
+                                  span, start, values, mode, wave);
+                fails++;
+            }
+        }
+    }
+    return fails;
+}
+
+int main(void) {
+    srand(3);
+    const uint32_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    uint32_t cases = 0, fails = check_time_edges(&cases), total = fails;
+    printf("simd  time_edges %u cases, offsets 0-3, %u sizes  %s\n", cases, nsizes, fails ? "FAIL" : "ok");
+
+    cases = 0;
+    fails = check_envelope(&cases);
+    total += fails;
+    printf("simd  envelope   %u cases, offsets 0-3, %u sizes, 16-bit range  %s\n",
+           cases, nsizes, fails ? "FAIL" : "ok");
+
+    uint32_t indexed = 0;
+    cases = 0;
+    fails = check_pyramid(&cases, &indexed);
+    total += fails;
+    printf("simd  pyramid    %u cases, %u-sample memory, %u windows off the index  %s\n",
+           cases, (unsigned)ACQ_MEMORY_SAMPLES, indexed, fails ? "FAIL" : "ok");
+    return total ? 1 : 0;
+}
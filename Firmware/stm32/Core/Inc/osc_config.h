@@ -5,10 +5,35 @@
 
 /* ==================== BUFFER SIZES ==================== */
 #define ADC_BUFFER_SIZE     8192    // Power of 2 for FFT efficiency
-#define DISPLAY_SAMPLES     256     // Samples sent to ESP32
+#define DISPLAY_SAMPLES     256     // Default frame resolution sent to ESP32
+#define SPI_CHUNK_GAP_MS    2       // Idle time for the ESP32 to re-arm between chunks
 #define OLED_SAMPLES        128     // OLED width in pixels
 #define CMD_BUFFER_SIZE     32
 #define FFT_SIZE            4096
+#define MAX_PEAKS           32      // Spectrum peaks reported per frame
+
+// Zoom index (osc_pyramid.h): min/max/sum blocks cost 0.14 B per sample of
+// acq_memory, paid for out of the deep-only tail so both builds take the
+// same SRAM (osc_signal.h); OSC_PYRAMID=0 keeps the tail whole
+#ifndef OSC_PYRAMID
+#define OSC_PYRAMID         1
+#endif
+#define DEEP_TAIL_SAMPLES   12288   // SRAM owned by deep records alone, in samples, without the index
+
+// FFT engine: float (rfft_fast) or fixed point. The fixed-point rffts write
+// both spectrum halves, so Q15 saves only a fifth of the FFT buffers and Q31
+// needs more than float; acq_memory, the zoom index over it and the window
+// table grow or shrink together (sim/fft_check compares the engines):
+//   F32  40 KB FFT buffers, 74 KB acq_memory, 87 KB in all
+//   Q15  32 KB FFT buffers, 67 KB acq_memory, 76 KB in all (within 1 dB of
+//        float only down to -45 dBFS)
+//   Q31  56 KB FFT buffers, 89 KB acq_memory, 103 KB in all
+#define FFT_ENGINE_F32      0
+#define FFT_ENGINE_Q15      1
+#define FFT_ENGINE_Q31      2
+#ifndef FFT_ENGINE
+#define FFT_ENGINE          FFT_ENGINE_F32
+#endif
 
 /* ==================== CLOCK CONFIG ==================== */
 #define SYSTEM_CLOCK_HZ     100000000UL  // 100 MHz
@@ -25,7 +50,8 @@
 typedef enum {
     MODE_NORMAL = 0,        // Direct sampling
     MODE_AVERAGE,           // Noise reduction
-    MODE_PEAK_DETECT        // Transient capture
+    MODE_PEAK_DETECT,       // Transient capture
+    MODE_ENVELOPE           // (min,max) pair per bucket
 } ScopeMode;
 
 typedef enum {
@@ -33,6 +59,31 @@ typedef enum {
     DISPLAY_FREQ            // FFT spectrum
 } DisplayMode;
 
+typedef enum {
+    TRIG_OFF = 0,           // Free-running capture
+    TRIG_AUTO,              // Free-run after timeout
+    TRIG_NORMAL,            // Only on trigger
+    TRIG_SINGLE             // One capture, then hold
+} TriggerMode;
+
+typedef enum {
+    TRIG_RISING = 0,
+    TRIG_FALLING
+} TriggerEdge;
+
+typedef enum {
+    WIN_HANN = 0,           // General purpose
+    WIN_HAMMING,            // Narrower main lobe
+    WIN_BLACKMAN_HARRIS,    // Low sidelobes (-92 dB)
+    WIN_FLATTOP             // Accurate amplitudes
+} FftWindow;
+
+typedef enum {
+    PEAK_PARABOLIC = 0,     // Parabola through linear magnitudes
+    PEAK_GAUSSIAN,          // Parabola through log magnitudes
+    PEAK_JACOBSEN           // Three-bin ratio with a per-window constant
+} PeakInterp;
+
 /* ==================== DATA STRUCTURES ==================== */
 typedef struct {
     uint16_t time_div_us;           // Timebase µs/div
@@ -43,6 +94,29 @@ typedef struct {
     ScopeMode mode;                 // Acquisition mode
     DisplayMode display_mode;       // Time/freq domain
     uint8_t  average_count;         // FFT averaging frames
+    FftWindow fft_window;           // FFT window function
+    uint16_t frame_samples;         // SPI frame resolution (0 = full record)
+    uint8_t  continuous_acq;        // Circular ping-pong DMA capture
+    TriggerMode trig_mode;          // Time-domain trigger mode
+    TriggerEdge trig_edge;          // Trigger slope
+    uint16_t trig_level_mv;         // Trigger level
+    uint16_t trig_hyst_mv;          // Re-arm hysteresis
+    uint16_t trig_holdoff_us;       // Min time between triggers
+    uint8_t  trig_pre_percent;      // Pre-trigger share of window
+    uint8_t  deep_segments;         // Deep memory: 0 off, 1 single record, N segments
+    uint32_t zoom_center_hz;        // Zoom-FFT band centre
+    uint32_t zoom_span_hz;          // Zoom-FFT band width (0 = full spectrum)
+    uint8_t  welch_segments;        // Welch PSD: segments per estimate (0 = EMA spectrum)
+    uint8_t  welch_overlap;         // Welch segment overlap, percent
+    uint8_t  spectrum_db;           // Spectrum samples in dB (0 = linear, display-scaled)
+    int16_t  db_ref_dbfs;           // dB spectrum reference level, dBFS
+    int16_t  db_floor_db;           // Lowest level shown, dB below the reference
+    uint8_t  dist_harmonics;        // Harmonics in THD/THD+N (0 = distortion analysis off)
+    uint8_t  peak_count;            // Spectrum peaks to report (1..MAX_PEAKS)
+    PeakInterp peak_interp;         // Sub-bin frequency estimator
+    uint16_t peak_spacing_hz;       // Min distance between peaks (0 = window main lobe)
+    uint8_t  peak_percentile;       // Noise floor: this percentile of the bins
+    int8_t   peak_margin_db;        // Peaks must clear the floor by this much
 } OscSettings;
 
 typedef struct {
@@ -52,12 +126,37 @@ typedef struct {
     uint16_t vmax_mv, vmin_mv;      // Voltage extremes
     uint16_t vrms_mv;               // RMS voltage
     uint16_t duty_percent;          // Duty cycle
-    uint32_t peak_freqs[5];         // Top 5 FFT peaks (Hz)
-    uint16_t peak_mags[5];          // Peak magnitudes
+    uint32_t peak_freqs[MAX_PEAKS]; // Strongest FFT peaks first (Hz, mHz for zoom spectra)
+    uint16_t peak_mags[MAX_PEAKS];  // Peak magnitudes
     uint8_t  num_peaks;             // Valid peak count
     uint8_t  valid;                 // Measurement validity
+    uint8_t  psd_segments;          // Welch segments behind the spectrum (0 = EMA)
+    uint8_t  psd_overlap;           // Their overlap, percent
+    int16_t  psd_tone_cdbfs;        // Strongest tone power, 0.01 dBFS
+    int16_t  psd_floor_cdbfs;       // Noise density, 0.01 dBFS/Hz
+    uint8_t  dist_harmonics;        // Harmonics below Nyquist in THD (0 = no analysis)
+    int16_t  thd_cdb;               // Harmonics / fundamental, 0.01 dBc
+    int16_t  thdn_cdb;              // Harmonics + noise / fundamental (SINAD = -THD+N)
+    int16_t  snr_cdb;               // Fundamental / noise, 0.01 dB
+    int16_t  sfdr_cdb;              // Fundamental / strongest spur, 0.01 dB
+    uint16_t enob_cbits;            // Effective bits, 0.01 bit (full-scale referred)
 } Measurements;
 
+typedef struct {
+    uint16_t fps;                   // Frames processed last second
+    uint16_t dead_permille;         // Samples not processed (0.1%)
+    uint32_t overruns;              // Halves lost to slow processing
+} AcqStats;
+
+typedef struct {
+    uint32_t window;                // DC removal + windowing
+    uint32_t fft;                   // Real FFT
+    uint32_t magnitude;             // Bin magnitudes + averaging
+    uint32_t peaks;                 // Peak search + display spectrum
+    uint32_t segments;              // Transforms behind these counts (Welch runs several)
+    uint32_t distortion;            // THD/SNR analysis
+} FftCycles;
+
 /* ==================== DEFAULT SETTINGS ==================== */
 #define DEFAULT_SETTINGS { \
     .time_div_us = 100,             \
@@ -67,7 +166,30 @@ typedef struct {
     .sample_rate_hz = SR_TIME_MODE_MAX, \
     .mode = MODE_NORMAL,            \
     .display_mode = DISPLAY_TIME,   \
-    .average_count = 20             \
+    .average_count = 20,            \
+    .fft_window = WIN_HANN,         \
+    .frame_samples = DISPLAY_SAMPLES, \
+    .continuous_acq = 1,            \
+    .trig_mode = TRIG_OFF,          \
+    .trig_edge = TRIG_RISING,       \
+    .trig_level_mv = 1650,          \
+    .trig_hyst_mv = 50,             \
+    .trig_holdoff_us = 0,           \
+    .trig_pre_percent = 50,         \
+    .deep_segments = 0,             \
+    .zoom_center_hz = 0,            \
+    .zoom_span_hz = 0,              \
+    .welch_segments = 0,            \
+    .welch_overlap = 50,            \
+    .spectrum_db = 1,               \
+    .db_ref_dbfs = 0,               \
+    .db_floor_db = -140,            \
+    .dist_harmonics = 9,            \
+    .peak_count = 5,                \
+    .peak_interp = PEAK_JACOBSEN,   \
+    .peak_spacing_hz = 0,           \
+    .peak_percentile = 50,          \
+    .peak_margin_db = 15            \
 }
 
 #endif /* OSC_CONFIG_H */
@@ -0,0 +1,67 @@
+#ifndef OSC_DEEP_H
+#define OSC_DEEP_H
+
+#include <stdint.h>
+#include "osc_config.h"
+
+/* ==================== DEEP MEMORY CONFIG ==================== */
+#define DEEP_MAX_SEGMENTS   32
+#define DEEP_HOLD_MS        1000    // Single record frozen this long after a window request
+#define DEEP_WINDOW_QUEUE   8       // I: requests waiting for a reply (every WebSocket client + UART)
+
+typedef struct {
+    uint16_t *base;                 // Segment 0 in acq_memory
+    uint32_t segment_len;           // Samples per segment
+    uint32_t total;                 // Samples held (filled segments)
+    uint16_t id;                    // Bumped whenever the content changes
+    uint8_t  segments;              // 0 off (or a retained STOP frame), 1 single record, N segmented
+    uint8_t  filled;                // Segments captured so far
+} DeepRecord;
+
+// One I: request, clamped to what a window frame can carry
+typedef struct {
+    uint32_t start, span;
+    uint16_t points;
+    ScopeMode mode;
+    uint8_t  tag;                   // Echoed as rec_tag so the reply finds its asker
+} DeepWindowRequest;
+
+/* ==================== API FUNCTIONS ==================== */
+
+// Longest segment for a segment count: a single record spans the whole
+// acquisition memory, segments share what follows the live adc_buffer
+uint32_t deep_capacity(uint8_t segments);
+
+// Start an empty record (segments 0 turns deep memory off); frame_len is
+// the acquisition length, clamped to deep_capacity
+void deep_configure(uint8_t segments, uint32_t frame_len);
+
+// Account a processed frame. A single record is the frame itself (it was
+// captured in place); segmented records copy it into the next free slot.
+// Returns 1 if the frame became part of the record
+uint8_t deep_store(const uint16_t *frame, uint32_t n);
+
+// Acquisition stopped: keep this frame as the record so a stopped trace can
+// be windowed without deep memory (segmented and single records already
+// hold their captures). Returns 1 if the frame became the record
+uint8_t deep_retain(uint16_t *frame, uint32_t n);
+
+// Record state for frame headers and reports
+const DeepRecord *deep_record(void);
+
+// Decimate record[*start, *start + *span) into dst with the scope mode
+// (start/span are clamped to the record; points never exceed the span).
+// Returns the uint16 values written: points, or 2 * points for MODE_ENVELOPE
+uint16_t deep_window(uint32_t *start, uint32_t *span, uint16_t *dst,
+                     uint16_t points, ScopeMode mode);
+
+// Queue an I: request, "start,span,points,mode,tag"; missing or empty fields
+// take span 0 (to the end), the given points and mode, and tag 0. A request
+// with the tag of a queued one replaces it, a full queue drops its oldest;
+// deep_configure empties the queue
+void deep_request(const char *args, uint16_t points, ScopeMode mode);
+
+// Take the oldest queued request; returns 0 if none is waiting
+uint8_t deep_next_request(DeepWindowRequest *req);
+
+#endif /* OSC_DEEP_H */
@@ -2,6 +2,14 @@
 #define OSC_DISPLAY_H
 
 #include <stdint.h>
+#include "osc_config.h"
+
+// Start a frame from the pre-rendered grid layer of the mode
+// (grid drawn once per mode change instead of every frame)
+void display_begin(DisplayMode mode);
+
+// Status line on page 0; glyphs re-rendered only when the text changes
+void display_status(const char *text);
 
 // Draw dotted grid for time domain (10 divisions)
 void draw_grid(void);
@@ -12,6 +20,9 @@ void draw_freq_grid(void);
 // Draw time-domain waveform from buffer
 void draw_waveform(uint16_t *buffer, uint16_t size);
 
+// Draw a filled min/max band from (min,max) pairs, one per column
+void draw_envelope(uint16_t *pairs, uint16_t columns);
+
 // Draw frequency spectrum as bar graph
 void draw_spectrum(uint16_t *buffer, uint16_t size);
 
@@ -0,0 +1,69 @@
+#ifndef OSC_PROFILE_H
+#define OSC_PROFILE_H
+
+#include "main.h"
+#include "osc_config.h"
+
+/* ==================== PROFILE CONFIG ==================== */
+// OSC_PROFILE=0 removes every probe and the P: command from the build
+#ifndef OSC_PROFILE
+#define OSC_PROFILE         1
+#endif
+
+#define PROF_HIST_BUCKETS   16      // Log2 cycle histogram per probe
+#define PROF_HIST_MIN_LOG2  8       // Bucket 0 = under 512 cycles (~5 µs)
+
+/* ==================== PROBE POINTS ==================== */
+typedef enum {
+    PROF_FRAME = 0,         // Whole frame: measure, encode, OLED
+    PROF_DECIMATE,          // decimate_samples into the SPI frame
+    PROF_MEASURE,           // measure_time_domain / measure_freq_domain
+    PROF_FFT_WINDOW,        // Split of measure_freq_domain (fft_cycles)
+    PROF_FFT,
+    PROF_FFT_MAGNITUDE,
+    PROF_FFT_PEAKS,
+    PROF_FFT_DISTORTION,
+    PROF_ENCODE,            // Frame header encode + SPI start
+    PROF_OLED_DRAW,         // Grid, decimation and trace into the framebuffer
+    PROF_OLED_STATUS,       // Status line snprintf + text
+    PROF_OLED_FLUSH,        // ssd1306_update
+    PROF_COMMAND,           // process_command
+    PROF_ZOOM_FEED,         // zoom_feed: mix and decimate one ADC half
+    PROF_NUM_PROBES
+} ProfProbe;
+
+/* ==================== PROBE MACROS ==================== */
+#if OSC_PROFILE
+#define PROF_BEGIN(t)           uint32_t t = DWT->CYCCNT
+#define PROF_END(probe, t)      prof_record((probe), DWT->CYCCNT - (t))
+#define PROF_ADD(probe, cycles) prof_record((probe), (cycles))
+#else
+#define PROF_BEGIN(t)           ((void)0)
+#define PROF_END(probe, t)      ((void)0)
+#define PROF_ADD(probe, cycles) ((void)0)
+#endif
+
+/* ==================== API FUNCTIONS ==================== */
+#if OSC_PROFILE
+// Calibrate the probe cost (DWT must be running) and clear all probes
+void prof_init(void);
+
+// Clear counters and restart the report window
+void prof_reset(void);
+
+// Runtime switch: probes cost one branch while disabled
+void prof_enable(uint8_t on);
+
+// Account one probe hit (probe overhead already subtracted)
+void prof_record(ProfProbe probe, uint32_t cycles);
+
+// Dump all probes over UART:
+//   P:name,count,avg,min,max,h0/h1/.../h15   (cycles, probes with hits only)
+//   P:END,enabled,overhead,calls,window_ms,clock_mhz,hist_min_log2
+void prof_dump(UART_HandleTypeDef *huart);
+#else
+#define prof_init()             ((void)0)
+#define prof_reset()            ((void)0)
+#endif
+
+#endif /* OSC_PROFILE_H */
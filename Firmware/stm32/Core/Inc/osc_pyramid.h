@@ -0,0 +1,52 @@
+#ifndef OSC_PYRAMID_H
+#define OSC_PYRAMID_H
+
+#include <stdint.h>
+#include "osc_signal.h"
+
+/* ==================== PYRAMID CONFIG ==================== */
+// Min/max/sum of every 64 and 512 samples of acq_memory. Blocks sit at
+// absolute positions, so live frames, deep records and segments share it.
+// 8-sample leaves would cut the edge scans but cost 25 KB, a third of the
+// K:1 record; these cost 0.14 B per sample
+#define PYR_LEAF        64
+#define PYR_NODE        512
+#define PYR_LEAVES      ((ACQ_MEMORY_SAMPLES + PYR_LEAF - 1) / PYR_LEAF)
+#define PYR_NODES       ((ACQ_MEMORY_SAMPLES + PYR_NODE - 1) / PYR_NODE)
+// Smaller buckets scan faster than their edge samples cost. Envelope
+// buckets tile, so whole ones land on leaves; average/peak buckets share
+// their end samples and always pay two edge scans
+#define PYR_MIN_BUCKET_ENV   64
+#define PYR_MIN_BUCKET_PEAK  128
+#define PYR_MIN_BUCKET_AVG   192
+
+#if OSC_PYRAMID
+#define PYR_BYTES       ((PYR_LEAVES + PYR_NODES) * 8)
+#else
+#define PYR_BYTES       0
+#endif
+
+typedef struct {
+    uint32_t sum;
+    uint64_t sum_sq;
+    uint16_t vmin, vmax;
+} PyrStats;
+
+/* ==================== API FUNCTIONS ==================== */
+
+// Index src[0, n) (inside acq_memory) once it holds a capture, returning
+// its sum, sum of squares and extremes from the same pass (stats may be
+// NULL). Blocks it only partly covers are never used for queries outside it
+void pyramid_update(const uint16_t *src, uint32_t n, PyrStats *stats);
+
+// decimate_samples() over indexed memory: same buckets, same output, but
+// min/max/average buckets of PYR_MIN_BUCKET_* or more samples are read from
+// blocks, O(points) instead of O(samples)
+void pyramid_decimate(const uint16_t *src, uint32_t n,
+                      uint16_t *dst, uint16_t dst_size, ScopeMode mode);
+
+// Whether pyramid_decimate() reads n samples into dst_size points from the
+// index (1) or falls back to decimate_samples() (0)
+uint8_t pyramid_indexed(uint32_t n, uint16_t dst_size, ScopeMode mode);
+
+#endif /* OSC_PYRAMID_H */
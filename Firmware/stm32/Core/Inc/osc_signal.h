@@ -5,20 +5,81 @@
 #include "arm_math.h"
 
 /* ==================== EXTERNAL BUFFERS ==================== */
-extern uint16_t adc_buffer[ADC_BUFFER_SIZE];
-extern float32_t fft_input[FFT_SIZE];
-extern float32_t fft_output[FFT_SIZE];
-extern float32_t fft_accumulator[FFT_SIZE/2];
-extern arm_rfft_fast_instance_f32 fft_instance;
+#if FFT_ENGINE == FFT_ENGINE_Q15
+typedef q15_t fft_sample_t;
+typedef arm_rfft_instance_q15 fft_instance_t;
+#define FFT_OUTPUT_SIZE     (FFT_SIZE * 2)      // rfft_q15 writes both halves
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+typedef q31_t fft_sample_t;
+typedef arm_rfft_instance_q31 fft_instance_t;
+#define FFT_OUTPUT_SIZE     (FFT_SIZE * 2)
+#else
+typedef float32_t fft_sample_t;
+typedef arm_rfft_fast_instance_f32 fft_instance_t;
+#define FFT_OUTPUT_SIZE     FFT_SIZE            // Packed N/2 complex bins
+#endif
+
+// Acquisition memory: the live ADC record, the FFT working set behind it
+// and the deep-memory tail. Time-domain deep records run on over the FFT
+// buffers, which only the spectrum mode uses. osc_pyramid.h indexes all of
+// it: samples and index take 137/64 B per sample, so the tail shrinks until
+// both fit the SRAM of the unindexed DEEP_TAIL_SAMPLES (whole nodes)
+#define FFT_WORK_BYTES      (sizeof(fft_sample_t) * (FFT_SIZE + FFT_OUTPUT_SIZE) + \
+                             sizeof(float32_t) * (FFT_SIZE / 2))
+#define ACQ_BASE_SAMPLES    (ADC_BUFFER_SIZE + FFT_WORK_BYTES / 2)
+#if OSC_PYRAMID
+#define DEEP_EXTRA_SAMPLES  ((((ACQ_BASE_SAMPLES + DEEP_TAIL_SAMPLES) * 128 / 137) - ACQ_BASE_SAMPLES) & ~511u)
+#else
+#define DEEP_EXTRA_SAMPLES  DEEP_TAIL_SAMPLES
+#endif
+#define ACQ_MEMORY_SAMPLES  (ACQ_BASE_SAMPLES + DEEP_EXTRA_SAMPLES)
+
+extern uint16_t acq_memory[ACQ_MEMORY_SAMPLES];
+extern uint16_t * const adc_buffer;                 // ADC_BUFFER_SIZE samples
+extern fft_sample_t * const fft_input;              // FFT_SIZE
+extern fft_sample_t * const fft_output;             // FFT_OUTPUT_SIZE
+extern float32_t * const fft_accumulator;           // FFT_SIZE/2
+extern fft_instance_t fft_instance;
 extern uint8_t fft_frame_count;
+extern FftCycles fft_cycles;
+
+// Welch PSD: FFT_SIZE segments of one capture, power averaged over
+// segments and, when one capture holds fewer, over consecutive captures
+#define WELCH_RECORD        ADC_BUFFER_SIZE     // One-shot capture per call
+#define WELCH_MAX_SEGMENTS  64
+#define WELCH_MAX_OVERLAP   75                  // Percent
+
+#define DIST_MAX_HARMONICS  20                  // THD up to the 21st harmonic
+
+// Peak threshold: noise floor from a histogram of bin levels in quarter
+// octaves (1.5 dB) below the strongest bin
+#define PEAK_HIST_BUCKETS   128                 // 192 dB below the strongest bin
+
+// dB spectra: 20*log10 from the float's exponent and a quartic fit of
+// log2(1 + x) on the mantissa, within 0.001 dB of log10f over its range
+static inline float32_t fast_db20(float32_t x) {
+    union { float32_t f; uint32_t u; } v = { (x > 1e-37f) ? x : 1e-37f };
+    int32_t e = (int32_t)(v.u >> 23) - 127;
+    v.u = (v.u & 0x007FFFFF) | 0x3F800000;
+    float32_t m = v.f - 1.0f;
+    float32_t log2 = (float32_t)e + m * (1.4387257f + m * (-0.6777839f +
+                                   m * (0.3211888f + m * -0.0821306f)));
+    return 6.0205999f * log2;
+}
 
 /* ==================== API FUNCTIONS ==================== */
 
 // Downsample src buffer to dst with specified mode
+// (MODE_ENVELOPE writes dst_size/2 interleaved min,max pairs)
 void decimate_samples(uint16_t *src, uint16_t src_size,
                       uint16_t *dst, uint16_t dst_size, ScopeMode mode);
 
-// Time-domain measurements (freq, amplitude, RMS, duty)
+// Reduce a MODE_ENVELOPE buffer to fewer (min,max) pairs (dst holds 2*buckets)
+void merge_envelope(const uint16_t *pairs, uint16_t pair_count,
+                    uint16_t *dst, uint16_t buckets);
+
+// Time-domain measurements (freq, amplitude, RMS, duty); buffer lies in
+// acq_memory and is indexed for pyramid_decimate() on the way
 void measure_time_domain(uint16_t *buffer, uint32_t size,
                          uint32_t sample_rate, Measurements *m);
 
@@ -26,10 +87,39 @@ void measure_time_domain(uint16_t *buffer, uint32_t size,
 void measure_freq_domain(uint16_t *src, uint32_t sample_rate,
                          uint16_t *dst, uint16_t dst_size, Measurements *m);
 
+// Welch PSD over src[0, n): overlapping windowed segments add their power
+// to the running sum. Returns 1 once segments have been averaged, with the
+// spectrum, peaks and dBFS tone/noise-floor levels in dst and m; 0 while
+// the estimate still needs more captures
+uint8_t measure_welch_domain(uint16_t *src, uint32_t n, uint32_t sample_rate,
+                             uint8_t segments, uint8_t overlap_percent,
+                             uint16_t *dst, uint16_t dst_size, Measurements *m);
+
+// Zoom-FFT of the band in osc_zoom's ring (call once zoom_ready()); same
+// outputs as measure_freq_domain() over the band, peaks in mHz
+void measure_zoom_domain(uint16_t *dst, uint16_t dst_size, Measurements *m);
+
 // Reset EMA filter state (call on settings change)
 void reset_measurement_filter(void);
 
-// Initialize FFT instance
-void init_fft(void);
+// Initialize FFT instance and window table
+void init_fft(FftWindow window);
+
+// Rebuild the window table (no-op if unchanged)
+void fft_set_window(FftWindow window);
+
+// Spectrum sample encoding: linear (display-scaled to the strongest bin)
+// or dB, one OSC_FRAME_DB_PER_LSB step per LSB above floor_db below ref_dbfs
+void fft_set_scale(uint8_t db, int16_t ref_dbfs, int16_t floor_db);
+
+// Distortion analysis of full-band spectra (rfft and Welch): THD over the
+// first `harmonics` harmonics, THD+N, SNR, SFDR and ENOB (0 = off)
+void fft_set_distortion(uint8_t harmonics);
+
+// Spectrum peaks: the `count` strongest local maxima at least spacing_hz
+// apart (0 = the window's main lobe) and margin_db above the percentile'th
+// bin level, strongest first, frequencies refined by `interp`
+void fft_set_peaks(uint8_t count, PeakInterp interp, uint16_t spacing_hz,
+                   uint8_t percentile, int8_t margin_db);
 
 #endif /* OSC_SIGNAL_H */
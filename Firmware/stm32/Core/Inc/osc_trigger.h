@@ -0,0 +1,42 @@
+#ifndef OSC_TRIGGER_H
+#define OSC_TRIGGER_H
+
+#include "main.h"
+#include "osc_config.h"
+
+/* ==================== TRIGGER CONFIG ==================== */
+#define TRIG_REFINE_SPAN    64      // Samples scanned back from AWD hit
+#define TRIG_AUTO_MIN_MS    20      // Auto mode free-run timeout floor
+#define TRIG_MAX_WINDOW     (ADC_BUFFER_SIZE - 2 * TRIG_REFINE_SPAN)
+
+/* ==================== API FUNCTIONS ==================== */
+
+// Start circular capture over adc_buffer and arm the analog watchdog
+// (window is clamped to TRIG_MAX_WINDOW). spill: samples behind adc_buffer
+// a window that wraps the ring end may run on into (0 if they're in use)
+void trigger_start(ADC_HandleTypeDef *hadc, const OscSettings *s, uint32_t window, uint32_t spill);
+
+// Disarm watchdog and forget any pending capture
+void trigger_stop(void);
+
+// Main loop poll; returns 1 once trigger_frame() holds a trigger-aligned
+// frame (capture is halted until trigger_rearm)
+uint8_t trigger_poll(void);
+
+// Start of the captured window, wherever it lies in acquisition memory
+uint16_t *trigger_frame(void);
+
+// Restart capture after the frame is consumed (holds after single shot)
+void trigger_rearm(void);
+
+// 1 while a single-shot frame is held after trigger_rearm
+uint8_t trigger_holding(void);
+
+// 1 if the last frame was an auto-mode free run rather than a real edge
+uint8_t trigger_was_forced(void);
+
+// Interrupt hooks: analog watchdog hit and DMA ring wrap
+void trigger_awd_isr(void);
+void trigger_wrap_isr(void);
+
+#endif /* OSC_TRIGGER_H */
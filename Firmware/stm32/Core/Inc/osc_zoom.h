@@ -0,0 +1,51 @@
+#ifndef OSC_ZOOM_H
+#define OSC_ZOOM_H
+
+#include <stdint.h>
+#include "osc_signal.h"
+
+/* ==================== ZOOM-FFT CONFIG ==================== */
+// NCO mix to baseband, CIC and FIR decimation, then the FFT_SIZE/2-point
+// complex FFT that rfft already carries. Decimated output collects in a
+// ring over fft_output, so the band costs no acquisition memory
+#define ZOOM_BINS           (FFT_SIZE / 2)      // Complex points per spectrum
+#define ZOOM_HOP            (ZOOM_BINS / 8)     // New outputs between spectra
+#define ZOOM_MIN_DECIMATION 4
+#define ZOOM_MAX_DECIMATION 4096
+#define ZOOM_CIC_ORDER      4
+#define ZOOM_CIC_A_MAX      16      // First CIC stage rate change: 32-bit state at the ADC rate
+#define ZOOM_FIR_TAPS       48      // Droop-compensating low-pass, decimates by 2
+#define ZOOM_NCO_BITS       10      // Cosine table entries (log2)
+
+typedef struct {
+    uint32_t center_hz;             // NCO frequency
+    uint16_t decimation;            // ADC samples per complex output (0 = zoom off)
+    uint8_t  log2;                  // log2(decimation)
+    float32_t rate_hz;              // Complex output rate = displayed band width
+} ZoomBand;
+
+/* ==================== API FUNCTIONS ==================== */
+
+// Pick the band for a centre and span at the ADC rate (span 0 turns zoom
+// off): the narrowest power-of-two decimation still at least span wide,
+// centre moved in if the band would cross DC or Nyquist. Redesigns the FIR for that decimation and restarts the decimators
+void zoom_configure(uint32_t center_hz, uint32_t span_hz, uint32_t sample_rate);
+
+// Current band (decimation 0 while zoom is off)
+const ZoomBand *zoom_band(void);
+
+// Restart the decimators and empty the ring (the stream had a gap)
+void zoom_reset(void);
+
+// Mix and decimate the next n ADC samples of the stream (n a multiple of
+// ZOOM_CIC_A_MAX, as ADC halves are) into the ring
+void zoom_feed(const uint16_t *src, uint32_t n);
+
+// ZOOM_HOP new outputs since the last zoom_take()
+uint8_t zoom_ready(void);
+
+// Claim the ring for a spectrum: fft_output holds ZOOM_BINS interleaved
+// (I,Q) values, oldest at the returned index (zeros until it first fills)
+uint32_t zoom_take(void);
+
+#endif /* OSC_ZOOM_H */
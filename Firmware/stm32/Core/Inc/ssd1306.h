@@ -13,13 +13,35 @@
 
 #include "main.h"
 
+#define SSD1306_WIDTH       128
+#define SSD1306_HEIGHT      64
+#define SSD1306_PAGES       (SSD1306_HEIGHT / 8)     // 8-pixel rows, one byte per column
+
 // Public functions
 void ssd1306_init(void);
 void ssd1306_clear(void);
-void ssd1306_update(void);
+
+// Queue the pages/columns that changed since the last frame over I2C DMA
+// and return at once; 0 = previous frame still in flight (nothing queued,
+// the drawing stays in the back buffer)
+uint8_t ssd1306_update(void);
+
+// 1 when no transfer is in flight (worth drawing a new frame)
+uint8_t ssd1306_ready(void);
+uint32_t ssd1306_error_count(void);
+
+// Copy whole pages between a layer and the drawing buffer
+void ssd1306_save_pages(uint8_t *dst, uint8_t first, uint8_t count);
+void ssd1306_load_pages(const uint8_t *src, uint8_t first, uint8_t count);
+
+// Interrupt hooks: I2C memory-write complete and I2C error
+void ssd1306_tx_isr(void);
+void ssd1306_error_isr(void);
+
 void ssd1306_print(uint8_t x, uint8_t y, const char *str);
 void ssd1306_draw_pixel(uint8_t x, uint8_t y, uint8_t color);
 void ssd1306_draw_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void ssd1306_draw_vline(uint8_t x, uint8_t y0, uint8_t y1);  // Page-byte fill, either order
 void ssd1306_fill_rect(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
 
 // Test functions (optional, for testing only)
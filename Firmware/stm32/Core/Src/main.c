@@ -25,6 +25,12 @@
 #include "osc_config.h"
 #include "osc_signal.h"
 #include "osc_display.h"
+#include "osc_trigger.h"
+#include "osc_deep.h"
+#include "osc_pyramid.h"
+#include "osc_zoom.h"
+#include "osc_frame.h"
+#include "osc_profile.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -50,6 +56,7 @@ ADC_HandleTypeDef hadc1;
 DMA_HandleTypeDef hdma_adc1;
 
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_tx;
 
 SPI_HandleTypeDef hspi2;
 DMA_HandleTypeDef hdma_spi2_tx;
@@ -61,22 +68,34 @@ UART_HandleTypeDef huart2;
 
 /* USER CODE BEGIN PV */
 
-// Display and command buffers
-uint16_t display_buffer[DISPLAY_SAMPLES];
+// SPI frame (protocol header + display samples) and command buffer
+uint8_t spi_frame[OSC_FRAME_MAX_BYTES] __attribute__((aligned(4)));
+uint16_t * const display_buffer = (uint16_t*)(spi_frame + OSC_FRAME_MAX_HEADER);   // Header ends here
+uint16_t display_count = DISPLAY_SAMPLES;
 char cmd_buffer[CMD_BUFFER_SIZE];
 
 // State flags
 volatile uint8_t adc_ready = 0;
-volatile uint8_t spi_busy = 0;
+volatile uint8_t spi_busy = 0;         // Frame transmission in progress
+volatile uint8_t spi_chunk_busy = 0;   // Chunk DMA in flight
 volatile uint8_t cmd_ready = 0;
 volatile uint16_t actual_samples_captured = 0;
 volatile uint8_t cmd_index = 0;
 uint8_t uart_rx_byte = 0;
 
+// Continuous acquisition: half of adc_buffer last completed by DMA
+uint16_t * volatile adc_frame = acq_memory;
+AcqStats acq_stats = {0};
+volatile uint8_t acq_triggered = 0;
+volatile uint8_t acq_circular = 0;     // DMA ping-pongs the two halves
+uint8_t acq_stop_pending = 0;          // STOP: halt after the next complete frame
+uint8_t acq_stopped = 0;               // Halted; the last frame is the record
+
 // Configuration
 OscSettings settings = DEFAULT_SETTINGS;
 Measurements measurements = {0};
 uint8_t measurements_enabled = 0;
+uint8_t bench_enabled = 0;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -92,39 +111,345 @@ static void MX_SPI2_Init(void);
 /* USER CODE BEGIN PFP */
 static void apply_settings(OscSettings *s);
 static void process_command(char *cmd);
+static void acq_stats_reset(void);
+static void acq_stats_frame(uint32_t samples);
+static void adc_publish_frame(uint16_t *frame);
+static void adc_start_dma(uint32_t length);
+static uint8_t acq_halt(uint16_t *frame);
+static void bench_reset(void);
+static void bench_record(uint32_t cycles, uint32_t samples);
+static uint8_t *frame_header_encode(uint8_t flags, uint16_t count,
+                                    uint32_t rec_start, uint32_t rec_span, uint8_t rec_tag);
+static void spi_send_frame(uint8_t *frame, uint32_t length);
+static void spi_poll(void);
+static void deep_request_window(char *args);
+static uint8_t deep_send_window(void);
+static uint8_t deep_holding(void);
+static void stack_paint(void);
+static void memory_report(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
+/* ==================== ACQUISITION STATISTICS ==================== */
+static uint32_t stats_tick = 0, stats_frames = 0, stats_samples = 0;
+
+static void acq_stats_reset(void) {
+    memset(&acq_stats, 0, sizeof(acq_stats));
+    stats_tick = HAL_GetTick();
+    stats_frames = stats_samples = 0;
+}
+
+// Account one processed frame; refreshes fps/dead time once per second
+static void acq_stats_frame(uint32_t samples) {
+    stats_frames++;
+    stats_samples += samples;
+
+    uint32_t elapsed = HAL_GetTick() - stats_tick;
+    if(elapsed < 1000) return;
+
+    // Dead time = share of the ADC stream that never reached processing
+    uint64_t streamed = (uint64_t)settings.sample_rate_hz * elapsed / 1000;
+    acq_stats.dead_permille = (streamed > stats_samples) ?
+        (uint16_t)(1000 - ((uint64_t)stats_samples * 1000) / streamed) : 0;
+    acq_stats.fps = (stats_frames * 1000) / elapsed;
+
+    stats_tick = HAL_GetTick();
+    stats_frames = stats_samples = 0;
+}
+
+/* ==================== CYCLE BENCHMARK ==================== */
+// B:1 reports DWT cycles spent in measure_time_domain / measure_freq_domain
+// every BENCH_REPORT calls; FFT mode adds the last frame's per-stage split
+#define BENCH_REPORT 32
+static uint32_t bench_min, bench_max, bench_calls;
+static uint64_t bench_sum;
+
+static void bench_reset(void) {
+    bench_min = UINT32_MAX;
+    bench_max = bench_calls = 0;
+    bench_sum = 0;
+}
+
+static void bench_record(uint32_t cycles, uint32_t samples) {
+    if(cycles < bench_min) bench_min = cycles;
+    if(cycles > bench_max) bench_max = cycles;
+    bench_sum += cycles;
+    if(++bench_calls < BENCH_REPORT) return;
+
+    // B:avg,min,max,samples,fps (cycles per call, last frame length)
+    // BF:avg,min,max,window,fft,magnitude,peaks,segments,distortion,fps
+    // (Welch: segments per call, so segments/s = segments * SYSTEM_CLOCK_HZ
+    // / avg); fps is acq_stats.fps, frames processed over the last second
+    char buf[112];
+    if(settings.display_mode == DISPLAY_FREQ)
+        snprintf(buf, sizeof(buf), "BF:%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%u\n",
+                 (uint32_t)(bench_sum / bench_calls), bench_min, bench_max,
+                 fft_cycles.window, fft_cycles.fft, fft_cycles.magnitude,
+                 fft_cycles.peaks, fft_cycles.segments, fft_cycles.distortion,
+                 acq_stats.fps);
+    else
+        snprintf(buf, sizeof(buf), "B:%lu,%lu,%lu,%lu,%u\n",
+                 (uint32_t)(bench_sum / bench_calls), bench_min, bench_max, samples,
+                 acq_stats.fps);
+    HAL_UART_Transmit(&huart2, (uint8_t*)buf, strlen(buf), 20);
+    bench_reset();
+}
+
+/* ==================== SPI FRAME HEADER ==================== */
+static uint32_t frame_seq = 0;
+
+// Measurements ride in the header of every SPI frame. The header is laid
+// out to end at display_buffer; returns where the frame starts
+static uint8_t *frame_header_encode(uint8_t flags, uint16_t count,
+                                    uint32_t rec_start, uint32_t rec_span, uint8_t rec_tag) {
+    OscFrameHeader h = {
+        .flags = flags,
+        .sample_count = count,
+        .seq = frame_seq++,
+        .sample_rate_hz = settings.sample_rate_hz
+    };
+
+    if(flags & OSC_FRAME_MEAS) {
+        h.amplitude_mv = measurements.amplitude_mv;
+        h.period_us = measurements.period_us;
+        h.vrms_mv = measurements.vrms_mv;
+        h.duty_percent = measurements.duty_percent;
+        h.vmax_mv = measurements.vmax_mv;
+        h.vmin_mv = measurements.vmin_mv;
+        h.frequency_hz = measurements.frequency_hz;
+        h.num_peaks = measurements.num_peaks;
+        for(uint8_t i = 0; i < OSC_FRAME_MAX_PEAKS; i++) {
+            h.peak_freqs[i] = measurements.peak_freqs[i];
+            h.peak_mags[i] = measurements.peak_mags[i];
+        }
+        h.psd_segments = measurements.psd_segments;
+        h.psd_overlap = measurements.psd_overlap;
+        h.psd_tone_cdbfs = measurements.psd_tone_cdbfs;
+        h.psd_floor_cdbfs = measurements.psd_floor_cdbfs;
+        h.dist_harmonics = measurements.dist_harmonics;
+        h.thd_cdb = measurements.thd_cdb;
+        h.thdn_cdb = measurements.thdn_cdb;
+        h.snr_cdb = measurements.snr_cdb;
+        h.sfdr_cdb = measurements.sfdr_cdb;
+        h.enob_cbits = measurements.enob_cbits;
+    }
+
+    if(flags & OSC_FRAME_ZOOM) {
+        h.zoom_center_hz = zoom_band()->center_hz;
+        h.zoom_log2 = zoom_band()->log2;
+    }
+
+    if(flags & OSC_FRAME_SPECTRUM) {
+        h.db_scale = settings.spectrum_db ? OSC_FRAME_SCALE_DB : OSC_FRAME_SCALE_LINEAR;
+        h.db_ref_cdbfs = settings.db_ref_dbfs * 100;
+        h.db_floor_cdb = settings.db_floor_db * 100;
+    }
+
+    if(flags & OSC_FRAME_RECORD) {
+        const DeepRecord *rec = deep_record();
+        h.rec_start = rec_start;
+        h.rec_span = rec_span;
+        h.rec_total = rec->total;
+        h.rec_id = rec->id;
+        h.rec_segments = rec->segments;
+        h.rec_filled = rec->filled;
+        h.rec_tag = rec_tag;
+    }
+
+    uint8_t *frame = (uint8_t*)display_buffer - osc_frame_header_len(flags, h.num_peaks);
+    osc_frame_encode(&h, frame);
+    return frame;
+}
+
+/* ==================== CHUNKED SPI TRANSMIT ==================== */
+// Frames larger than one chunk go out as consecutive CS-framed transactions
+static uint8_t *spi_tx_buf = spi_frame;
+static uint32_t spi_tx_pos = 0, spi_tx_len = 0;
+static volatile uint32_t spi_chunk_tick = 0;
+
+static void spi_send_chunk(void) {
+    uint32_t n = spi_tx_len - spi_tx_pos;
+    if(n > OSC_FRAME_CHUNK_BYTES) n = OSC_FRAME_CHUNK_BYTES;
+
+    spi_chunk_busy = 1;
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_12, GPIO_PIN_RESET);
+    HAL_SPI_Transmit_DMA(&hspi2, spi_tx_buf + spi_tx_pos, n);
+    spi_tx_pos += n;
+}
+
+static void spi_send_frame(uint8_t *frame, uint32_t length) {
+    spi_tx_buf = frame;
+    spi_tx_pos = 0;
+    spi_tx_len = length;
+    spi_busy = 1;
+    spi_send_chunk();
+}
+
+// Main loop: start the next chunk once the ESP32 had time to re-arm
+static void spi_poll(void) {
+    if(!spi_busy || spi_chunk_busy) return;
+    if((HAL_GetTick() - spi_chunk_tick) < SPI_CHUNK_GAP_MS) return;
+    spi_send_chunk();
+}
+
+/* ==================== DEEP MEMORY WINDOWS ==================== */
+// I: queues a request for record[start, start + span) decimated to points
+// (mode M); each reply is a RECORD|WINDOW frame carrying the request's tag,
+// sent ahead of the next live frame
+static uint32_t window_tick;
+static uint8_t window_hold = 0;
+
+static void deep_request_window(char *args) {
+    deep_request(args, DISPLAY_SAMPLES, settings.mode);
+    window_hold = 1;
+    window_tick = HAL_GetTick();
+}
+
+// Answer the oldest queued request; 0 if none is waiting
+static uint8_t deep_send_window(void) {
+    DeepWindowRequest req;
+    if(!deep_next_request(&req)) return 0;
+
+    uint32_t start = req.start, span = req.span;
+    uint16_t count = deep_window(&start, &span, display_buffer, req.points, req.mode);
+
+    uint8_t flags = OSC_FRAME_RECORD | OSC_FRAME_WINDOW;
+    if(req.mode == MODE_ENVELOPE) flags |= OSC_FRAME_ENVELOPE;
+    uint8_t *frame = frame_header_encode(flags, count, start, span, req.tag);
+    spi_send_frame(frame, (uint8_t*)(display_buffer + count) - frame);
+    return 1;
+}
+
+// A single record is captured in place: keep it frozen while a client reads it
+static uint8_t deep_holding(void) {
+    if(!window_hold || deep_record()->segments != 1) return 0;
+    if((HAL_GetTick() - window_tick) < DEEP_HOLD_MS) return 1;
+    window_hold = 0;
+    return 0;
+}
+
+/* ==================== MEMORY BUDGET ==================== */
+// Linker script symbols (STM32F411CEUX_FLASH.ld) and the newlib heap break
+extern uint8_t _sdata, _ebss, _end, _estack;
+extern void *_sbrk(ptrdiff_t incr);
+#define STACK_PAINT 0xA5A5A5A5u
+
+// Fill the gap between heap and stack so the report can find the stack peak
+static void stack_paint(void) {
+    uint32_t *p = (uint32_t*)(((uintptr_t)_sbrk(0) + 3) & ~3u);
+    uint32_t *sp = (uint32_t*)(uintptr_t)(__get_MSP() - 64);
+    while(p < sp) *p++ = STACK_PAINT;
+}
+
+// H:ram,static,acq_memory,fft_shared,deep_extra,record_max,heap,stack_peak,free,pyramid
+// (bytes, record_max in samples)
+static void memory_report(void) {
+    uint8_t *heap_top = _sbrk(0);
+    uint32_t *p = (uint32_t*)(((uintptr_t)heap_top + 3) & ~3u);
+    while(p < (uint32_t*)&_estack && *p == STACK_PAINT) p++;
+
+    char buf[112];
+    snprintf(buf, sizeof(buf), "H:%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+             (uint32_t)(&_estack - &_sdata), (uint32_t)(&_ebss - &_sdata),
+             (uint32_t)sizeof(acq_memory), (uint32_t)FFT_WORK_BYTES,
+             (uint32_t)(DEEP_EXTRA_SAMPLES * sizeof(uint16_t)), deep_capacity(1),
+             (uint32_t)(heap_top - &_end), (uint32_t)(&_estack - (uint8_t*)p),
+             (uint32_t)((uint8_t*)p - heap_top), (uint32_t)PYR_BYTES);
+    HAL_UART_Transmit(&huart2, (uint8_t*)buf, strlen(buf), 20);
+}
+
 /* ==================== HARDWARE CONFIGURATION ==================== */
+// Overrun IRQ stays masked: one-shot frames leave the ADC running past the DMA
+static void adc_start_dma(uint32_t length) {
+    HAL_ADC_Start_DMA(&hadc1, (uint32_t*)adc_buffer, length);
+    __HAL_ADC_DISABLE_IT(&hadc1, ADC_IT_OVR);
+}
+
+// STOP lands on a complete frame: halt the ADC there and keep the frame
+// for I: windows (deep records are retained as they are)
+static uint8_t acq_halt(uint16_t *frame) {
+    trigger_stop();
+    HAL_ADC_Stop_DMA(&hadc1);
+    HAL_TIM_Base_Stop(&htim2);
+    adc_ready = 0;
+    acq_stop_pending = 0;
+    acq_stopped = 1;
+    if(settings.display_mode != DISPLAY_TIME) return 0;
+    return deep_retain(frame, actual_samples_captured);
+}
+
 static void apply_settings(OscSettings *s) {
+    fft_set_window(s->fft_window);
+    fft_set_scale(s->spectrum_db, s->db_ref_dbfs, s->db_floor_db);
+    fft_set_distortion(s->dist_harmonics);
+    fft_set_peaks(s->peak_count, s->peak_interp, s->peak_spacing_hz,
+                  s->peak_percentile, s->peak_margin_db);
+    bench_reset();
+    prof_reset();
+
     // Stop peripherals
+    trigger_stop();
     HAL_ADC_Stop_DMA(&hadc1);
     HAL_TIM_Base_Stop(&htim2);
     HAL_TIM_PWM_Stop(&htim3, TIM_CHANNEL_1);
-    adc_ready = spi_busy = 0;
-    memset(adc_buffer, 0, sizeof(adc_buffer));
+    HAL_SPI_Abort(&hspi2);
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_12, GPIO_PIN_SET);
+    adc_ready = spi_busy = spi_chunk_busy = 0;
+    memset(adc_buffer, 0, ADC_BUFFER_SIZE * sizeof(uint16_t));
+
+    // Changing settings while stopped takes one fresh frame and stops again
+    acq_stop_pending |= acq_stopped;
+    acq_stopped = 0;
     HAL_Delay(2);
 
+    // Triggered capture runs a circular ring over the whole buffer;
+    // continuous mode ping-pongs two halves of it. A single deep record is
+    // one untriggered shot over all of acq_memory, segments bound the record.
+    // Zoom-FFT needs the unbroken stream, so it always ping-pongs; a Welch
+    // PSD overlaps its segments within one-shot records of the whole buffer
+    uint8_t deep_segments = (s->display_mode == DISPLAY_TIME) ? s->deep_segments : 0;
+    uint8_t zoom = (s->display_mode == DISPLAY_FREQ && s->zoom_span_hz);
+    uint8_t welch = (s->display_mode == DISPLAY_FREQ && s->welch_segments && !zoom);
+    acq_triggered = (s->trig_mode != TRIG_OFF && s->display_mode == DISPLAY_TIME && deep_segments != 1);
+    acq_circular = ((s->continuous_acq || zoom) && !welch && !acq_triggered && deep_segments != 1);
+    uint32_t record = (deep_segments == 1) ? ACQ_MEMORY_SAMPLES :
+                      acq_triggered ? TRIG_MAX_WINDOW :
+                      acq_circular ? ADC_BUFFER_SIZE / 2 : ADC_BUFFER_SIZE;
+    if(deep_segments > 1 && record > deep_capacity(deep_segments))
+        record = deep_capacity(deep_segments);
+    hdma_adc1.Init.Mode = (acq_triggered || acq_circular) ? DMA_CIRCULAR : DMA_NORMAL;
+    HAL_DMA_Init(&hdma_adc1);
+
     // Calculate sample rate based on mode
     uint64_t window_us = (uint64_t)s->time_div_us * 10;
     uint32_t target_rate, samples_needed;
 
     if(s->display_mode == DISPLAY_FREQ) {
         target_rate = SR_FFT_MODE;
-        samples_needed = FFT_SIZE;
+        samples_needed = welch ? WELCH_RECORD : FFT_SIZE;
     } else {
-        target_rate = window_us ? (ADC_BUFFER_SIZE * 1000000ULL / window_us) : SR_TIME_MODE_MAX;
+        target_rate = window_us ? (record * 1000000ULL / window_us) : SR_TIME_MODE_MAX;
         if(target_rate > SR_TIME_MODE_MAX) target_rate = SR_TIME_MODE_MAX;
         if(target_rate < 10) target_rate = 10;
         samples_needed = (target_rate * window_us) / 1000000ULL;
-        if(samples_needed > ADC_BUFFER_SIZE) samples_needed = ADC_BUFFER_SIZE;
+        if(samples_needed > record) samples_needed = record;
         if(samples_needed < DISPLAY_SAMPLES) samples_needed = DISPLAY_SAMPLES;
     }
 
     s->sample_rate_hz = target_rate;
     actual_samples_captured = samples_needed;
+    zoom_configure(s->zoom_center_hz, zoom ? s->zoom_span_hz : 0, target_rate);
+
+    // Frame resolution: requested size, capped at the record (or spectrum) length
+    uint32_t frame_max = (s->display_mode == DISPLAY_FREQ) ? FFT_SIZE / 2 : samples_needed;
+    if(frame_max > OSC_FRAME_MAX_SAMPLES) frame_max = OSC_FRAME_MAX_SAMPLES;
+    display_count = (s->frame_samples && s->frame_samples < frame_max) ? s->frame_samples : frame_max;
+    display_count &= ~1u;  // Envelope frames carry whole (min,max) pairs
+    adc_frame = adc_buffer;
+    acq_stats_reset();
+    deep_configure(deep_segments, samples_needed);
 
     // Configure TIM2 (ADC trigger)
     HAL_TIM_Base_DeInit(&htim2);
@@ -159,8 +484,14 @@ static void apply_settings(OscSettings *s) {
     };
     HAL_TIM_PWM_ConfigChannel(&htim3, &oc, TIM_CHANNEL_1);
 
-    // Start acquisition
-    HAL_ADC_Start_DMA(&hadc1, (uint32_t*)adc_buffer, samples_needed);
+    // Start acquisition (circular DMA covers both halves)
+    // A wrapped trigger window runs on over the idle FFT buffers unless
+    // segments live there
+    if(acq_triggered)
+        trigger_start(&hadc1, s, samples_needed,
+                      deep_segments ? 0 : ACQ_MEMORY_SAMPLES - ADC_BUFFER_SIZE);
+    else
+        adc_start_dma(acq_circular ? samples_needed * 2 : samples_needed);
     HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_1);
     HAL_TIM_Base_Start(&htim2);
 }
@@ -184,14 +515,64 @@ static void process_command(char *cmd) {
             apply_settings(&settings);
             break;
 
-        case 'D':  // Duty cycle: D:50
+        case 'D':
+            if(cmd[1] == 'B') {  // dB spectrum: DB:mode[,ref_dbfs[,floor_db]]
+                if(cmd[2] != ':') break;  // Fields start past the ':' (cmd[3] may be stale)
+                char *ref = strchr(&cmd[3], ',');
+                char *lo = ref ? strchr(ref + 1, ',') : NULL;
+                settings.spectrum_db = (atoi(&cmd[3]) != 0);
+                if(ref) {
+                    int r = atoi(ref + 1);
+                    settings.db_ref_dbfs = (r < -100) ? -100 : (r > 100) ? 100 : r;
+                }
+                if(lo) {
+                    int f = atoi(lo + 1);
+                    settings.db_floor_db = (f < -300) ? -300 : (f > -10) ? -10 : f;
+                }
+                fft_set_scale(settings.spectrum_db, settings.db_ref_dbfs, settings.db_floor_db);
+                break;
+            }
+            if(cmd[1] == 'H') {  // Distortion analysis: DH:harmonics (DH:0 = off)
+                int n = (cmd[2] == ':') ? atoi(&cmd[3]) : 0;
+                settings.dist_harmonics = (n < 0) ? 0 : (n > DIST_MAX_HARMONICS) ? DIST_MAX_HARMONICS : n;
+                fft_set_distortion(settings.dist_harmonics);
+                break;
+            }
+            if(cmd[1] == 'P') {  // Peaks: DP:count[,interp[,spacing_hz[,percentile[,margin_db]]]]
+                if(cmd[2] != ':') break;
+                char *f[4] = {NULL};
+                f[0] = strchr(&cmd[3], ',');
+                for(uint8_t i = 1; i < 4 && f[i-1]; i++) f[i] = strchr(f[i-1] + 1, ',');
+                int k = atoi(&cmd[3]);
+                settings.peak_count = (k < 1) ? 1 : (k > MAX_PEAKS) ? MAX_PEAKS : k;
+                if(f[0]) {
+                    int v = atoi(f[0] + 1);
+                    settings.peak_interp = (v < 0 || v > PEAK_JACOBSEN) ? PEAK_JACOBSEN : (PeakInterp)v;
+                }
+                if(f[1]) {
+                    int v = atoi(f[1] + 1);
+                    settings.peak_spacing_hz = (v < 0) ? 0 : (v > 65535) ? 65535 : v;
+                }
+                if(f[2]) {
+                    int v = atoi(f[2] + 1);
+                    settings.peak_percentile = (v < 0) ? 0 : (v > 100) ? 100 : v;
+                }
+                if(f[3]) {
+                    int v = atoi(f[3] + 1);
+                    settings.peak_margin_db = (v < -60) ? -60 : (v > 60) ? 60 : v;
+                }
+                fft_set_peaks(settings.peak_count, settings.peak_interp, settings.peak_spacing_hz,
+                              settings.peak_percentile, settings.peak_margin_db);
+                break;
+            }
+            // Duty cycle: D:50
             settings.duty_cycle_percent = (val < 1) ? 1 : (val > 99) ? 99 : val;
             reset_measurement_filter();
             apply_settings(&settings);
             break;
 
-        case 'M':  // Mode: M:0/1/2
-            if(val <= 2) settings.mode = (ScopeMode)val;
+        case 'M':  // Mode: M:0/1/2/3
+            if(val <= MODE_ENVELOPE) settings.mode = (ScopeMode)val;
             reset_measurement_filter();
             break;
 
@@ -204,17 +585,142 @@ static void process_command(char *cmd) {
             }
             break;
 
+        case 'A':  // Acquisition: A:0 one-shot, A:1 continuous
+            settings.continuous_acq = (val != 0);
+            reset_measurement_filter();
+            fft_frame_count = 0;
+            apply_settings(&settings);
+            break;
+
+        case 'Q': {  // Acquisition stats: Q -> Q:fps,dead_permille,overruns,continuous
+            char buf[48];
+            snprintf(buf, sizeof(buf), "Q:%u,%u,%lu,%u\n",
+                     acq_stats.fps, acq_stats.dead_permille,
+                     acq_stats.overruns, settings.continuous_acq);
+            HAL_UART_Transmit(&huart2, (uint8_t*)buf, strlen(buf), 20);
+            break;
+        }
+
+        case 'G':  // Trigger mode: G:0 off, 1 auto, 2 normal, 3 single (re-arms)
+            if(val <= 3) {
+                settings.trig_mode = (TriggerMode)val;
+                apply_settings(&settings);
+            }
+            break;
+
+        case 'L':  // Trigger level: L:1650 (mV)
+            settings.trig_level_mv = (val < 0) ? 0 : (val > 3300) ? 3300 : val;
+            apply_settings(&settings);
+            break;
+
+        case 'J':  // Trigger slope: J:0 rising, J:1 falling
+            settings.trig_edge = val ? TRIG_FALLING : TRIG_RISING;
+            apply_settings(&settings);
+            break;
+
+        case 'Y':  // Trigger hysteresis: Y:50 (mV)
+            settings.trig_hyst_mv = (val < 1) ? 1 : (val > 1000) ? 1000 : val;
+            apply_settings(&settings);
+            break;
+
+        case 'O':  // Trigger holdoff: O:0 (us)
+            settings.trig_holdoff_us = (val < 0) ? 0 : (val > 65535) ? 65535 : val;
+            apply_settings(&settings);
+            break;
+
+        case 'W':  // Pre-trigger: W:50 (% of window)
+            settings.trig_pre_percent = (val < 0) ? 0 : (val > 100) ? 100 : val;
+            apply_settings(&settings);
+            break;
+
+        case 'N':  // FFT window: N:0 Hann, 1 Hamming, 2 Blackman-Harris, 3 flat-top
+            if(val <= WIN_FLATTOP) {
+                settings.fft_window = (FftWindow)val;
+                fft_set_window(settings.fft_window);
+            }
+            break;
+
+        case 'Z':  // Frame resolution: Z:256/1024/4096 samples, Z:0 full record
+            settings.frame_samples = (val <= 0 || val >= OSC_FRAME_MAX_SAMPLES) ? 0 :
+                                     (val < 64) ? 64 : val;
+            apply_settings(&settings);
+            break;
+
+        case 'K':  // Deep memory: K:0 off, K:1 single record, K:n segments
+            settings.deep_segments = (val < 0) ? 0 : (val > DEEP_MAX_SEGMENTS) ? DEEP_MAX_SEGMENTS : val;
+            reset_measurement_filter();
+            apply_settings(&settings);
+            break;
+
+        case 'C': {  // Zoom-FFT: C:center_hz,span_hz (span 0 = full spectrum)
+            char *span = strchr(&cmd[2], ',');
+            settings.zoom_center_hz = (val < 0) ? 0 : val;
+            settings.zoom_span_hz = (span && atoi(span + 1) > 0) ? atoi(span + 1) : 0;
+            fft_frame_count = 0;  // Restart averaging over the new band
+            apply_settings(&settings);
+            break;
+        }
+
+        case 'U': {  // Welch PSD: U:segments,overlap_percent (U:0 = EMA spectrum)
+            char *overlap = strchr(&cmd[2], ',');
+            settings.welch_segments = (val < 0) ? 0 : (val > WELCH_MAX_SEGMENTS) ? WELCH_MAX_SEGMENTS : val;
+            if(overlap) {
+                int ov = atoi(overlap + 1);
+                settings.welch_overlap = (ov < 0) ? 0 : (ov > WELCH_MAX_OVERLAP) ? WELCH_MAX_OVERLAP : ov;
+            }
+            fft_frame_count = 0;
+            apply_settings(&settings);
+            break;
+        }
+
+        case 'I':  // Record window: I:start,span,points[,mode[,tag]]
+            deep_request_window(&cmd[2]);
+            break;
+
+        case 'H':  // Memory budget report
+            memory_report();
+            break;
+
+        case 'B':  // Benchmark: B:0/1 (cycle counts over UART)
+            bench_enabled = (val != 0);
+            bench_reset();
+            break;
+
+#if OSC_PROFILE
+        case 'P':  // Profiling: P:0 off, P:1 on, P:2 dump, P:3 clear
+            if(val <= 1) prof_enable(val);
+            else if(val == 2) prof_dump(&huart2);
+            else prof_reset();
+            break;
+#endif
+
         case 'E':  // Measurements: E:0/1
             measurements_enabled = (cmd[2] == '1');
             reset_measurement_filter();
             break;
 
-        case 'R':  // Reset
+        case 'R':  // Reset / RUN
             if(strcmp(cmd, "RESET") == 0) {
                 settings = (OscSettings)DEFAULT_SETTINGS;
                 reset_measurement_filter();
                 fft_frame_count = 0;
                 apply_settings(&settings);
+            } else if(strcmp(cmd, "RUN") == 0) {
+                acq_stop_pending = 0;
+                if(acq_stopped) {
+                    acq_stopped = 0;
+                    apply_settings(&settings);
+                }
+            }
+            break;
+
+        case 'S':  // STOP: freeze on the next complete frame
+            if(strcmp(cmd, "STOP") != 0 || acq_stopped) break;
+            acq_stop_pending = 1;
+            // A held single shot is that frame already: run it through once more
+            if(acq_triggered && trigger_holding()) {
+                adc_frame = trigger_frame();
+                adc_ready = 1;
             }
             break;
     }
@@ -267,8 +773,15 @@ int main(void)
   ssd1306_update();
   HAL_Delay(1000);
 
-  init_fft();
+  // DWT cycle counter for B: benchmark reports and P: profiling
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  prof_init();
+
+  init_fft(settings.fft_window);
   apply_settings(&settings);
+  stack_paint();
   HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
 
   ssd1306_clear();
@@ -278,92 +791,181 @@ int main(void)
   /* USER CODE END 2 */
 
   /* USER CODE BEGIN WHILE */
-  static uint8_t meas_counter = 0;
-  static uint8_t oled_counter = 0;
   static uint8_t frames_to_discard = 0;
+  static uint32_t zoom_overruns = 0;
 
   while(1) {
       // Process commands
       if(cmd_ready) {
           cmd_ready = 0;
+          PROF_BEGIN(t_cmd);
           process_command(cmd_buffer);
-          meas_counter = 0;
-          frames_to_discard = 3;  // Discard stale frames
+          PROF_END(PROF_COMMAND, t_cmd);
+          // Discard stale frames (record queries and STOP leave the acquisition alone)
+          if(cmd_buffer[0] != 'I' && cmd_buffer[0] != 'H' && cmd_buffer[0] != 'S') frames_to_discard = 3;
+      }
+
+      // Continue a multi-chunk SPI frame
+      spi_poll();
+
+      // Deep-record window goes out ahead of the next live frame
+      if(!spi_busy) deep_send_window();
+
+      // Triggered capture: engine reports a trigger-aligned frame
+      if(acq_triggered && !adc_ready && trigger_poll()) {
+          adc_frame = trigger_frame();
+          adc_ready = 1;
+      }
+
+      // Zoom-FFT: every half feeds the decimators, even while a frame is on
+      // the bus; a spectrum is due each ZOOM_HOP outputs. A lost half breaks
+      // the stream, so the decimators start over
+      uint8_t zoom_due = 0;
+      if(zoom_band()->decimation) {
+          if(adc_ready) {
+              adc_ready = 0;
+              if(frames_to_discard > 0) {
+                  frames_to_discard--;
+              } else {
+                  if(acq_stats.overruns != zoom_overruns) {
+                      zoom_overruns = acq_stats.overruns;
+                      zoom_reset();
+                  }
+                  PROF_BEGIN(t_zoom);
+                  zoom_feed(adc_frame, actual_samples_captured);
+                  PROF_END(PROF_ZOOM_FEED, t_zoom);
+                  acq_stats_frame(actual_samples_captured);
+              }
+          }
+          zoom_due = zoom_ready();
       }
 
       // Process ADC data
-      if(adc_ready && !spi_busy) {
+      if((adc_ready || zoom_due) && !spi_busy) {
           adc_ready = 0;
+          uint16_t *frame = adc_frame;
 
-          if(frames_to_discard > 0) { frames_to_discard--; continue; }
+          // Triggered frames are captured fresh after every restart
+          if(frames_to_discard > 0 && !acq_triggered && !zoom_due) { frames_to_discard--; continue; }
+          PROF_BEGIN(t_frame);
 
           // Measure and prepare display buffer
           if(settings.display_mode == DISPLAY_FREQ) {
-              measure_freq_domain(adc_buffer, settings.sample_rate_hz,
-                                 display_buffer, DISPLAY_SAMPLES, &measurements);
+              uint32_t t0 = DWT->CYCCNT;
+              uint8_t spectrum = 1;
+              if(zoom_due)
+                  measure_zoom_domain(display_buffer, display_count, &measurements);
+              else if(settings.welch_segments)
+                  spectrum = measure_welch_domain(frame, actual_samples_captured, settings.sample_rate_hz,
+                                                  settings.welch_segments, settings.welch_overlap,
+                                                  display_buffer, display_count, &measurements);
+              else
+                  measure_freq_domain(frame, settings.sample_rate_hz,
+                                     display_buffer, display_count, &measurements);
+              uint32_t cycles = DWT->CYCCNT - t0;
+              if(bench_enabled) bench_record(cycles, actual_samples_captured);
+              PROF_ADD(PROF_MEASURE, cycles);
+              PROF_ADD(PROF_FFT_WINDOW, fft_cycles.window);
+              PROF_ADD(PROF_FFT, fft_cycles.fft);
+              PROF_ADD(PROF_FFT_MAGNITUDE, fft_cycles.magnitude);
+              if(spectrum) PROF_ADD(PROF_FFT_PEAKS, fft_cycles.peaks);
+              if(spectrum && fft_cycles.distortion) PROF_ADD(PROF_FFT_DISTORTION, fft_cycles.distortion);
+
+              // Welch estimate still collecting segments: nothing to send yet
+              if(!spectrum) {
+                  acq_stats_frame(actual_samples_captured);
+                  PROF_END(PROF_FRAME, t_frame);
+                  continue;
+              }
           } else {
-              decimate_samples(adc_buffer, actual_samples_captured,
-                              display_buffer, DISPLAY_SAMPLES, settings.mode);
-              measure_time_domain(adc_buffer, actual_samples_captured,
+              // Measuring indexes the frame, so decimation reads the pyramid
+              uint32_t t0 = DWT->CYCCNT;
+              measure_time_domain(frame, actual_samples_captured,
                                  settings.sample_rate_hz, &measurements);
+              uint32_t cycles = DWT->CYCCNT - t0;
+              if(bench_enabled) bench_record(cycles, actual_samples_captured);
+              PROF_ADD(PROF_MEASURE, cycles);
+              PROF_BEGIN(t_dec);
+              pyramid_decimate(frame, actual_samples_captured,
+                              display_buffer, display_count, settings.mode);
+              PROF_END(PROF_DECIMATE, t_dec);
           }
-
-          // Send to ESP32 via SPI
-          spi_busy = 1;
-          HAL_GPIO_WritePin(GPIOB, GPIO_PIN_12, GPIO_PIN_RESET);
-          HAL_SPI_Transmit_DMA(&hspi2, (uint8_t*)display_buffer,
-                               DISPLAY_SAMPLES * sizeof(uint16_t));
-
-          // Send measurements via UART (every 6 frames)
-          if((measurements_enabled || settings.display_mode == DISPLAY_FREQ)
-             && ++meas_counter >= 6 && measurements.valid) {
-              meas_counter = 0;
-              char buf[160];
-              snprintf(buf, sizeof(buf),
-                  "M:%u,%lu,%u,%u,%u,%lu,%u,%lu,%u,%lu,%u,%lu,%u,%lu,%u\n",
-                  measurements.amplitude_mv, measurements.frequency_hz,
-                  measurements.period_us, measurements.vrms_mv, measurements.num_peaks,
-                  measurements.peak_freqs[0], measurements.peak_mags[0],
-                  measurements.peak_freqs[1], measurements.peak_mags[1],
-                  measurements.peak_freqs[2], measurements.peak_mags[2],
-                  measurements.peak_freqs[3], measurements.peak_mags[3],
-                  measurements.peak_freqs[4], measurements.peak_mags[4]);
-              HAL_UART_Transmit(&huart2, (uint8_t*)buf, strlen(buf), 20);
-          }
-
-          // Update OLED (~12fps)
-          if(++oled_counter >= 2) {
-              oled_counter = 0;
-              ssd1306_clear();
-
-              uint16_t oled_buf[OLED_SAMPLES];
+          if(!zoom_due) acq_stats_frame(actual_samples_captured);
+          uint8_t recorded = deep_store(frame, actual_samples_captured);
+          if(acq_stop_pending) recorded |= acq_halt(frame);
+
+          uint8_t envelope = (settings.display_mode == DISPLAY_TIME && settings.mode == MODE_ENVELOPE);
+          uint8_t flags = (settings.display_mode == DISPLAY_FREQ) ? OSC_FRAME_SPECTRUM : 0;
+          if(envelope) flags |= OSC_FRAME_ENVELOPE;
+          if(zoom_due) flags |= OSC_FRAME_ZOOM;
+          if((measurements_enabled || settings.display_mode == DISPLAY_FREQ) && measurements.valid)
+              flags |= OSC_FRAME_MEAS;
+          if(acq_triggered)
+              flags |= trigger_was_forced() ? OSC_FRAME_FORCED : OSC_FRAME_TRIGGERED;
+          if(acq_triggered) trigger_rearm();
+
+          // Deep memory: the header names the record and where this frame sits in it
+          const DeepRecord *rec = deep_record();
+          uint32_t rec_span = recorded ? rec->segment_len : 0;
+          uint32_t rec_start = recorded ? rec->total - rec_span : 0;
+          if(rec->segments || rec->total) flags |= OSC_FRAME_RECORD;
+
+          // Send to ESP32 via SPI (measurements travel in the frame header)
+          PROF_BEGIN(t_enc);
+          uint8_t *tx = frame_header_encode(flags, display_count, rec_start, rec_span, 0);
+          spi_send_frame(tx, (uint8_t*)(display_buffer + display_count) - tx);
+          PROF_END(PROF_ENCODE, t_enc);
+
+          // Update OLED every frame; skipped while the last one is still on the bus
+          if(ssd1306_ready()) {
+              PROF_BEGIN(t_draw);
+              display_begin(settings.display_mode);
+
+              uint16_t oled_buf[OLED_SAMPLES * 2];
               if(settings.display_mode == DISPLAY_FREQ) {
-                  draw_freq_grid();
-                  decimate_samples(display_buffer, DISPLAY_SAMPLES,
+                  decimate_samples(display_buffer, display_count,
                                   oled_buf, OLED_SAMPLES, MODE_PEAK_DETECT);
                   draw_spectrum(oled_buf, OLED_SAMPLES);
+              } else if(envelope) {
+                  merge_envelope(display_buffer, display_count / 2, oled_buf, OLED_SAMPLES);
+                  draw_envelope(oled_buf, OLED_SAMPLES);
               } else {
-                  draw_grid();
-                  decimate_samples(display_buffer, DISPLAY_SAMPLES,
+                  decimate_samples(display_buffer, display_count,
                                   oled_buf, OLED_SAMPLES, MODE_NORMAL);
                   draw_waveform(oled_buf, OLED_SAMPLES);
               }
+              PROF_END(PROF_OLED_DRAW, t_draw);
 
               // Status line
+              PROF_BEGIN(t_status);
               char status[32];
-              if(settings.display_mode == DISPLAY_FREQ)
+              if(settings.display_mode == DISPLAY_FREQ && measurements.psd_segments)
+                  snprintf(status, 32, "PSD %luHz %ddBFS",
+                           measurements.frequency_hz, measurements.psd_tone_cdbfs / 100);
+              else if(settings.display_mode == DISPLAY_FREQ && measurements.dist_harmonics)
+                  snprintf(status, 32, "FFT %luHz THD%ddB",
+                           measurements.frequency_hz, measurements.thd_cdb / 100);
+              else if(settings.display_mode == DISPLAY_FREQ)
                   snprintf(status, 32, "FFT %luHz Pk:%lumV",
                            measurements.frequency_hz, (uint32_t)measurements.amplitude_mv);
               else
                   snprintf(status, 32, "T:%uus F:%luHz",
                            settings.time_div_us, measurements.frequency_hz);
-              ssd1306_print(0, 0, status);
+              display_status(status);
+              PROF_END(PROF_OLED_STATUS, t_status);
+
+              PROF_BEGIN(t_flush);
               ssd1306_update();
+              PROF_END(PROF_OLED_FLUSH, t_flush);
           }
+          PROF_END(PROF_FRAME, t_frame);
       }
 
-      HAL_ADC_Start_DMA(&hadc1, (uint32_t*)adc_buffer, actual_samples_captured);
-      HAL_Delay(1);
+      // One-shot mode re-arms the DMA; circular and triggered modes never stop
+      if(!acq_stopped && !acq_circular && !acq_triggered && !deep_holding()) {
+          adc_start_dma(actual_samples_captured);
+          HAL_Delay(1);
+      }
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -687,6 +1289,9 @@ static void MX_DMA_Init(void)
   /* DMA1_Stream4_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
   /* DMA2_Stream0_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
@@ -750,17 +1355,49 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+// Hand a finished frame to the main loop; an unconsumed one is an overrun
+static void adc_publish_frame(uint16_t *frame) {
+    if(adc_ready) acq_stats.overruns++;
+    adc_frame = frame;
+    adc_ready = 1;
+}
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+    if(hadc->Instance == ADC1 && acq_circular)
+        adc_publish_frame(adc_buffer);
+}
+
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
-    if(hadc->Instance == ADC1) adc_ready = 1;
+    if(hadc->Instance != ADC1) return;
+    if(acq_triggered)
+        trigger_wrap_isr();
+    else if(acq_circular)
+        adc_publish_frame(adc_buffer + actual_samples_captured);
+    else
+        adc_ready = 1;
+}
+
+void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef* hadc) {
+    if(hadc->Instance == ADC1) trigger_awd_isr();
 }
 
 void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
     if(hspi->Instance == SPI2) {
         HAL_GPIO_WritePin(GPIOB, GPIO_PIN_12, GPIO_PIN_SET);
-        spi_busy = 0;
+        spi_chunk_tick = HAL_GetTick();
+        spi_chunk_busy = 0;
+        if(spi_tx_pos >= spi_tx_len) spi_busy = 0;
     }
 }
 
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    if(hi2c->Instance == I2C1) ssd1306_tx_isr();
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    if(hi2c->Instance == I2C1) ssd1306_error_isr();
+}
+
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     if(huart->Instance == USART2) {
         if(uart_rx_byte == '\n') {
@@ -0,0 +1,146 @@
+#include "osc_deep.h"
+#include "osc_signal.h"
+#include "osc_pyramid.h"
+#include "osc_frame.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_MEMORY  (ACQ_MEMORY_SAMPLES - ADC_BUFFER_SIZE)
+
+/* ==================== RECORD STATE ==================== */
+static DeepRecord deep;
+static DeepWindowRequest requests[DEEP_WINDOW_QUEUE];
+static uint8_t request_head = 0, request_count = 0;
+
+/* ==================== CONFIGURATION ==================== */
+uint32_t deep_capacity(uint8_t segments) {
+    if(segments <= 1) return ACQ_MEMORY_SAMPLES;
+    return SEGMENT_MEMORY / segments;
+}
+
+void deep_configure(uint8_t segments, uint32_t frame_len) {
+    if(segments > DEEP_MAX_SEGMENTS) segments = DEEP_MAX_SEGMENTS;
+    uint32_t cap = deep_capacity(segments);
+
+    deep.segments = segments;
+    deep.filled = 0;
+    deep.total = 0;
+    deep.id++;
+    request_count = 0;
+
+    // Segments live behind adc_buffer so live capture never overwrites them
+    deep.base = (segments > 1) ? adc_buffer + ADC_BUFFER_SIZE : adc_buffer;
+    deep.segment_len = (frame_len < cap) ? frame_len : cap;
+}
+
+/* ==================== CAPTURE ==================== */
+uint8_t deep_store(const uint16_t *frame, uint32_t n) {
+    if(!deep.segments) return 0;
+
+    if(deep.segments == 1) {
+        if(frame != deep.base) return 0;
+        deep.segment_len = (n < deep_capacity(1)) ? n : deep_capacity(1);
+        deep.total = deep.segment_len;
+        deep.filled = 1;
+        deep.id++;
+        return 1;
+    }
+
+    // Segmented: fill once, then hold until reconfigured
+    if(deep.filled >= deep.segments) return 0;
+    if(n > deep.segment_len) n = deep.segment_len;
+
+    uint16_t *slot = deep.base + deep.filled * deep.segment_len;
+    memcpy(slot, frame, n * sizeof(uint16_t));
+    if(n < deep.segment_len)
+        memset(slot + n, 0, (deep.segment_len - n) * sizeof(uint16_t));
+    pyramid_update(slot, deep.segment_len, NULL);
+
+    deep.filled++;
+    deep.total = deep.filled * deep.segment_len;
+    deep.id++;
+    return 1;
+}
+
+uint8_t deep_retain(uint16_t *frame, uint32_t n) {
+    if(deep.segments) return 0;
+
+    deep.base = frame;
+    deep.segment_len = deep.total = n;
+    deep.filled = 1;
+    deep.id++;
+    return 1;
+}
+
+const DeepRecord *deep_record(void) {
+    return &deep;
+}
+
+/* ==================== WINDOWS ==================== */
+uint16_t deep_window(uint32_t *start, uint32_t *span, uint16_t *dst,
+                     uint16_t points, ScopeMode mode) {
+    if(!deep.total || !points) {
+        *start = *span = 0;
+        return 0;
+    }
+
+    if(*start >= deep.total) *start = deep.total - 1;
+    if(!*span || *span > deep.total - *start) *span = deep.total - *start;
+    if(*span > UINT16_MAX) *span = UINT16_MAX;  // decimate_samples length
+
+    // Zoomed past one sample per point: send the samples themselves
+    if(points > *span) points = *span;
+    uint16_t values = (mode == MODE_ENVELOPE) ? points * 2 : points;
+
+    pyramid_decimate(deep.base + *start, *span, dst, values, mode);
+    return values;
+}
+
+/* ==================== WINDOW REQUESTS ==================== */
+// Next ",value" of the request; missing or empty fields keep def
+static uint32_t request_field(const char **p, uint32_t def) {
+    if(**p != ',') return def;
+    char *end;
+    uint32_t val = strtoul(*p + 1, &end, 10);
+    uint8_t empty = (end == *p + 1);
+    *p = end;
+    return empty ? def : val;
+}
+
+void deep_request(const char *args, uint16_t points, ScopeMode mode) {
+    DeepWindowRequest r;
+    char *end;
+    r.start = strtoul(args, &end, 10);
+    const char *p = end;
+    r.span = request_field(&p, 0);
+    uint32_t n = request_field(&p, points);
+    uint32_t m = request_field(&p, mode);
+    r.tag = (uint8_t)request_field(&p, 0);
+    r.mode = (m <= MODE_ENVELOPE) ? (ScopeMode)m : MODE_NORMAL;
+
+    // Envelope windows carry two values per point
+    uint32_t max = (r.mode == MODE_ENVELOPE) ? OSC_FRAME_MAX_SAMPLES / 2 : OSC_FRAME_MAX_SAMPLES;
+    r.points = (n < 2) ? 2 : (n > max) ? max : n;
+
+    // A re-sent request takes its queued one's place
+    for(uint8_t i = 0; i < request_count; i++) {
+        DeepWindowRequest *q = &requests[(request_head + i) % DEEP_WINDOW_QUEUE];
+        if(q->tag == r.tag) {
+            *q = r;
+            return;
+        }
+    }
+    if(request_count == DEEP_WINDOW_QUEUE) {
+        request_head = (request_head + 1) % DEEP_WINDOW_QUEUE;
+        request_count--;
+    }
+    requests[(request_head + request_count++) % DEEP_WINDOW_QUEUE] = r;
+}
+
+uint8_t deep_next_request(DeepWindowRequest *req) {
+    if(!request_count) return 0;
+    *req = requests[request_head];
+    request_head = (request_head + 1) % DEEP_WINDOW_QUEUE;
+    request_count--;
+    return 1;
+}
@@ -1,9 +1,45 @@
 #include "osc_display.h"
 #include "ssd1306.h"
+#include <string.h>
 
 #define WAVE_TOP    16      // Top of waveform area
 #define WAVE_BOTTOM 63      // Bottom of display
 #define WAVE_CENTER 40      // Vertical center
+#define STATUS_PAGE 0       // Status text row (above WAVE_TOP)
+#define STATUS_LEN  32
+
+/* ==================== LAYERS ==================== */
+static uint8_t grid_layer[SSD1306_PAGES * SSD1306_WIDTH];
+static int8_t grid_mode = -1;
+static uint8_t status_layer[SSD1306_WIDTH];
+static char status_text[STATUS_LEN];
+static uint8_t status_valid = 0;
+
+void display_begin(DisplayMode mode) {
+    if(grid_mode == (int8_t)mode) {
+        ssd1306_load_pages(grid_layer, 0, SSD1306_PAGES);
+        return;
+    }
+
+    ssd1306_clear();
+    if(mode == DISPLAY_FREQ) draw_freq_grid();
+    else draw_grid();
+    ssd1306_save_pages(grid_layer, 0, SSD1306_PAGES);
+    grid_mode = mode;
+}
+
+void display_status(const char *text) {
+    if(status_valid && strncmp(text, status_text, STATUS_LEN) == 0) {
+        ssd1306_load_pages(status_layer, STATUS_PAGE, 1);
+        return;
+    }
+
+    ssd1306_print(0, STATUS_PAGE * 8, text);
+    ssd1306_save_pages(status_layer, STATUS_PAGE, 1);
+    strncpy(status_text, text, STATUS_LEN - 1);
+    status_text[STATUS_LEN - 1] = '\0';
+    status_valid = 1;
+}
 
 /* ==================== TIME DOMAIN GRID ==================== */
 void draw_grid(void) {
@@ -34,23 +70,75 @@ void draw_freq_grid(void) {
 }
 
 /* ==================== WAVEFORM DRAWING ==================== */
+static inline int32_t wave_y(uint16_t sample) {
+    const int32_t scale = 4;
+    int32_t y = WAVE_CENTER - ((sample - 2048) * scale / 85);
+    if(y < WAVE_TOP) y = WAVE_TOP;
+    if(y > WAVE_BOTTOM) y = WAVE_BOTTOM;
+    return y;
+}
+
+// One vertical run per column. A Bresenham segment between neighbouring
+// columns puts the first half of its rise (d/2 + 1 pixels) in the left column
+// and the rest in the right one; each column is the union of the tail of
+// the segment on its left and the head of the one on its right.
 void draw_waveform(uint16_t *buffer, uint16_t size) {
     if(size > 128) size = 128;
-    const int32_t scale = 4;
+    if(size < 2) return;
+
+    int32_t y = wave_y(buffer[0]);
+    int32_t lo = y, hi = y;             // Tail of the segment arriving at x
+
+    for(uint16_t x = 0; x < size; x++) {
+        if(x + 1 < size) {
+            int32_t next = wave_y(buffer[x + 1]);
+            int32_t d = next - y;
+            int32_t head = (d >= 0) ? y + d / 2 : y - (-d) / 2;
+            if(head < lo) lo = head;
+            if(head > hi) hi = head;
+
+            ssd1306_draw_vline(x, lo, hi);
+
+            // Right column gets next back to just past the head (or next alone)
+            int32_t tail = (d > 0) ? head + 1 : (d < 0) ? head - 1 : next;
+            lo = (tail < next) ? tail : next;
+            hi = (tail > next) ? tail : next;
+            y = next;
+        } else {
+            ssd1306_draw_vline(x, lo, hi);
+        }
+    }
+}
+
+/* ==================== ENVELOPE DRAWING ==================== */
+// Each column spans its bucket's max..min. Where neighbouring columns don't
+// overlap, both reach toward each other and meet halfway, so the band stays
+// connected across fast edges like the Bresenham trace does.
+void draw_envelope(uint16_t *pairs, uint16_t columns) {
+    if(columns > 128) columns = 128;
+    if(columns < 1) return;
+
+    int32_t top[3], bot[3];             // Previous, current, next column
+    top[1] = wave_y(pairs[1]); bot[1] = wave_y(pairs[0]);
+    top[0] = top[1]; bot[0] = bot[1];
 
-    // Clamp and scale first point
-    int32_t prev_y = WAVE_CENTER - ((buffer[0] - 2048) * scale / 85);
-    if(prev_y < WAVE_TOP) prev_y = WAVE_TOP;
-    if(prev_y > WAVE_BOTTOM) prev_y = WAVE_BOTTOM;
+    for(uint16_t x = 0; x < columns; x++) {
+        if(x + 1 < columns) {
+            top[2] = wave_y(pairs[2 * x + 3]);
+            bot[2] = wave_y(pairs[2 * x + 2]);
+        } else {
+            top[2] = top[1]; bot[2] = bot[1];
+        }
 
-    // Draw connected line segments
-    for(uint16_t x = 1; x < size; x++) {
-        int32_t y = WAVE_CENTER - ((buffer[x] - 2048) * scale / 85);
-        if(y < WAVE_TOP) y = WAVE_TOP;
-        if(y > WAVE_BOTTOM) y = WAVE_BOTTOM;
+        int32_t t = top[1], b = bot[1];
+        for(uint8_t k = 0; k < 3; k += 2) {
+            if(top[k] > bot[1]) { int32_t m = (bot[1] + top[k]) / 2; if(m > b) b = m; }
+            if(bot[k] < top[1]) { int32_t m = (bot[k] + top[1]) / 2 + 1; if(m < t) t = m; }
+        }
+        ssd1306_draw_vline(x, t, b);
 
-        ssd1306_draw_line(x - 1, prev_y, x, y);
-        prev_y = y;
+        top[0] = top[1]; bot[0] = bot[1];
+        top[1] = top[2]; bot[1] = bot[2];
     }
 }
 
@@ -71,6 +159,6 @@ void draw_spectrum(uint16_t *buffer, uint16_t size) {
         if(bar < 1 && buffer[x] > 0) bar = 1;
 
         if(bar > 0)
-            ssd1306_draw_line(x, WAVE_BOTTOM, x, WAVE_BOTTOM - bar);
+            ssd1306_draw_vline(x, WAVE_BOTTOM - bar, WAVE_BOTTOM);
     }
 }
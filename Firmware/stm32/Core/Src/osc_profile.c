@@ -0,0 +1,104 @@
+#include "osc_profile.h"
+
+#if OSC_PROFILE
+#include <stdio.h>
+#include <string.h>
+
+#define PROF_CAL_RUNS   16
+
+static const char * const probe_names[PROF_NUM_PROBES] = {
+    "frame", "decimate", "measure", "fft_window", "fft", "fft_magnitude",
+    "fft_peaks", "fft_distortion", "encode", "oled_draw", "oled_status", "oled_flush",
+    "command", "zoom_feed"
+};
+
+/* ==================== PROFILE STATE ==================== */
+typedef struct {
+    uint32_t count;
+    uint32_t min, max;
+    uint64_t sum;
+    uint32_t hist[PROF_HIST_BUCKETS];
+} ProbeStats;
+
+static struct {
+    ProbeStats probes[PROF_NUM_PROBES];
+    uint32_t bias;                      // Back-to-back CYCCNT read delta
+    uint32_t cost;                      // Cycles one BEGIN/END pair adds to the loop
+    uint32_t calls;                     // Probe hits since reset
+    uint32_t start_tick;
+    uint8_t enabled;
+} prof = {.enabled = 1};
+
+/* ==================== API FUNCTIONS ==================== */
+void prof_reset(void) {
+    memset(prof.probes, 0, sizeof(prof.probes));
+    for(uint8_t i = 0; i < PROF_NUM_PROBES; i++) prof.probes[i].min = UINT32_MAX;
+    prof.calls = 0;
+    prof.start_tick = HAL_GetTick();
+}
+
+void prof_init(void) {
+    uint8_t enabled = prof.enabled;
+    prof.enabled = 1;
+    prof.bias = UINT32_MAX;
+
+    // Smallest interval the probes can see: subtracted from every hit
+    for(uint8_t i = 0; i < PROF_CAL_RUNS; i++) {
+        uint32_t t0 = DWT->CYCCNT;
+        uint32_t t1 = DWT->CYCCNT;
+        if(t1 - t0 < prof.bias) prof.bias = t1 - t0;
+    }
+
+    // Full probe cost, for the overhead figure in the report
+    uint32_t start = DWT->CYCCNT;
+    for(uint8_t i = 0; i < PROF_CAL_RUNS; i++) {
+        PROF_BEGIN(t);
+        PROF_END(PROF_COMMAND, t);
+    }
+    prof.cost = (DWT->CYCCNT - start) / PROF_CAL_RUNS;
+
+    prof.enabled = enabled;
+    prof_reset();
+}
+
+void prof_enable(uint8_t on) {
+    prof.enabled = on;
+    prof_reset();
+}
+
+void prof_record(ProfProbe probe, uint32_t cycles) {
+    if(!prof.enabled) return;
+
+    ProbeStats *p = &prof.probes[probe];
+    cycles = (cycles > prof.bias) ? cycles - prof.bias : 0;
+    if(cycles < p->min) p->min = cycles;
+    if(cycles > p->max) p->max = cycles;
+    p->sum += cycles;
+    p->count++;
+    prof.calls++;
+
+    // Log2 bucket: one CLZ instead of a search
+    int32_t b = 31 - (int32_t)__CLZ(cycles | 1) - PROF_HIST_MIN_LOG2;
+    p->hist[(b < 0) ? 0 : (b >= PROF_HIST_BUCKETS) ? PROF_HIST_BUCKETS - 1 : b]++;
+}
+
+void prof_dump(UART_HandleTypeDef *huart) {
+    char buf[224];
+
+    for(uint8_t i = 0; i < PROF_NUM_PROBES; i++) {
+        ProbeStats *p = &prof.probes[i];
+        if(!p->count) continue;
+
+        int n = snprintf(buf, sizeof(buf), "P:%s,%lu,%lu,%lu,%lu,", probe_names[i],
+                         p->count, (uint32_t)(p->sum / p->count), p->min, p->max);
+        for(uint8_t b = 0; b < PROF_HIST_BUCKETS && n < (int)sizeof(buf); b++)
+            n += snprintf(buf + n, sizeof(buf) - n, (b < PROF_HIST_BUCKETS - 1) ? "%lu/" : "%lu\n", p->hist[b]);
+        HAL_UART_Transmit(huart, (uint8_t*)buf, strlen(buf), 50);
+    }
+
+    snprintf(buf, sizeof(buf), "P:END,%u,%lu,%lu,%lu,%lu,%u\n",
+             prof.enabled, prof.cost, prof.calls, HAL_GetTick() - prof.start_tick,
+             SYSTEM_CLOCK_HZ / 1000000, PROF_HIST_MIN_LOG2);
+    HAL_UART_Transmit(huart, (uint8_t*)buf, strlen(buf), 20);
+}
+#endif
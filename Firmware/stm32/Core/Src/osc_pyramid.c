@@ -0,0 +1,213 @@
+#include "osc_pyramid.h"
+#include "main.h"
+
+/* ==================== INDEX STATE ==================== */
+typedef struct {
+    uint16_t vmin, vmax;
+    uint32_t sum;
+} PyrNode;
+
+#if OSC_PYRAMID
+static PyrNode leaves[PYR_LEAVES];      // 64 samples
+static PyrNode nodes[PYR_NODES];        // 512 samples
+#define LEAF(blk)   (&leaves[blk])
+#else
+static PyrNode leaf_sink;               // Statistics only
+#define LEAF(blk)   (&leaf_sink)
+#endif
+
+/* ==================== LEAF KERNELS ==================== */
+// Partial blocks at the ends of a range (and the scalar build) go sample by sample
+static void leaf_scalar(const uint16_t *buf, uint32_t size, PyrNode *leaf, PyrStats *t) {
+    uint16_t vmin = buf[0], vmax = buf[0];
+    uint32_t sum = 0, sum_sq = 0;       // 64 x 4095^2 fits 32 bits
+
+    for(uint32_t i = 0; i < size; i++) {
+        uint16_t val = buf[i];
+        sum += val;
+        sum_sq += (uint32_t)val * val;
+        if(val < vmin) vmin = val;
+        if(val > vmax) vmax = val;
+    }
+    leaf->vmin = vmin; leaf->vmax = vmax; leaf->sum = sum;
+    t->sum += sum; t->sum_sq += sum_sq;
+    if(vmin < t->vmin) t->vmin = vmin;
+    if(vmax > t->vmax) t->vmax = vmax;
+}
+
+#if defined(__ARM_FEATURE_SIMD32) && !defined(OSC_SCALAR_REF)
+// Whole blocks are word aligned (acq_memory is): packed words, SMLAD for
+// sum and sum of squares, USUB16+SEL for min/max
+static void leaf_full(const uint16_t *buf, PyrNode *leaf, PyrStats *t) {
+    const uint32_t *w = (const uint32_t*)buf;
+    uint32_t sum = 0, sum_sq = 0, vmin = w[0], vmax = w[0];
+
+    for(uint32_t i = 0; i < PYR_LEAF / 2; i++) {
+        uint32_t x = w[i];
+        sum = __SMLAD(x, 0x00010001, sum);
+        sum_sq = __SMLAD(x, x, sum_sq);
+        __USUB16(x, vmax); vmax = __SEL(x, vmax);
+        __USUB16(vmin, x); vmin = __SEL(x, vmin);
+    }
+
+    uint16_t lo_min = vmin & 0xFFFF, hi_min = vmin >> 16;
+    uint16_t lo_max = vmax & 0xFFFF, hi_max = vmax >> 16;
+    leaf->vmin = (lo_min < hi_min) ? lo_min : hi_min;
+    leaf->vmax = (lo_max > hi_max) ? lo_max : hi_max;
+    leaf->sum = sum;
+    t->sum += sum; t->sum_sq += sum_sq;
+    if(leaf->vmin < t->vmin) t->vmin = leaf->vmin;
+    if(leaf->vmax > t->vmax) t->vmax = leaf->vmax;
+}
+#else
+#define leaf_full(buf, leaf, t) leaf_scalar(buf, PYR_LEAF, leaf, t)
+#endif
+
+/* ==================== BUILD ==================== */
+#if OSC_PYRAMID
+static void node_merge(uint32_t blk) {
+    uint32_t first = blk * (PYR_NODE / PYR_LEAF), last = first + PYR_NODE / PYR_LEAF;
+    if(last > PYR_LEAVES) last = PYR_LEAVES;
+
+    PyrNode n = {leaves[first].vmin, leaves[first].vmax, 0};
+    for(uint32_t i = first; i < last; i++) {
+        if(leaves[i].vmin < n.vmin) n.vmin = leaves[i].vmin;
+        if(leaves[i].vmax > n.vmax) n.vmax = leaves[i].vmax;
+        n.sum += leaves[i].sum;
+    }
+    nodes[blk] = n;
+}
+#endif
+
+void pyramid_update(const uint16_t *src, uint32_t n, PyrStats *stats) {
+    PyrStats t = {0, 0, 4095, 0};
+
+    if(src >= acq_memory && n && (uint32_t)(src - acq_memory) + n <= ACQ_MEMORY_SAMPLES) {
+        uint32_t a = src - acq_memory, b = a + n;
+        // A leaf straddling the range's ends is rebuilt from the whole block
+        // as memory holds it (the statistics take only the range's part), so
+        // leaves across neighbouring ranges, such as segments that don't end
+        // on a leaf, stay exact. Nodes merge whatever their leaves hold
+        for(uint32_t blk = a / PYR_LEAF; blk * PYR_LEAF < b; blk++) {
+            uint32_t lo = (blk * PYR_LEAF > a) ? blk * PYR_LEAF : a;
+            uint32_t hi = (blk * PYR_LEAF + PYR_LEAF < b) ? blk * PYR_LEAF + PYR_LEAF : b;
+            if(hi - lo == PYR_LEAF) {
+                leaf_full(&acq_memory[lo], LEAF(blk), &t);
+                continue;
+            }
+            PyrNode part;
+            PyrStats whole = t;
+            uint32_t end = blk * PYR_LEAF + PYR_LEAF;
+            if(end > ACQ_MEMORY_SAMPLES) end = ACQ_MEMORY_SAMPLES;
+            leaf_scalar(&acq_memory[lo], hi - lo, &part, &t);
+            leaf_scalar(&acq_memory[blk * PYR_LEAF], end - blk * PYR_LEAF, LEAF(blk), &whole);
+        }
+#if OSC_PYRAMID
+        for(uint32_t blk = a / PYR_NODE; blk * PYR_NODE < b; blk++) node_merge(blk);
+#endif
+    }
+    if(stats) *stats = t;
+}
+
+/* ==================== QUERIES ==================== */
+#if OSC_PYRAMID
+typedef struct {
+    uint16_t vmin, vmax;
+    uint32_t sum;
+} PyrRange;
+
+static inline void range_add(PyrRange *r, const PyrNode *n) {
+    if(n->vmin < r->vmin) r->vmin = n->vmin;
+    if(n->vmax > r->vmax) r->vmax = n->vmax;
+    r->sum += n->sum;
+}
+
+// Samples outside whole leaves
+static inline void range_scan(PyrRange *r, uint32_t a, uint32_t b) {
+    uint16_t vmin = r->vmin, vmax = r->vmax;
+    uint32_t sum = r->sum;
+    for(; a < b; a++) {
+        uint16_t val = acq_memory[a];
+        sum += val;
+        if(val < vmin) vmin = val;
+        if(val > vmax) vmax = val;
+    }
+    r->vmin = vmin; r->vmax = vmax; r->sum = sum;
+}
+
+// acq_memory[a, b): edge samples, leaves up to the first node, nodes, leaves, edge samples
+static void range_query(uint32_t a, uint32_t b, PyrRange *r) {
+    r->vmin = 0xFFFF; r->vmax = 0; r->sum = 0;
+
+    uint32_t la = (a + PYR_LEAF - 1) & ~(PYR_LEAF - 1), lb = b & ~(PYR_LEAF - 1);
+    if(la >= lb) {
+        range_scan(r, a, b);
+        return;
+    }
+    range_scan(r, a, la);
+    for(; la < lb && (la & (PYR_NODE - 1)); la += PYR_LEAF) range_add(r, &leaves[la / PYR_LEAF]);
+    for(; la + PYR_NODE <= lb; la += PYR_NODE) range_add(r, &nodes[la / PYR_NODE]);
+    for(; la < lb; la += PYR_LEAF) range_add(r, &leaves[la / PYR_LEAF]);
+    range_scan(r, lb, b);
+}
+
+uint8_t pyramid_indexed(uint32_t n, uint16_t dst_size, ScopeMode mode) {
+    // Point samples and fine buckets are cheaper to read sample by sample
+    switch(mode) {
+        case MODE_ENVELOPE:    return dst_size >= 2 && n / (dst_size / 2) >= PYR_MIN_BUCKET_ENV;
+        case MODE_PEAK_DETECT: return dst_size >= 2 && n / dst_size >= PYR_MIN_BUCKET_PEAK;
+        case MODE_AVERAGE:     return dst_size >= 2 && n / dst_size >= PYR_MIN_BUCKET_AVG;
+        default:               return 0;
+    }
+}
+
+void pyramid_decimate(const uint16_t *src, uint32_t n,
+                      uint16_t *dst, uint16_t dst_size, ScopeMode mode) {
+    if(!n || !dst_size) return;
+    uint32_t base = src - acq_memory;
+    uint32_t buckets = (mode == MODE_ENVELOPE) ? dst_size / 2 : dst_size;
+    PyrRange r;
+
+    if(!pyramid_indexed(n, dst_size, mode)) {
+        decimate_samples((uint16_t*)src, n, dst, dst_size, mode);
+        return;
+    }
+
+    // Envelope: envelope_decimate()'s tiling, one (min,max) pair per bucket
+    if(mode == MODE_ENVELOPE) {
+        for(uint32_t i = 0; i < buckets; i++) {
+            uint32_t start = (i * n) / buckets;
+            uint32_t end = ((i + 1) * n) / buckets;
+            if(end == start) end = start + 1;
+            range_query(base + start, base + end, &r);
+            dst[2 * i] = r.vmin;
+            dst[2 * i + 1] = r.vmax;
+        }
+        return;
+    }
+
+    // Average / peak detect: decimate_samples()'s overlapping buckets
+    for(uint16_t i = 0; i < dst_size; i++) {
+        uint32_t start = ((uint32_t)i * (n - 1)) / (dst_size - 1);
+        uint32_t end = (i == dst_size - 1) ? n - 1 :
+                       ((uint32_t)(i + 1) * (n - 1)) / (dst_size - 1);
+        if(start >= n) start = n - 1;
+        if(end >= n) end = n - 1;
+
+        range_query(base + start, base + end + 1, &r);
+        if(mode == MODE_AVERAGE)
+            dst[i] = r.sum / (end - start + 1);
+        else
+            dst[i] = (i & 1) ? r.vmax : r.vmin;
+    }
+}
+#else
+uint8_t pyramid_indexed(uint32_t n, uint16_t dst_size, ScopeMode mode) {
+    return 0;
+}
+
+void pyramid_decimate(const uint16_t *src, uint32_t n,
+                      uint16_t *dst, uint16_t dst_size, ScopeMode mode) {
+    decimate_samples((uint16_t*)src, n, dst, dst_size, mode);
+}
+#endif
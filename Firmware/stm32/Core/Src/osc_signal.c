@@ -1,14 +1,42 @@
 #include "osc_signal.h"
+#include "osc_pyramid.h"
+#include "osc_zoom.h"
+#include "osc_frame.h"
+#include "main.h"
 #include <string.h>
 #include <math.h>
 
 /* ==================== BUFFERS ==================== */
-uint16_t adc_buffer[ADC_BUFFER_SIZE] __attribute__((aligned(4)));
-float32_t fft_input[FFT_SIZE];
-float32_t fft_output[FFT_SIZE];
-float32_t fft_accumulator[FFT_SIZE/2];
-arm_rfft_fast_instance_f32 fft_instance;
+uint16_t acq_memory[ACQ_MEMORY_SAMPLES] __attribute__((aligned(8)));
+uint16_t * const adc_buffer = acq_memory;
+fft_sample_t * const fft_input = (fft_sample_t*)&acq_memory[ADC_BUFFER_SIZE];
+fft_sample_t * const fft_output = (fft_sample_t*)&acq_memory[ADC_BUFFER_SIZE] + FFT_SIZE;
+float32_t * const fft_accumulator = (float32_t*)((fft_sample_t*)&acq_memory[ADC_BUFFER_SIZE] +
+                                                 FFT_SIZE + FFT_OUTPUT_SIZE);
+fft_instance_t fft_instance;
 uint8_t fft_frame_count = 0;
+FftCycles fft_cycles = {0};
+
+// Symmetric window: only the first half is stored
+static fft_sample_t fft_window[FFT_SIZE/2];
+static int8_t fft_window_type = -1;
+static float32_t fft_window_sum, fft_window_sum_sq;    // Over all FFT_SIZE points
+static uint8_t fft_window_lobe;                        // Main-lobe half-width, bins
+static float32_t fft_window_jacobsen;                  // PEAK_JACOBSEN constant
+static uint8_t dist_harmonics;                         // fft_set_distortion
+
+// Peak engine (fft_set_peaks)
+static struct {
+    uint8_t count, interp, percentile;
+    uint16_t spacing_hz;
+    float32_t margin;               // Threshold over the noise floor, linear
+} peak_cfg = {5, PEAK_JACOBSEN, 50, 0, 5.6234f};
+
+// Spectrum sample encoding (fft_set_scale)
+static struct {
+    uint8_t db;
+    float32_t offset_db;            // ref + floor: the dB level of code 0
+} fft_scale = {0, 0.0f};
 
 /* ==================== EMA FILTER STATE ==================== */
 static struct {
@@ -22,8 +50,82 @@ static inline void ema_update(float32_t *state, float32_t value, uint8_t init) {
 }
 
 /* ==================== INITIALIZATION ==================== */
-void init_fft(void) {
+void init_fft(FftWindow window) {
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    arm_rfft_init_q15(&fft_instance, FFT_SIZE, 0, 1);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    arm_rfft_init_q31(&fft_instance, FFT_SIZE, 0, 1);
+#else
     arm_rfft_fast_init_f32(&fft_instance, FFT_SIZE);
+#endif
+    fft_set_window(window);
+}
+
+// Cosine-sum windows: w = a0 - a1*cos(x) + a2*cos(2x) - a3*cos(3x) + a4*cos(4x)
+static const float32_t window_coefs[][5] = {
+    [WIN_HANN]            = {0.5f,        0.5f,        0.0f,         0.0f,         0.0f},
+    [WIN_HAMMING]         = {0.54f,       0.46f,       0.0f,         0.0f,         0.0f},
+    [WIN_BLACKMAN_HARRIS] = {0.35875f,    0.48829f,    0.14128f,     0.01168f,     0.0f},
+    [WIN_FLATTOP]         = {0.21557895f, 0.41663158f, 0.277263158f, 0.083578947f, 0.006947368f}
+};
+
+// Bins either side of a tone that hold its leakage: the main lobe (2, 2, 4
+// and 5 bins) plus one for a tone between bins
+static const uint8_t window_lobes[] = {
+    [WIN_HANN] = 3, [WIN_HAMMING] = 3, [WIN_BLACKMAN_HARRIS] = 5, [WIN_FLATTOP] = 6
+};
+
+// Jacobsen's three-bin estimator on magnitudes, offset = P * (y2 - y0) /
+// (y0 + y1 + y2): P fitted to each window's own lobe over +-0.5 bin
+// (Hann and Hamming match the published 1.36 and 1.22)
+static const float32_t window_jacobsen[] = {
+    [WIN_HANN] = 1.361f, [WIN_HAMMING] = 1.219f, [WIN_BLACKMAN_HARRIS] = 2.238f, [WIN_FLATTOP] = 10.0f
+};
+
+void fft_set_window(FftWindow window) {
+    if(window > WIN_FLATTOP) window = WIN_HANN;
+    if(fft_window_type == (int8_t)window) return;
+
+    const float32_t *a = window_coefs[window];
+    fft_window_sum = fft_window_sum_sq = 0;
+    for(uint16_t i = 0; i < FFT_SIZE/2; i++) {
+        float32_t x = 2.0f * PI * i / (FFT_SIZE - 1);
+        float32_t w = a[0] - a[1] * arm_cos_f32(x);
+        if(a[2] != 0.0f)
+            w += a[2] * arm_cos_f32(2.0f * x) - a[3] * arm_cos_f32(3.0f * x)
+                 + a[4] * arm_cos_f32(4.0f * x);
+        fft_window_sum += 2.0f * w;
+        fft_window_sum_sq += 2.0f * w * w;
+#if FFT_ENGINE == FFT_ENGINE_Q15
+        arm_float_to_q15(&w, &fft_window[i], 1);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+        arm_float_to_q31(&w, &fft_window[i], 1);
+#else
+        fft_window[i] = w;
+#endif
+    }
+    fft_window_type = window;
+    fft_window_lobe = window_lobes[window];
+    fft_window_jacobsen = window_jacobsen[window];
+    fft_frame_count = 0;  // Restart averaging with the new window
+}
+
+void fft_set_scale(uint8_t db, int16_t ref_dbfs, int16_t floor_db) {
+    fft_scale.db = db ? 1 : 0;
+    fft_scale.offset_db = (float32_t)ref_dbfs + (float32_t)floor_db;
+}
+
+void fft_set_distortion(uint8_t harmonics) {
+    dist_harmonics = (harmonics > DIST_MAX_HARMONICS) ? DIST_MAX_HARMONICS : harmonics;
+}
+
+void fft_set_peaks(uint8_t count, PeakInterp interp, uint16_t spacing_hz,
+                   uint8_t percentile, int8_t margin_db) {
+    peak_cfg.count = (count < 1) ? 1 : (count > MAX_PEAKS) ? MAX_PEAKS : count;
+    peak_cfg.interp = (interp > PEAK_JACOBSEN) ? PEAK_JACOBSEN : interp;
+    peak_cfg.spacing_hz = spacing_hz;
+    peak_cfg.percentile = (percentile > 100) ? 100 : percentile;
+    peak_cfg.margin = powf(10.0f, margin_db / 20.0f);
 }
 
 void reset_measurement_filter(void) {
@@ -31,10 +133,19 @@ void reset_measurement_filter(void) {
 }
 
 /* ==================== DECIMATION ==================== */
+static void envelope_decimate(const uint16_t *src, uint32_t units, uint32_t step,
+                              uint16_t *dst, uint32_t buckets);
+
 void decimate_samples(uint16_t *src, uint16_t src_size,
                       uint16_t *dst, uint16_t dst_size, ScopeMode mode) {
     if(!src_size || !dst_size) return;
 
+    // Envelope: one (min,max) pair per bucket
+    if(mode == MODE_ENVELOPE) {
+        envelope_decimate(src, src_size, 1, dst, dst_size / 2);
+        return;
+    }
+
     // Source smaller than dest: pad with last sample
     if(src_size <= dst_size) {
         for(uint16_t i = 0; i < dst_size; i++)
@@ -77,24 +188,136 @@ void decimate_samples(uint16_t *src, uint16_t src_size,
     }
 }
 
+void merge_envelope(const uint16_t *pairs, uint16_t pair_count,
+                    uint16_t *dst, uint16_t buckets) {
+    if(!pair_count || !buckets) return;
+    envelope_decimate(pairs, pair_count, 2, dst, buckets);
+}
+
+/* ==================== TIME DOMAIN KERNELS ==================== */
+// Scalar kernels are the bit-exact reference; the Cortex-M4 build swaps in
+// packed 16-bit SIMD versions (define OSC_SCALAR_REF to force scalar).
+// Sum, sum of squares and extremes come out of pyramid_update()
+typedef struct {
+    uint16_t dc, thresh_high, thresh_low;
+    uint8_t state;
+    uint32_t rising_edges, first_edge, last_edge, high_count;
+} EdgeScan;
+
+// One Schmitt-trigger step, also counting samples above DC for duty
+static inline void edge_step(EdgeScan *e, uint16_t val, uint32_t i) {
+    if(val > e->dc) e->high_count++;
+
+    if(!e->state && val > e->thresh_high) {
+        e->state = 1;
+        if(!e->rising_edges) e->first_edge = i;
+        e->last_edge = i;
+        e->rising_edges++;
+    } else if(e->state && val < e->thresh_low) {
+        e->state = 0;
+    }
+}
+
+static void time_edges_scalar(const uint16_t *buf, uint32_t size, EdgeScan *e) {
+    for(uint32_t i = 1; i < size; i++) edge_step(e, buf[i], i);
+}
+
+static inline void envelope_bucket_scalar(const uint16_t *buf, uint32_t size, uint16_t *out) {
+    uint16_t vmin = buf[0], vmax = buf[0];
+    for(uint32_t i = 1; i < size; i++) {
+        if(buf[i] < vmin) vmin = buf[i];
+        if(buf[i] > vmax) vmax = buf[i];
+    }
+    out[0] = vmin; out[1] = vmax;
+}
+
+#if defined(__ARM_FEATURE_SIMD32) && !defined(OSC_SCALAR_REF)
+#define PAIR(v) (((uint32_t)(v) << 16) | (uint16_t)(v))
+
+// Words that cannot flip the Schmitt state only feed the packed duty count
+static void time_edges_simd(const uint16_t *buf, uint32_t size, EdgeScan *e) {
+    uint32_t i = 1;
+    if(i < size && ((uintptr_t)(buf + i) & 2)) { edge_step(e, buf[i], i); i++; }
+
+    const uint32_t dc1 = PAIR(e->dc + 1);
+    const uint32_t hi1 = PAIR(e->thresh_high + 1);
+    const uint32_t lo = PAIR(e->thresh_low);
+    uint32_t counts = 0;  // Two 16-bit lanes of above-DC counts
+
+    for(; i + 1 < size; i += 2) {
+        uint32_t x = *(const uint32_t*)&buf[i];
+        uint32_t flip;
+        if(e->state) { __USUB16(x, lo); flip = __SEL(0, 0xFFFFFFFF); }
+        else         { __USUB16(x, hi1); flip = __SEL(0xFFFFFFFF, 0); }
+
+        if(flip) {
+            edge_step(e, buf[i], i);
+            edge_step(e, buf[i + 1], i + 1);
+        } else {
+            __USUB16(x, dc1);
+            counts = __UADD16(counts, __SEL(0x00010001, 0));
+        }
+    }
+    e->high_count += (counts & 0xFFFF) + (counts >> 16);
+
+    if(i < size) edge_step(e, buf[i], i);
+}
+
+// Packed min/max over the bucket; an odd head or tail sample enters both lanes
+static inline void envelope_bucket_simd(const uint16_t *buf, uint32_t size, uint16_t *out) {
+    uint32_t vmin = 0xFFFFFFFF, vmax = 0, i = 0;
+    if((uintptr_t)buf & 2) vmin = vmax = PAIR(buf[0]), i = 1;
+
+    for(; i + 1 < size; i += 2) {
+        uint32_t x = *(const uint32_t*)&buf[i];
+        __USUB16(x, vmax); vmax = __SEL(x, vmax);
+        __USUB16(vmin, x); vmin = __SEL(x, vmin);
+    }
+    if(i < size) {
+        uint32_t x = PAIR(buf[i]);
+        __USUB16(x, vmax); vmax = __SEL(x, vmax);
+        __USUB16(vmin, x); vmin = __SEL(x, vmin);
+    }
+
+    uint16_t lo_min = vmin & 0xFFFF, hi_min = vmin >> 16;
+    uint16_t lo_max = vmax & 0xFFFF, hi_max = vmax >> 16;
+    out[0] = (lo_min < hi_min) ? lo_min : hi_min;
+    out[1] = (lo_max > hi_max) ? lo_max : hi_max;
+}
+
+#define time_edges      time_edges_simd
+#define envelope_bucket envelope_bucket_simd
+#else
+#define time_edges      time_edges_scalar
+#define envelope_bucket envelope_bucket_scalar
+#endif
+
+/* ==================== ENVELOPE DECIMATION ==================== */
+// Buckets tile the source without overlap, so each sample is read exactly
+// once. units counts groups of step samples: step 1 reduces raw samples,
+// step 2 keeps bucket edges on the (min,max) pairs of an existing envelope,
+// whose bucket extremes are then the min and max over every value in it.
+static void envelope_decimate(const uint16_t *src, uint32_t units, uint32_t step,
+                              uint16_t *dst, uint32_t buckets) {
+    for(uint32_t i = 0; i < buckets; i++) {
+        uint32_t start = (i * units) / buckets;
+        uint32_t end = ((i + 1) * units) / buckets;
+        if(end == start) end = start + 1;  // Fewer units than buckets: repeat
+        envelope_bucket(&src[start * step], (end - start) * step, &dst[2 * i]);
+    }
+}
+
 /* ==================== TIME DOMAIN MEASUREMENTS ==================== */
 void measure_time_domain(uint16_t *buffer, uint32_t size,
                          uint32_t sample_rate, Measurements *m) {
+    // Indexing the frame for zoom queries yields its statistics in the same pass
+    PyrStats t;
+    pyramid_update(buffer, size, &t);
     if(size < 64) { m->valid = 0; return; }
 
-    // Single-pass statistics
-    uint32_t sum = 0;
-    uint64_t sum_sq = 0;
-    uint16_t vmin = 4095, vmax = 0;
-    uint32_t high_count = 0;
-
-    for(uint32_t i = 0; i < size; i++) {
-        uint16_t val = buffer[i];
-        sum += val;
-        sum_sq += (uint64_t)val * val;
-        if(val < vmin) vmin = val;
-        if(val > vmax) vmax = val;
-    }
+    uint32_t sum = t.sum;
+    uint64_t sum_sq = t.sum_sq;
+    uint16_t vmin = t.vmin, vmax = t.vmax;
 
     uint16_t dc = sum / size;
     uint16_t amplitude = vmax - vmin;
@@ -127,22 +350,14 @@ void measure_time_domain(uint16_t *buffer, uint32_t size,
     if(hyst < 20) hyst = 20;
     uint16_t thresh_high = dc + hyst, thresh_low = dc - hyst;
 
-    uint32_t rising_edges = 0, first_edge = 0, last_edge = 0;
-    uint8_t state = (buffer[0] > dc);
-
-    for(uint32_t i = 1; i < size; i++) {
-        if(buffer[i] > dc) high_count++;
-
-        // Schmitt trigger edge detection
-        if(!state && buffer[i] > thresh_high) {
-            state = 1;
-            if(!rising_edges) first_edge = i;
-            last_edge = i;
-            rising_edges++;
-        } else if(state && buffer[i] < thresh_low) {
-            state = 0;
-        }
-    }
+    // Schmitt trigger edge detection + duty count
+    EdgeScan e = {
+        .dc = dc, .thresh_high = thresh_high, .thresh_low = thresh_low,
+        .state = (buffer[0] > dc)
+    };
+    time_edges(buffer, size, &e);
+    uint32_t rising_edges = e.rising_edges, first_edge = e.first_edge;
+    uint32_t last_edge = e.last_edge, high_count = e.high_count;
 
     // Calculate frequency from edge timing
     float32_t raw_freq = 0, raw_period = 0;
@@ -200,95 +415,170 @@ void measure_time_domain(uint16_t *buffer, uint32_t size,
 }
 
 /* ==================== FREQUENCY DOMAIN (FFT) ==================== */
-void measure_freq_domain(uint16_t *src, uint32_t sample_rate,
-                         uint16_t *dst, uint16_t dst_size, Measurements *m) {
-    // Reset accumulator on first frame
-    if(fft_frame_count == 0)
-        memset(fft_accumulator, 0, sizeof(fft_accumulator));
-
-    // Remove DC and apply Hanning window
-    float32_t dc = 0;
-    for(uint16_t i = 0; i < FFT_SIZE; i++) dc += src[i];
-    dc /= FFT_SIZE;
+// Magnitudes in ADC counts: rfft 4096 and the cfft 2048 inside it both
+// output 12.4 (q15) / 12.20 (q31), cmplx_mag drops one more bit
+#if FFT_ENGINE == FFT_ENGINE_Q15
+#define fft_magnitude   arm_cmplx_mag_q15
+#define FFT_MAG_SCALE   512.0f
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+#define fft_magnitude   arm_cmplx_mag_q31
+#define FFT_MAG_SCALE   (1.0f / 128.0f)
+#else
+#define fft_magnitude   arm_cmplx_mag_f32
+#define FFT_MAG_SCALE   1.0f
+#endif
+
+// Spectrum sample for a magnitude: display-scaled, or dB of the sine
+// amplitude it stands for (magnitude * amp_cal counts) against full scale
+static inline uint16_t spectrum_code(float32_t mag, float32_t scale, float32_t amp_cal) {
+    if(!fft_scale.db) return (uint16_t)(mag * scale);
+
+    float32_t code = (fast_db20(mag * amp_cal * (1.0f / 2048.0f)) - fft_scale.offset_db)
+                     * (1.0f / OSC_FRAME_DB_PER_LSB);
+    return (code <= 0.0f) ? 0 : (code >= 65535.0f) ? 65535 : (uint16_t)(code + 0.5f);
+}
 
-    for(uint16_t i = 0; i < FFT_SIZE; i++) {
-        float32_t window = 0.5f - 0.5f * arm_cos_f32(2.0f * PI * i / (FFT_SIZE - 1));
-        fft_input[i] = ((float32_t)src[i] - dc) * window;
+/* ==================== PEAK ENGINE ==================== */
+typedef struct {
+    float32_t mag;
+    uint16_t bin;
+} PeakCand;
+
+// Level of the percentile'th bin of fft_accumulator[first, FFT_SIZE/2),
+// to the quarter octave below it: a histogram on each float's exponent and
+// top two mantissa bits, counted down from the strongest bin
+static float32_t peak_floor(uint16_t first, float32_t max_mag) {
+    uint16_t hist[PEAK_HIST_BUCKETS] = {0};
+    union { float32_t f; uint32_t u; } v = { max_mag };
+    int32_t top = (int32_t)(v.u >> 21);
+
+    for(uint16_t i = first; i < FFT_SIZE/2; i++) {
+        v.f = fft_accumulator[i];
+        int32_t b = top - (int32_t)(v.u >> 21);
+        hist[(b < 0) ? 0 : (b >= PEAK_HIST_BUCKETS) ? PEAK_HIST_BUCKETS - 1 : b]++;
     }
 
-    // Execute FFT
-    arm_rfft_fast_f32(&fft_instance, fft_input, fft_output, 0);
-
-    // Magnitude with exponential averaging
-    float32_t hz_per_bin = (float32_t)sample_rate / FFT_SIZE;
-    float32_t max_mag = 0;
-    uint16_t max_idx = 0;
-    float32_t alpha = 0.3f;
+    // Quietest buckets first until more than the percentile's share is below
+    uint32_t rank = (uint32_t)(FFT_SIZE/2 - first) * peak_cfg.percentile / 100, below = 0;
+    int32_t b = PEAK_HIST_BUCKETS - 1;
+    for(; b > 0; b--) {
+        below += hist[b];
+        if(below > rank) break;
+    }
+    if(top - b <= 0) return 0.0f;
+    v.u = (uint32_t)(top - b) << 21;
+    return v.f;
+}
 
-    for(uint16_t i = 0; i < FFT_SIZE/2; i++) {
-        float32_t real = fft_output[i*2], imag = fft_output[i*2+1];
-        float32_t mag;
-        arm_sqrt_f32(real*real + imag*imag, &mag);
+// Min-heap on magnitude: the root is the weakest peak kept so far
+static void heap_sift_down(PeakCand *h, uint8_t n, uint8_t i) {
+    for(;;) {
+        uint8_t c = 2 * i + 1;
+        if(c >= n) return;
+        if(c + 1 < n && h[c + 1].mag < h[c].mag) c++;
+        if(h[i].mag <= h[c].mag) return;
+        PeakCand t = h[i]; h[i] = h[c]; h[c] = t;
+        i = c;
+    }
+}
 
-        fft_accumulator[i] = (fft_frame_count == 0) ? mag :
-                             fft_accumulator[i] * (1.0f - alpha) + mag * alpha;
+static void heap_offer(PeakCand *h, uint8_t *n, PeakCand p) {
+    if(*n < peak_cfg.count) {
+        uint8_t i = (*n)++;
+        h[i] = p;
+        while(i && h[(i - 1) / 2].mag > h[i].mag) {
+            PeakCand t = h[i]; h[i] = h[(i - 1) / 2]; h[(i - 1) / 2] = t;
+            i = (i - 1) / 2;
+        }
+    } else if(p.mag > h[0].mag) {
+        h[0] = p;
+        heap_sift_down(h, *n, 0);
+    }
+}
 
-        if(i > 2 && fft_accumulator[i] > max_mag) {
-            max_mag = fft_accumulator[i];
-            max_idx = i;
+// Local maxima of fft_accumulator above threshold; of those closer than
+// spacing bins only the stronger survives. The top peak_cfg.count go
+// through a bounded heap, O(bins + peaks log K), and come out in peaks[]
+// strongest first; returns how many
+static uint8_t find_peaks(float32_t threshold, uint32_t spacing, PeakCand *peaks) {
+    PeakCand pend = {0.0f, 0};
+    uint8_t n = 0;
+
+    if(spacing < 1) spacing = 1;
+    for(uint16_t i = 3; i < FFT_SIZE/2 - 1; i++) {
+        float32_t y = fft_accumulator[i];
+        if(y <= threshold || y <= fft_accumulator[i-1] || y < fft_accumulator[i+1]) continue;
+
+        if(pend.mag > 0.0f && (uint32_t)(i - pend.bin) < spacing) {
+            if(y > pend.mag) pend = (PeakCand){y, i};
+            continue;
         }
+        if(pend.mag > 0.0f) heap_offer(peaks, &n, pend);
+        pend = (PeakCand){y, i};
     }
-    fft_frame_count++;
+    if(pend.mag > 0.0f) heap_offer(peaks, &n, pend);
+
+    // Heap sort: each weakest root moves behind the shrinking heap
+    for(uint8_t k = n; k > 1; ) {
+        PeakCand t = peaks[0];
+        peaks[0] = peaks[--k];
+        heap_sift_down(peaks, k, 0);
+        peaks[k] = t;
+    }
+    return n;
+}
 
-    // Peak detection with quadratic interpolation
-    typedef struct { float32_t idx, mag; } Peak;
-    Peak peaks[20];
-    uint8_t peak_count = 0;
-    float32_t threshold = max_mag * 0.10f;
-
-    for(uint16_t i = 3; i < (FFT_SIZE/2) - 3 && peak_count < 20; i++) {
-        if(fft_accumulator[i] > threshold &&
-           fft_accumulator[i] > fft_accumulator[i-1] &&
-           fft_accumulator[i] > fft_accumulator[i+1] &&
-           fft_accumulator[i] > fft_accumulator[i-2] &&
-           fft_accumulator[i] > fft_accumulator[i+2]) {
-            // Quadratic interpolation for sub-bin accuracy
-            float32_t y0 = fft_accumulator[i-1];
-            float32_t y1 = fft_accumulator[i];
-            float32_t y2 = fft_accumulator[i+1];
-            float32_t denom = y0 - 2*y1 + y2;
-            float32_t delta = (denom != 0) ? (0.5f * (y0 - y2) / denom) : 0;
-
-            peaks[peak_count].idx = (float32_t)i + delta;
-            peaks[peak_count].mag = y1;
-            peak_count++;
-            i += 3;  // Skip nearby bins
+// Sub-bin offset of the tone behind local maximum bin i, within +-0.5
+static float32_t peak_offset(uint16_t i) {
+    float32_t y0 = fft_accumulator[i-1], y1 = fft_accumulator[i], y2 = fft_accumulator[i+1];
+    float32_t d = 0.0f;
+
+    if(peak_cfg.interp == PEAK_JACOBSEN) {
+        float32_t sum = y0 + y1 + y2;
+        if(sum > 0.0f) d = fft_window_jacobsen * (y2 - y0) / sum;
+    } else {
+        // Gaussian: the parabola through log magnitudes, exact for a Gaussian lobe
+        if(peak_cfg.interp == PEAK_GAUSSIAN) {
+            y0 = fast_db20(y0); y1 = fast_db20(y1); y2 = fast_db20(y2);
         }
+        float32_t denom = y0 - 2.0f * y1 + y2;
+        if(denom != 0.0f) d = 0.5f * (y0 - y2) / denom;
     }
+    return (d < -0.5f) ? -0.5f : (d > 0.5f) ? 0.5f : d;
+}
 
-    // Sort peaks by magnitude (descending)
-    for(uint8_t i = 0; i < peak_count; i++) {
-        for(uint8_t j = 0; j < peak_count - i - 1; j++) {
-            if(peaks[j].mag < peaks[j+1].mag) {
-                Peak tmp = peaks[j];
-                peaks[j] = peaks[j+1];
-                peaks[j+1] = tmp;
-            }
+// Peaks, Parseval RMS and display for the FFT_SIZE/2 averaged magnitudes in
+// fft_accumulator, bin i at f0 + i * hz_per_bin; peak frequencies are
+// reported in 1/peak_unit Hz. A sine of amplitude A counts on a bin reads
+// A / amp_cal there
+static void spectrum_report(float32_t f0, float32_t hz_per_bin, float32_t peak_unit, float32_t amp_cal,
+                            uint16_t *dst, uint16_t dst_size, Measurements *m) {
+    uint32_t t3 = DWT->CYCCNT;
+    float32_t max_mag = 0;
+    uint16_t max_idx = 0;
+
+    for(uint16_t i = 3; i < FFT_SIZE/2; i++) {
+        if(fft_accumulator[i] > max_mag) {
+            max_mag = fft_accumulator[i];
+            max_idx = i;
         }
     }
 
     // Scale factor for display
     float32_t scale = (max_mag > 1.0f) ? (3800.0f / max_mag) : 1.0f;
 
-    // Store top 5 peaks
-    m->num_peaks = (peak_count > 5) ? 5 : peak_count;
+    // Strongest peaks, strongest first
+    PeakCand peaks[MAX_PEAKS];
+    uint32_t spacing = peak_cfg.spacing_hz ? (uint32_t)(peak_cfg.spacing_hz / hz_per_bin) : fft_window_lobe;
+    m->num_peaks = find_peaks(peak_floor(3, max_mag) * peak_cfg.margin, spacing, peaks);
     for(uint8_t i = 0; i < m->num_peaks; i++) {
-        m->peak_freqs[i] = (uint32_t)(peaks[i].idx * hz_per_bin);
-        m->peak_mags[i] = (uint16_t)(peaks[i].mag * scale);
+        float32_t idx = (float32_t)peaks[i].bin + peak_offset(peaks[i].bin);
+        m->peak_freqs[i] = (uint32_t)((f0 + idx * hz_per_bin) * peak_unit + 0.5f);
+        m->peak_mags[i] = spectrum_code(peaks[i].mag, scale, amp_cal);
     }
 
     // Basic measurements
-    m->frequency_hz = (uint32_t)(max_idx * hz_per_bin);
+    m->frequency_hz = (uint32_t)(f0 + max_idx * hz_per_bin);
     m->period_us = m->frequency_hz ? (1000000UL / m->frequency_hz) : 0;
     m->amplitude_mv = (uint16_t)(max_mag * scale * 0.87f);
 
@@ -300,6 +590,7 @@ void measure_freq_domain(uint16_t *src, uint32_t sample_rate,
     arm_sqrt_f32(total_power * 2.0f / FFT_SIZE, &rms);
     m->vrms_mv = (uint16_t)(rms * 3300.0f / 4095.0f / sqrtf(2.0f));
     m->valid = (max_mag > 100.0f && m->num_peaks > 0);
+    m->psd_segments = 0;
 
     // Downsample spectrum for display
     if(dst) {
@@ -311,7 +602,324 @@ void measure_freq_domain(uint16_t *src, uint32_t sample_rate,
                 if(idx < FFT_SIZE/2 && fft_accumulator[idx] > local_max)
                     local_max = fft_accumulator[idx];
             }
-            dst[i] = (uint16_t)(local_max * scale);
+            dst[i] = spectrum_code(local_max, scale, amp_cal);
+        }
+    }
+
+    fft_cycles.peaks = DWT->CYCCNT - t3;
+}
+
+// Exponential average of FFT_SIZE/2 magnitudes, bin i read from
+// mags[i + shift] (wrapping), then spectrum_report()
+static void analyse_spectrum(const fft_sample_t *mags, uint16_t shift,
+                             float32_t f0, float32_t hz_per_bin, float32_t peak_unit, float32_t amp_cal,
+                             uint16_t *dst, uint16_t dst_size, Measurements *m, uint32_t t2) {
+    float32_t alpha = 0.3f;
+
+    for(uint16_t i = 0; i < FFT_SIZE/2; i++) {
+        float32_t mag = (float32_t)mags[(i + shift) & (FFT_SIZE/2 - 1)] * FFT_MAG_SCALE;
+
+        fft_accumulator[i] = (fft_frame_count == 0) ? mag :
+                             fft_accumulator[i] * (1.0f - alpha) + mag * alpha;
+    }
+    fft_frame_count++;
+    fft_cycles.magnitude = DWT->CYCCNT - t2;
+    fft_cycles.segments = 1;
+
+    spectrum_report(f0, hz_per_bin, peak_unit, amp_cal, dst, dst_size, m);
+}
+
+// Remove the segment's DC and apply the window (table mirrored around the centre)
+static void window_segment(const uint16_t *src) {
+    uint32_t sum = 0;
+    for(uint16_t i = 0; i < FFT_SIZE; i++) sum += src[i];
+
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    // 12-bit samples scaled into q15 (<<3), DC kept at full precision
+    int32_t dc = (sum << 3) / FFT_SIZE;
+    for(uint16_t i = 0, j = FFT_SIZE - 1; i < FFT_SIZE/2; i++, j--) {
+        fft_input[i] = (q15_t)((((int32_t)(src[i] << 3) - dc) * fft_window[i]) >> 15);
+        fft_input[j] = (q15_t)((((int32_t)(src[j] << 3) - dc) * fft_window[i]) >> 15);
+    }
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    int32_t dc = (int32_t)(((uint64_t)sum << 19) / FFT_SIZE);
+    for(uint16_t i = 0, j = FFT_SIZE - 1; i < FFT_SIZE/2; i++, j--) {
+        fft_input[i] = (q31_t)((((int64_t)src[i] << 19) - dc) * fft_window[i] >> 31);
+        fft_input[j] = (q31_t)((((int64_t)src[j] << 19) - dc) * fft_window[i] >> 31);
+    }
+#else
+    float32_t dc = (float32_t)sum / FFT_SIZE;
+    for(uint16_t i = 0, j = FFT_SIZE - 1; i < FFT_SIZE/2; i++, j--) {
+        fft_input[i] = ((float32_t)src[i] - dc) * fft_window[i];
+        fft_input[j] = ((float32_t)src[j] - dc) * fft_window[i];
+    }
+#endif
+}
+
+// fft_input -> fft_output (input is consumed and free again afterwards)
+static void rfft_segment(void) {
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    arm_rfft_q15(&fft_instance, fft_input, fft_output);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    arm_rfft_q31(&fft_instance, fft_input, fft_output);
+#else
+    arm_rfft_fast_f32(&fft_instance, fft_input, fft_output, 0);
+#endif
+}
+
+static int16_t centi_db(float32_t power_ratio) {
+    if(power_ratio < 1e-30f) power_ratio = 1e-30f;
+    return (int16_t)lrintf(1000.0f * log10f(power_ratio));
+}
+
+// THD, THD+N, SNR, SFDR and ENOB of the spectrum in fft_accumulator. Power
+// adds, so magnitudes are squared as they are read; the fundamental and
+// each harmonic own their leakage width around the peak, everything else
+// past the DC lobe is noise (scaled up to the whole band for the bins the
+// tones hide). Harmonics above Nyquist are left out rather than folded back
+static void distortion_report(Measurements *m) {
+    uint32_t t0 = DWT->CYCCNT;
+    const float32_t *a = fft_accumulator;
+    const int32_t half = FFT_SIZE / 2, lobe = fft_window_lobe;
+    int32_t lo[DIST_MAX_HARMONICS + 1], hi[DIST_MAX_HARMONICS + 1];
+
+    m->dist_harmonics = 0;
+    fft_cycles.distortion = 0;
+    if(!dist_harmonics) return;
+
+    // Fundamental: strongest bin past the segment DC removal's residue,
+    // frequency from the power centroid of its lobe (exact for a tone
+    // between bins). A low tone's lobe takes over the DC bins it reaches
+    int32_t k = 3;
+    for(int32_t i = k; i < half - lobe; i++)
+        if(a[i] > a[k]) k = i;
+    lo[0] = (k - lobe > 1) ? k - lobe : 1;
+    hi[0] = k + lobe;
+    float32_t fund = 0, moment = 0;
+    for(int32_t i = lo[0]; i <= hi[0]; i++) {
+        fund += a[i] * a[i];
+        moment += a[i] * a[i] * i;
+    }
+    if(fund <= 0) return;
+    float32_t f1 = moment / fund;
+
+    // Harmonics: the peak within a bin or two of n * f1 and its lobe
+    float32_t harm = 0, spur = 0;
+    uint8_t n = 0;
+    while(n < dist_harmonics) {
+        int32_t c = (int32_t)lrintf((n + 2) * f1);
+        int32_t p = (c - 2 > hi[n]) ? c - 2 : hi[n] + 1;
+        if(p + lobe + 4 >= half) break;
+        for(int32_t i = p + 1; i <= c + 2; i++)
+            if(a[i] > a[p]) p = i;
+        n++;
+        lo[n] = (p - lobe > hi[n - 1]) ? p - lobe : hi[n - 1] + 1;
+        hi[n] = p + lobe;
+        for(int32_t i = lo[n]; i <= hi[n]; i++) harm += a[i] * a[i];
+        if(a[p] > spur) spur = a[p];
+    }
+
+    // Noise in the gaps between the tones; any of its bins may be the spur
+    float32_t noise = 0;
+    int32_t noise_bins = 0, from = (lobe < lo[0]) ? lobe + 1 : lo[0];
+    for(uint8_t r = 0; r <= n; r++) {
+        for(int32_t i = from; i < lo[r]; i++) {
+            noise += a[i] * a[i];
+            if(a[i] > spur) spur = a[i];
+        }
+        noise_bins += lo[r] - from;
+        from = hi[r] + 1;
+    }
+    for(int32_t i = from; i < half; i++) {
+        noise += a[i] * a[i];
+        if(a[i] > spur) spur = a[i];
+    }
+    noise_bins += half - from;
+    if(noise_bins > 0) noise *= (float32_t)(half - 1) / noise_bins;
+    if(noise <= 0) noise = fund * 1e-15f;
+
+    // Lobe power to the tone's mean square (A^2/2 = 2 * sum / (N * sum(w^2)))
+    // for the full-scale correction of ENOB
+    const float32_t full_scale = 2048.0f * 2048.0f / 2.0f;
+    float32_t tone_ms = 2.0f * fund / (FFT_SIZE * fft_window_sum_sq);
+    int32_t sinad_cdb = -centi_db((harm + noise) / fund);
+    int32_t enob = (sinad_cdb - 176 - centi_db(tone_ms / full_scale)) * 100 / 602;
+
+    m->dist_harmonics = n;
+    m->thd_cdb = n ? centi_db(harm / fund) : 0;
+    m->thdn_cdb = -sinad_cdb;
+    m->snr_cdb = centi_db(fund / noise);
+    m->sfdr_cdb = (spur > 0) ? centi_db(a[k] * a[k] / (spur * spur)) : m->snr_cdb;
+    m->enob_cbits = (enob < 0) ? 0 : (uint16_t)enob;
+    fft_cycles.distortion = DWT->CYCCNT - t0;
+}
+
+void measure_freq_domain(uint16_t *src, uint32_t sample_rate,
+                         uint16_t *dst, uint16_t dst_size, Measurements *m) {
+    // Reset accumulator on first frame
+    if(fft_frame_count == 0)
+        memset(fft_accumulator, 0, (FFT_SIZE / 2) * sizeof(float32_t));
+
+    uint32_t t0 = DWT->CYCCNT;
+    window_segment(src);
+    uint32_t t1 = DWT->CYCCNT;
+    rfft_segment();
+    uint32_t t2 = DWT->CYCCNT;
+
+    // Batch magnitudes (input is free again), scaled back to ADC counts
+    fft_sample_t *mags = fft_input;
+    fft_magnitude(fft_output, mags, FFT_SIZE/2);
+    analyse_spectrum(mags, 0, 0.0f, (float32_t)sample_rate / FFT_SIZE, 1.0f,
+                     2.0f / fft_window_sum, dst, dst_size, m, t2);
+    distortion_report(m);
+
+    fft_cycles.window = t1 - t0;
+    fft_cycles.fft = t2 - t1;
+}
+
+// k-th smallest of v[0, n), Wirth's selection (reorders v)
+static float32_t select_kth(float32_t *v, int32_t n, int32_t k) {
+    int32_t lo = 0, hi = n - 1;
+    while(lo < hi) {
+        float32_t pivot = v[k];
+        int32_t i = lo, j = hi;
+        do {
+            while(v[i] < pivot) i++;
+            while(pivot < v[j]) j--;
+            if(i <= j) {
+                float32_t tmp = v[i]; v[i] = v[j]; v[j] = tmp;
+                i++; j--;
+            }
+        } while(i <= j);
+        if(j < k) lo = i;
+        if(k < i) hi = j;
+    }
+    return v[k];
+}
+
+uint8_t measure_welch_domain(uint16_t *src, uint32_t n, uint32_t sample_rate,
+                             uint8_t segments, uint8_t overlap_percent,
+                             uint16_t *dst, uint16_t dst_size, Measurements *m) {
+    if(fft_frame_count == 0)
+        memset(fft_accumulator, 0, (FFT_SIZE / 2) * sizeof(float32_t));
+    if(segments < 1) segments = 1;
+    if(overlap_percent > WELCH_MAX_OVERLAP) overlap_percent = WELCH_MAX_OVERLAP;
+    uint32_t hop = FFT_SIZE - (FFT_SIZE * overlap_percent) / 100;
+
+    // Power, not magnitude, is what averages: |X|^2 of every segment adds
+    // up in fft_accumulator, fft_frame_count counts the segments
+    fft_cycles.window = fft_cycles.fft = fft_cycles.magnitude = fft_cycles.segments = 0;
+    for(uint32_t start = 0; start + FFT_SIZE <= n && fft_frame_count < segments; start += hop) {
+        uint32_t t0 = DWT->CYCCNT;
+        window_segment(&src[start]);
+        uint32_t t1 = DWT->CYCCNT;
+        rfft_segment();
+        uint32_t t2 = DWT->CYCCNT;
+#if FFT_ENGINE == FFT_ENGINE_F32
+        arm_cmplx_mag_squared_f32(fft_output, fft_input, FFT_SIZE/2);
+        arm_add_f32(fft_accumulator, fft_input, fft_accumulator, FFT_SIZE/2);
+#else
+        fft_magnitude(fft_output, fft_input, FFT_SIZE/2);
+        for(uint16_t i = 0; i < FFT_SIZE/2; i++) {
+            float32_t mag = (float32_t)fft_input[i] * FFT_MAG_SCALE;
+            fft_accumulator[i] += mag * mag;
         }
+#endif
+        fft_frame_count++;
+        fft_cycles.window += t1 - t0;
+        fft_cycles.fft += t2 - t1;
+        fft_cycles.magnitude += DWT->CYCCNT - t2;
+        fft_cycles.segments++;
+    }
+    if(fft_frame_count < segments) return 0;
+
+    // Bins calibrated to the mean square of a sine on them (coherent gain:
+    // amplitude A gives |X| = A * sum(w) / 2); spread power is divided by the
+    // window's equivalent noise bandwidth, N * sum(w^2) / sum(w)^2 bins
+    uint32_t t3 = DWT->CYCCNT;
+    float32_t hz_per_bin = (float32_t)sample_rate / FFT_SIZE;
+    float32_t bin_cal = 2.0f / (fft_window_sum * fft_window_sum * segments);
+    float32_t enbw = FFT_SIZE * fft_window_sum_sq / (fft_window_sum * fft_window_sum);
+    const float32_t full_scale = 2048.0f * 2048.0f / 2.0f;    // Full-scale sine, counts^2
+
+    // Tone: the strongest bin's main lobe, whatever the window
+    uint16_t k = 3;
+    for(uint16_t i = 3; i < FFT_SIZE/2; i++)
+        if(fft_accumulator[i] > fft_accumulator[k]) k = i;
+    float32_t tone = 0;
+    for(uint16_t i = (k > 8) ? k - 5 : 3; i <= k + 5 && i < FFT_SIZE/2; i++)
+        tone += fft_accumulator[i];
+    tone *= bin_cal / enbw;
+
+    // Noise floor: median bin (tones barely move it), scaled to the mean of
+    // an average of `segments` chi-squared bins, per Hz
+    float32_t *scratch = (float32_t*)fft_input;
+    memcpy(scratch, &fft_accumulator[3], (FFT_SIZE/2 - 3) * sizeof(float32_t));
+    float32_t median = select_kth(scratch, FFT_SIZE/2 - 3, (FFT_SIZE/2 - 3) / 2);
+    float32_t bias = 1.0f - 1.0f / (9.0f * segments);
+    float32_t floor_hz = median / (bias * bias * bias) * bin_cal / enbw / hz_per_bin;
+
+    // Back to magnitudes for the peaks and display shared with the EMA spectrum
+    for(uint16_t i = 0; i < FFT_SIZE/2; i++)
+        arm_sqrt_f32(fft_accumulator[i] / segments, &fft_accumulator[i]);
+    fft_frame_count = 0;
+    fft_cycles.magnitude += DWT->CYCCNT - t3;
+
+    spectrum_report(0.0f, hz_per_bin, 1.0f, 2.0f / fft_window_sum, dst, dst_size, m);
+    distortion_report(m);
+    m->psd_segments = segments;
+    m->psd_overlap = overlap_percent;
+    m->psd_tone_cdbfs = centi_db(tone / full_scale);
+    m->psd_floor_cdbfs = centi_db(floor_hz / full_scale);
+    return 1;
+}
+
+void measure_zoom_domain(uint16_t *dst, uint16_t dst_size, Measurements *m) {
+    const ZoomBand *band = zoom_band();
+    if(fft_frame_count == 0)
+        memset(fft_accumulator, 0, (FFT_SIZE / 2) * sizeof(float32_t));
+
+    uint32_t t0 = DWT->CYCCNT;
+
+    // Unroll the ring oldest first under the window (every other table entry)
+    uint32_t head = zoom_take();
+    for(uint16_t i = 0; i < ZOOM_BINS; i++) {
+        uint32_t r = 2 * ((head + i) & (ZOOM_BINS - 1));
+        fft_sample_t w = fft_window[(i < ZOOM_BINS/2) ? 2 * i : 2 * (ZOOM_BINS - 1 - i)];
+#if FFT_ENGINE == FFT_ENGINE_Q15
+        fft_input[2 * i] = (q15_t)(((int32_t)fft_output[r] * w) >> 15);
+        fft_input[2 * i + 1] = (q15_t)(((int32_t)fft_output[r + 1] * w) >> 15);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+        fft_input[2 * i] = (q31_t)(((int64_t)fft_output[r] * w) >> 31);
+        fft_input[2 * i + 1] = (q31_t)(((int64_t)fft_output[r + 1] * w) >> 31);
+#else
+        fft_input[2 * i] = fft_output[r] * w;
+        fft_input[2 * i + 1] = fft_output[r + 1] * w;
+#endif
     }
+    uint32_t t1 = DWT->CYCCNT;
+
+    // The rfft's own half-size complex FFT, in place
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    arm_cfft_q15(fft_instance.pCfft, fft_input, 0, 1);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    arm_cfft_q31(fft_instance.pCfft, fft_input, 0, 1);
+#else
+    arm_cfft_f32(&fft_instance.Sint, fft_input, 0, 1);
+#endif
+    uint32_t t2 = DWT->CYCCNT;
+
+    // In place: each magnitude lands below the pair it comes from. Bin 0 is
+    // the centre, so read from ZOOM_BINS/2 to put the band's low edge first.
+    // The mixer keeps a tone's amplitude as one phasor over half the window's
+    // points, so a bin reads what the rfft's would
+    fft_magnitude(fft_input, fft_input, ZOOM_BINS);
+    analyse_spectrum(fft_input, ZOOM_BINS / 2, band->center_hz - band->rate_hz / 2,
+                     band->rate_hz / ZOOM_BINS, 1000.0f, 2.0f / fft_window_sum,
+                     dst, dst_size, m, t2);
+    m->dist_harmonics = 0;  // Harmonics lie outside the band
+    fft_cycles.distortion = 0;
+
+    fft_cycles.window = t1 - t0;
+    fft_cycles.fft = t2 - t1;
 }
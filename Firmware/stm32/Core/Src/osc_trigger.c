@@ -0,0 +1,259 @@
+#include "osc_trigger.h"
+#include "osc_signal.h"
+#include <string.h>
+
+#define RING_SIZE   ADC_BUFFER_SIZE     // Power of 2 (index masking)
+#define RING_MASK   (RING_SIZE - 1)
+
+/* ==================== TRIGGER STATE ==================== */
+typedef enum {
+    PHASE_IDLE = 0,         // Not capturing
+    PHASE_PRETRIG,          // Filling pre-trigger / holdoff samples
+    PHASE_ARMING,           // Waiting for signal beyond hysteresis
+    PHASE_ARMED,            // Waiting for the edge
+    PHASE_FIRED,            // Collecting post-trigger samples
+    PHASE_CAPTURED          // Frame aligned, waiting for consumer
+} TrigPhase;
+
+static struct {
+    ADC_HandleTypeDef *hadc;
+    TriggerMode mode;
+    TriggerEdge edge;
+    uint16_t level;                     // Trigger level (ADC counts)
+    uint16_t arm_low, arm_high;         // AWD window while arming
+    uint16_t fire_low, fire_high;       // AWD window while armed
+    uint32_t pre, post;                 // Window split (samples)
+    uint32_t spill;                     // Free samples behind the ring
+    uint32_t arm_after;                 // Samples before arming
+    uint32_t auto_ms;                   // Auto free-run timeout
+    uint32_t arm_tick;
+    volatile TrigPhase phase;
+    volatile uint32_t wraps;            // DMA ring wraps since restart
+    volatile uint32_t trig_at;          // Samples written at AWD hit
+    uint16_t *frame;                    // Captured window (in the ring or run on past it)
+    uint8_t forced;
+} trig;
+
+/* ==================== HELPERS ==================== */
+static inline uint16_t mv_to_adc(uint32_t mv) {
+    uint32_t v = (mv * 4095UL) / 3300;
+    return (v > 4095) ? 4095 : v;
+}
+
+// Samples written since restart (DMA counter counts down per ring lap)
+static uint32_t ring_elapsed(void) {
+    uint32_t w, pos;
+    do {
+        w = trig.wraps;
+        pos = RING_SIZE - __HAL_DMA_GET_COUNTER(trig.hadc->DMA_Handle);
+    } while(w != trig.wraps);
+    return w * RING_SIZE + (pos & RING_MASK);
+}
+
+static inline void awd_window(uint16_t low, uint16_t high) {
+    trig.hadc->Instance->LTR = low;
+    trig.hadc->Instance->HTR = high;
+}
+
+static inline uint8_t past_level(uint16_t v) {
+    return (trig.edge == TRIG_RISING) ? (v > trig.level) : (v < trig.level);
+}
+
+// AWD interrupt latency leaves the hit a few samples late: walk back to the edge
+static uint32_t refine_edge(uint32_t idx) {
+    for(uint16_t n = 0; n < TRIG_REFINE_SPAN; n++) {
+        uint32_t prev = (idx - 1) & RING_MASK;
+        if(!past_level(adc_buffer[prev])) break;
+        idx = prev;
+    }
+    return idx;
+}
+
+// Frame for ring[start, start + window) with indices wrapping at RING_SIZE.
+// A window short of the ring end is used where it lies; one that wraps
+// gets its head continued past the end (the spill) or, when that memory
+// is taken, slid through the gap the window leaves in the ring
+static uint16_t *ring_window(uint32_t start, uint32_t window) {
+    uint32_t head = RING_SIZE - start;
+    if(window <= head) return adc_buffer + start;
+
+    uint32_t tail = window - head, gap = RING_SIZE - window;
+    if(tail <= trig.spill) {
+        memcpy(adc_buffer + RING_SIZE, adc_buffer, tail * sizeof(uint16_t));
+        return adc_buffer + start;
+    }
+    if(tail <= gap) {
+        memmove(adc_buffer + start - tail, adc_buffer + start, head * sizeof(uint16_t));
+        memcpy(adc_buffer + RING_SIZE - tail, adc_buffer, tail * sizeof(uint16_t));
+        return adc_buffer + start - tail;
+    }
+    if(head <= gap) {
+        memmove(adc_buffer + head, adc_buffer, tail * sizeof(uint16_t));
+        memcpy(adc_buffer, adc_buffer + start, head * sizeof(uint16_t));
+        return adc_buffer;
+    }
+
+    // Both pieces outgrow the gap: rotate the ring, one move per sample
+    // along each of the gcd(RING_SIZE, start) cycles
+    uint32_t cycles = start & (~start + 1);
+    for(uint32_t c = 0; c < cycles; c++) {
+        uint16_t first = adc_buffer[c];
+        uint32_t i = c, next;
+        while((next = (i + start) & RING_MASK) != c) {
+            adc_buffer[i] = adc_buffer[next];
+            i = next;
+        }
+        adc_buffer[i] = first;
+    }
+    return adc_buffer;
+}
+
+static void capture_restart(void) {
+    trig.wraps = 0;
+    trig.forced = 0;
+    trig.phase = PHASE_PRETRIG;
+    HAL_ADC_Start_DMA(trig.hadc, (uint32_t*)adc_buffer, RING_SIZE);
+    __HAL_ADC_DISABLE_IT(trig.hadc, ADC_IT_OVR);
+}
+
+/* ==================== CONFIGURATION ==================== */
+void trigger_start(ADC_HandleTypeDef *hadc, const OscSettings *s, uint32_t window, uint32_t spill) {
+    trigger_stop();
+    trig.hadc = hadc;
+    trig.spill = spill;
+    trig.mode = s->trig_mode;
+    trig.edge = s->trig_edge;
+
+    if(window > TRIG_MAX_WINDOW) window = TRIG_MAX_WINDOW;
+    trig.pre = (window * s->trig_pre_percent) / 100;
+    trig.post = window - trig.pre;
+
+    // Schmitt trigger in hardware: arm beyond hysteresis, fire past the level
+    uint16_t level = mv_to_adc(s->trig_level_mv);
+    uint16_t hyst = mv_to_adc(s->trig_hyst_mv);
+    if(hyst < 1) hyst = 1;
+    trig.level = level;
+
+    if(trig.edge == TRIG_RISING) {
+        trig.arm_low = (level > hyst) ? level - hyst : 0;
+        trig.arm_high = 4095;
+        trig.fire_low = 0;
+        trig.fire_high = level;
+    } else {
+        trig.arm_low = 0;
+        trig.arm_high = (level + hyst < 4095) ? level + hyst : 4095;
+        trig.fire_low = level;
+        trig.fire_high = 4095;
+    }
+
+    // Pre-trigger data and holdoff both gate arming after a restart
+    uint32_t holdoff = ((uint64_t)s->trig_holdoff_us * s->sample_rate_hz) / 1000000ULL;
+    trig.arm_after = trig.pre + TRIG_REFINE_SPAN;
+    if(holdoff > trig.arm_after) trig.arm_after = holdoff;
+
+    uint32_t window_ms = ((uint64_t)window * 1000) / s->sample_rate_hz;
+    trig.auto_ms = 2 * window_ms;
+    if(trig.auto_ms < TRIG_AUTO_MIN_MS) trig.auto_ms = TRIG_AUTO_MIN_MS;
+
+    ADC_AnalogWDGConfTypeDef awd = {
+        .WatchdogMode = ADC_ANALOGWATCHDOG_SINGLE_REG,
+        .HighThreshold = trig.arm_high,
+        .LowThreshold = trig.arm_low,
+        .Channel = ADC_CHANNEL_0,
+        .ITMode = DISABLE
+    };
+    HAL_ADC_AnalogWDGConfig(hadc, &awd);
+
+    capture_restart();
+}
+
+void trigger_stop(void) {
+    if(trig.hadc) __HAL_ADC_DISABLE_IT(trig.hadc, ADC_IT_AWD);
+    trig.phase = PHASE_IDLE;
+}
+
+/* ==================== MAIN LOOP ==================== */
+uint8_t trigger_poll(void) {
+    switch(trig.phase) {
+        case PHASE_PRETRIG:
+            if(ring_elapsed() < trig.arm_after) return 0;
+            awd_window(trig.arm_low, trig.arm_high);
+            trig.arm_tick = HAL_GetTick();
+            trig.phase = PHASE_ARMING;
+            __HAL_ADC_CLEAR_FLAG(trig.hadc, ADC_FLAG_AWD);
+            __HAL_ADC_ENABLE_IT(trig.hadc, ADC_IT_AWD);
+            return 0;
+
+        case PHASE_ARMING:
+        case PHASE_ARMED:
+            // Auto mode free-runs when no edge shows up in time
+            if(trig.mode != TRIG_AUTO) return 0;
+            if((HAL_GetTick() - trig.arm_tick) < trig.auto_ms) return 0;
+            __HAL_ADC_DISABLE_IT(trig.hadc, ADC_IT_AWD);
+            if(trig.phase != PHASE_FIRED) {
+                trig.trig_at = ring_elapsed();
+                trig.forced = 1;
+                trig.phase = PHASE_FIRED;
+            }
+            return 0;
+
+        case PHASE_FIRED: {
+            uint32_t since = ring_elapsed() - trig.trig_at;
+            if(since < trig.post) return 0;
+            HAL_ADC_Stop_DMA(trig.hadc);
+
+            // Main loop stalled too long: pre-trigger data was overwritten
+            if(since >= RING_SIZE - trig.pre - TRIG_REFINE_SPAN) {
+                capture_restart();
+                return 0;
+            }
+
+            uint32_t idx = (trig.trig_at - 1) & RING_MASK;
+            if(!trig.forced) idx = refine_edge(idx);
+            trig.frame = ring_window((idx - trig.pre) & RING_MASK, trig.pre + trig.post);
+            trig.phase = PHASE_CAPTURED;
+            return 1;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+void trigger_rearm(void) {
+    if(trig.phase != PHASE_CAPTURED) return;
+    if(trig.mode == TRIG_SINGLE) {
+        trig.phase = PHASE_IDLE;  // Hold until G:3 re-arms
+        return;
+    }
+    capture_restart();
+}
+
+uint8_t trigger_holding(void) {
+    return trig.phase == PHASE_IDLE && trig.mode == TRIG_SINGLE;
+}
+
+uint16_t *trigger_frame(void) {
+    return trig.frame;
+}
+
+uint8_t trigger_was_forced(void) {
+    return trig.forced;
+}
+
+/* ==================== INTERRUPT HOOKS ==================== */
+void trigger_awd_isr(void) {
+    if(trig.phase == PHASE_ARMING) {
+        // Signal crossed the hysteresis band: now watch for the edge
+        awd_window(trig.fire_low, trig.fire_high);
+        trig.phase = PHASE_ARMED;
+    } else if(trig.phase == PHASE_ARMED) {
+        __HAL_ADC_DISABLE_IT(trig.hadc, ADC_IT_AWD);
+        trig.trig_at = ring_elapsed();
+        trig.phase = PHASE_FIRED;
+    }
+}
+
+void trigger_wrap_isr(void) {
+    trig.wraps++;
+}
@@ -0,0 +1,241 @@
+#include "osc_zoom.h"
+#include "main.h"
+#include <string.h>
+
+/* ==================== DECIMATOR STATE ==================== */
+#define ZOOM_FRAC       16          // Fraction bits of CIC/FIR samples (ADC counts << 16)
+#define MIX_FRAC        3           // Fraction bits of the mixer output (16-bit signed)
+#define MIX_ROUND       (1 << (13 - MIX_FRAC))
+#define ZOOM_ADC_MID    2048        // Mid-scale of the 12-bit ADC
+#define NCO_SIZE        (1u << ZOOM_NCO_BITS)
+#define NCO_QUARTER     (NCO_SIZE / 4)
+#define FIR_GRID        128         // Frequency points of the FIR design
+
+static ZoomBand band = {0};
+static int16_t nco_cos[NCO_SIZE];   // q15 cosine, filled on first use
+static uint32_t nco_step;           // Phase increment per ADC sample (2^32 = one turn)
+static int16_t fir_taps[ZOOM_FIR_TAPS / 2];  // q15, symmetric: first half only
+static uint8_t cic_a_rate, cic_b_rate;
+static int8_t gain_shift;           // CIC gain (log2) above ZOOM_FRAC
+
+// Integrators wrap (unsigned arithmetic); the combs recover the true value
+// as long as it fits: 16 mixer bits + 4 * log2(16) in 32 bits for stage A,
+// plus up to 4 * log2(128) more in 64 bits for stage B
+static struct {
+    uint32_t nco_phase;
+    uint32_t a_integ[2][ZOOM_CIC_ORDER], a_comb[2][ZOOM_CIC_ORDER];
+    uint64_t b_integ[2][ZOOM_CIC_ORDER], b_comb[2][ZOOM_CIC_ORDER];
+    uint8_t b_count;
+    int32_t fir_delay[2][2 * ZOOM_FIR_TAPS];  // Doubled so a window never wraps
+    uint8_t fir_pos, fir_phase;
+    uint16_t settle;                // Outputs dropped while the filters fill
+    uint32_t head, fresh;           // Ring write index, outputs since zoom_take()
+} zs;
+
+/* ==================== RING ==================== */
+// ADC counts << ZOOM_FRAC to the FFT engine's input scale (the same the
+// rfft path feeds: counts, counts << 3 in q15, counts << 19 in q31)
+static inline fft_sample_t zoom_sample(int32_t v) {
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    v >>= ZOOM_FRAC - 3;
+    return (q15_t)((v > 32767) ? 32767 : (v < -32768) ? -32768 : v);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    int64_t s = (int64_t)v * (1 << (19 - ZOOM_FRAC));
+    return (q31_t)((s > INT32_MAX) ? INT32_MAX : (s < INT32_MIN) ? INT32_MIN : s);
+#else
+    return (float32_t)v * (1.0f / (1 << ZOOM_FRAC));
+#endif
+}
+
+static void ring_push(int32_t vi, int32_t vq) {
+    if(zs.settle) { zs.settle--; return; }
+    fft_output[2 * zs.head] = zoom_sample(vi);
+    fft_output[2 * zs.head + 1] = zoom_sample(vq);
+    zs.head = (zs.head + 1) & (ZOOM_BINS - 1);
+    zs.fresh++;
+}
+
+/* ==================== FIR (DECIMATE BY 2) ==================== */
+static void fir_push(int32_t vi, int32_t vq) {
+    zs.fir_pos = zs.fir_pos ? zs.fir_pos - 1 : ZOOM_FIR_TAPS - 1;
+    zs.fir_delay[0][zs.fir_pos] = zs.fir_delay[0][zs.fir_pos + ZOOM_FIR_TAPS] = vi;
+    zs.fir_delay[1][zs.fir_pos] = zs.fir_delay[1][zs.fir_pos + ZOOM_FIR_TAPS] = vq;
+    if((zs.fir_phase ^= 1)) return;
+
+    // Symmetric taps: fold the window first, one MAC per tap pair
+    const int32_t *di = &zs.fir_delay[0][zs.fir_pos], *dq = &zs.fir_delay[1][zs.fir_pos];
+    int64_t ai = 0, aq = 0;
+    for(uint32_t k = 0; k < ZOOM_FIR_TAPS / 2; k++) {
+        int32_t t = fir_taps[k];
+        ai += (int64_t)(di[k] + di[ZOOM_FIR_TAPS - 1 - k]) * t;
+        aq += (int64_t)(dq[k] + dq[ZOOM_FIR_TAPS - 1 - k]) * t;
+    }
+    ring_push((int32_t)(ai >> 15), (int32_t)(aq >> 15));
+}
+
+/* ==================== CIC STAGES ==================== */
+// Unity gain in ADC counts << ZOOM_FRAC, whatever the decimation
+static inline int32_t cic_scale(int64_t v) {
+    if(gain_shift <= 0) return (int32_t)(v * ((int64_t)1 << -gain_shift));
+    return (int32_t)((v + ((int64_t)1 << (gain_shift - 1))) >> gain_shift);
+}
+
+static void cic_b_push(int32_t vi, int32_t vq) {
+    if(cic_b_rate == 1) {
+        fir_push(cic_scale(vi), cic_scale(vq));
+        return;
+    }
+
+    uint64_t *si = zs.b_integ[0], *sq = zs.b_integ[1];
+    si[0] += (uint64_t)(int64_t)vi;
+    sq[0] += (uint64_t)(int64_t)vq;
+    for(uint32_t k = 1; k < ZOOM_CIC_ORDER; k++) {
+        si[k] += si[k - 1];
+        sq[k] += sq[k - 1];
+    }
+    if(++zs.b_count < cic_b_rate) return;
+    zs.b_count = 0;
+
+    uint64_t oi = si[ZOOM_CIC_ORDER - 1], oq = sq[ZOOM_CIC_ORDER - 1];
+    for(uint32_t k = 0; k < ZOOM_CIC_ORDER; k++) {
+        uint64_t yi = oi - zs.b_comb[0][k], yq = oq - zs.b_comb[1][k];
+        zs.b_comb[0][k] = oi; zs.b_comb[1][k] = oq;
+        oi = yi; oq = yq;
+    }
+    fir_push(cic_scale((int64_t)oi), cic_scale((int64_t)oq));
+}
+
+static void cic_a_comb(uint32_t oi, uint32_t oq) {
+    for(uint32_t k = 0; k < ZOOM_CIC_ORDER; k++) {
+        uint32_t yi = oi - zs.a_comb[0][k], yq = oq - zs.a_comb[1][k];
+        zs.a_comb[0][k] = oi; zs.a_comb[1][k] = oq;
+        oi = yi; oq = yq;
+    }
+    cic_b_push((int32_t)oi, (int32_t)oq);
+}
+
+/* ==================== MIXER + STAGE A ==================== */
+// The hot loop: one table lookup pair, two multiplies and eight adds per
+// ADC sample, with the integrators kept in registers
+void zoom_feed(const uint16_t *src, uint32_t n) {
+    if(!band.decimation) return;
+
+    uint32_t phase = zs.nco_phase;
+    const uint32_t step = nco_step, rate = cic_a_rate;
+    uint32_t i0 = zs.a_integ[0][0], i1 = zs.a_integ[0][1], i2 = zs.a_integ[0][2], i3 = zs.a_integ[0][3];
+    uint32_t q0 = zs.a_integ[1][0], q1 = zs.a_integ[1][1], q2 = zs.a_integ[1][2], q3 = zs.a_integ[1][3];
+
+    for(uint32_t blk = 0; blk + rate <= n; blk += rate) {
+        for(uint32_t j = blk; j < blk + rate; j++) {
+            int32_t x = (int32_t)src[j] - ZOOM_ADC_MID;
+            uint32_t k = phase >> (32 - ZOOM_NCO_BITS);
+            phase += step;
+            // x * 2cos, x * -2sin: doubled so a real tone keeps its amplitude,
+            // rounded so truncation doesn't leave a DC line at the centre
+            i0 += (uint32_t)((x * nco_cos[k] + MIX_ROUND) >> (14 - MIX_FRAC));
+            q0 += (uint32_t)((x * nco_cos[(k + NCO_QUARTER) & (NCO_SIZE - 1)] + MIX_ROUND) >> (14 - MIX_FRAC));
+            i1 += i0; i2 += i1; i3 += i2;
+            q1 += q0; q2 += q1; q3 += q2;
+        }
+        cic_a_comb(i3, q3);
+    }
+
+    zs.nco_phase = phase;
+    zs.a_integ[0][0] = i0; zs.a_integ[0][1] = i1; zs.a_integ[0][2] = i2; zs.a_integ[0][3] = i3;
+    zs.a_integ[1][0] = q0; zs.a_integ[1][1] = q1; zs.a_integ[1][2] = q2; zs.a_integ[1][3] = q3;
+}
+
+/* ==================== CONFIGURATION ==================== */
+// |sin(pi f r) / (r sin(pi f))|^order: one CIC stage at its input rate
+static float32_t cic_stage(float32_t f, uint32_t r) {
+    float32_t d = r * arm_sin_f32(PI * f);
+    float32_t g = (d > 1e-9f || d < -1e-9f) ? arm_sin_f32(PI * f * r) / d : 1.0f;
+    float32_t h = 1.0f;
+    for(uint32_t k = 0; k < ZOOM_CIC_ORDER; k++) h *= g;
+    return (h < 0) ? -h : h;
+}
+
+// Windowed (Blackman) frequency-sampling design at the CIC output rate:
+// the inverse CIC droop up to a quarter of it (half the output rate), zero
+// beyond, normalised to unity DC gain
+static void fir_design(void) {
+    float32_t inv[FIR_GRID], h[ZOOM_FIR_TAPS / 2], sum = 0;
+    const float32_t cutoff = 0.25f;
+    const uint32_t half = (uint32_t)cic_a_rate * cic_b_rate;
+
+    for(uint32_t g = 0; g < FIR_GRID; g++) {
+        float32_t f = (g + 0.5f) * cutoff / FIR_GRID;
+        float32_t r = cic_stage(f / half, cic_a_rate);
+        if(cic_b_rate > 1) r *= cic_stage(f / cic_b_rate, cic_b_rate);
+        inv[g] = 1.0f / r;
+    }
+
+    for(uint32_t k = 0; k < ZOOM_FIR_TAPS / 2; k++) {
+        float32_t t = k - (ZOOM_FIR_TAPS - 1) / 2.0f;
+        float32_t acc = 0;
+        for(uint32_t g = 0; g < FIR_GRID; g++)
+            acc += inv[g] * arm_cos_f32(2.0f * PI * (g + 0.5f) * cutoff / FIR_GRID * t);
+        float32_t x = 2.0f * PI * k / (ZOOM_FIR_TAPS - 1);
+        h[k] = acc * (0.42f - 0.5f * arm_cos_f32(x) + 0.08f * arm_cos_f32(2.0f * x));
+        sum += 2.0f * h[k];
+    }
+
+    for(uint32_t k = 0; k < ZOOM_FIR_TAPS / 2; k++) {
+        float32_t v = h[k] / sum * 32768.0f;
+        fir_taps[k] = (int16_t)(v + ((v >= 0) ? 0.5f : -0.5f));
+    }
+}
+
+void zoom_configure(uint32_t center_hz, uint32_t span_hz, uint32_t sample_rate) {
+    memset(&band, 0, sizeof(band));
+    if(!span_hz || !sample_rate) return;
+
+    if(nco_cos[0] == 0) {
+        for(uint32_t k = 0; k < NCO_SIZE; k++) {
+            float32_t c = arm_cos_f32(2.0f * PI * k / NCO_SIZE) * 32767.0f;
+            nco_cos[k] = (int16_t)(c + ((c >= 0) ? 0.5f : -0.5f));
+        }
+    }
+
+    // Narrowest power-of-two band that still covers the span
+    uint32_t d = ZOOM_MIN_DECIMATION;
+    uint8_t log2 = 2;
+    while(d < ZOOM_MAX_DECIMATION && sample_rate / (2 * d) >= span_hz) { d *= 2; log2++; }
+
+    // Keep the band between DC and Nyquist: no mirror images in view
+    uint32_t half_band = sample_rate / d / 2;
+    if(center_hz < half_band) center_hz = half_band;
+    if(center_hz > sample_rate / 2 - half_band) center_hz = sample_rate / 2 - half_band;
+
+    band.center_hz = center_hz;
+    band.decimation = d;
+    band.log2 = log2;
+    band.rate_hz = (float32_t)sample_rate / d;
+    nco_step = (uint32_t)(((uint64_t)center_hz << 32) / sample_rate);
+
+    // The FIR takes the last factor of 2, stage A as much of the rest as fits 32 bits
+    cic_a_rate = (d / 2 > ZOOM_CIC_A_MAX) ? ZOOM_CIC_A_MAX : d / 2;
+    cic_b_rate = (d / 2) / cic_a_rate;
+    gain_shift = ZOOM_CIC_ORDER * (log2 - 1) + MIX_FRAC - ZOOM_FRAC;
+    fir_design();
+    zoom_reset();
+}
+
+const ZoomBand *zoom_band(void) {
+    return &band;
+}
+
+void zoom_reset(void) {
+    memset(&zs, 0, sizeof(zs));
+    zs.settle = ZOOM_FIR_TAPS;
+    if(band.decimation) memset(fft_output, 0, 2 * ZOOM_BINS * sizeof(fft_sample_t));
+}
+
+uint8_t zoom_ready(void) {
+    return band.decimation && zs.fresh >= ZOOM_HOP;
+}
+
+uint32_t zoom_take(void) {
+    zs.fresh = 0;
+    return zs.head;
+}
@@ -6,14 +6,35 @@
 
 // ==================== Private Defines ====================
 #define SSD1306_I2C_ADDR    0x78    // 0x3C << 1 (Change to 0x7A if 0x78 doesn't work)
-#define SSD1306_WIDTH       128
-#define SSD1306_HEIGHT      64
+#define SSD1306_FB_SIZE     (SSD1306_WIDTH * SSD1306_HEIGHT / 8)
+#define SSD1306_CTRL_CMD    0x00    // Control byte: command stream
+#define SSD1306_CTRL_DATA   0x40    // Control byte: GDDRAM data stream
 
 // IMPORTANT: Change this to match your I2C peripheral
 extern I2C_HandleTypeDef hi2c1;  // Change to hi2c2 if you enabled I2C2 in CubeMX
 
 // ==================== Private Variables ====================
-static uint8_t ssd1306_buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+// Double buffer: drawing goes to the back buffer while DMA sends the front
+static uint8_t ssd1306_fb[2][SSD1306_FB_SIZE] __attribute__((aligned(4)));
+static uint8_t *ssd1306_buffer = ssd1306_fb[0];
+static uint8_t *ssd1306_front = ssd1306_fb[1];
+
+typedef enum {
+    OLED_IDLE = 0,
+    OLED_PREAMBLE,          // Column/page window being set
+    OLED_DATA               // Window contents streaming
+} OledState;
+
+static volatile OledState oled_state = OLED_IDLE;
+static volatile uint32_t oled_errors = 0;
+static volatile uint8_t oled_resync = 1;    // Panel contents unknown: send everything
+
+// Dirty span per page (lo > hi = clean), consumed by the transfer chain
+static uint8_t dirty_lo[SSD1306_PAGES], dirty_hi[SSD1306_PAGES];
+static uint8_t tx_page;                     // Next page to schedule
+static uint8_t tx_window[6];                // Column range, page range
+static uint8_t *tx_data;
+static uint16_t tx_len;
 
 // ==================== Font Data ====================
 // Simple 5x7 font (only printable ASCII 32-90)
@@ -79,58 +100,152 @@ static const uint8_t font5x7[][5] = {
     {0x61, 0x59, 0x49, 0x4D, 0x43}, // Z
 };
 
-void ssd1306_command(uint8_t cmd) {
-    uint8_t data[2] = {0x00, cmd};
-    HAL_I2C_Master_Transmit(&hi2c1, SSD1306_I2C_ADDR, data, 2, 100);
-}
-
 void ssd1306_init(void) {
+    static uint8_t init_seq[] = {
+        0xAE,       // Display off
+        0x20, 0x00, // Horizontal addressing mode
+        0xB0,       // Set page start address
+        0xC8,       // Set COM scan direction
+        0x00,       // Set low column address
+        0x10,       // Set high column address
+        0x40,       // Set start line address
+        0x81, 0xFF, // Max contrast
+        0xA1,       // Set segment re-map
+        0xA6,       // Normal display
+        0xA8, 0x3F, // 1/64 duty
+        0xA4,       // Display all on resume
+        0xD3, 0x00, // No display offset
+        0xD5, 0xF0, // Fastest display clock
+        0xD9, 0x22, // Set pre-charge period
+        0xDA, 0x12, // Set COM pins
+        0xDB, 0x20, // Set VCOMH
+        0x8D, 0x14, // Enable charge pump
+        0xAF        // Display on
+    };
+
     HAL_Delay(100);
-    ssd1306_command(0xAE); // Display off
-    ssd1306_command(0x20); // Set memory addressing mode
-    ssd1306_command(0x00); // Horizontal addressing mode
-    ssd1306_command(0xB0); // Set page start address
-    ssd1306_command(0xC8); // Set COM scan direction
-    ssd1306_command(0x00); // Set low column address
-    ssd1306_command(0x10); // Set high column address
-    ssd1306_command(0x40); // Set start line address
-    ssd1306_command(0x81); // Set contrast
-    ssd1306_command(0xFF); // Max contrast
-    ssd1306_command(0xA1); // Set segment re-map
-    ssd1306_command(0xA6); // Normal display
-    ssd1306_command(0xA8); // Set multiplex ratio
-    ssd1306_command(0x3F); // 1/64 duty
-    ssd1306_command(0xA4); // Display all on resume
-    ssd1306_command(0xD3); // Set display offset
-    ssd1306_command(0x00); // No offset
-    ssd1306_command(0xD5); // Set display clock
-    ssd1306_command(0xF0); // Fastest
-    ssd1306_command(0xD9); // Set pre-charge period
-    ssd1306_command(0x22);
-    ssd1306_command(0xDA); // Set COM pins
-    ssd1306_command(0x12);
-    ssd1306_command(0xDB); // Set VCOMH
-    ssd1306_command(0x20);
-    ssd1306_command(0x8D); // Enable charge pump
-    ssd1306_command(0x14);
-    ssd1306_command(0xAF); // Display on
+    oled_state = OLED_IDLE;
+    oled_resync = 1;
+    HAL_I2C_Mem_Write(&hi2c1, SSD1306_I2C_ADDR, SSD1306_CTRL_CMD, I2C_MEMADD_SIZE_8BIT,
+                      init_seq, sizeof(init_seq), 100);
 }
 
 void ssd1306_clear(void) {
-    memset(ssd1306_buffer, 0, sizeof(ssd1306_buffer));
+    memset(ssd1306_buffer, 0, SSD1306_FB_SIZE);
+}
+
+uint8_t ssd1306_ready(void) {
+    return oled_state == OLED_IDLE;
 }
 
-void ssd1306_update(void) {
-    for(uint8_t page = 0; page < 8; page++) {
-        ssd1306_command(0xB0 + page);
-        ssd1306_command(0x00);
-        ssd1306_command(0x10);
+// Columns that differ between the drawn frame and what the panel shows,
+// compared a word at a time (buffers are 4-byte aligned)
+static void find_dirty(const uint8_t *next, const uint8_t *shown) {
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        const uint32_t *a = (const uint32_t *)(next + page * SSD1306_WIDTH);
+        const uint32_t *b = (const uint32_t *)(shown + page * SSD1306_WIDTH);
+        int16_t lo = 0, hi = SSD1306_WIDTH / 4 - 1;
+
+        if(oled_resync) {
+            dirty_lo[page] = 0;
+            dirty_hi[page] = SSD1306_WIDTH - 1;
+            continue;
+        }
 
-        uint8_t data[SSD1306_WIDTH + 1];
-        data[0] = 0x40; // Data mode
-        memcpy(&data[1], &ssd1306_buffer[SSD1306_WIDTH * page], SSD1306_WIDTH);
-        HAL_I2C_Master_Transmit(&hi2c1, SSD1306_I2C_ADDR, data, SSD1306_WIDTH + 1, 100);
+        while(lo <= hi && a[lo] == b[lo]) lo++;
+        while(hi >= lo && a[hi] == b[hi]) hi--;
+        if(lo > hi) {
+            dirty_lo[page] = 1;
+            dirty_hi[page] = 0;
+            continue;
+        }
+
+        // Narrow the first and last word down to bytes
+        const uint8_t *pa = next + page * SSD1306_WIDTH, *pb = shown + page * SSD1306_WIDTH;
+        uint8_t c0 = lo * 4, c1 = hi * 4 + 3;
+        while(pa[c0] == pb[c0]) c0++;
+        while(pa[c1] == pb[c1]) c1--;
+        dirty_lo[page] = c0;
+        dirty_hi[page] = c1;
     }
+    oled_resync = 0;
+}
+
+// Queue the window for the next dirty run: consecutive full-width pages are
+// contiguous in the framebuffer and go out as one window
+static uint8_t start_next_span(void) {
+    while(tx_page < SSD1306_PAGES && dirty_lo[tx_page] > dirty_hi[tx_page]) tx_page++;
+    if(tx_page >= SSD1306_PAGES) return 0;
+
+    uint8_t first = tx_page, lo = dirty_lo[first], hi = dirty_hi[first];
+    tx_page++;
+    if(lo == 0 && hi == SSD1306_WIDTH - 1) {
+        while(tx_page < SSD1306_PAGES && dirty_lo[tx_page] == 0 &&
+              dirty_hi[tx_page] == SSD1306_WIDTH - 1) tx_page++;
+    }
+
+    tx_window[0] = 0x21; tx_window[1] = lo; tx_window[2] = hi;
+    tx_window[3] = 0x22; tx_window[4] = first; tx_window[5] = tx_page - 1;
+    tx_data = ssd1306_front + first * SSD1306_WIDTH + lo;
+    tx_len = (tx_page - first) * (hi - lo + 1);
+
+    oled_state = OLED_PREAMBLE;
+    if(HAL_I2C_Mem_Write_DMA(&hi2c1, SSD1306_I2C_ADDR, SSD1306_CTRL_CMD, I2C_MEMADD_SIZE_8BIT,
+                             tx_window, sizeof(tx_window)) == HAL_OK) return 1;
+
+    oled_errors++;
+    oled_resync = 1;
+    oled_state = OLED_IDLE;
+    return 0;
+}
+
+// Swap buffers and queue only the spans that changed since the last frame
+uint8_t ssd1306_update(void) {
+    if(oled_state != OLED_IDLE) return 0;
+
+    find_dirty(ssd1306_buffer, ssd1306_front);
+
+    uint8_t *sent = ssd1306_front;
+    ssd1306_front = ssd1306_buffer;
+    ssd1306_buffer = sent;
+
+    tx_page = 0;
+    start_next_span();
+    return 1;
+}
+
+uint32_t ssd1306_error_count(void) {
+    return oled_errors;
+}
+
+// I2C memory-write complete (interrupt context): window set -> data, data -> next span
+void ssd1306_tx_isr(void) {
+    if(oled_state == OLED_PREAMBLE) {
+        oled_state = OLED_DATA;
+        if(HAL_I2C_Mem_Write_DMA(&hi2c1, SSD1306_I2C_ADDR, SSD1306_CTRL_DATA, I2C_MEMADD_SIZE_8BIT,
+                                 tx_data, tx_len) == HAL_OK) return;
+        oled_errors++;
+        oled_resync = 1;
+    } else if(oled_state == OLED_DATA && start_next_span()) {
+        return;
+    }
+    oled_state = OLED_IDLE;
+}
+
+// NACK / bus error: drop the frame; the panel is resent in full next time
+void ssd1306_error_isr(void) {
+    oled_errors++;
+    oled_resync = 1;
+    oled_state = OLED_IDLE;
+}
+
+// Layers: whole pages copied in/out of the drawing buffer
+void ssd1306_save_pages(uint8_t *dst, uint8_t first, uint8_t count) {
+    memcpy(dst, ssd1306_buffer + first * SSD1306_WIDTH, count * SSD1306_WIDTH);
+}
+
+void ssd1306_load_pages(const uint8_t *src, uint8_t first, uint8_t count) {
+    memcpy(ssd1306_buffer + first * SSD1306_WIDTH, src, count * SSD1306_WIDTH);
 }
 
 void ssd1306_draw_pixel(uint8_t x, uint8_t y, uint8_t color) {
@@ -142,6 +257,27 @@ void ssd1306_draw_pixel(uint8_t x, uint8_t y, uint8_t color) {
         ssd1306_buffer[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y % 8));
 }
 
+// Vertical run y0..y1 (inclusive) in column x: whole page bytes, edge masks from tables
+static const uint8_t mask_from[8] = {0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80};
+static const uint8_t mask_to[8]   = {0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF};
+
+void ssd1306_draw_vline(uint8_t x, uint8_t y0, uint8_t y1) {
+    if(y0 > y1) { uint8_t t = y0; y0 = y1; y1 = t; }
+    if(x >= SSD1306_WIDTH || y0 >= SSD1306_HEIGHT) return;
+    if(y1 >= SSD1306_HEIGHT) y1 = SSD1306_HEIGHT - 1;
+
+    uint8_t *col = ssd1306_buffer + x;
+    uint8_t p0 = y0 >> 3, p1 = y1 >> 3;
+    if(p0 == p1) {
+        col[p0 * SSD1306_WIDTH] |= mask_from[y0 & 7] & mask_to[y1 & 7];
+        return;
+    }
+
+    col[p0 * SSD1306_WIDTH] |= mask_from[y0 & 7];
+    for(uint8_t p = p0 + 1; p < p1; p++) col[p * SSD1306_WIDTH] = 0xFF;
+    col[p1 * SSD1306_WIDTH] |= mask_to[y1 & 7];
+}
+
 void ssd1306_draw_char(uint8_t x, uint8_t y, char c) {
     if(c < 32 || c > 90) c = 32; // Only support space to Z
 